@@ -2063,8 +2063,9 @@ ssl_info_callback(SSL *ssl, int what, int ret)
 //
 
 int
-stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
+stcp_init_ssl( SSL_CTX **pssl_ctx, struct stcp_secure_options *secure_opts )
 {
+    SSL_CTX *ssl_ctx;
     __attribute__((unused))int callback_ret;
     int should_verify_peer;
     int peer_certificate_optional;
@@ -2076,11 +2077,13 @@ stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
     md5_state_t md5state;
     __attribute__((unused))int protocol_ver;
     
-    /* Must have secure options */
-    if ( NULL == secure_opts ) {
+    /* Must have secure options and somewhere to return the context */
+    if ( ( NULL == pssl_ctx ) || ( NULL == secure_opts ) ) {
         return 0;
     }
 
+    *pssl_ctx = NULL;
+
     /* 
         If PEM file is not specified and the init_ssl callback
         is not specified, skip SSL initialization.
@@ -2179,11 +2182,31 @@ stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
                                     (const unsigned char *)&ssl_context_id,
                                     sizeof( ssl_context_id ) );
 
+    // Session resumption. Resumed sessions skip the certificate exchange
+    // and key agreement, which is what makes reconnects cheap. Sessions
+    // are kept in the server cache and/or handed to the client as tickets.
+    if ( secure_opts->session_cache_size > 0 ) {
+        SSL_CTX_set_session_cache_mode( ssl_ctx, SSL_SESS_CACHE_SERVER );
+        SSL_CTX_sess_set_cache_size( ssl_ctx, secure_opts->session_cache_size );
+    }
+    else {
+        SSL_CTX_set_session_cache_mode( ssl_ctx, SSL_SESS_CACHE_OFF );
+    }
+
+    if ( secure_opts->session_timeout > 0 ) {
+        SSL_CTX_set_timeout( ssl_ctx, secure_opts->session_timeout );
+    }
+
+    if ( !secure_opts->session_tickets ) {
+        SSL_CTX_set_options( ssl_ctx, SSL_OP_NO_TICKET );
+    }
+
     if ( secure_opts->pem != NULL ) {
 
         if ( !ssl_use_pem_file( ssl_ctx, 
                                     secure_opts->pem, 
                                     secure_opts->chain ) ) {
+            SSL_CTX_free( ssl_ctx );
             return 0;
         }
     }
@@ -2219,6 +2242,7 @@ stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
                         "present in "
                         "the .conf file?",
                         stcp_ssl_error() );
+            SSL_CTX_free( ssl_ctx );
             return 0;
         }
 
@@ -2236,6 +2260,7 @@ stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
                 ( SSL_CTX_set_default_verify_paths( ssl_ctx ) != 1 ) ) {
             stcp_report_error( "SSL_CTX_set_default_verify_paths error: %s",
                                 stcp_ssl_error() );
+            SSL_CTX_free( ssl_ctx );
             return 0;
         }
 
@@ -2243,10 +2268,16 @@ stcp_init_ssl( SSL_CTX *ssl_ctx, struct stcp_secure_options *secure_opts )
 
     }
 
-    if ( SSL_CTX_set_cipher_list( ssl_ctx, STCP_SSL_CIPHER_LIST ) != 1 ) {
+    if ( SSL_CTX_set_cipher_list( ssl_ctx,
+                                    ( ( NULL != secure_opts->chipher_list ) &&
+                                      *secure_opts->chipher_list ) ?
+                                        secure_opts->chipher_list :
+                                        STCP_SSL_CIPHER_LIST ) != 1 ) {
         stcp_report_error( "SSL_CTX_set_cipher_list error: %s", stcp_ssl_error() );
     }
 
+    *pssl_ctx = ssl_ctx;
+
     return 1;
 }
 
@@ -2529,11 +2560,15 @@ stcp_connect_remote_impl( const char *host,
     }
 
     if ( bUseSSL ) {
-        // Init SSL subsystem
-        if ( 0 == stcp_init_ssl( conn->ssl_ctx, secure_options ) ) {
+        // Init SSL subsystem. The server context is not used by a client.
+        SSL_CTX *srv_ctx = NULL;
+        if ( 0 == stcp_init_ssl( &srv_ctx, secure_options ) ) {
             free( conn );
             return NULL;
         }
+        if ( NULL != srv_ctx ) {
+            SSL_CTX_free( srv_ctx );
+        }
     }
 
     if ( !stcp_connect_socket( host,
@@ -3529,6 +3564,69 @@ stcp_write( struct stcp_connection *conn, const void *buf, size_t len )
     return (int)total;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// stcp_write_nonblocking
+//
+
+int
+stcp_write_nonblocking( struct stcp_connection *conn, 
+                            const void *buf, 
+                            size_t len )
+{
+    int n, err;
+
+    if ( ( NULL == conn ) || ( NULL == buf ) ) {
+        return -2;
+    }
+    
+    if ( 0 == len ) return 0;
+
+    if ( len > INT_MAX ) {
+        len = INT_MAX;
+    }
+
+    if ( conn->ssl != NULL ) {
+
+        // Take what fits in one go. A write that could not be done is
+        // retried with the same data but it may have moved.
+        SSL_set_mode( conn->ssl, 
+                        SSL_MODE_ENABLE_PARTIAL_WRITE | 
+                        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER );
+
+        n = SSL_write( conn->ssl, buf, (int)len );
+        if ( n <= 0 ) {
+            err = SSL_get_error( conn->ssl, n );
+            if ( ( err == SSL_ERROR_WANT_READ ) ||
+                 ( err == SSL_ERROR_WANT_WRITE ) ) {
+                return 0;
+            }
+            return -2;
+        }
+
+        return n;
+    }
+
+    n = (int)send( conn->client.sock, buf, len, MSG_NOSIGNAL );
+    if ( n < 0 ) {
+        err = ERRNO;
+#ifdef _WIN32
+        if ( err == WSAEWOULDBLOCK ) {
+            return 0;
+        }
+#else
+        if ( ( err == EWOULDBLOCK ) || ( err == EAGAIN ) || ( err == EINTR ) ) {
+            return 0;
+        }
+        else if ( err == EPIPE ) {  // Broken pipe
+            conn->conn_state = STCP_CONN_STATE_UNDEFINED;
+        }
+#endif
+        return -2;
+    }
+
+    return n;
+}
+
 
 // -----------------------------------------------------------------------------
 //                                  S E R V E R
@@ -4129,11 +4227,6 @@ void stcp_init_client_connection( struct stcp_connection *conn,
         return;
     }
 
-    // If secure then secure options must be set
-    if ( conn->client.is_ssl && ( NULL == secure_opts ) ) {
-        return;
-    }
-
     conn->conn_state = STCP_CONN_STATE_CONNECTED;
 
     conn->birth = time( NULL );
@@ -4152,7 +4245,9 @@ void stcp_init_client_connection( struct stcp_connection *conn,
                             sizeof( conn->remote_addr ),
                             &conn->client.rsa );
 
-    if ( conn->client.is_ssl ) {
+    // Without secure options the handshake of a secure connection is
+    // left to the caller (stcp_ssl_accept_nonblocking)
+    if ( conn->client.is_ssl && ( NULL != secure_opts ) ) {
 
         // Secure connection
         if ( make_ssl( conn,
@@ -4170,6 +4265,71 @@ void stcp_init_client_connection( struct stcp_connection *conn,
 
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// stcp_ssl_accept_nonblocking
+//
+// One step of the server side handshake. The socket is non blocking so
+// SSL_accept return as soon as it needs more data from the client or can't
+// write more. The caller wait for the socket to become readable/writable
+// and call again.
+//
+
+int stcp_ssl_accept_nonblocking( struct stcp_connection *conn,
+                                    SSL_CTX *ssl_ctx )
+{
+    int ret, err;
+
+    if ( ( NULL == conn ) || ( NULL == ssl_ctx ) ) {
+        return STCP_SSL_HANDSHAKE_ERROR;
+    }
+
+    // First call creates the SSL descriptor
+    if ( NULL == conn->ssl ) {
+
+        if ( NULL == ( conn->ssl = SSL_new( ssl_ctx ) ) ) {
+            return STCP_SSL_HANDSHAKE_ERROR;
+        }
+
+        SSL_set_app_data( conn->ssl, (char *)conn );
+
+        if ( 1 != SSL_set_fd( conn->ssl, conn->client.sock ) ) {
+            SSL_free( conn->ssl );
+            conn->ssl = NULL;
+            return STCP_SSL_HANDSHAKE_ERROR;
+        }
+    }
+
+    ret = SSL_accept( conn->ssl );
+    if ( 1 == ret ) {
+        return STCP_SSL_HANDSHAKE_DONE;
+    }
+
+    err = SSL_get_error( conn->ssl, ret );
+    if ( SSL_ERROR_WANT_READ == err ) {
+        return STCP_SSL_HANDSHAKE_WANT_READ;
+    }
+    else if ( SSL_ERROR_WANT_WRITE == err ) {
+        return STCP_SSL_HANDSHAKE_WANT_WRITE;
+    }
+
+    // Failed handshake. The descriptor is freed with the connection.
+    ERR_clear_error();
+    return STCP_SSL_HANDSHAKE_ERROR;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// stcp_ssl_session_reused
+//
+
+int stcp_ssl_session_reused( struct stcp_connection *conn )
+{
+    if ( ( NULL == conn ) || ( NULL == conn->ssl ) ) {
+        return 0;
+    }
+
+    return SSL_session_reused( conn->ssl ) ? 1 : 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // stcp_socket_get_address
 //
@@ -98,6 +98,12 @@ extern "C" {
 //#define STCP_SSL_CIPHER_LIST            "kEECDH:kEDH:kRSA:AESGCM:AES256:AES128:3DES:SHA256:SHA84:SHA1:!aNULL:!eNULL:!EXP:!LOW:!MEDIUM!ADH:!AECDH"
 #define STCP_SSL_SHORT_TRUST             (0)
 
+/* Result of one step of a non blocking server handshake */
+#define STCP_SSL_HANDSHAKE_ERROR         (-1)
+#define STCP_SSL_HANDSHAKE_DONE          (0)
+#define STCP_SSL_HANDSHAKE_WANT_READ     (1)
+#define STCP_SSL_HANDSHAKE_WANT_WRITE    (2)
+
 /*
 "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
     "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
@@ -209,6 +215,9 @@ struct stcp_secure_options
     int default_verify_path;    /* 0 == no, 1 == yes */
     int verify_depth;           /* Set to zero for default */
     char *chipher_list;         /* NULL for default */
+    int session_cache_size;     /* Sessions cached for resumption, 0 == no cache */
+    long session_timeout;       /* Seconds a session can be resumed, 0 == default */
+    int session_tickets;        /* 0 == no session tickets */
 
     /* 
         Ths flag should be set to non zero if the multi thread 
@@ -277,7 +286,7 @@ stcp_init_mt_ssl(void);
     @return Non zero on success, zero on failure.
 */
 int
-stcp_init_ssl( SSL_CTX *ssl_ctx, 
+stcp_init_ssl( SSL_CTX **pssl_ctx, 
                 struct stcp_secure_options *secure_opts );
 
 /*!
@@ -348,6 +357,22 @@ stcp_read( struct stcp_connection *conn, void *buf, size_t len, int mstimeout );
 int
 stcp_write( struct stcp_connection *conn, const void *buf, size_t len );
 
+/*!
+ * Write data to remote without waiting for the socket. Only what 
+ * the socket (or TLS layer) can take right now is written.
+ * 
+ * @param conn Connection to write to.
+ * @buf Buffer with data to write.
+ * @len Number of chars to write.
+ * @return >= 0 Number of characters written, 0 if the socket is full.
+ *            -2 = error.
+ */
+
+int
+stcp_write_nonblocking( struct stcp_connection *conn, 
+                            const void *buf, 
+                            size_t len );
+
 
 /*!
  * Poll for action on an array with file descriptors
@@ -407,11 +432,34 @@ stcp_close_all_listening_sockets( struct server_context *srv_ctx );
 /*!
     INit data for a connected client (after accept)
     @param conn Pointer to client connection object
-    TODO args docs
+    @param secure_opts Settings for ssl. If NULL the handshake of a secure
+            connection is not done here and must be done with
+            stcp_ssl_accept_nonblocking.
 */
 void stcp_init_client_connection( struct stcp_connection *conn,
                                     struct stcp_secure_options *secure_opts );
 
+/*!
+    Do one step of the server side handshake of a secure connection
+    on a non blocking socket. Call again when the socket is readable
+    (STCP_SSL_HANDSHAKE_WANT_READ) or writable (STCP_SSL_HANDSHAKE_WANT_WRITE).
+    @param conn Pointer to client connection object
+    @param ssl_ctx Server ssl context
+    @return STCP_SSL_HANDSHAKE_DONE when the handshake is done,
+            STCP_SSL_HANDSHAKE_WANT_READ/STCP_SSL_HANDSHAKE_WANT_WRITE
+            when it is not finished yet and STCP_SSL_HANDSHAKE_ERROR
+            if it failed.
+*/
+int stcp_ssl_accept_nonblocking( struct stcp_connection *conn,
+                                    SSL_CTX *ssl_ctx );
+
+/*!
+    Check if a secure connection resumed a previous session
+    @param conn Pointer to client connection object
+    @return Non zero if the session was resumed.
+*/
+int stcp_ssl_session_reused( struct stcp_connection *conn );
+
 /*!
     Get address from connection (socket)
 
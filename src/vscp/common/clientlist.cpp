@@ -23,11 +23,14 @@
 
 #define _POSIX
 
+#include <algorithm>
+
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <syslog.h>
@@ -73,7 +76,6 @@ CClientItem::CClientItem()
 
     m_dtutc = vscpdatetime::UTCNow();
 
-    sem_init(&m_semClientInputQueue, 0, 0);
     sem_init(&m_hEventSend, 0, 0);
     pthread_mutex_init(&m_mutexClientInputQueue, NULL);
 
@@ -110,16 +112,8 @@ CClientItem::CClientItem()
 
 CClientItem::~CClientItem()
 {
-    std::deque<vscpEvent*>::iterator iter;
-    for (iter = m_clientInputQueue.begin(); iter != m_clientInputQueue.end();
-         ++iter) {
-        vscpEvent* pEvent = *iter;
-        vscp_deleteEvent_v2(&pEvent);
-    }
-    m_clientInputQueue.clear();
-
+    // Queued events are released by the queue
     sem_destroy(&m_hEventSend);
-    sem_destroy(&m_semClientInputQueue);
     pthread_mutex_destroy(&m_mutexClientInputQueue);
 }
 
@@ -130,16 +124,19 @@ CClientItem::~CClientItem()
 bool
 CClientItem::CommandStartsWith(const std::string& cmd, bool bFix)
 {
-    if (!vscp_startsWith(vscp_upper(m_currentCommand), vscp_upper(cmd))) {
+    // Compared in place as this is done for each command the line is
+    // checked against
+    if ((m_currentCommand.length() < cmd.length()) ||
+        (0 != strncasecmp(m_currentCommand.c_str(),
+                          cmd.c_str(),
+                          cmd.length()))) {
         return false;
     }
 
     // If asked to do so remove the command.
     if (bFix) {
         if (m_currentCommand.length() - cmd.length()) {
-            m_currentCommand =
-              vscp_str_right(m_currentCommand,
-                             m_currentCommand.length() - cmd.length() - 1);
+            m_currentCommand.erase(0, cmd.length() + 1);
         } else {
             m_currentCommand.clear();
         }
@@ -189,6 +186,220 @@ CClientItem::getAsString(void)
 
 // ----------------------------------------------------------------------------
 
+///////////////////////////////////////////////////////////////////////////////
+// getGuidPrefixLength
+//
+// Number of leading GUID bytes that are fully masked in a filter
+//
+
+static int
+getGuidPrefixLength(const vscpEventFilter* pFilter)
+{
+    int len = 0;
+    while ((len < 16) && (0xff == pFilter->mask_GUID[len])) {
+        len++;
+    }
+
+    return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeFromBucket
+//
+
+static void
+removeFromBucket(std::vector<CClientItem*>& bucket, CClientItem* pClientItem)
+{
+    std::vector<CClientItem*>::iterator it =
+      std::find(bucket.begin(), bucket.end(), pClientItem);
+    if (bucket.end() != it) {
+        bucket.erase(it);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CSubscriptionIndex
+//
+
+CSubscriptionIndex::CSubscriptionIndex()
+{
+    memset(m_cntGuidPrefix, 0, sizeof(m_cntGuidPrefix));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CSubscriptionIndex
+//
+
+CSubscriptionIndex::~CSubscriptionIndex()
+{
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addClient
+//
+
+void
+CSubscriptionIndex::addClient(CClientItem* pClientItem)
+{
+    int len;
+
+    // Check pointer
+    if (NULL == pClientItem)
+        return;
+
+    // Remember the filter so the client can be found when removed
+    const vscpEventFilter& filter = m_indexedFilter[pClientItem] =
+      pClientItem->m_filter;
+
+    if ((0xffff == filter.mask_class) && (0xffff == filter.mask_type)) {
+        uint32_t key = ((uint32_t)filter.filter_class << 16) + filter.filter_type;
+        m_mapClassType[key].push_back(pClientItem);
+    } else if (0xffff == filter.mask_class) {
+        m_mapClass[filter.filter_class].push_back(pClientItem);
+    } else if ((len = getGuidPrefixLength(&filter)) > 0) {
+        std::string key((const char*)filter.filter_GUID, len);
+        m_mapGuidPrefix[key].push_back(pClientItem);
+        m_cntGuidPrefix[len]++;
+    } else {
+        m_wildcard.push_back(pClientItem);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeClient
+//
+
+void
+CSubscriptionIndex::removeClient(CClientItem* pClientItem)
+{
+    int len;
+
+    std::map<CClientItem*, vscpEventFilter>::iterator it =
+      m_indexedFilter.find(pClientItem);
+    if (m_indexedFilter.end() == it)
+        return;
+
+    const vscpEventFilter& filter = it->second;
+
+    if ((0xffff == filter.mask_class) && (0xffff == filter.mask_type)) {
+        uint32_t key = ((uint32_t)filter.filter_class << 16) + filter.filter_type;
+        std::map<uint32_t, std::vector<CClientItem*> >::iterator it_bucket =
+          m_mapClassType.find(key);
+        if (m_mapClassType.end() != it_bucket) {
+            removeFromBucket(it_bucket->second, pClientItem);
+            if (it_bucket->second.empty()) {
+                m_mapClassType.erase(it_bucket);
+            }
+        }
+    } else if (0xffff == filter.mask_class) {
+        std::map<uint16_t, std::vector<CClientItem*> >::iterator it_bucket =
+          m_mapClass.find(filter.filter_class);
+        if (m_mapClass.end() != it_bucket) {
+            removeFromBucket(it_bucket->second, pClientItem);
+            if (it_bucket->second.empty()) {
+                m_mapClass.erase(it_bucket);
+            }
+        }
+    } else if ((len = getGuidPrefixLength(&filter)) > 0) {
+        std::string key((const char*)filter.filter_GUID, len);
+        std::map<std::string, std::vector<CClientItem*> >::iterator it_bucket =
+          m_mapGuidPrefix.find(key);
+        if (m_mapGuidPrefix.end() != it_bucket) {
+            removeFromBucket(it_bucket->second, pClientItem);
+            if (it_bucket->second.empty()) {
+                m_mapGuidPrefix.erase(it_bucket);
+            }
+        }
+        m_cntGuidPrefix[len]--;
+    } else {
+        removeFromBucket(m_wildcard, pClientItem);
+    }
+
+    m_indexedFilter.erase(it);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// updateClient
+//
+
+void
+CSubscriptionIndex::updateClient(CClientItem* pClientItem)
+{
+    // Only clients already in the index are updated
+    if (m_indexedFilter.end() == m_indexedFilter.find(pClientItem))
+        return;
+
+    removeClient(pClientItem);
+    addClient(pClientItem);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getCandidates
+//
+
+void
+CSubscriptionIndex::getCandidates(std::vector<CClientItem*>& candidates,
+                                  const vscpEvent* pEvent) const
+{
+    // Check pointer
+    if (NULL == pEvent)
+        return;
+
+    candidates.insert(candidates.end(), m_wildcard.begin(), m_wildcard.end());
+
+    uint32_t key = ((uint32_t)pEvent->vscp_class << 16) + pEvent->vscp_type;
+    std::map<uint32_t, std::vector<CClientItem*> >::const_iterator it_ct =
+      m_mapClassType.find(key);
+    if (m_mapClassType.end() != it_ct) {
+        candidates.insert(candidates.end(),
+                          it_ct->second.begin(),
+                          it_ct->second.end());
+    }
+
+    std::map<uint16_t, std::vector<CClientItem*> >::const_iterator it_c =
+      m_mapClass.find(pEvent->vscp_class);
+    if (m_mapClass.end() != it_c) {
+        candidates.insert(candidates.end(),
+                          it_c->second.begin(),
+                          it_c->second.end());
+    }
+
+    if (m_mapGuidPrefix.empty())
+        return;
+
+    for (int len = 1; len <= 16; len++) {
+
+        if (!m_cntGuidPrefix[len])
+            continue;
+
+        std::map<std::string, std::vector<CClientItem*> >::const_iterator it_g =
+          m_mapGuidPrefix.find(std::string((const char*)pEvent->GUID, len));
+        if (m_mapGuidPrefix.end() != it_g) {
+            candidates.insert(candidates.end(),
+                              it_g->second.begin(),
+                              it_g->second.end());
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CSubscriptionIndex::clear(void)
+{
+    m_mapClassType.clear();
+    m_mapClass.clear();
+    m_mapGuidPrefix.clear();
+    m_wildcard.clear();
+    m_indexedFilter.clear();
+    memset(m_cntGuidPrefix, 0, sizeof(m_cntGuidPrefix));
+}
+
+// ----------------------------------------------------------------------------
+
 ///////////////////////////////////////////////////////////////////////////////
 // compareClientItems
 //
@@ -212,6 +423,11 @@ compareClientItems(const uint16_t element1, const uint16_t element2)
 CClientList::CClientList()
 {
     pthread_mutex_init(&m_mutexItemList, NULL);
+
+    m_nShards = 1;
+    for (int i = 0; i < CLIENTLIST_MAX_SHARDS; i++) {
+        pthread_mutex_init(&m_mutexShard[i], NULL);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -222,6 +438,10 @@ CClientList::~CClientList()
 {
     removeAllClients();
     pthread_mutex_destroy(&m_mutexItemList);
+
+    for (int i = 0; i < CLIENTLIST_MAX_SHARDS; i++) {
+        pthread_mutex_destroy(&m_mutexShard[i]);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -298,6 +518,13 @@ CClientList::addClient(CClientItem* pClientItem, uint32_t id)
 
     // Append to list
     m_itemList.push_back(pClientItem);
+    indexGUID(pClientItem);
+
+    // Index the client on its filter
+    uint8_t shard = getShard(pClientItem);
+    lockShard(shard);
+    m_subscriptions[shard].addClient(pClientItem);
+    unlockShard(shard);
 
     return true;
 }
@@ -314,16 +541,17 @@ CClientList::removeClient(CClientItem* pClientItem)
         syslog(LOG_ERR,"removeClient in clientlist but clinet obj is NULL");
         return false;
     }
-     
-    std::deque<vscpEvent*>::iterator iter;
-    for (iter = pClientItem->m_clientInputQueue.begin();
-         iter != pClientItem->m_clientInputQueue.end();
-         ++iter) {
-            
-        vscpEvent* pEvent = *iter;
-        vscp_deleteEvent_v2(&pEvent);
-    }
+
+    // Take the client out of the index first so no more events
+    // can be delivered to it
+    uint8_t shard = getShard(pClientItem);
+    lockShard(shard);
+    m_subscriptions[shard].removeClient(pClientItem);
+    unlockShard(shard);
+
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
     pClientItem->m_clientInputQueue.clear();
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
     // Take away the node
     for (std::deque<CClientItem*>::iterator it = m_itemList.begin();
@@ -331,6 +559,7 @@ CClientList::removeClient(CClientItem* pClientItem)
          ++it) {
         if (*it == pClientItem) {
             m_itemList.erase(it);
+            unindexGUID(pClientItem);
             delete pClientItem;
             return true;
         }
@@ -343,13 +572,123 @@ bool
 CClientList::removeAllClients()  
 {
     pthread_mutex_lock(&m_mutexItemList);
-    // Empty the client list
-    std::deque<CClientItem*>::iterator it;
-    for (it = m_itemList.begin(); it != m_itemList.end(); ++it) {
-        removeClient(*it);
-        delete *it;
+    // Empty the client list (removeClient deletes the client)
+    while (!m_itemList.empty()) {
+        removeClient(m_itemList.front());
+    }
+    m_guidIndex.clear();
+    for (int i = 0; i < m_nShards; i++) {
+        lockShard(i);
+        m_subscriptions[i].clear();
+        unlockShard(i);
     }
-    m_itemList.clear();
+    pthread_mutex_unlock(&m_mutexItemList);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setClientFilter
+//
+
+void
+CClientList::setClientFilter(CClientItem* pClientItem,
+                             const vscpEventFilter* pFilter)
+{
+    // Check pointers
+    if ((NULL == pClientItem) || (NULL == pFilter))
+        return;
+
+    pthread_mutex_lock(&m_mutexItemList);
+    uint8_t shard = getShard(pClientItem);
+    lockShard(shard);
+    memcpy(&pClientItem->m_filter, pFilter, sizeof(vscpEventFilter));
+    m_subscriptions[shard].updateClient(pClientItem);
+    unlockShard(shard);
+    pthread_mutex_unlock(&m_mutexItemList);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setClientGUID
+//
+
+void
+CClientList::setClientGUID(CClientItem* pClientItem, const cguid& guid)
+{
+    // Check pointer
+    if (NULL == pClientItem)
+        return;
+
+    unindexGUID(pClientItem);
+    pClientItem->m_guid = guid;
+    indexGUID(pClientItem);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// indexGUID
+//
+
+void
+CClientList::indexGUID(CClientItem* pClientItem)
+{
+    clientGuidKey key;
+    memcpy(key.id, pClientItem->m_guid.m_id, 16);
+
+    // First client with a GUID owns it
+    m_guidIndex.insert(std::make_pair(key, pClientItem));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unindexGUID
+//
+
+void
+CClientList::unindexGUID(CClientItem* pClientItem)
+{
+    clientGuidKey key;
+    memcpy(key.id, pClientItem->m_guid.m_id, 16);
+
+    std::unordered_map<clientGuidKey, CClientItem*, clientGuidKeyHash>::
+      iterator it = m_guidIndex.find(key);
+    if ((it == m_guidIndex.end()) || (it->second != pClientItem)) {
+        return;
+    }
+
+    m_guidIndex.erase(it);
+
+    // Let the next client with the same GUID take over
+    std::deque<CClientItem*>::iterator itClient;
+    for (itClient = m_itemList.begin(); itClient != m_itemList.end();
+         ++itClient) {
+        if ((*itClient != pClientItem) &&
+            (0 == memcmp((*itClient)->m_guid.m_id, key.id, 16))) {
+            m_guidIndex.insert(std::make_pair(key, *itClient));
+            break;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setShardCount
+//
+
+bool
+CClientList::setShardCount(uint8_t nShards)
+{
+    if ((0 == nShards) || (nShards > CLIENTLIST_MAX_SHARDS)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&m_mutexItemList);
+
+    // Clients are indexed on their shard so the shard count
+    // can't change when there are clients in the list
+    if (!m_itemList.empty()) {
+        pthread_mutex_unlock(&m_mutexItemList);
+        return false;
+    }
+
+    m_nShards = nShards;
     pthread_mutex_unlock(&m_mutexItemList);
 
     return true;
@@ -397,21 +736,18 @@ CClientList::getClientFromOrdinal(uint16_t ordinal)
 //
 
 CClientItem*
-CClientList::getClientFromGUID(cguid& guid)
+CClientList::getClientFromGUID(const cguid& guid)
 {
-    std::deque<CClientItem*>::iterator it;
-    CClientItem* returnItem = NULL;
+    clientGuidKey key;
+    memcpy(key.id, guid.m_id, 16);
 
-    for (it = m_itemList.begin(); it != m_itemList.end(); ++it) {
-
-        CClientItem* pItem = *it;
-        if (pItem->m_guid == guid) {
-            returnItem = pItem;
-            break;
-        }
+    std::unordered_map<clientGuidKey, CClientItem*, clientGuidKeyHash>::
+      const_iterator it = m_guidIndex.find(key);
+    if (it == m_guidIndex.end()) {
+        return NULL;
     }
 
-    return returnItem;
+    return it->second;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,11 +24,19 @@
 #if !defined(CLIENTLIST_H__B0190EE5_E0E8_497F_92A0_A8616296AF3E__INCLUDED_)
 #define CLIENTLIST_H__B0190EE5_E0E8_497F_92A0_A8616296AF3E__INCLUDED_
 
+#include <string.h>
+
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
+#include <clientqueue.h>
 #include <devicelist.h>
 #include <vscpdatetime.h>
 #include <guid.h>
+#include <sharedevent.h>
+#include <tokenbucket.h>
 #include <userlist.h>
 #include <vscp.h>
 
@@ -36,6 +44,9 @@
 #define CLIENT_ID_DAEMON_WORKER 0xffff
 #define CLIENT_ID_INTERNAL 0xfffe
 
+// Max number of shards the client list can be split into
+#define CLIENTLIST_MAX_SHARDS 32
+
 //
 // defines for levels
 //
@@ -114,13 +125,11 @@ class CClientItem
     std::string getAsString(void);
 
   public:
-    // Input Queue
-    std::deque<vscpEvent*> m_clientInputQueue;
-
-    // Semaphore to indicate that an event has been received
-    sem_t m_semClientInputQueue;
+    // Input Queue (one reference held for each queued event)
+    CClientQueue m_clientInputQueue;
 
-    // Mutex handle that is used for sharing of the client object
+    // Serialize readers of the input queue for clients where more than
+    // one thread can read the queue (REST, websocket).
     pthread_mutex_t m_mutexClientInputQueue;
 
     // Client ID for this client item
@@ -170,6 +179,10 @@ class CClientItem
     // Interface type: CANAL, TCP/IP
     uint8_t m_type;
 
+    // Rate limit for events sent by this client (set from the
+    // settings of the interface type)
+    CTokenBucket m_rateLimit;
+
     /*!
         Mark as UDP receive channel if set
         This is used by the UDP send routine to disregard
@@ -218,6 +231,119 @@ class CClientItem
 
 // ----------------------------------------------------------------------------
 
+/*!
+    Subscription index
+
+    Index clients on the filter they have set so that an event only
+    need to be tested against the filters of the clients that can
+    possibly receive it. Each client is put in exactly one bucket
+
+        - (class,type) if both class and type is fully masked.
+        - class if the class is fully masked.
+        - GUID prefix if one or more leading GUID bytes are fully masked.
+        - wildcard for everything else.
+
+    The index is a pre filter. The full filter must still be tested on
+    the clients returned by getCandidates.
+
+    The index is not locked. It is owned by the client list and is
+    protected by the shard mutex of the client list.
+*/
+
+class CSubscriptionIndex
+{
+
+  public:
+    /// Constructor
+    CSubscriptionIndex();
+
+    /// Destructor
+    ~CSubscriptionIndex();
+
+    /*!
+        Add a client to the index using the filter currently set for
+        the client.
+        @param pClientItem Client to add
+    */
+    void addClient(CClientItem *pClientItem);
+
+    /*!
+        Remove a client from the index
+        @param pClientItem Client to remove
+    */
+    void removeClient(CClientItem *pClientItem);
+
+    /*!
+        Re-index a client after its filter has been changed.
+        @param pClientItem Client to update
+    */
+    void updateClient(CClientItem *pClientItem);
+
+    /*!
+        Get clients that possibly can receive an event
+        @param candidates Clients that may receive the event is appended
+                            to this list.
+        @param pEvent Event to find subscribers for
+    */
+    void getCandidates(std::vector<CClientItem *> &candidates,
+                       const vscpEvent *pEvent) const;
+
+    /*!
+        Remove all clients from the index
+    */
+    void clear(void);
+
+  private:
+    // Clients with fully masked class and type. Key is (class << 16) + type
+    std::map<uint32_t, std::vector<CClientItem *> > m_mapClassType;
+
+    // Clients with fully masked class.
+    std::map<uint16_t, std::vector<CClientItem *> > m_mapClass;
+
+    // Clients with fully masked leading GUID bytes. Key is the
+    // prefix, its length is the number of masked bytes.
+    std::map<std::string, std::vector<CClientItem *> > m_mapGuidPrefix;
+
+    // Number of clients indexed for each GUID prefix length
+    uint32_t m_cntGuidPrefix[17];
+
+    // Clients that can not be indexed
+    std::vector<CClientItem *> m_wildcard;
+
+    // The filter each client was indexed with
+    std::map<CClientItem *, vscpEventFilter> m_indexedFilter;
+};
+
+// ----------------------------------------------------------------------------
+
+/*!
+    Key for the GUID index of the client list
+*/
+struct clientGuidKey
+{
+    uint8_t id[16];
+
+    bool operator==(const clientGuidKey &other) const
+    {
+        return (0 == memcmp(id, other.id, 16));
+    };
+};
+
+/*!
+    Hash for the GUID index (FNV-1a over the 16 GUID bytes)
+*/
+struct clientGuidKeyHash
+{
+    size_t operator()(const clientGuidKey &key) const
+    {
+        uint32_t hash = 2166136261u;
+        for (int i = 0; i < 16; i++) {
+            hash = (hash ^ key.id[i]) * 16777619u;
+        }
+        return hash;
+    };
+};
+
 class CClientList
 {
 
@@ -256,6 +382,86 @@ class CClientList
     */
     bool removeAllClients(void);
 
+    /*!
+        Set filter for a client and update the subscription index.
+        This is the only way a filter should be changed for a client
+        that has been added to the list.
+        @param pClientItem Pointer to client item
+        @param pFilter Pointer to new filter
+    */
+    void setClientFilter(CClientItem *pClientItem,
+                         const vscpEventFilter *pFilter);
+
+    /*!
+        Set GUID for a client and update the GUID index. This is the
+        only way the GUID should be changed for a client that has been
+        added to the list. The caller must hold m_mutexItemList.
+        @param pClientItem Pointer to client item
+        @param guid New GUID for the client
+    */
+    void setClientGUID(CClientItem *pClientItem, const cguid &guid);
+
+    /*!
+        Set the number of shards the client list is split into. Each
+        client belongs to one shard (client id modulo shard count) and
+        each shard has its own subscription index and mutex so events
+        can be delivered to different shards in parallel.
+        Can only be changed when there are no clients in the list.
+        @param nShards Number of shards (1 - CLIENTLIST_MAX_SHARDS)
+        @return true on success
+    */
+    bool setShardCount(uint8_t nShards);
+
+    /*!
+        Get the number of shards the client list is split into
+        @return Number of shards
+    */
+    uint8_t getShardCount(void) { return m_nShards; };
+
+    /*!
+        Get the shard a client belongs to
+        @param pClientItem Pointer to client item
+        @return Shard index
+    */
+    uint8_t getShard(CClientItem *pClientItem)
+    {
+        return (pClientItem->m_clientID % m_nShards);
+    };
+
+    /*!
+        Lock a shard. Clients of the shard can not be added, removed
+        or have their filter changed while the shard is locked.
+        @param shard Shard index
+    */
+    void lockShard(uint8_t shard)
+    {
+        pthread_mutex_lock(&m_mutexShard[shard]);
+    };
+
+    /*!
+        Unlock a shard
+        @param shard Shard index
+    */
+    void unlockShard(uint8_t shard)
+    {
+        pthread_mutex_unlock(&m_mutexShard[shard]);
+    };
+
+    /*!
+        Get clients in a shard that possibly can receive an event. The
+        shard must be locked by the caller.
+        @param candidates Clients that may receive the event is appended
+                            to this list.
+        @param pEvent Event to find subscribers for
+        @param shard Shard to search.
+    */
+    void getSubscribers(std::vector<CClientItem *> &candidates,
+                        const vscpEvent *pEvent,
+                        uint8_t shard = 0)
+    {
+        m_subscriptions[shard].getCandidates(candidates, pEvent);
+    };
+
     /*!
         Get client form client id
         @param id Numeric id for the client
@@ -271,11 +477,12 @@ class CClientList
     CClientItem *getClientFromOrdinal(uint16_t ordinal);
 
     /*!
-        Get Client from GUID
+        Get Client from GUID. Constant time lookup in the GUID index.
+        The caller must hold m_mutexItemList.
         @param guid Guid for the client
         @return A pointer to a cientitem on success or NULL on failure.
     */
-    CClientItem *getClientFromGUID(cguid &guid);
+    CClientItem *getClientFromGUID(const cguid &guid);
 
     /*!
         Get current number of clients
@@ -305,6 +512,28 @@ class CClientList
 
     // Mutex that protect the list
     pthread_mutex_t m_mutexItemList;
+
+  private:
+    // Number of shards in use
+    uint8_t m_nShards;
+
+    // Clients indexed on their filters (one index for each shard)
+    CSubscriptionIndex m_subscriptions[CLIENTLIST_MAX_SHARDS];
+
+    // Mutex that protect each shard
+    pthread_mutex_t m_mutexShard[CLIENTLIST_MAX_SHARDS];
+
+    // Put a client in the GUID index unless another client already
+    // has the same GUID
+    void indexGUID(CClientItem *pClientItem);
+
+    // Take a client out of the GUID index. Another client with the
+    // same GUID takes its place.
+    void unindexGUID(CClientItem *pClientItem);
+
+    // Clients indexed on their GUID. Protected by m_mutexItemList.
+    std::unordered_map<clientGuidKey, CClientItem *, clientGuidKeyHash>
+      m_guidIndex;
 };
 
 #endif // !defined(CLIENTLIST_H__B0190EE5_E0E8_497F_92A0_A8616296AF3E__INCLUDED_)
@@ -0,0 +1,336 @@
+// clientqueue.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <eventlatency.h>
+#include <vscphelper.h>
+
+#include "clientqueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CClientQueue::CClientQueue()
+  : m_slots(NULL)
+  , m_mask(0)
+  , m_tail(0)
+  , m_head(0)
+  , m_nStaged(0)
+  , m_bWaiting(false)
+{
+    m_fdEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (-1 == m_fdEvent) {
+        syslog(LOG_ERR,
+               "Unable to create eventfd for client queue. [%s]",
+               strerror(errno));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CClientQueue::~CClientQueue()
+{
+    clear();
+
+    delete[] m_slots;
+
+    if (-1 != m_fdEvent) {
+        close(m_fdEvent);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+bool
+CClientQueue::init(uint32_t capacity)
+{
+    // Already initialized
+    if (NULL != m_slots) {
+        return false;
+    }
+
+    // Round up to power of two
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    m_slots = new CSharedEvent*[size];
+    if (NULL == m_slots) {
+        return false;
+    }
+
+    m_mask = size - 1;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+
+bool
+CClientQueue::push(CSharedEvent* pSharedEvent, bool bWakeup)
+{
+    if ((NULL == m_slots) || (NULL == pSharedEvent)) {
+        return false;
+    }
+
+    // Events already moved to the lanes count against the capacity.
+    // Head is read first, the consumer counts events as staged before
+    // it moves head, so they are never missed.
+    size_t tail   = m_tail.load(std::memory_order_relaxed);
+    size_t head   = m_head.load(std::memory_order_acquire);
+    size_t staged = m_nStaged.load(std::memory_order_acquire);
+    if (((tail - head) + staged) > m_mask) {
+        return false; // Full
+    }
+
+    m_slots[tail & m_mask] = pSharedEvent;
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    if (bWakeup) {
+        wakeup();
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wakeup
+//
+
+void
+CClientQueue::wakeup(void)
+{
+    // The consumer checks the queue after it has set the wait flag and
+    // we check the flag after the event is queued. The fences make sure
+    // at least one of us see what the other did.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_bWaiting.load(std::memory_order_relaxed)) {
+        signal();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stage
+//
+
+void
+CClientQueue::stage(void)
+{
+    if (NULL == m_slots) {
+        return;
+    }
+
+    size_t head = m_head.load(std::memory_order_relaxed);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    if (head == tail) {
+        return;
+    }
+
+    // Don't let the lanes grow past the size of the ring
+    while ((head != tail) && (m_lanes.size() <= m_mask)) {
+        m_lanes.push(m_slots[head & m_mask]);
+        head++;
+    }
+
+    // Count the events as staged before the ring slots are handed back
+    // so size() never misses them
+    m_nStaged.store(m_lanes.size(), std::memory_order_release);
+    m_head.store(head, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pop
+//
+
+CSharedEvent*
+CClientQueue::pop(void)
+{
+    stage();
+
+    CSharedEvent* pSharedEvent = m_lanes.pop();
+    if (NULL == pSharedEvent) {
+        return NULL;
+    }
+
+    m_nStaged.store(m_lanes.size(), std::memory_order_release);
+
+    CEventLatency::getLatency().record(
+      vscp_getEventPriority(pSharedEvent->getEvent()),
+      CEventLatency::now() - pSharedEvent->getCreated());
+
+    return pSharedEvent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// front
+//
+
+CSharedEvent*
+CClientQueue::front(void)
+{
+    stage();
+
+    return m_lanes.front();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CClientQueue::clear(void)
+{
+    if (NULL != m_slots) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        while (head != tail) {
+            m_slots[head & m_mask]->release();
+            head++;
+        }
+        m_head.store(head, std::memory_order_release);
+    }
+
+    m_lanes.clear();
+    m_nStaged.store(0, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// size
+//
+
+size_t
+CClientQueue::size(void) const
+{
+    // Head is read first so events moved to the lanes after it are
+    // still counted in the ring
+    size_t head   = m_head.load(std::memory_order_acquire);
+    size_t staged = m_nStaged.load(std::memory_order_acquire);
+    size_t tail   = m_tail.load(std::memory_order_acquire);
+
+    return staged + ((tail > head) ? (tail - head) : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wait
+//
+
+bool
+CClientQueue::wait(int timeout)
+{
+    if (prepareWait()) {
+
+        struct pollfd fd;
+        fd.fd      = m_fdEvent;
+        fd.events  = POLLIN;
+        fd.revents = 0;
+
+        if (-1 != m_fdEvent) {
+            poll(&fd, 1, timeout);
+        }
+        else {
+            usleep(timeout * 1000);
+        }
+
+        finishWait();
+    }
+
+    return !empty();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// prepareWait
+//
+
+bool
+CClientQueue::prepareWait(void)
+{
+    if (!empty()) {
+        return false;
+    }
+
+    m_bWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // An event may have been queued before the producer saw the flag
+    if (!empty()) {
+        m_bWaiting.store(false, std::memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// finishWait
+//
+
+void
+CClientQueue::finishWait(void)
+{
+    uint64_t cnt;
+
+    m_bWaiting.store(false, std::memory_order_relaxed);
+
+    // Reset the eventfd
+    if (-1 != m_fdEvent) {
+        while (sizeof(cnt) == read(m_fdEvent, &cnt, sizeof(cnt))) {
+            ;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// signal
+//
+
+void
+CClientQueue::signal(void)
+{
+    uint64_t one = 1;
+
+    if (-1 != m_fdEvent) {
+        if (sizeof(one) != write(m_fdEvent, &one, sizeof(one))) {
+            ; // Counter is already signaled
+        }
+    }
+}
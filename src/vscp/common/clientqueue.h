@@ -0,0 +1,203 @@
+// clientqueue.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(CLIENTQUEUE_H__INCLUDED_)
+#define CLIENTQUEUE_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <prioritylanes.h>
+#include <sharedevent.h>
+
+/*!
+    Client input queue
+
+    A fixed size single producer, single consumer ring of shared events.
+    The producer is the thread that deliver events to the client (the
+    dispatcher for the client list shard the client belongs to, the shard
+    lock makes sure there is only one at a time). The consumer is the
+    thread that serves the client. No locks are used between them.
+
+    The consumer is woken up through an eventfd. The descriptor can be
+    put in the same poll() set as the client socket so one call waits
+    for both. The producer only writes to the eventfd when the consumer
+    has said it is going to sleep (prepareWait) so a busy consumer costs
+    no system calls.
+
+    Each queued event holds one reference that is released by the
+    consumer when it is done with the event.
+
+    The consumer moves the events from the ring to priority lanes
+    before it takes one, so events are received in priority order
+    (see CPriorityLanes). Events in the lanes count against the
+    capacity, together the ring and the lanes never hold more than
+    capacity events. The time from when an event was shared until it
+    is taken out of the queue is counted in the latency histograms.
+*/
+
+class CClientQueue
+{
+
+  public:
+    /// Constructor
+    CClientQueue();
+
+    /// Destructor - Release all queued events
+    ~CClientQueue();
+
+    /*!
+        Allocate the queue. Must be called before events are queued.
+        Can only be called once.
+        @param capacity Max number of events in the queue. Is rounded up
+            to the nearest power of two.
+        @return true on success
+    */
+    bool init(uint32_t capacity);
+
+    /*!
+        Put an event in the queue and wake up the consumer if it waits.
+        Producer only.
+        @param pSharedEvent Event to queue. The queue takes over the
+            reference on success.
+        @param bWakeup Set to false when more events will follow. The
+            producer must then call wakeup when it is done.
+        @return true on success, false if the queue is full.
+    */
+    bool push(CSharedEvent* pSharedEvent, bool bWakeup = true);
+
+    /*!
+        Wake up the consumer if it waits. Used after a number of
+        events have been queued with push without wake up. Producer only.
+    */
+    void wakeup(void);
+
+    /*!
+        Take the next event out of the queue. Consumer only.
+        @return Pointer to event (the reference now belongs to the
+            caller) or NULL if the queue is empty.
+    */
+    CSharedEvent* pop(void);
+
+    /*!
+        Get the next event without taking it out of the queue. The
+        next pop returns the same event. Consumer only.
+        @return Pointer to event (still owned by the queue) or NULL if
+            the queue is empty.
+    */
+    CSharedEvent* front(void);
+
+    /*!
+        Take out and release all events in the queue. Consumer only.
+    */
+    void clear(void);
+
+    /*!
+        Get the number of events in the queue.
+        @return Number of events.
+    */
+    size_t size(void) const;
+
+    /*!
+        Check if queue is empty
+        @return true if there are no events in the queue.
+    */
+    bool empty(void) const { return (0 == size()); };
+
+    /*!
+        Wait for an event to be queued.
+        @param timeout Max time to wait in milliseconds.
+        @return true if there are events in the queue.
+    */
+    bool wait(int timeout);
+
+    /*!
+        Tell the producer that the consumer is going to wait on the
+        eventfd. Must be called before the eventfd is polled and be
+        followed by a call to finishWait.
+        @return true if the consumer can sleep, false if events already
+            are queued in which case it should not.
+    */
+    bool prepareWait(void);
+
+    /*!
+        Called by the consumer when it has been woken up (or timed out)
+        after prepareWait.
+    */
+    void finishWait(void);
+
+    /*!
+        Wake up the consumer even if there is no new event.
+    */
+    void signal(void);
+
+    /*!
+        Get the eventfd that is readable when the consumer should wake up.
+        @return File descriptor or -1 if not available.
+    */
+    int getEventFd(void) const { return m_fdEvent; };
+
+  private:
+    /*!
+        Move events from the ring to the priority lanes. Consumer only.
+    */
+    void stage(void);
+
+    // Not copyable
+    CClientQueue(const CClientQueue&);
+    CClientQueue& operator=(const CClientQueue&);
+
+  private:
+    // The slots
+    CSharedEvent** m_slots;
+
+    // Capacity - 1
+    size_t m_mask;
+
+    // Position for next push. Only written by the producer.
+    std::atomic<size_t> m_tail;
+
+    // Position for next pop. Only written by the consumer.
+    std::atomic<size_t> m_head;
+
+    // Events taken from the ring by the consumer
+    CPriorityLanes m_lanes;
+
+    // Number of events in the lanes. Only written by the consumer.
+    std::atomic<size_t> m_nStaged;
+
+    // True when the consumer waits on the eventfd
+    std::atomic<bool> m_bWaiting;
+
+    // Wake up descriptor
+    int m_fdEvent;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// commandhistory.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "commandhistory.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CCommandHistory::CCommandHistory()
+  : m_next(0)
+  , m_count(0)
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CCommandHistory::~CCommandHistory()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setDepth
+//
+
+void
+CCommandHistory::setDepth(size_t depth)
+{
+    std::vector<std::string>(depth).swap(m_slots);
+    m_next  = 0;
+    m_count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CCommandHistory::add(const char* pCommand, size_t len)
+{
+    if (m_slots.empty() || (len > COMMAND_HISTORY_MAX_LENGTH)) {
+        return;
+    }
+
+    // assign keeps the memory of the slot
+    m_slots[m_next].assign(pCommand, len);
+
+    if (++m_next == m_slots.size()) {
+        m_next = 0;
+    }
+
+    if (m_count < m_slots.size()) {
+        m_count++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// get
+//
+
+const std::string*
+CCommandHistory::get(size_t n)
+{
+    if (n >= m_count) {
+        return NULL;
+    }
+
+    size_t pos = (m_next + m_slots.size() - 1 - n) % m_slots.size();
+    return &m_slots[pos];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CCommandHistory::clear(void)
+{
+    m_next  = 0;
+    m_count = 0;
+}
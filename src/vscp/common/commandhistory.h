@@ -0,0 +1,109 @@
+// commandhistory.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(COMMANDHISTORY_H__INCLUDED_)
+#define COMMANDHISTORY_H__INCLUDED_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// Commands longer than this are not saved
+#define COMMAND_HISTORY_MAX_LENGTH 4096
+
+/*!
+    Bounded command history
+
+    A fixed number of the last commands given on a connection. When
+    the history is full the oldest command is overwritten. The strings
+    of the slots are reused so once the history has been filled no
+    more memory is allocated. Adding a command and getting one back
+    are both O(1).
+
+    A depth of zero turns the history off.
+
+    Not thread safe. Used by the thread that serves the connection.
+*/
+
+class CCommandHistory
+{
+
+  public:
+    /// Constructor
+    CCommandHistory();
+
+    /// Destructor
+    ~CCommandHistory();
+
+    /*!
+        Set the number of commands that are kept. Saved commands
+        are removed.
+        @param depth Max number of commands. Zero turns the
+            history off.
+    */
+    void setDepth(size_t depth);
+
+    /// Get the max number of commands that are kept
+    size_t getDepth(void) { return m_slots.size(); };
+
+    /// Get the number of saved commands
+    size_t size(void) { return m_count; };
+
+    /*!
+        Save a command. Does nothing if the history is off or the
+        command is longer than COMMAND_HISTORY_MAX_LENGTH.
+        @param pCommand Command to save.
+        @param len Length of the command.
+    */
+    void add(const char* pCommand, size_t len);
+
+    /*!
+        Get a saved command.
+        @param n Zero for the last command, one for the one before
+            that and so on.
+        @return Pointer to the command or NULL if there is no such
+            command. Valid until the next add.
+    */
+    const std::string* get(size_t n);
+
+    /// Remove all saved commands
+    void clear(void);
+
+  private:
+    /// One string for each command that can be kept
+    std::vector<std::string> m_slots;
+
+    /// Slot for the next command
+    size_t m_next;
+
+    /// Number of saved commands
+    size_t m_count;
+};
+
+#endif // COMMANDHISTORY_H__INCLUDED_
@@ -84,8 +84,12 @@
 #include <crc.h>
 #include <devicelist.h>
 #include <devicethread.h>
+#include <eventlatency.h>
+#include <eventpool.h>
+#include <prioritylanes.h>
 #include <randpassword.h>
 #include <remotevariablecodes.h>
+#include <restsrv.h>
 #include <version.h>
 #include <vscp.h>
 #include <vscp_debug.h>
@@ -116,6 +120,8 @@ createFolderStuct(std::string& rootFolder); // from vscpd.cpp
 void*
 clientMsgWorkerThread(void* userdata); // this
 void*
+dispatchWorkerThread(void* userdata); // this
+void*
 tcpipListenThread(void* pData); // tcpipsev.cpp
 void*
 UDPThread(void* pData); // udpsrv.cpp
@@ -147,21 +153,6 @@ CControlObject::CControlObject()
         return;
     }
 
-    if (0 != pthread_mutex_init(&m_mutex_ClientOutputQueue, NULL)) {
-        syslog(LOG_ERR, "Unable to init m_mutex_ClientOutputQueue");
-        return;
-    }
-
-    if (0 != pthread_mutex_init(&m_mutex_websrvSession, NULL)) {
-        syslog(LOG_ERR, "Unable to init m_mutex_websrvSession");
-        return;
-    }
-
-    if (0 != pthread_mutex_init(&m_mutex_restSession, NULL)) {
-        syslog(LOG_ERR, "Unable to init m_mutex_restSession");
-        return;
-    }
-
     if (0 != pthread_mutex_init(&m_mutex_websocketSession, NULL)) {
         syslog(LOG_ERR, "Unable to init m_mutex_websocketSession");
         return;
@@ -198,6 +189,10 @@ CControlObject::CControlObject()
 
     m_automation.setControlObject(this);
     m_maxItemsInClientReceiveQueue = MAX_ITEMS_CLIENT_RECEIVE_QUEUE;
+    m_maxItemsInClientOutputQueue  = MAX_ITEMS_CLIENT_OUTPUT_QUEUE;
+    m_nDispatchWorkers             = DEFAULT_DISPATCH_WORKERS;
+    m_nDispatchBatch               = DEFAULT_DISPATCH_BATCH;
+    m_nEventPoolSize               = DEFAULT_EVENT_POOL_SIZE;
 
     // Nill the GUID
     m_guid.clear();
@@ -212,6 +207,11 @@ CControlObject::CControlObject()
     m_enableTcpip            = true;
     m_strTcpInterfaceAddress = "9598";
     m_encryptionTcpip        = 0;
+    m_tcpip_nWorkers         = DEFAULT_TCPIP_WORKERS;
+    m_tcpip_maxConnections   = VSCP_TCP_MAX_CLIENTS;
+    m_tcpip_commandHistory   = VSCP_TCPIP_COMMAND_LIST_MAX;
+    m_tcpip_rateLimit        = 0; // No limit
+    m_tcpip_rateLimitBurst   = 0;
     m_tcpip_ssl_certificate.clear();
     m_tcpip_ssl_certificate_chain.clear();
     m_tcpip_ssl_verify_peer = 0; // no=0, optional=1, yes=2
@@ -222,6 +222,9 @@ CControlObject::CControlObject()
     m_tcpip_ssl_cipher_list.clear();
     m_tcpip_ssl_protocol_version = 0;
     m_tcpip_ssl_short_trust      = false;
+    m_tcpip_ssl_session_cache_size = VSCP_TCPIP_SSL_SESSION_CACHE_SIZE;
+    m_tcpip_ssl_session_timeout    = VSCP_TCPIP_SSL_SESSION_TIMEOUT;
+    m_tcpip_ssl_session_tickets    = true;
 
     // Web server SSL settings
     m_web_ssl_certificate          = "/etc/vscp/certs/server.pem";
@@ -288,8 +291,12 @@ CControlObject::CControlObject()
     bEnable_websocket_ping_pong = false;
     lua_websocket_pattern =
       std::string(VSCPDB_CONFIG_DEFAULT_WEB_LUA_WEBSOCKET_PATTERN);
+    m_websocket_rateLimit      = 0; // No limit
+    m_websocket_rateLimitBurst = 0;
 
-    m_bEnableRestApi = true;
+    m_bEnableRestApi      = true;
+    m_rest_rateLimit      = 0; // No limit
+    m_rest_rateLimitBurst = 0;
 
     // Init. web server subsystem - All features enabled
     // ssl mt locks will we initiated here for openssl 1.0
@@ -313,17 +320,7 @@ CControlObject::~CControlObject()
         syslog(LOG_DEBUG, "Cleaning up");
     }
 
-    // Remove objects in Client send queue
-    std::list<vscpEvent*>::iterator iterVSCP;
-    pthread_mutex_lock(&m_mutex_ClientOutputQueue);
-    for (iterVSCP = m_clientOutputQueue.begin();
-         iterVSCP != m_clientOutputQueue.end();
-         ++iterVSCP) {
-        vscpEvent* pEvent = *iterVSCP;
-        vscp_deleteEvent_v2(&pEvent);
-    }
-    m_clientOutputQueue.clear();
-    pthread_mutex_unlock(&m_mutex_ClientOutputQueue);
+    // Events left in the client send queue are deleted by the queue
 
     // Remove all clients
     m_clientList.removeAllClients();
@@ -339,21 +336,6 @@ CControlObject::~CControlObject()
         syslog(LOG_ERR, "Unable to destroy m_semSentToAllClients");
     }
 
-    if (0 != pthread_mutex_destroy(&m_mutex_ClientOutputQueue)) {
-        syslog(LOG_ERR, "Unable to destroy m_mutex_ClientOutputQueue");
-        return;
-    }
-
-    if (0 != pthread_mutex_destroy(&m_mutex_websrvSession)) {
-        syslog(LOG_ERR, "Unable to destroy m_mutex_websrvSession");
-        return;
-    }
-
-    if (0 != pthread_mutex_destroy(&m_mutex_restSession)) {
-        syslog(LOG_ERR, "Unable to destroy m_mutex_restSession");
-        return;
-    }
-
     if (0 != pthread_mutex_destroy(&m_mutex_websocketSession)) {
         syslog(LOG_ERR, "Unable to destroy m_mutex_websocketSession");
         return;
@@ -460,6 +442,24 @@ CControlObject::init(std::string& strcfgfile, std::string& rootFolder)
         syslog(LOG_DEBUG, "Using configuration file: %s", strcfgfile.c_str());
     }
 
+    // Allocate the event pool. Events are allocated on the heap if
+    // this fails.
+    if (m_nEventPoolSize) {
+        if (CEventPool::getPool().init(m_nEventPoolSize)) {
+            CEventPool::install();
+        } else {
+            syslog(LOG_ERR,
+                   "Unable to allocate event pool. Events will be "
+                   "allocated on the heap.");
+        }
+    }
+
+    // Allocate the client send queue
+    if (!m_clientOutputQueue.init(m_maxItemsInClientOutputQueue)) {
+        syslog(LOG_ERR, "Unable to allocate client output queue.");
+        return FALSE;
+    }
+
     //==========================================================================
     //                           Add admin user
     //==========================================================================
@@ -619,11 +619,19 @@ CControlObject::run(void)
     struct timespec now, old_now;
     clock_gettime(CLOCK_REALTIME, &old_now);
     old_now.tv_sec -= 60;  // Do firts send right away
+    time_t lastExpire = 0;
 
     while (!m_bQuit) {
 
         clock_gettime(CLOCK_REALTIME, &now);
 
+        // Expire idle web and REST sessions once a second
+        if (now.tv_sec != lastExpire) {
+            lastExpire = now.tv_sec;
+            websrv_expire_sessions();
+            restsrv_expire_sessions();
+        }
+
         // We send heartbeat every minute
         if ((now.tv_sec-old_now.tv_sec) > 60) {
 
@@ -641,28 +649,14 @@ CControlObject::run(void)
             continue;
         }
 
-        // Send events to websocket clients
-        websock_post_incomingEvents();
-
         //----------------------------------------------------------------------
         //                         Event received here
         //                   from one of the incoming source
         //----------------------------------------------------------------------
 
-        if (pClientItem->m_clientInputQueue.size()) {
-
-            vscpEvent* pEvent;
-
-            pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-            pEvent = pClientItem->m_clientInputQueue.front();
-            pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
-
-            if (NULL != pEvent) {
-            }
-
-            vscp_deleteEvent_v2(&pEvent);
-
+        CSharedEvent* pSharedEvent = pClientItem->m_clientInputQueue.pop();
+        if (NULL != pSharedEvent) {
+            pSharedEvent->release();
         } // Event in queue
 
     } // while
@@ -872,6 +866,36 @@ CControlObject::cleanup(void)
         syslog(LOG_ERR, "REST: Exception occurred when stoping tcp/ip server");
     }
 
+    // Report how well the event pool did
+    if (CEventPool::getPool().isActive()) {
+        eventPoolStatistics stat;
+        for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+            CEventPool::getPool().getStatistics(cls, &stat);
+            syslog(LOG_INFO,
+                   "Event pool: %u byte blocks hits=%llu misses=%llu "
+                   "inline=%llu",
+                   (unsigned)stat.blockSize,
+                   (unsigned long long)stat.cntHits,
+                   (unsigned long long)stat.cntMisses,
+                   (unsigned long long)stat.cntInline);
+        }
+    }
+
+    // Report delivery latency for the priorities that have been used
+    for (uint8_t prio = 0; prio < EVENTLATENCY_PRIORITIES; prio++) {
+        CEventLatency& latency = CEventLatency::getLatency();
+        if (latency.getCount(prio)) {
+            syslog(LOG_INFO,
+                   "Delivery latency priority %d: events=%llu p50<%lluus "
+                   "p99<%lluus max=%lluus",
+                   prio,
+                   (unsigned long long)latency.getCount(prio),
+                   (unsigned long long)latency.getPercentile(prio, 50),
+                   (unsigned long long)latency.getPercentile(prio, 99),
+                   (unsigned long long)latency.getMax(prio));
+        }
+    }
+
     if (__VSCP_DEBUG_EXTRA) {
         syslog(LOG_DEBUG, "Controlobject: ControlObject: Cleanup done.");
     }
@@ -890,6 +914,46 @@ CControlObject::startClientMsgWorkerThread(void)
         syslog(LOG_DEBUG, "Controlobject: Starting client worker thread...");
     }
 
+    // Split the client list in one shard for each dispatch worker. With
+    // one worker the client message worker thread deliver all events.
+    if (m_nDispatchWorkers > 1) {
+
+        if (!m_clientList.setShardCount(m_nDispatchWorkers)) {
+            syslog(LOG_ERR,
+                   "Controlobject: Unable to split client list in %d shards. "
+                   "Using one dispatch worker.",
+                   m_nDispatchWorkers);
+            m_nDispatchWorkers = 1;
+        }
+    }
+
+    if (m_nDispatchWorkers > 1) {
+
+        if (__VSCP_DEBUG_EXTRA) {
+            syslog(LOG_DEBUG,
+                   "Controlobject: Starting %d dispatch workers...",
+                   m_nDispatchWorkers);
+        }
+
+        for (uint8_t i = 0; i < m_nDispatchWorkers; i++) {
+
+            CDispatchWorker* pWorker = new CDispatchWorker(this, i);
+
+            if (pthread_create(&pWorker->m_workerThread,
+                               NULL,
+                               dispatchWorkerThread,
+                               pWorker)) {
+                syslog(LOG_ERR,
+                       "Controlobject: Unable to start dispatch worker %d.",
+                       i);
+                delete pWorker;
+                return false;
+            }
+
+            m_dispatchWorkers.push_back(pWorker);
+        }
+    }
+
     if (pthread_create(&m_clientMsgWorkerThread,
                        NULL,
                        clientMsgWorkerThread,
@@ -913,6 +977,19 @@ CControlObject::stopClientMsgWorkerThread(void)
     m_bQuit_clientMsgWorkerThread = true;
     pthread_join(m_clientMsgWorkerThread, NULL);
 
+    // No more events will be queued to the dispatch workers
+    std::vector<CDispatchWorker*>::iterator it;
+    for (it = m_dispatchWorkers.begin(); it != m_dispatchWorkers.end(); ++it) {
+        (*it)->m_bQuit = true;
+    }
+
+    for (it = m_dispatchWorkers.begin(); it != m_dispatchWorkers.end(); ++it) {
+        pthread_join((*it)->m_workerThread, NULL);
+        delete *it;
+    }
+
+    m_dispatchWorkers.clear();
+
     return true;
 }
 
@@ -944,6 +1021,9 @@ CControlObject::startTcpipSrvThread(void)
     // Set the port to listen for connections on
     m_ptcpipSrvObject->setListeningPort(m_strTcpInterfaceAddress);
 
+    // Set number of threads that serve the connections
+    m_ptcpipSrvObject->setWorkers(m_tcpip_nWorkers);
+
     if (pthread_create(&m_tcpipListenThread,
                        NULL,
                        tcpipListenThread,
@@ -1191,30 +1271,37 @@ CControlObject::getVscpCapabilities(uint8_t* pCapability)
 //
 
 bool
-CControlObject::sendEventToClient(CClientItem* pClientItem, vscpEvent* pEvent)
+CControlObject::sendEventToClient(CClientItem* pClientItem,
+                                  CSharedEvent* pSharedEvent,
+                                  bool bWakeup)
 {
     // Must be valid pointers
     if (NULL == pClientItem) {
         syslog(LOG_ERR, "sendEventToClient - Pointer to clientitem is null");
         return false;
     }
-    if (NULL == pEvent) {
+    if (NULL == pSharedEvent) {
         syslog(LOG_ERR, "sendEventToClient - Pointer to event is null");
         return false;
     }
 
     // Check if filtered out - if so do nothing here
-    if (!vscp_doLevel2Filter(pEvent, &pClientItem->m_filter)) {
+    if (!vscp_doLevel2Filter(pSharedEvent->getEvent(),
+                             &pClientItem->m_filter)) {
         if (__VSCP_DEBUG_EXTRA) {
             syslog(LOG_DEBUG, "sendEventToClient - Filtered out");
         }
         return false;
     }
 
+    // Add a reference to the event to the input queue. The
+    // event is shared by all receiving clients, no copy is made.
+    pSharedEvent->addRef();
+
     // If the client queue is full for this client then the
     // client will not receive the message
-    if (pClientItem->m_clientInputQueue.size() >
-        m_maxItemsInClientReceiveQueue) {
+    if (!pClientItem->m_clientInputQueue.push(pSharedEvent, bWakeup)) {
+        pSharedEvent->release();
         if (__VSCP_DEBUG_EXTRA) {
             syslog(LOG_DEBUG, "sendEventToClient - overrun");
         }
@@ -1223,45 +1310,53 @@ CControlObject::sendEventToClient(CClientItem* pClientItem, vscpEvent* pEvent)
         return false;
     }
 
-    // Create a new event
-    vscpEvent* pnewvscpEvent = new vscpEvent;
-    if (NULL != pnewvscpEvent) {
+    return true;
+}
 
-        // Copy in the new event
-        if (!vscp_copyEvent(pnewvscpEvent, pEvent)) {
-            vscp_deleteEvent_v2(&pnewvscpEvent);
-            return false;
-        }
+///////////////////////////////////////////////////////////////////////////////
+// sendEventAllClients
+//
+
+bool
+CControlObject::sendEventAllClients(CSharedEvent* pSharedEvent,
+                                    uint32_t excludeID)
+{
+    if (NULL == pSharedEvent) {
+        syslog(LOG_ERR, "sendEventAllClients - null event");
+        return false;
+    }
 
-        // Add the new event to the input queue
-        pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-        pClientItem->m_clientInputQueue.push_back(pnewvscpEvent);
-        pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
-        sem_post(&pClientItem->m_semClientInputQueue);
+    for (uint8_t i = 0; i < m_clientList.getShardCount(); i++) {
+        sendEventShard(pSharedEvent, i, excludeID);
     }
 
     return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// sendEventAllClients
+// sendEventShard
 //
 
 bool
-CControlObject::sendEventAllClients(vscpEvent* pEvent, uint32_t excludeID)
+CControlObject::sendEventShard(CSharedEvent* pSharedEvent,
+                               uint8_t shard,
+                               uint32_t excludeID)
 {
     CClientItem* pClientItem;
-    std::deque<CClientItem*>::iterator it;
+    std::vector<CClientItem*> subscribers;
+    std::vector<CClientItem*>::iterator it;
 
-    if (NULL == pEvent) {
-        syslog(LOG_ERR, "sendEventAllClients - null event");
+    if (NULL == pSharedEvent) {
+        syslog(LOG_ERR, "sendEventShard - null event");
         return false;
     }
 
-    pthread_mutex_lock(&m_clientList.m_mutexItemList);
-    for (it = m_clientList.m_itemList.begin();
-         it != m_clientList.m_itemList.end();
-         ++it) {
+    m_clientList.lockShard(shard);
+
+    // Only clients with a filter that can match the event
+    m_clientList.getSubscribers(subscribers, pSharedEvent->getEvent(), shard);
+
+    for (it = subscribers.begin(); it != subscribers.end(); ++it) {
         pClientItem = *it;
 
         if ((NULL != pClientItem) && (excludeID != pClientItem->m_clientID)) {
@@ -1270,75 +1365,132 @@ CControlObject::sendEventAllClients(vscpEvent* pEvent, uint32_t excludeID)
                        "Send event to client [%s]",
                        pClientItem->m_strDeviceName.c_str());
             }
-            if (!sendEventToClient(pClientItem, pEvent)) {
-                syslog(LOG_ERR, "sendEventAllClients - Failed to send event");
+            if (!sendEventToClient(pClientItem, pSharedEvent)) {
+                syslog(LOG_ERR, "sendEventShard - Failed to send event");
             }
         }
     }
 
-    pthread_mutex_unlock(&m_clientList.m_mutexItemList);
+    m_clientList.unlockShard(shard);
 
     return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// sendEvent
+// sendEventBatchAllClients
 //
-// !!! pEventToSend must be deallocated by sender !!!
+
+bool
+CControlObject::sendEventBatchAllClients(
+  const std::vector<CSharedEvent*>& batch)
+{
+    for (uint8_t i = 0; i < m_clientList.getShardCount(); i++) {
+        sendEventBatchShard(batch, i);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendEventBatchShard
 //
 
 bool
-CControlObject::sendEvent(CClientItem* pClientItem, vscpEvent* peventToSend)
+CControlObject::sendEventBatchShard(const std::vector<CSharedEvent*>& batch,
+                                    uint8_t shard)
 {
-    bool bSent = false;
+    CClientItem* pClientItem;
+    std::vector<CClientItem*> subscribers;
+    std::vector<CClientItem*> receivers;
+    std::vector<CClientItem*>::iterator it;
+    std::vector<CSharedEvent*>::const_iterator itEvent;
 
-    // Check pointers
-    if (NULL == pClientItem) {
-        syslog(LOG_ERR, "sendEvent - null clientItem");
-        return false;
-    }
-    if (NULL == peventToSend) {
-        syslog(LOG_ERR, "sendEvent - null event");
-        return false;
+    if (batch.empty()) {
+        return true;
     }
 
-    // If timestamp is nulled make one
-    if (0 == peventToSend->timestamp) {
-        peventToSend->timestamp = vscp_makeTimeStamp();
-    }
+    m_clientList.lockShard(shard);
 
-    // If obid is nulled set client interface id
-    if (0 == peventToSend->obid) {
-        peventToSend->obid = pClientItem->m_clientID;
+    for (itEvent = batch.begin(); itEvent != batch.end(); ++itEvent) {
+
+        CSharedEvent* pSharedEvent = *itEvent;
+        uint32_t excludeID         = pSharedEvent->getEvent()->obid;
+
+        // Only clients with a filter that can match the event
+        subscribers.clear();
+        m_clientList.getSubscribers(subscribers,
+                                    pSharedEvent->getEvent(),
+                                    shard);
+
+        for (it = subscribers.begin(); it != subscribers.end(); ++it) {
+            pClientItem = *it;
+
+            if ((NULL != pClientItem) &&
+                (excludeID != pClientItem->m_clientID)) {
+                if (__VSCP_DEBUG_EXTRA) {
+                    syslog(LOG_DEBUG,
+                           "Send event to client [%s]",
+                           pClientItem->m_strDeviceName.c_str());
+                }
+                if (sendEventToClient(pClientItem, pSharedEvent, false)) {
+                    receivers.push_back(pClientItem);
+                }
+            }
+        }
     }
 
-    // If GUID is all nilled set interface GUID
-    if (vscp_isGUIDEmpty(peventToSend->GUID)) {
-        memcpy(peventToSend->GUID, pClientItem->m_guid.getGUID(), 16);
+    // Wake up every client that got events once. Done before the shard
+    // is unlocked as the clients can't go away while it is locked.
+    std::sort(receivers.begin(), receivers.end());
+    it = std::unique(receivers.begin(), receivers.end());
+    receivers.erase(it, receivers.end());
+    for (it = receivers.begin(); it != receivers.end(); ++it) {
+        (*it)->m_clientInputQueue.wakeup();
     }
 
-    vscpEvent* pEvent = new vscpEvent; // Create new VSCP Event
+    m_clientList.unlockShard(shard);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// postClientOutputEvent
+//
+
+bool
+CControlObject::postClientOutputEvent(CClientItem* pClientItem,
+                                      vscpEvent* pEvent)
+{
     if (NULL == pEvent) {
-        syslog(LOG_ERR, "sendEvent - Allocation of event failed");
         return false;
     }
 
-    pEvent->pdata = NULL;
-
-    // Copy event
-    if (!vscp_copyEvent(pEvent, peventToSend)) {
-        vscp_deleteEvent_v2(&pEvent);
-        syslog(LOG_ERR, "sendEvent - Event copy failed");
+    if (!m_clientOutputQueue.push(pEvent)) {
+        // Queue is full
+        if (NULL != pClientItem) {
+            pClientItem->m_statistics.cntOverruns++;
+        }
         return false;
     }
 
-    // Save the originating clients id so
-    // this client don't get the message back
-    pEvent->obid = pClientItem->m_clientID;
+    sem_post(&m_semClientOutputQueue);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendEventToInterface
+//
+// Level II events between 512-1023 is recognised by the daemon and
+// sent to the correct interface as Level I events if the interface
+// is addressed by the client.
+//
+
+bool
+CControlObject::sendEventToInterface(vscpEvent* pEvent)
+{
+    bool bSent = false;
 
-    // Level II events between 512-1023 is recognised by the daemon and
-    // sent to the correct interface as Level I events if the interface
-    // is addressed by the client.
     if ((pEvent->vscp_class <= 1023) && (pEvent->vscp_class >= 512) &&
         (pEvent->sizeData >= 16)) {
 
@@ -1378,70 +1530,106 @@ CControlObject::sendEvent(CClientItem* pClientItem, vscpEvent* peventToSend)
         // Find client
         pthread_mutex_lock(&m_clientList.m_mutexItemList);
 
-        std::deque<CClientItem*>::iterator it;
-        for (it = m_clientList.m_itemList.begin();
-             it != m_clientList.m_itemList.end();
-             ++it) {
+        CClientItem* pItem = m_clientList.getClientFromGUID(destguid);
+        if (NULL != pItem) {
 
-            CClientItem* pItem = *it;
             if (__VSCP_DEBUG_EXTRA) {
                 syslog(LOG_DEBUG,
-                       "Test if = "
-                       "%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%d:%s",
-                       pItem->m_guid.getAt(0),
-                       pItem->m_guid.getAt(1),
-                       pItem->m_guid.getAt(2),
-                       pItem->m_guid.getAt(3),
-                       pItem->m_guid.getAt(4),
-                       pItem->m_guid.getAt(5),
-                       pItem->m_guid.getAt(6),
-                       pItem->m_guid.getAt(7),
-                       pItem->m_guid.getAt(8),
-                       pItem->m_guid.getAt(9),
-                       pItem->m_guid.getAt(10),
-                       pItem->m_guid.getAt(11),
-                       pItem->m_guid.getAt(12),
-                       pItem->m_guid.getAt(13),
-                       pItem->m_guid.getAt(14),
-                       pItem->m_guid.getAt(15),
+                       "Level I event over Level II to %s",
                        pItem->m_strDeviceName.c_str());
             }
 
-            if (pItem->m_guid == destguid) {
-                // Found
-                // pDestClientItem = pItem;
-                bSent = true;
-                if (!sendEventToClient(pItem, pEvent)) {
-                    ;
-                }
-                break;
+            bSent = true;
+            CSharedEvent* pSharedEvent = new CSharedEvent(pEvent);
+
+            // The shard lock makes this the only thread that
+            // queue events for the client
+            uint8_t shard = m_clientList.getShard(pItem);
+            m_clientList.lockShard(shard);
+            if (!sendEventToClient(pItem, pSharedEvent)) {
+                ;
             }
+            m_clientList.unlockShard(shard);
+            pSharedEvent->release();
         }
 
         pthread_mutex_unlock(&m_clientList.m_mutexItemList);
     }
 
-    if (!bSent) {
+    return bSent;
+}
 
-        // There must be room in the send queue
-        if (m_maxItemsInClientReceiveQueue > m_clientOutputQueue.size()) {
+///////////////////////////////////////////////////////////////////////////////
+// sendEvent
+//
+// !!! pEventToSend must be deallocated by sender !!!
+//
+
+bool
+CControlObject::sendEvent(CClientItem* pClientItem, vscpEvent* peventToSend)
+{
+    bool bSent = false;
 
-            pthread_mutex_lock(&m_mutex_ClientOutputQueue);
-            m_clientOutputQueue.push_back(pEvent);
+    // Check pointers
+    if (NULL == pClientItem) {
+        syslog(LOG_ERR, "sendEvent - null clientItem");
+        return false;
+    }
+    if (NULL == peventToSend) {
+        syslog(LOG_ERR, "sendEvent - null event");
+        return false;
+    }
 
-            // TX Statistics
-            pClientItem->m_statistics.cntTransmitData += pEvent->sizeData;
-            pClientItem->m_statistics.cntTransmitFrames++;
+    // If timestamp is nulled make one
+    if (0 == peventToSend->timestamp) {
+        peventToSend->timestamp = vscp_makeTimeStamp();
+    }
 
-            pthread_mutex_unlock(&m_mutex_ClientOutputQueue);
+    // If obid is nulled set client interface id
+    if (0 == peventToSend->obid) {
+        peventToSend->obid = pClientItem->m_clientID;
+    }
 
-            sem_post(&m_semClientOutputQueue);
+    // If GUID is all nilled set interface GUID
+    if (vscp_isGUIDEmpty(peventToSend->GUID)) {
+        memcpy(peventToSend->GUID, pClientItem->m_guid.getGUID(), 16);
+    }
+
+    vscpEvent* pEvent; // Create new VSCP Event
+    if (!vscp_newEvent(&pEvent)) {
+        syslog(LOG_ERR, "sendEvent - Allocation of event failed");
+        return false;
+    }
+
+    // Copy event
+    if (!vscp_copyEvent(pEvent, peventToSend)) {
+        vscp_deleteEvent_v2(&pEvent);
+        syslog(LOG_ERR, "sendEvent - Event copy failed");
+        return false;
+    }
+
+    // Save the originating clients id so
+    // this client don't get the message back
+    pEvent->obid = pClientItem->m_clientID;
+
+    // Level I events over Level II to an interface on this machine
+    bSent = sendEventToInterface(pEvent);
+
+    if (!bSent) {
+
+        // The event belongs to the queue once it is posted
+        uint16_t sizeData = pEvent->sizeData;
+
+        // There must be room in the send queue
+        if (postClientOutputEvent(pClientItem, pEvent)) {
+            // TX Statistics
+            pClientItem->m_statistics.cntTransmitData += sizeData;
+            pClientItem->m_statistics.cntTransmitFrames++;
         }
         else {
             if (__VSCP_DEBUG_EXTRA) {
                 syslog(LOG_DEBUG, "sendEvent - overrun");
             }
-            pClientItem->m_statistics.cntOverruns++;
             vscp_deleteEvent_v2(&pEvent);
             return false;
         }
@@ -1474,6 +1662,136 @@ CControlObject::sendEvent(CClientItem* pClientItem, vscpEventEx* pex)
     return rv;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sendEvents
+//
+
+size_t
+CControlObject::sendEvents(CClientItem* pClientItem,
+                           std::vector<vscpEvent*>& events,
+                           std::vector<size_t>& failed)
+{
+    size_t nSent = 0;
+    uint32_t sizeData = 0;
+
+    // Events for the client output queue and their index in events
+    std::vector<vscpEvent*> queue;
+    std::vector<size_t> index;
+
+    if (NULL == pClientItem) {
+        syslog(LOG_ERR, "sendEvents - null clientItem");
+        for (size_t i = 0; i < events.size(); i++) {
+            failed.push_back(i);
+            vscp_deleteEvent_v2(&events[i]);
+        }
+        events.clear();
+        return 0;
+    }
+
+    queue.reserve(events.size());
+    index.reserve(events.size());
+
+    for (size_t i = 0; i < events.size(); i++) {
+
+        vscpEvent* pEvent = events[i];
+        if (NULL == pEvent) {
+            failed.push_back(i);
+            continue;
+        }
+
+        // If timestamp is nulled make one
+        if (0 == pEvent->timestamp) {
+            pEvent->timestamp = vscp_makeTimeStamp();
+        }
+
+        // If GUID is all nilled set interface GUID
+        if (vscp_isGUIDEmpty(pEvent->GUID)) {
+            memcpy(pEvent->GUID, pClientItem->m_guid.getGUID(), 16);
+        }
+
+        // Save the originating clients id so
+        // this client don't get the message back
+        pEvent->obid = pClientItem->m_clientID;
+
+        // Level I events over Level II to an interface on this machine
+        if (sendEventToInterface(pEvent)) {
+            nSent++;
+            continue;
+        }
+
+        sizeData += pEvent->sizeData;
+        queue.push_back(pEvent);
+        index.push_back(i);
+    }
+
+    events.clear();
+
+    if (queue.empty()) {
+        return nSent;
+    }
+
+    // All events go in the queue at once and the worker thread
+    // takes them all out when it is signaled
+    size_t n = m_clientOutputQueue.push(queue.data(), queue.size());
+    if (n > 0) {
+        sem_post(&m_semClientOutputQueue);
+    }
+
+    // The events that did not fit are still ours
+    for (size_t i = n; i < queue.size(); i++) {
+        sizeData -= queue[i]->sizeData;
+        failed.push_back(index[i]);
+        vscp_deleteEvent_v2(&queue[i]);
+    }
+
+    if (n < queue.size()) {
+        pClientItem->m_statistics.cntOverruns += queue.size() - n;
+        if (__VSCP_DEBUG_EXTRA) {
+            syslog(LOG_DEBUG, "sendEvents - overrun");
+        }
+    }
+
+    // TX Statistics
+    pClientItem->m_statistics.cntTransmitData += sizeData;
+    pClientItem->m_statistics.cntTransmitFrames += n;
+
+    return nSent + n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// admitEvents
+//
+// Tokens taken from the client bucket that the user bucket can not cover
+// are given back so a throttled user does not use up the client rate.
+//
+
+uint32_t
+CControlObject::admitEvents(CClientItem* pClientItem, uint32_t count)
+{
+    if (NULL == pClientItem) {
+        return 0;
+    }
+
+    uint32_t n = pClientItem->m_rateLimit.take(count);
+
+    CUserItem* pUserItem = pClientItem->m_pUserItem;
+    if ((NULL != pUserItem) && (n > 0)) {
+        uint32_t nUser = pUserItem->getRateLimit().take(n);
+        pClientItem->m_rateLimit.giveBack(n - nUser);
+        n = nUser;
+    }
+
+    if ((n < count) && __VSCP_DEBUG_EXTRA) {
+        syslog(LOG_DEBUG,
+               "admitEvents - client %lu throttled %u of %u event(s)",
+               (unsigned long)pClientItem->m_clientID,
+               count - n,
+               count);
+    }
+
+    return n;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // addClient
 //
@@ -1481,17 +1799,43 @@ CControlObject::sendEvent(CClientItem* pClientItem, vscpEventEx* pex)
 bool
 CControlObject::addClient(CClientItem* pClientItem, uint32_t id)
 {
+    // Allocate the input queue for the client
+    if (!pClientItem->m_clientInputQueue.init(m_maxItemsInClientReceiveQueue)) {
+        syslog(LOG_ERR, "addClient - Unable to allocate client input queue");
+        return false;
+    }
+
     // Add client to client list
     if (!m_clientList.addClient(pClientItem, id)) {
         return false;
     }
 
     // Set GUID for interface
-    pClientItem->m_guid = m_guid;
+    cguid guid = m_guid;
 
     // Fill in client id
-    pClientItem->m_guid.setNicknameID(0);
-    pClientItem->m_guid.setClientID(pClientItem->m_clientID);
+    guid.setNicknameID(0);
+    guid.setClientID(pClientItem->m_clientID);
+
+    m_clientList.setClientGUID(pClientItem, guid);
+
+    // Rate limit for the interface type
+    switch (pClientItem->m_type) {
+        case CLIENT_ITEM_INTERFACE_TYPE_CLIENT_TCPIP:
+            pClientItem->m_rateLimit.setRate(m_tcpip_rateLimit,
+                                             m_tcpip_rateLimitBurst);
+            break;
+        case CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEBSOCKET:
+            pClientItem->m_rateLimit.setRate(m_websocket_rateLimit,
+                                             m_websocket_rateLimitBurst);
+            break;
+        case CLIENT_ITEM_INTERFACE_TYPE_CLIENT_REST:
+            pClientItem->m_rateLimit.setRate(m_rest_rateLimit,
+                                             m_rest_rateLimitBurst);
+            break;
+        default:
+            break;
+    }
 
     return true;
 }
@@ -1777,6 +2121,33 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                 pObj->m_maxItemsInClientReceiveQueue =
                   vscp_readStringValue(attribute);
             }
+            else if (0 == vscp_strcasecmp(attr[i], "outputqueuesize")) {
+                pObj->m_maxItemsInClientOutputQueue =
+                  vscp_readStringValue(attribute);
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "dispatchworkers")) {
+                uint32_t n = vscp_readStringValue(attribute);
+                if (n < 1) {
+                    n = 1;
+                }
+                else if (n > CLIENTLIST_MAX_SHARDS) {
+                    syslog(LOG_ERR,
+                           "dispatchworkers limited to %d",
+                           CLIENTLIST_MAX_SHARDS);
+                    n = CLIENTLIST_MAX_SHARDS;
+                }
+                pObj->m_nDispatchWorkers = (uint8_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "dispatchbatch")) {
+                uint32_t n = vscp_readStringValue(attribute);
+                if (0 == n) {
+                    n = 1;
+                }
+                pObj->m_nDispatchBatch = n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "eventpoolsize")) {
+                pObj->m_nEventPoolSize = vscp_readStringValue(attribute);
+            }
             else if (0 == vscp_strcasecmp(attr[i], "runasuser")) {
                 vscp_trim(attribute);
                 pObj->m_runAsUser = attribute;
@@ -1904,6 +2275,39 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                 vscp_trim(attribute);
                 pObj->m_strTcpInterfaceAddress = attribute;
             }
+            else if (0 == vscp_strcasecmp(attr[i], "workers")) {
+                int n = vscp_readStringValue(attribute);
+                if (n < 1) {
+                    n = 1;
+                }
+                else if (n > VSCP_TCPIP_MAX_WORKERS) {
+                    syslog(LOG_ERR,
+                           "tcp/ip workers limited to %d",
+                           VSCP_TCPIP_MAX_WORKERS);
+                    n = VSCP_TCPIP_MAX_WORKERS;
+                }
+                pObj->m_tcpip_nWorkers = (uint8_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "maxconnections")) {
+                int n = vscp_readStringValue(attribute);
+                if (n < 1) {
+                    n = 1;
+                }
+                pObj->m_tcpip_maxConnections = (uint32_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "commandhistory")) {
+                int n = vscp_readStringValue(attribute);
+                if (n < 0) {
+                    n = 0;
+                }
+                pObj->m_tcpip_commandHistory = (uint32_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimit")) {
+                pObj->m_tcpip_rateLimit = vscp_readStringValue(attribute);
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimitburst")) {
+                pObj->m_tcpip_rateLimitBurst = vscp_readStringValue(attribute);
+            }
             else if (0 == vscp_strcasecmp(attr[i], "ssl_certificate")) {
                 pObj->m_tcpip_ssl_certificate = attribute;
             }
@@ -1947,6 +2351,29 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                     pObj->m_tcpip_ssl_short_trust = false;
                 }
             }
+            else if (0 ==
+                     vscp_strcasecmp(attr[i], "ssl_session_cache_size")) {
+                int n = vscp_readStringValue(attribute);
+                if (n < 0) {
+                    n = 0;
+                }
+                pObj->m_tcpip_ssl_session_cache_size = (uint32_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ssl_session_timeout")) {
+                int n = vscp_readStringValue(attribute);
+                if (n < 0) {
+                    n = 0;
+                }
+                pObj->m_tcpip_ssl_session_timeout = (uint32_t)n;
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ssl_session_tickets")) {
+                if (0 == vscp_strcasecmp(attribute.c_str(), "true")) {
+                    pObj->m_tcpip_ssl_session_tickets = true;
+                }
+                else {
+                    pObj->m_tcpip_ssl_session_tickets = false;
+                }
+            }
         }
     }
 
@@ -2299,6 +2726,12 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                     pObj->m_bEnableRestApi = false;
                 }
             }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimit")) {
+                pObj->m_rest_rateLimit = vscp_readStringValue(attribute);
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimitburst")) {
+                pObj->m_rest_rateLimitBurst = vscp_readStringValue(attribute);
+            }
         }
     }
     else if (bVscpConfigFound && (1 == depth_full_config_parser) &&
@@ -2343,6 +2776,13 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                     pObj->lua_websocket_pattern = attribute;
                 }
             }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimit")) {
+                pObj->m_websocket_rateLimit = vscp_readStringValue(attribute);
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimitburst")) {
+                pObj->m_websocket_rateLimitBurst =
+                  vscp_readStringValue(attribute);
+            }
         }
     }
     else if (bVscpConfigFound && (1 == depth_full_config_parser) &&
@@ -2363,6 +2803,8 @@ startFullConfigParser(void* data, const char* name, const char** attr)
         std::string allowevent;
         std::string fullname;
         std::string note;
+        uint32_t rateLimit      = 0; // No limit
+        uint32_t rateLimitBurst = 0;
 
         vscp_clearVSCPFilter(&VSCPFilter); // Allow all frames
 
@@ -2392,6 +2834,12 @@ startFullConfigParser(void* data, const char* name, const char** attr)
             else if (0 == vscp_strcasecmp(attr[i], "allowevent")) {
                 allowevent = attribute;
             }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimit")) {
+                rateLimit = vscp_readStringValue(attribute);
+            }
+            else if (0 == vscp_strcasecmp(attr[i], "ratelimitburst")) {
+                rateLimitBurst = vscp_readStringValue(attribute);
+            }
             else if (0 == vscp_strcasecmp(attr[i], "filter")) {
                 if (attribute.length()) {
                     if (vscp_readFilterFromString(&VSCPFilter, attribute)) {
@@ -2406,30 +2854,25 @@ startFullConfigParser(void* data, const char* name, const char** attr)
                     }
                 }
             }
+        }
 
-            if (bFilterPresent && bMaskPresent) {
-                pObj->m_userList.addUser(name,
-                                         md5,
-                                         fullname,
-                                         note,
-                                         pObj->m_web_authentication_domain,
-                                         &VSCPFilter,
-                                         privilege,
-                                         allowfrom,
-                                         allowevent,
-                                         0);
-            }
-            else {
-                pObj->m_userList.addUser(name,
-                                         md5,
-                                         fullname,
-                                         note,
-                                         pObj->m_web_authentication_domain,
-                                         NULL,
-                                         privilege,
-                                         allowfrom,
-                                         allowevent,
-                                         0);
+        // The user is added when all attributes are read
+        if (pObj->m_userList.addUser(name,
+                                     md5,
+                                     fullname,
+                                     note,
+                                     pObj->m_web_authentication_domain,
+                                     (bFilterPresent && bMaskPresent)
+                                       ? &VSCPFilter
+                                       : NULL,
+                                     privilege,
+                                     allowfrom,
+                                     allowevent,
+                                     0) &&
+            rateLimit) {
+            CUserItem* pUserItem = pObj->m_userList.getUser(name);
+            if (NULL != pUserItem) {
+                pUserItem->getRateLimit().setRate(rateLimit, rateLimitBurst);
             }
         }
     }
@@ -2693,6 +3136,73 @@ CControlObject::readConfiguration(const std::string& strcfgfile)
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////////////////////////////////////////////////
+// CDispatchWorker
+//
+
+CDispatchWorker::CDispatchWorker(CControlObject* pObj, uint8_t shard)
+{
+    m_pObj          = pObj;
+    m_shard         = shard;
+    m_bQuit         = false;
+    m_maxEventQueue = pObj->m_maxItemsInClientOutputQueue;
+
+    sem_init(&m_semEventQueue, 0, 0);
+    pthread_mutex_init(&m_mutexEventQueue, NULL);
+    pthread_cond_init(&m_condEventQueue, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CDispatchWorker
+//
+
+CDispatchWorker::~CDispatchWorker(void)
+{
+    // Release events that never was delivered
+    std::deque<CSharedEvent*>::iterator it;
+    for (it = m_eventQueue.begin(); it != m_eventQueue.end(); ++it) {
+        (*it)->release();
+    }
+    m_eventQueue.clear();
+
+    sem_destroy(&m_semEventQueue);
+    pthread_cond_destroy(&m_condEventQueue);
+    pthread_mutex_destroy(&m_mutexEventQueue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// postEvents
+//
+
+void
+CDispatchWorker::postEvents(const std::vector<CSharedEvent*>& batch)
+{
+    std::vector<CSharedEvent*>::const_iterator it;
+
+    if (batch.empty()) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_mutexEventQueue);
+
+    // Wait for the worker to make room. The events that can't be
+    // queued meanwhile stay in the client output queue where they
+    // hold back the clients that send them. An empty queue takes
+    // any batch.
+    while (!m_eventQueue.empty() &&
+           ((m_eventQueue.size() + batch.size()) > m_maxEventQueue)) {
+        pthread_cond_wait(&m_condEventQueue, &m_mutexEventQueue);
+    }
+
+    for (it = batch.begin(); it != batch.end(); ++it) {
+        (*it)->addRef();
+        m_eventQueue.push_back(*it);
+    }
+    pthread_mutex_unlock(&m_mutexEventQueue);
+    sem_post(&m_semEventQueue);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // clientMsgWorkerThread
 //
@@ -2703,14 +3213,19 @@ CControlObject::readConfiguration(const std::string& strcfgfile)
 void*
 clientMsgWorkerThread(void* userdata)
 {
-    std::list<vscpEvent*>::iterator it;
-    vscpEvent* pvscpEvent = NULL;
+    vscpEvent* pvscpEvent        = NULL;
+    CSharedEvent* pSharedEvent   = NULL;
+    CPriorityLanes lanes;
+    std::vector<CSharedEvent*> batch;
+    std::vector<CSharedEvent*>::iterator it;
 
     // Must be a valid control object pointer
     CControlObject* pObj = (CControlObject*)userdata;
     if (NULL == pObj)
         return NULL;
 
+    batch.reserve(pObj->m_nDispatchBatch);
+
     while (!pObj->m_bQuit_clientMsgWorkerThread) {
 
         // Wait for event
@@ -2719,32 +3234,130 @@ clientMsgWorkerThread(void* userdata)
             continue;
         }
 
-        if (pObj->m_clientOutputQueue.size()) {
+        // Take out all events that are ready. An event that is still
+        // being put in the queue by one client can hide events queued
+        // after it by other clients so the queue is always emptied.
+        // Events are delivered in batches so that a burst of events
+        // lock the client list and wake up each client once per batch
+        // instead of once per event. The events go through priority
+        // lanes so high priority events that arrive during a burst are
+        // delivered before the low priority events queued ahead of them.
+        do {
 
-            pthread_mutex_lock(&pObj->m_mutex_ClientOutputQueue);
-            pvscpEvent = pObj->m_clientOutputQueue.front();
-            pObj->m_clientOutputQueue.pop_front();
-            pthread_mutex_unlock(&pObj->m_mutex_ClientOutputQueue);
+            while ((lanes.size() < pObj->m_maxItemsInClientOutputQueue) &&
+                   (NULL != (pvscpEvent = pObj->m_clientOutputQueue.pop()))) {
 
-            if (NULL != pvscpEvent) {
+                // The shared event takes over the event and is
+                // deleted when the last client has released it
+                lanes.push(new CSharedEvent(pvscpEvent));
+                pvscpEvent = NULL;
+            }
 
-                // * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-                //
-                // Send event to all Level II clients (not to
-                // ourself )
-                //
-                // * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+            while ((batch.size() < pObj->m_nDispatchBatch) &&
+                   (NULL != (pSharedEvent = lanes.pop()))) {
+                batch.push_back(pSharedEvent);
+            }
+
+            if (batch.empty()) {
+                break;
+            }
+
+            // * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+            //
+            // Send events to all Level II clients (not to
+            // the sender)
+            //
+            // * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+
+            if (pObj->m_dispatchWorkers.empty()) {
+                pObj->sendEventBatchAllClients(batch);
 
-                pObj->sendEventAllClients(pvscpEvent, pvscpEvent->obid);
                 // Tell main thread that there are work to do
                 sem_post(&pObj->m_semSentToAllClients);
+            }
+            else {
+                // Every worker deliver the events to its shard
+                std::vector<CDispatchWorker*>::iterator itWorker;
+                for (itWorker = pObj->m_dispatchWorkers.begin();
+                     itWorker != pObj->m_dispatchWorkers.end();
+                     ++itWorker) {
+                    (*itWorker)->postEvents(batch);
+                }
+            }
+
+            for (it = batch.begin(); it != batch.end(); ++it) {
+                (*it)->release();
+            }
+            batch.clear();
+
+        } while (true); // Events in queue
+
+    } // while
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// dispatchWorkerThread
+//
+// Deliver events queued by the client message worker thread to the
+// clients in one shard of the client list.
+//
+
+void*
+dispatchWorkerThread(void* userdata)
+{
+    std::vector<CSharedEvent*> batch;
+    std::vector<CSharedEvent*>::iterator it;
+
+    // Must be a valid worker pointer
+    CDispatchWorker* pWorker = (CDispatchWorker*)userdata;
+    if (NULL == pWorker)
+        return NULL;
 
-            } // Valid event
+    CControlObject* pObj = pWorker->m_pObj;
+
+    batch.reserve(pObj->m_nDispatchBatch);
+
+    while (!pWorker->m_bQuit) {
+
+        // Wait for event
+        if ((-1 == vscp_sem_wait(&pWorker->m_semEventQueue, 10)) &&
+            errno == ETIMEDOUT) {
+            continue;
+        }
+
+        // Deliver everything that is queued, a batch at a time
+        do {
+
+            pthread_mutex_lock(&pWorker->m_mutexEventQueue);
+            while ((batch.size() < pObj->m_nDispatchBatch) &&
+                   !pWorker->m_eventQueue.empty()) {
+                batch.push_back(pWorker->m_eventQueue.front());
+                pWorker->m_eventQueue.pop_front();
+            }
+            pthread_mutex_unlock(&pWorker->m_mutexEventQueue);
+
+            // The client message worker thread may wait for room
+            if (!batch.empty()) {
+                pthread_cond_signal(&pWorker->m_condEventQueue);
+            }
+
+            if (batch.empty()) {
+                break;
+            }
+
+            pObj->sendEventBatchShard(batch, pWorker->m_shard);
+
+            for (it = batch.begin(); it != batch.end(); ++it) {
+                (*it)->release();
+            }
+            batch.clear();
 
-            // Delete the event - we are done with it
-            vscp_deleteEvent_v2(&pvscpEvent);
+            // Tell main thread that there are work to do
+            sem_post(&pObj->m_semSentToAllClients);
 
-        } // Events in queue
+        } while (true);
 
     } // while
 
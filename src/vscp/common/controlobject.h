@@ -29,12 +29,17 @@
 #if !defined(CONTROLOBJECT_H__INCLUDED_)
 #define CONTROLOBJECT_H__INCLUDED_
 
+#include <atomic>
+#include <deque>
 #include <set>
+#include <vector>
 
 #include <automation.h>
 #include <clientlist.h>
 #include <devicelist.h>
+#include <eventring.h>
 #include <interfacelist.h>
+#include <sessiontable.h>
 #include <tcpipsrv.h>
 #include <userlist.h>
 #include <vscp.h>
@@ -43,6 +48,7 @@
 
 // Forward declarations
 class TCPListenThread;
+class CControlObject;
 
 // TTL     Scope
 // ----------------------------------------------------------------------
@@ -71,11 +77,86 @@ class TCPListenThread;
 #define MAX_ITEMS_RECEIVE_QUEUE        1021
 #define MAX_ITEMS_SEND_QUEUE           1021
 #define MAX_ITEMS_CLIENT_RECEIVE_QUEUE 8192
+#define MAX_ITEMS_CLIENT_OUTPUT_QUEUE  8192
+
+// Default number of threads that deliver events to clients
+#define DEFAULT_DISPATCH_WORKERS 1
+
+// Default max number of events delivered together by the dispatch threads
+#define DEFAULT_DISPATCH_BATCH 64
+
+// Default number of threads that serve tcp/ip connections
+#define DEFAULT_TCPIP_WORKERS 4
+
+// Default number of blocks of each size in the event pool
+#define DEFAULT_EVENT_POOL_SIZE 4096
 
 // VSCP daemon defines from vscp.h
 #define VSCP_MAX_CLIENTS 4096 // abs. max. is 0xffff
 #define VSCP_MAX_DEVICES 1024 // abs. max. is 0xffff
 
+/*!
+    Dispatch worker
+
+    Each dispatch worker deliver events to the clients in one shard
+    of the client list. All events are queued to all workers in the
+    same order so events with the same priority are received in the
+    order they were sent by every client. The queue of each worker
+    hold at most as many events as the client output queue.
+*/
+
+class CDispatchWorker {
+  public:
+    /*!
+        Constructor
+        @param pObj Pointer to control object
+        @param shard Client list shard this worker deliver events to
+     */
+    CDispatchWorker(CControlObject* pObj, uint8_t shard);
+
+    /*!
+        Destructor
+     */
+    ~CDispatchWorker(void);
+
+    /*!
+        Queue a batch of events for delivery. A reference is added to
+        each event for the queue. The queue is locked and the worker
+        signaled once for the whole batch. Waits until there is room
+        for the batch in the queue.
+        @param batch Events to queue in the order they should be delivered.
+     */
+    void postEvents(const std::vector<CSharedEvent*>& batch);
+
+  public:
+    // Pointer to the control object
+    CControlObject* m_pObj;
+
+    // Client list shard served by this worker
+    uint8_t m_shard;
+
+    // Set to true to terminate the worker thread
+    std::atomic<bool> m_bQuit;
+
+    // Events waiting to be delivered (one reference each)
+    std::deque<CSharedEvent*> m_eventQueue;
+
+    // Max number of events in the event queue
+    size_t m_maxEventQueue;
+
+    // Protects the event queue
+    pthread_mutex_t m_mutexEventQueue;
+
+    // Signaled when an event is queued
+    sem_t m_semEventQueue;
+
+    // Signaled when events are taken from the event queue
+    pthread_cond_t m_condEventQueue;
+
+    // The worker thread
+    pthread_t m_workerThread;
+};
+
 /*!
     This is the class that does the main work in the daemon.
 */
@@ -246,20 +327,86 @@ class CControlObject {
         send level II message to all clients
         @param pClientItem Pointer to client object for client that should
                            receive the event
-        @param pEvent Pointer to event that should be sent to client. Caller
-                        must deallocate if needed.
+        @param pSharedEvent Pointer to shared event that should be sent to
+                        client. A reference is added for the client queue,
+                        the caller still owns its own reference.
+                        The client list shard of the client must be locked
+                        by the caller.
+        @param bWakeup Set to false to not wake up the client. The caller
+                        must then call wakeup on the client input queue
+                        when all events have been sent.
         @return true on success
      */
-    bool sendEventToClient(CClientItem* pClientItem, vscpEvent* pEvent);
+    bool sendEventToClient(CClientItem* pClientItem,
+                           CSharedEvent* pSharedEvent,
+                           bool bWakeup = true);
 
     /*!
         Send Level II event to all clients with exception
-        @param pEvent Pointer to event that should be sent. Caller must
-                        must take care of deallocation.
+        @param pSharedEvent Pointer to shared event that should be sent.
+                        Every receiving client queue gets a reference to
+                        the same event, the caller still owns its own
+                        reference.
         @param excludeID Client with this obid should not receive event.
         @return True on success
      */
-    bool sendEventAllClients(vscpEvent* pEvent, uint32_t excludeID = 0);
+    bool sendEventAllClients(CSharedEvent* pSharedEvent,
+                             uint32_t excludeID = 0);
+
+    /*!
+        Send Level II event to all clients in one shard of the client
+        list with exception
+        @param pSharedEvent Pointer to shared event that should be sent.
+                        The caller still owns its own reference.
+        @param shard Client list shard to send the event to.
+        @param excludeID Client with this obid should not receive event.
+        @return True on success
+     */
+    bool sendEventShard(CSharedEvent* pSharedEvent,
+                        uint8_t shard,
+                        uint32_t excludeID = 0);
+
+    /*!
+        Send a batch of Level II events to all clients except the
+        sender of each event.
+        @param batch Shared events that should be sent. The caller still
+                        owns its references.
+        @return True on success
+     */
+    bool sendEventBatchAllClients(const std::vector<CSharedEvent*>& batch);
+
+    /*!
+        Send a batch of Level II events to all clients in one shard of
+        the client list except the sender of each event. The shard is
+        locked once for the batch and every receiving client is woken
+        up once when all events have been queued.
+        @param batch Shared events that should be sent. The caller still
+                        owns its references.
+        @param shard Client list shard to send the events to.
+        @return True on success
+     */
+    bool sendEventBatchShard(const std::vector<CSharedEvent*>& batch,
+                             uint8_t shard);
+
+    /*!
+        Put an event in the client output queue for delivery to all
+        clients and signal the client message worker thread.
+        @param pClientItem Client that send the event. Its overrun counter
+                        is updated if the queue is full. Can be NULL.
+        @param pEvent Event to queue. The queue owns the event on success,
+                        on failure it is still owned by the caller.
+        @return true on success, false if the queue is full.
+     */
+    bool postClientOutputEvent(CClientItem* pClientItem, vscpEvent* pEvent);
+
+    /*!
+        Send a Level I event over Level II to the interface it is
+        addressed to if that interface is on this machine.
+        @param pEvent Event to send. Taken over if it is sent.
+        @return true if the event was sent to an interface, false if it
+                        should be sent to all clients.
+     */
+    bool sendEventToInterface(vscpEvent* pEvent);
 
     /*!
      * Send event
@@ -278,6 +425,34 @@ class CControlObject {
      */
     bool sendEvent(CClientItem* pClientItem, vscpEventEx* pex);
 
+    /*!
+     * Send a block of events. Each event is completed as by sendEvent
+     * but the events are not copied. The events for all clients are
+     * put in the client output queue in one go and the client message
+     * worker thread is signaled once.
+     * @param pClientItem Client that send the events.
+     * @param events Events to send allocated with vscp_newEvent. All
+     *               of them are taken over (sent or deleted) and the
+     *               vector is cleared.
+     * @param failed The index in events of each event that could not be
+     *               sent (the queue was full) is added to this vector.
+     * @return Number of events sent.
+     */
+    size_t sendEvents(CClientItem* pClientItem,
+                      std::vector<vscpEvent*>& events,
+                      std::vector<size_t>& failed);
+
+    /*!
+     * Check how many events a client is allowed to send right now. The
+     * events are counted against the rate limit of the client (set
+     * for its interface type) and the rate limit of its user.
+     * @param pClientItem Client that want to send the events.
+     * @param count Number of events the client want to send.
+     * @return Number of events (the first ones) that can be sent, the
+     *         rest should be refused.
+     */
+    uint32_t admitEvents(CClientItem* pClientItem, uint32_t count = 1);
+
     /*!
      * Check if a driver name is free to us
      *
@@ -359,6 +534,29 @@ class CControlObject {
      */
     uint32_t m_maxItemsInClientReceiveQueue;
 
+    /*!
+        Maximum number of items in the client output queue (OutputQueueSize)
+     */
+    uint32_t m_maxItemsInClientOutputQueue;
+
+    /*!
+        Number of threads that deliver events to clients (dispatchworkers).
+        The client list is split in this many shards.
+     */
+    uint8_t m_nDispatchWorkers;
+
+    /*!
+        Max number of events taken from the client output queue and
+        delivered to clients in one go (dispatchbatch).
+     */
+    uint32_t m_nDispatchBatch;
+
+    /*!
+        Number of blocks of each size in the event pool (eventpoolsize).
+        Zero disables the pool and all events are allocated on the heap.
+     */
+    uint32_t m_nEventPoolSize;
+
     /*!
         Name of this server
      */
@@ -397,6 +595,19 @@ class CControlObject {
     // Listen thread for tcp/ip connections
     pthread_t m_tcpipListenThread;
 
+    // Number of threads that serve the tcp/ip connections
+    uint8_t m_tcpip_nWorkers;
+
+    // Max number of tcp/ip clients connected at the same time
+    uint32_t m_tcpip_maxConnections;
+
+    // Number of old commands saved for each tcp/ip client. Zero is off.
+    uint32_t m_tcpip_commandHistory;
+
+    // Rate limit (events/second) and burst for each tcp/ip client
+    uint32_t m_tcpip_rateLimit;
+    uint32_t m_tcpip_rateLimitBurst;
+
     // tcp/ip SSL settings
     std::string m_tcpip_ssl_certificate;
     std::string m_tcpip_ssl_certificate_chain;
@@ -409,6 +620,13 @@ class CControlObject {
     uint8_t m_tcpip_ssl_protocol_version;
     bool m_tcpip_ssl_short_trust;
 
+    // tcp/ip SSL session resumption. Number of sessions in the server
+    // cache (zero is off), seconds a session can be resumed and if
+    // session tickets are given to clients.
+    uint32_t m_tcpip_ssl_session_cache_size;
+    uint32_t m_tcpip_ssl_session_timeout;
+    bool m_tcpip_ssl_session_tickets;
+
     //*****************************************************
     //               webserver interface
     //*****************************************************
@@ -478,25 +696,23 @@ class CControlObject {
     std::string m_web_lua_background_script;
     std::string m_web_lua_background_script_params;
 
-    // Protects the web session object
-    pthread_mutex_t m_mutex_websrvSession;
-
-    // Linked list of all active sessions. (websrv.h)
-    std::list<struct websrv_session*> m_web_sessions;
+    // All active web sessions keyed on sid. (websrv.h)
+    CSessionTable m_web_sessions;
 
     //**************************************************************************
     //                              REST
     //**************************************************************************
 
-    // Protects the REST session object
-    pthread_mutex_t m_mutex_restSession;
-
-    // Session structure for REST API
-    std::list<struct restsrv_session*> m_rest_sessions;
+    // All active REST sessions keyed on sid. (restsrv.h)
+    CSessionTable m_rest_sessions;
 
     // Enable REST API
     bool m_bEnableRestApi;
 
+    // Rate limit (events/second) and burst for each REST session
+    uint32_t m_rest_rateLimit;
+    uint32_t m_rest_rateLimitBurst;
+
     //**************************************************************************
     //                              WEBSOCKETS
     //**************************************************************************
@@ -507,6 +723,10 @@ class CControlObject {
     bool bEnable_websocket_ping_pong;
     std::string lua_websocket_pattern;
 
+    // Rate limit (events/second) and burst for each websocket session
+    uint32_t m_websocket_rateLimit;
+    uint32_t m_websocket_rateLimitBurst;
+
     // * * Websockets * *
 
     // Protects the websocket session object
@@ -564,8 +784,9 @@ class CControlObject {
 
         This is the send queue for all clients attached to the system. A client
         place events here and the system distribute it to all other clients.
+        Use postClientOutputEvent to put events in the queue.
      */
-    std::list<vscpEvent*> m_clientOutputQueue;
+    CEventRing m_clientOutputQueue;
 
     /*!
        Event object to indicate that there is an event in the client output
@@ -573,17 +794,18 @@ class CControlObject {
      */
     sem_t m_semClientOutputQueue;
 
-    /*!
-        Mutex for Level II message send queue
-     */
-    pthread_mutex_t m_mutex_ClientOutputQueue;
-
     /*!
         Semaphore that is signaled when workerthread
         have send an incoming event to all clients
     */
     sem_t m_semSentToAllClients;
 
+    /*!
+        Dispatch workers, one for each client list shard. Empty
+        if the client message worker thread deliver events itself.
+     */
+    std::vector<CDispatchWorker*> m_dispatchWorkers;
+
     // *************************************************************************
 
   private:
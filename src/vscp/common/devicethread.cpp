@@ -111,16 +111,17 @@ deviceThread(void* pData)
                "Devicethread: Failed to add client. Terminating thread.");
         return NULL;
     }
-    pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
 
     // Client now have GUID set to server GUID + channel id
     // If device has a non NULL GUID replace the client GUID preserving
-    // the channel id with that GUID
+    // the channel id with that GUID. The GUID index of the client list
+    // must follow so events addressed to the driver find it.
     if (!pClientItem->m_guid.isNULL()) {
-        memcpy(pClientItem->m_guid.m_id,
-               pDevItem->m_interface_guid.getGUID(),
-               12);
+        cguid guid = pClientItem->m_guid;
+        memcpy(guid.m_id, pDevItem->m_interface_guid.getGUID(), 12);
+        pObj->m_clientList.setClientGUID(pClientItem, guid);
     }
+    pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
 
     void* hdll;
 
@@ -467,36 +468,30 @@ deviceThread(void* pData)
 
                         bActivity = true;
 
-                        // There must be room in the receive queue
-                        if (pObj->m_maxItemsInClientReceiveQueue >
-                            pObj->m_clientOutputQueue.size()) {
-
-                            vscpEvent* pev = new vscpEvent;
-                            if (NULL != pev) {
-
-                                // Set driver GUID if set
-                                if (pDevItem->m_interface_guid.isNULL()) {
-                                    pDevItem->m_interface_guid.writeGUID(
-                                      pev->GUID);
-                                } else {
-                                    // If no driver GUID set use interface GUID
-                                    pClientItem->m_guid.writeGUID(pev->GUID);
-                                }
-
-                                // Convert CANAL message to VSCP event
-                                vscp_convertCanalToEvent(
-                                  pev,
-                                  &msg,
-                                  pClientItem->m_guid.m_id);
-
-                                pev->obid = pClientItem->m_clientID;
-
-                                pthread_mutex_lock(
-                                  &pObj->m_mutex_ClientOutputQueue);
-                                pObj->m_clientOutputQueue.push_back(pev);
-                                pthread_mutex_unlock(
-                                  &pObj->m_mutex_ClientOutputQueue);
-                                sem_post(&pObj->m_semClientOutputQueue);
+                        vscpEvent* pev;
+                        if (vscp_newEvent(&pev)) {
+
+                            // Set driver GUID if set
+                            if (pDevItem->m_interface_guid.isNULL()) {
+                                pDevItem->m_interface_guid.writeGUID(
+                                  pev->GUID);
+                            } else {
+                                // If no driver GUID set use interface GUID
+                                pClientItem->m_guid.writeGUID(pev->GUID);
+                            }
+
+                            // Convert CANAL message to VSCP event
+                            vscp_convertCanalToEvent(
+                              pev,
+                              &msg,
+                              pClientItem->m_guid.m_id);
+
+                            pev->obid = pClientItem->m_clientID;
+
+                            // There must be room in the receive queue
+                            if (!pObj->postClientOutputEvent(pClientItem,
+                                                             pev)) {
+                                vscp_deleteEvent_v2(&pev);
                             }
                         }
                     }
@@ -507,27 +502,26 @@ deviceThread(void* pData)
                 // * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 
                 // Check if there is something to send
-                if (pClientItem->m_clientInputQueue.size()) {
+                CSharedEvent* pSharedEvent =
+                  pClientItem->m_clientInputQueue.front();
+                if (NULL != pSharedEvent) {
 
                     bActivity = true;
 
-                    std::deque<vscpEvent*>::iterator it;
-                    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-                    vscpEvent* pev = pClientItem->m_clientInputQueue.front();
-                    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+                    const vscpEvent* pev = pSharedEvent->getEvent();
 
                     // Trow away Level II event on Level I interface
                     if ((CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL1 ==
                          pClientItem->m_type) &&
                         (pev->vscp_class > 512)) {
-                        // Remove the event and the node
-                        pClientItem->m_clientInputQueue.pop_front();
                         syslog(LOG_ERR,
                                "Level II event on Level I queue thrown away. "
                                "class=%d, type=%d",
                                pev->vscp_class,
                                pev->vscp_type);
-                        vscp_deleteEvent(pev);
+                        // Remove the event and the node
+                        pClientItem->m_clientInputQueue.pop();
+                        pSharedEvent->release();
                         continue;
                     }
 
@@ -537,12 +531,11 @@ deviceThread(void* pData)
                         pDevItem->m_proc_CanalSend(pDevItem->m_openHandle,
                                                    &canmsg)) {
                         // Remove the event and the node
-                        pClientItem->m_clientInputQueue.pop_front();
-                        vscp_deleteEvent(pev);
+                        pClientItem->m_clientInputQueue.pop();
+                        pSharedEvent->release();
                     } else {
-                        // Another try
-                        // pObj->m_semClientOutputQueue.Post();
-                        vscp_deleteEvent(pev); // TODO ????
+                        // Another try - event is left in the queue
+                        ;
                     }
 
                 } // events
@@ -788,100 +781,95 @@ deviceLevel1ReceiveThread(void* pData)
                                                   &msg,
                                                   500)) {
 
-            // There must be room in the receive queue
-            if (pDevItem->m_pObj->m_maxItemsInClientReceiveQueue >
-                pDevItem->m_pObj->m_clientOutputQueue.size()) {
+            vscpEvent* pvscpEvent;
+            if (vscp_newEvent(&pvscpEvent)) {
 
-                vscpEvent* pvscpEvent = new vscpEvent;
-                if (NULL != pvscpEvent) {
+                memset(pvscpEvent, 0, sizeof(vscpEvent));
 
-                    memset(pvscpEvent, 0, sizeof(vscpEvent));
+                // Set driver GUID if set
+                /*if ( pDevItem->m_interface_guid.isNULL()
+                ) { pDevItem->m_interface_guid.writeGUID(
+                pvscpEvent->GUID );
+                }
+                else {
+                    // If no driver GUID set use interface GUID
+                    pDevItem->m_guid.writeGUID(
+                pvscpEvent->GUID );
+                }*/
+
+                // Convert CANAL message to VSCP event
+                vscp_convertCanalToEvent(
+                  pvscpEvent,
+                  &msg,
+                  pDevItem->m_pClientItem->m_guid.m_id);
+
+                pvscpEvent->obid = pDevItem->m_pClientItem->m_clientID;
+
+                // If no GUID is set,
+                //      - Set driver GUID if it is defined
+                //      - Set to interface GUID if not.
+
+                uint8_t ifguid[16];
+
+                // Save nickname
+                uint8_t nickname_lsb = pvscpEvent->GUID[15];
+
+                // Set if to use
+                memcpy(ifguid, pvscpEvent->GUID, 16);
+                ifguid[14] = 0;
+                ifguid[15] = 0;
+
+                // If if is set to zero use interface id
+                if (vscp_isGUIDEmpty(ifguid)) {
 
                     // Set driver GUID if set
-                    /*if ( pDevItem->m_interface_guid.isNULL()
-                    ) { pDevItem->m_interface_guid.writeGUID(
-                    pvscpEvent->GUID );
-                    }
-                    else {
+                    if (!pDevItem->m_interface_guid.isNULL()) {
+                        pDevItem->m_interface_guid.writeGUID(
+                          pvscpEvent->GUID);
+                    } else {
                         // If no driver GUID set use interface GUID
-                        pDevItem->m_guid.writeGUID(
-                    pvscpEvent->GUID );
-                    }*/
-
-                    // Convert CANAL message to VSCP event
-                    vscp_convertCanalToEvent(
-                      pvscpEvent,
-                      &msg,
-                      pDevItem->m_pClientItem->m_guid.m_id);
-
-                    pvscpEvent->obid = pDevItem->m_pClientItem->m_clientID;
-
-                    // If no GUID is set,
-                    //      - Set driver GUID if it is defined
-                    //      - Set to interface GUID if not.
-
-                    uint8_t ifguid[16];
-
-                    // Save nickname
-                    uint8_t nickname_lsb = pvscpEvent->GUID[15];
-
-                    // Set if to use
-                    memcpy(ifguid, pvscpEvent->GUID, 16);
-                    ifguid[14] = 0;
-                    ifguid[15] = 0;
-
-                    // If if is set to zero use interface id
-                    if (vscp_isGUIDEmpty(ifguid)) {
-
-                        // Set driver GUID if set
-                        if (!pDevItem->m_interface_guid.isNULL()) {
-                            pDevItem->m_interface_guid.writeGUID(
-                              pvscpEvent->GUID);
-                        } else {
-                            // If no driver GUID set use interface GUID
-                            pDevItem->m_pClientItem->m_guid.writeGUID(
-                              pvscpEvent->GUID);
-                        }
-
-                        // Preserve nickname
-                        pvscpEvent->GUID[15] = nickname_lsb;
+                        pDevItem->m_pClientItem->m_guid.writeGUID(
+                          pvscpEvent->GUID);
                     }
 
-                    // =========================================================
-                    //                   Outgoing translations
-                    // =========================================================
+                    // Preserve nickname
+                    pvscpEvent->GUID[15] = nickname_lsb;
+                }
 
-                    // Level I measurement events to Level II measurement float
-                    if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_M1_M2F) {
-                        vscp_convertLevel1MeasuremenToLevel2Double(pvscpEvent);
-                    }
+                // =========================================================
+                //                   Outgoing translations
+                // =========================================================
 
-                    // Level I measurement events to Level II measurement string
-                    if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_M1_M2S) {
-                        vscp_convertLevel1MeasuremenToLevel2String(pvscpEvent);
-                    }
+                // Level I measurement events to Level II measurement float
+                if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_M1_M2F) {
+                    vscp_convertLevel1MeasuremenToLevel2Double(pvscpEvent);
+                }
 
-                    // Level I events to Level I over Level II events
-                    if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_ALL_L2) {
-                        pvscpEvent->vscp_class += 512;
-                        uint8_t* p = new uint8_t[16 + pvscpEvent->sizeData];
-                        if (NULL != p) {
-                            memset(p, 0, 16 + pvscpEvent->sizeData);
-                            memcpy(p + 16,
-                                   pvscpEvent->pdata,
-                                   pvscpEvent->sizeData);
-                            pvscpEvent->sizeData += 16;
-                            delete[] pvscpEvent->pdata;
-                            pvscpEvent->pdata = p;
-                        }
+                // Level I measurement events to Level II measurement string
+                if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_M1_M2S) {
+                    vscp_convertLevel1MeasuremenToLevel2String(pvscpEvent);
+                }
+
+                // Level I events to Level I over Level II events
+                if (pDevItem->m_translation & VSCP_DRIVER_OUT_TR_ALL_L2) {
+                    pvscpEvent->vscp_class += 512;
+                    uint8_t* p = new uint8_t[16 + pvscpEvent->sizeData];
+                    if (NULL != p) {
+                        memset(p, 0, 16 + pvscpEvent->sizeData);
+                        memcpy(p + 16,
+                               pvscpEvent->pdata,
+                               pvscpEvent->sizeData);
+                        pvscpEvent->sizeData += 16;
+                        vscp_deleteEvent(pvscpEvent);
+                        pvscpEvent->pdata = p;
                     }
+                }
 
-                    pthread_mutex_lock(
-                      &pDevItem->m_pObj->m_mutex_ClientOutputQueue);
-                    pDevItem->m_pObj->m_clientOutputQueue.push_back(pvscpEvent);
-                    pthread_mutex_unlock(
-                      &pDevItem->m_pObj->m_mutex_ClientOutputQueue);
-                    sem_post(&pDevItem->m_pObj->m_semClientOutputQueue);
+                // There must be room in the receive queue
+                if (!pDevItem->m_pObj->postClientOutputEvent(
+                      pDevItem->m_pClientItem,
+                      pvscpEvent)) {
+                    vscp_deleteEvent_v2(&pvscpEvent);
                 }
             }
         }
@@ -915,43 +903,36 @@ deviceLevel1WriteThread(void* pData)
     while (!pDevItem->m_bQuit) {
 
         // Wait until there is something to send
-        if ((-1 ==
-             vscp_sem_wait(&pDevItem->m_pClientItem->m_semClientInputQueue,
-                           500)) &&
-            errno == ETIMEDOUT) {
+        if (!pDevItem->m_pClientItem->m_clientInputQueue.wait(500)) {
             continue;
         }
 
-        if (pDevItem->m_pClientItem->m_clientInputQueue.size()) {
+        CSharedEvent* pSharedEvent =
+          pDevItem->m_pClientItem->m_clientInputQueue.pop();
+        if (NULL != pSharedEvent) {
 
-            pthread_mutex_lock(
-              &pDevItem->m_pClientItem->m_mutexClientInputQueue);
-            vscpEvent* pev =
-              pDevItem->m_pClientItem->m_clientInputQueue.front();
-            pDevItem->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pDevItem->m_pClientItem->m_mutexClientInputQueue);
+            const vscpEvent* pev = pSharedEvent->getEvent();
 
             // Trow away event if Level II and Level I interface
             if ((CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL1 ==
                  pDevItem->m_pClientItem->m_type) &&
                 (pev->vscp_class > 512)) {
-                vscp_deleteEvent(pev);
+                pSharedEvent->release();
                 continue;
             }
 
             canalMsg msg;
             vscp_convertEventToCanal(&msg, pev);
-            if (CANAL_ERROR_SUCCESS ==
+            if (CANAL_ERROR_SUCCESS !=
                 pDevItem->m_proc_CanalBlockingSend(pDevItem->m_openHandle,
                                                    &msg,
                                                    300)) {
-                vscp_deleteEvent(pev);
-            } else {
                 // Give it another try
-                sem_post(&pDevItem->m_pObj->m_semClientOutputQueue);
+                pDevItem->m_pClientItem->m_clientInputQueue.signal();
             }
 
+            pSharedEvent->release();
+
         } // events in queue
 
     } // while
@@ -985,13 +966,12 @@ deviceLevel2ReceiveThread(void* pData)
     int rv;
     while (!pDevItem->m_bQuit) {
 
-        pev = new vscpEvent;
-        if (NULL == pev)
+        if (!vscp_newEvent(&pev))
             continue;
         rv = pDevItem->m_proc_VSCPRead(pDevItem->m_openHandle, pev, 500);
 
         if ((CANAL_ERROR_SUCCESS != rv) || (NULL == pev)) {
-            delete pev;
+            vscp_deleteEvent_v2(&pev);
             continue;
         }
 
@@ -1035,17 +1015,9 @@ deviceLevel2ReceiveThread(void* pData)
         }
 
         // There must be room in the receive queue
-        if (pDevItem->m_pObj->m_maxItemsInClientReceiveQueue >
-            pDevItem->m_pObj->m_clientOutputQueue.size()) {
-
-            pthread_mutex_lock(&pDevItem->m_pObj->m_mutex_ClientOutputQueue);
-            pDevItem->m_pObj->m_clientOutputQueue.push_back(pev);
-            pthread_mutex_unlock(&pDevItem->m_pObj->m_mutex_ClientOutputQueue);
-            sem_post(&pDevItem->m_pObj->m_semClientOutputQueue);
-
-        } else {
-            if (NULL == pev)
-                vscp_deleteEvent_v2(&pev);
+        if (!pDevItem->m_pObj->postClientOutputEvent(pDevItem->m_pClientItem,
+                                                     pev)) {
+            vscp_deleteEvent_v2(&pev);
         }
     }
 
@@ -1073,34 +1045,25 @@ deviceLevel2WriteThread(void* pData)
     while (!pDevItem->m_bQuit) {
 
         // Wait until there is something to send
-        if ((-1 ==
-             vscp_sem_wait(&pDevItem->m_pClientItem->m_semClientInputQueue,
-                           500)) &&
-            errno == ETIMEDOUT) {
+        if (!pDevItem->m_pClientItem->m_clientInputQueue.wait(500)) {
             continue;
         }
 
-        if (pDevItem->m_pClientItem->m_clientInputQueue.size()) {
-
-            pthread_mutex_lock(
-              &pDevItem->m_pClientItem->m_mutexClientInputQueue);
-            vscpEvent* pev =
-              pDevItem->m_pClientItem->m_clientInputQueue.front();
-            pthread_mutex_unlock(
-              &pDevItem->m_pClientItem->m_mutexClientInputQueue);
+        CSharedEvent* pSharedEvent =
+          pDevItem->m_pClientItem->m_clientInputQueue.front();
+        if (NULL != pSharedEvent) {
 
             if (CANAL_ERROR_SUCCESS ==
-                pDevItem->m_proc_VSCPWrite(pDevItem->m_openHandle, pev, 300)) {
+                pDevItem->m_proc_VSCPWrite(pDevItem->m_openHandle,
+                                           pSharedEvent->getEvent(),
+                                           300)) {
 
                 // Remove the node
-                pthread_mutex_lock(
-                  &pDevItem->m_pClientItem->m_mutexClientInputQueue);
-                pDevItem->m_pClientItem->m_clientInputQueue.pop_front();
-                pthread_mutex_unlock(
-                  &pDevItem->m_pClientItem->m_mutexClientInputQueue);
+                pDevItem->m_pClientItem->m_clientInputQueue.pop();
+                pSharedEvent->release();
             } else {
                 // Give it another try
-                sem_post(&pDevItem->m_pObj->m_semClientOutputQueue);
+                pDevItem->m_pClientItem->m_clientInputQueue.signal();
             }
 
         } // events in queue
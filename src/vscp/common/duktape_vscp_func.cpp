@@ -678,20 +678,16 @@ try_again:
     // Check the client queue
     if (pClientItem->m_bOpen && pClientItem->m_clientInputQueue.size()) {
 
-        vscpEvent* pEvent;
+        CSharedEvent* pSharedEvent = pClientItem->m_clientInputQueue.pop();
 
-        pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-        pEvent = pClientItem->m_clientInputQueue.front();
-        pClientItem->m_clientInputQueue.pop_front();
-
-        if (NULL == pEvent) {
+        if (NULL == pSharedEvent) {
 
             // Exception
             duk_push_null(ctx); // return code failure
             return JAVASCRIPT_OK;
         }
 
-        pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+        const vscpEvent* pEvent = pSharedEvent->getEvent();
 
         if (NULL != pEvent) {
 
@@ -702,7 +698,7 @@ try_again:
                 std::string strResult;
                 vscp_convertEventToJSON(strResult, pEvent);
                 // Event is not needed anymore
-                vscp_deleteEvent(pEvent);
+                pSharedEvent->release();
                 duk_push_string(ctx, (const char*)strResult.c_str());
                 duk_json_decode(ctx, -1);
 
@@ -712,16 +708,14 @@ try_again:
             } else {
 
                 // Filtered out
-                vscp_deleteEvent(pEvent);
+                pSharedEvent->release();
                 goto try_again;
             }
 
-            // Remove the event
-            vscp_deleteEvent(pEvent);
-
         } // Valid pEvent pointer
         else {
             // NULL event
+            pSharedEvent->release();
             duk_push_null(ctx); // return code failure
             return JAVASCRIPT_OK;
         }
@@ -873,7 +867,7 @@ js_vscp_setFilter(duk_context* ctx)
     duk_pop(ctx);
 
     // Set the filter
-    vscp_copyVSCPFilter(&pClientItem->m_filter, &filter);
+    gpobj->m_clientList.setClientFilter(pClientItem, &filter);
 
     duk_push_boolean(ctx, 1); // return code success
     return JAVASCRIPT_OK;
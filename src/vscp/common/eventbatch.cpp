@@ -0,0 +1,509 @@
+// eventbatch.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <clientlist.h>
+#include <controlobject.h>
+#include <guid.h>
+#include <userlist.h>
+#include <vscp_class.h>
+#include <vscp_debug.h>
+#include <vscphelper.h>
+
+#include "eventbatch.h"
+
+// for convenience
+using json = nlohmann::json;
+
+// Globals
+extern CControlObject* gpobj;
+
+// Status texts
+static const char* const eventbatch_statusText[] = {
+    "Sent",
+    "Invalid event",
+    "Not allowed to send event",
+    "Rate limited",
+    "No room in queue"
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CEventBatch::CEventBatch()
+  : m_nSent(0)
+{
+    time_t now = time(NULL);
+    gmtime_r(&now, &m_now);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CEventBatch::~CEventBatch()
+{
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CEventBatch::clear(void)
+{
+    for (size_t i = 0; i < m_events.size(); i++) {
+        vscp_deleteEvent_v2(&m_events[i]);
+    }
+
+    m_events.clear();
+    m_status.clear();
+    m_nSent = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parse
+//
+// An array is parsed in one go. Newline delimited events are parsed a
+// line at a time so a bad line only makes that event invalid.
+//
+
+bool
+CEventBatch::parse(const char* pData, size_t len)
+{
+    if (NULL == pData) {
+        return false;
+    }
+
+    const char* p    = pData;
+    const char* pEnd = pData + len;
+
+    while ((p < pEnd) && isspace((unsigned char)*p)) {
+        p++;
+    }
+
+    if (p == pEnd) {
+        return false;
+    }
+
+    time_t now = time(NULL);
+    gmtime_r(&now, &m_now);
+
+    // JSON array
+    if ('[' == *p) {
+
+        json j;
+        try {
+            j = json::parse(p, pEnd);
+        } catch (...) {
+            return false;
+        }
+
+        m_events.reserve(m_events.size() + j.size());
+        m_status.reserve(m_status.size() + j.size());
+        for (json::const_iterator it = j.begin(); it != j.end(); ++it) {
+            add(*it);
+        }
+
+        return true;
+    }
+
+    // Newline delimited JSON
+    if ('{' != *p) {
+        return false;
+    }
+
+    while (p < pEnd) {
+
+        const char* pEol = (const char*)memchr(p, '\n', pEnd - p);
+        if (NULL == pEol) {
+            pEol = pEnd;
+        }
+
+        while ((p < pEol) && isspace((unsigned char)*p)) {
+            p++;
+        }
+
+        // Empty lines are skipped
+        if (p < pEol) {
+            try {
+                add(json::parse(p, pEol));
+            } catch (...) {
+                m_events.push_back(NULL);
+                m_status.push_back(EVENTBATCH_INVALID);
+            }
+        }
+
+        p = pEol + 1;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CEventBatch::add(const json& j)
+{
+    vscpEvent* pEvent = convert(j);
+    m_events.push_back(pEvent);
+    m_status.push_back((NULL != pEvent) ? EVENTBATCH_OK : EVENTBATCH_INVALID);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// convert
+//
+// Same keys as vscp_convertJSONToEvent but taken from the parsed object
+// and checked. Class and type must be there, the data must be bytes.
+//
+
+vscpEvent*
+CEventBatch::convert(const json& j)
+{
+    vscpEvent* pEvent = NULL;
+    json::const_iterator it;
+
+    if (!j.is_object()) {
+        return NULL;
+    }
+
+    if (!vscp_newEvent(&pEvent)) {
+        return NULL;
+    }
+
+    memset(pEvent, 0, sizeof(vscpEvent));
+
+    try {
+
+        // Head
+        if (j.end() != (it = j.find("head"))) {
+            pEvent->head = it->get<uint16_t>();
+        }
+
+        // TimeStamp
+        if (j.end() != (it = j.find("timestamp"))) {
+            pEvent->timestamp = it->get<uint32_t>();
+        }
+
+        // DateTime
+        if (j.end() != (it = j.find("datetime"))) {
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            std::string dt = it->get<std::string>();
+            if (!vscp_parseISOCombined(&tm, dt)) {
+                throw std::invalid_argument("datetime");
+            }
+            vscp_setEventDateTime(pEvent, &tm);
+        } else {
+            vscp_setEventDateTime(pEvent, &m_now);
+        }
+
+        // VSCP class
+        if ((j.end() != (it = j.find("class"))) ||
+            (j.end() != (it = j.find("vscpclass")))) {
+            pEvent->vscp_class = it->get<uint16_t>();
+        } else {
+            throw std::invalid_argument("class");
+        }
+
+        // VSCP type
+        if ((j.end() != (it = j.find("type"))) ||
+            (j.end() != (it = j.find("vscptype")))) {
+            pEvent->vscp_type = it->get<uint16_t>();
+        } else {
+            throw std::invalid_argument("type");
+        }
+
+        // GUID
+        if (j.end() != (it = j.find("guid"))) {
+            cguid guid;
+            guid.getFromString(it->get_ref<const std::string&>().c_str());
+            guid.writeGUID(pEvent->GUID);
+        }
+
+        // Data
+        if (j.end() != (it = j.find("data"))) {
+
+            if (!it->is_array() || (it->size() > VSCP_MAX_DATA)) {
+                throw std::invalid_argument("data");
+            }
+
+            if (!vscp_newEventData(pEvent, it->size())) {
+                throw std::bad_alloc();
+            }
+
+            for (size_t i = 0; i < pEvent->sizeData; i++) {
+                const json& byte = (*it)[i];
+                if (!byte.is_number_unsigned() ||
+                    (byte.get<uint32_t>() > 0xff)) {
+                    throw std::invalid_argument("data");
+                }
+                pEvent->pdata[i] = byte.get<uint8_t>();
+            }
+        }
+
+    } catch (...) {
+        vscp_deleteEvent_v2(&pEvent);
+        return NULL;
+    }
+
+    return pEvent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fail
+//
+
+void
+CEventBatch::fail(size_t idx, uint8_t status)
+{
+    vscp_deleteEvent_v2(&m_events[idx]);
+    m_status[idx] = status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check
+//
+// Same checks as for a single websocket event. The user is looked at
+// once for each class/type in the batch.
+//
+
+void
+CEventBatch::check(CUserItem* pUserItem)
+{
+    std::unordered_map<uint32_t, bool> allowed;
+
+    uint32_t rights = (NULL != pUserItem) ? pUserItem->getUserRights() : 0;
+
+    for (size_t i = 0; i < m_events.size(); i++) {
+
+        vscpEvent* pEvent = m_events[i];
+        if (NULL == pEvent) {
+            continue;
+        }
+
+        // Not allowed to send events at all
+        if (!(rights & VSCP_USER_RIGHT_ALLOW_SEND_EVENT)) {
+            fail(i, EVENTBATCH_NOT_ALLOWED);
+            continue;
+        }
+
+        uint32_t key = ((uint32_t)pEvent->vscp_class << 16) + pEvent->vscp_type;
+        std::unordered_map<uint32_t, bool>::iterator it = allowed.find(key);
+        if (allowed.end() == it) {
+
+            bool bAllowed = true;
+
+            if (((VSCP_CLASS1_PROTOCOL == pEvent->vscp_class) ||
+                 (VSCP_CLASS2_LEVEL1_PROTOCOL == pEvent->vscp_class)) &&
+                !(rights & VSCP_USER_RIGHT_ALLOW_SEND_L1CTRL_EVENT)) {
+                bAllowed = false;
+            } else if ((VSCP_CLASS2_PROTOCOL == pEvent->vscp_class) &&
+                       !(rights & VSCP_USER_RIGHT_ALLOW_SEND_L2CTRL_EVENT)) {
+                bAllowed = false;
+            } else if ((VSCP_CLASS2_HLO == pEvent->vscp_class) &&
+                       !(rights & VSCP_USER_RIGHT_ALLOW_SEND_HLO_EVENT)) {
+                bAllowed = false;
+            } else if (!pUserItem->isUserAllowedToSendEvent(
+                         pEvent->vscp_class,
+                         pEvent->vscp_type)) {
+                bAllowed = false;
+            }
+
+            if (!bAllowed) {
+                syslog(LOG_ERR,
+                       "Event batch: User [%s] is not allowed to send "
+                       "event class=%d type=%d.",
+                       pUserItem->getUserName().c_str(),
+                       pEvent->vscp_class,
+                       pEvent->vscp_type);
+            }
+
+            it = allowed.insert(std::make_pair(key, bAllowed)).first;
+        }
+
+        if (!it->second) {
+            fail(i, EVENTBATCH_NOT_ALLOWED);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// send
+//
+// The client output queue is bounded. The events that do not fit in the
+// room that is left are failed at once so the client can send them again
+// later, the request is never held up waiting for room. The rate limit
+// tokens of the failed events are given back.
+//
+
+size_t
+CEventBatch::send(CClientItem* pClientItem)
+{
+    std::vector<size_t> index;
+    std::vector<vscpEvent*> events;
+    std::vector<size_t> failed;
+
+    // Index of the events to send
+    index.reserve(m_events.size());
+    for (size_t i = 0; i < m_events.size(); i++) {
+        if (NULL != m_events[i]) {
+            index.push_back(i);
+        }
+    }
+
+    if (index.empty()) {
+        return m_nSent;
+    }
+
+    if (NULL == pClientItem) {
+        syslog(LOG_ERR, "Event batch - null clientItem");
+        for (size_t i = 0; i < index.size(); i++) {
+            fail(index[i], EVENTBATCH_NO_ROOM);
+        }
+        return m_nSent;
+    }
+
+    // The rate limit is taken for the whole batch at once
+    size_t nAdmitted = admit(pClientItem, index.size());
+    for (size_t i = nAdmitted; i < index.size(); i++) {
+        fail(index[i], EVENTBATCH_RATE_LIMITED);
+    }
+
+    if (0 == nAdmitted) {
+        return m_nSent;
+    }
+
+    events.resize(nAdmitted);
+    for (size_t i = 0; i < nAdmitted; i++) {
+        events[i]           = m_events[index[i]];
+        m_events[index[i]] = NULL; // Taken over by post
+    }
+
+    m_nSent += post(pClientItem, events, failed);
+    for (size_t i = 0; i < failed.size(); i++) {
+        m_status[index[failed[i]]] = EVENTBATCH_NO_ROOM;
+    }
+
+    // Events that were not sent are not counted against the rate
+    if (failed.size()) {
+        pClientItem->m_rateLimit.giveBack(failed.size());
+        if (NULL != pClientItem->m_pUserItem) {
+            pClientItem->m_pUserItem->getRateLimit().giveBack(failed.size());
+        }
+    }
+
+    if (__VSCP_DEBUG_EXTRA) {
+        syslog(LOG_DEBUG,
+               "Event batch - %zu of %zu event(s) sent",
+               m_nSent,
+               m_events.size());
+    }
+
+    return m_nSent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// admit
+//
+
+size_t
+CEventBatch::admit(CClientItem* pClientItem, size_t count)
+{
+    return gpobj->admitEvents(pClientItem, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// post
+//
+
+size_t
+CEventBatch::post(CClientItem* pClientItem,
+                  std::vector<vscpEvent*>& events,
+                  std::vector<size_t>& failed)
+{
+    return gpobj->sendEvents(pClientItem, events, failed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatusText
+//
+
+const char*
+CEventBatch::getStatusText(uint8_t status)
+{
+    if (status >= sizeof(eventbatch_statusText) / sizeof(char*)) {
+        return "Unknown";
+    }
+
+    return eventbatch_statusText[status];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getFailedJSON
+//
+// Keys in the same (sorted) order as json::dump() use.
+//
+
+std::string
+CEventBatch::getFailedJSON(void) const
+{
+    std::string str = "[";
+
+    for (size_t i = 0; i < m_status.size(); i++) {
+
+        if (EVENTBATCH_OK == m_status[i]) {
+            continue;
+        }
+
+        if (str.length() > 1) {
+            str += ",";
+        }
+
+        str += vscp_str_format("{\"code\":%d,\"error\":\"%s\",\"index\":%zu}",
+                               (int)m_status[i],
+                               getStatusText(m_status[i]),
+                               i);
+    }
+
+    str += "]";
+
+    return str;
+}
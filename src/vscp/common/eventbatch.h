@@ -0,0 +1,207 @@
+// eventbatch.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(EVENTBATCH_H__INCLUDED_)
+#define EVENTBATCH_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+#include <vscp.h>
+
+class CClientItem;
+class CUserItem;
+
+// Status of an event in a batch
+enum {
+    EVENTBATCH_OK = 0,       // Sent (or not sent yet)
+    EVENTBATCH_INVALID,      // Not a valid event
+    EVENTBATCH_NOT_ALLOWED,  // User is not allowed to send the event
+    EVENTBATCH_RATE_LIMITED, // Over the rate limit of the client or user
+    EVENTBATCH_NO_ROOM       // No room in the client output queue
+};
+
+/*!
+    A batch of events sent by a client in one request
+
+    The events are given as JSON, either as an array of event objects or
+    as newline delimited JSON with one event object on each line. The
+    event objects are the same as for a single event
+
+    {
+        "head": 0,
+        "timestamp": 0,
+        "datetime": "2020-01-02T03:04:05Z",
+        "class": 10,
+        "type": 6,
+        "guid": "FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:01",
+        "data": [1,2,3]
+    }
+
+    where "vscpclass"/"vscptype" also can be used for class and type so
+    events read from the REST interface can be sent back as they are.
+    An event without a date/time is given the time the batch was parsed.
+
+    The rights of the user are checked once for the batch and the check
+    for each class/type is only done once. All events that are allowed
+    are then put in the client output queue with one call to
+    CControlObject::sendEvents. The status of each event tells if it was
+    sent or why it was not.
+*/
+
+class CEventBatch
+{
+
+  public:
+    /// Constructor
+    CEventBatch();
+
+    /// Destructor
+    virtual ~CEventBatch();
+
+    /// Remove all events
+    void clear(void);
+
+    /*!
+        Add events from a JSON array of events or from newline delimited
+        JSON events. Lines that are not valid JSON events are added as
+        invalid events.
+        @param pData JSON data.
+        @param len Number of bytes.
+        @return true on success, false if the data is not an array of
+            events or newline delimited events.
+    */
+    bool parse(const char* pData, size_t len);
+
+    /*!
+        Add an event.
+        @param j JSON event object. If this is not a valid event it is
+            added as an invalid event.
+    */
+    void add(const nlohmann::json& j);
+
+    /*!
+        Check that a user is allowed to send the events of the batch.
+        Events that the user is not allowed to send are marked as not
+        allowed.
+        @param pUserItem User that send the events.
+    */
+    void check(CUserItem* pUserItem);
+
+    /*!
+        Send the events that are valid and allowed. The events are
+        admitted by the rate limit of the client and its user in one go
+        and the events that are admitted are put in the client output
+        queue in one go. Events that there is no room for in the queue
+        are marked as no room at once so the client can send them again.
+        @param pClientItem Client that send the events.
+        @return Number of events sent.
+    */
+    size_t send(CClientItem* pClientItem);
+
+    /// Number of events in the batch
+    size_t getCount(void) const { return m_status.size(); }
+
+    /// Number of events sent
+    size_t getSent(void) const { return m_nSent; }
+
+    /// Number of events that was not sent
+    size_t getFailed(void) const { return m_status.size() - m_nSent; }
+
+    /*!
+        Get the status of an event
+        @param idx Index of event in the batch.
+        @return Status (EVENTBATCH_OK etc).
+    */
+    uint8_t getStatus(size_t idx) const { return m_status[idx]; }
+
+    /*!
+        Get a status as text
+        @param status Status (EVENTBATCH_OK etc).
+        @return Text that describes the status.
+    */
+    static const char* getStatusText(uint8_t status);
+
+    /*!
+        Get the events that was not sent as a JSON array of objects
+        with the index, status code and status text of each event,
+        [{"code":3,"error":"Rate limited","index":12},...]
+        @return JSON array.
+    */
+    std::string getFailedJSON(void) const;
+
+  protected:
+    /*!
+        Take rate limit tokens for events. CControlObject::admitEvents
+        is used.
+        @param pClientItem Client that send the events.
+        @param count Number of events.
+        @return Number of events admitted.
+    */
+    virtual size_t admit(CClientItem* pClientItem, size_t count);
+
+    /*!
+        Put events in the client output queue. CControlObject::sendEvents
+        is used.
+        @param pClientItem Client that send the events.
+        @param events Events to send. They are taken over.
+        @param failed Index in events of the events that was not sent.
+        @return Number of events sent.
+    */
+    virtual size_t post(CClientItem* pClientItem,
+                        std::vector<vscpEvent*>& events,
+                        std::vector<size_t>& failed);
+
+  private:
+    /// Make an event from a JSON event object, NULL if not valid
+    vscpEvent* convert(const nlohmann::json& j);
+
+    /// Mark an event as failed and delete it
+    void fail(size_t idx, uint8_t status);
+
+  private:
+    /// Events, NULL for an event that was not valid or has been failed
+    std::vector<vscpEvent*> m_events;
+
+    /// Status of each event
+    std::vector<uint8_t> m_status;
+
+    /// Number of events sent
+    size_t m_nSent;
+
+    /// Date/time for events that does not have one
+    struct tm m_now;
+};
+
+#endif // EVENTBATCH_H__INCLUDED_
@@ -0,0 +1,154 @@
+// eventlatency.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "eventlatency.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CEventLatency::CEventLatency()
+{
+    for (int i = 0; i < EVENTLATENCY_PRIORITIES; i++) {
+        for (int j = 0; j < EVENTLATENCY_BUCKETS; j++) {
+            m_buckets[i][j].store(0);
+        }
+        m_max[i].store(0);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getLatency
+//
+
+CEventLatency&
+CEventLatency::getLatency(void)
+{
+    // Never deleted so it can be used until the process ends
+    static CEventLatency* pLatency = new CEventLatency;
+    return *pLatency;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// record
+//
+
+void
+CEventLatency::record(uint8_t priority, uint64_t usec)
+{
+    priority &= (EVENTLATENCY_PRIORITIES - 1);
+
+    int bucket = usec ? (64 - __builtin_clzll(usec)) : 0;
+    if (bucket >= EVENTLATENCY_BUCKETS) {
+        bucket = EVENTLATENCY_BUCKETS - 1;
+    }
+
+    m_buckets[priority][bucket].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = m_max[priority].load(std::memory_order_relaxed);
+    while ((usec > max) &&
+           !m_max[priority].compare_exchange_weak(max,
+                                                  usec,
+                                                  std::memory_order_relaxed)) {
+        ;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getCount
+//
+
+uint64_t
+CEventLatency::getCount(uint8_t priority) const
+{
+    uint64_t cnt = 0;
+
+    priority &= (EVENTLATENCY_PRIORITIES - 1);
+    for (int i = 0; i < EVENTLATENCY_BUCKETS; i++) {
+        cnt += m_buckets[priority][i].load(std::memory_order_relaxed);
+    }
+
+    return cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getBucket
+//
+
+uint64_t
+CEventLatency::getBucket(uint8_t priority, int bucket) const
+{
+    if ((bucket < 0) || (bucket >= EVENTLATENCY_BUCKETS)) {
+        return 0;
+    }
+
+    priority &= (EVENTLATENCY_PRIORITIES - 1);
+    return m_buckets[priority][bucket].load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getPercentile
+//
+
+uint64_t
+CEventLatency::getPercentile(uint8_t priority, double percent) const
+{
+    uint64_t total = getCount(priority);
+    if (0 == total) {
+        return 0;
+    }
+
+    // Number of events that must be at or below the percentile
+    uint64_t limit = (uint64_t)((total * percent) / 100.0 + 0.5);
+    if (0 == limit) {
+        limit = 1;
+    }
+
+    priority &= (EVENTLATENCY_PRIORITIES - 1);
+
+    uint64_t cnt = 0;
+    for (int i = 0; i < EVENTLATENCY_BUCKETS; i++) {
+        cnt += m_buckets[priority][i].load(std::memory_order_relaxed);
+        if (cnt >= limit) {
+            return ((uint64_t)1 << i);
+        }
+    }
+
+    return getMax(priority);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getMax
+//
+
+uint64_t
+CEventLatency::getMax(uint8_t priority) const
+{
+    priority &= (EVENTLATENCY_PRIORITIES - 1);
+    return m_max[priority].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,128 @@
+// eventlatency.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(EVENTLATENCY_H__INCLUDED_)
+#define EVENTLATENCY_H__INCLUDED_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+
+// Number of event priorities
+#define EVENTLATENCY_PRIORITIES 8
+
+// Histogram bucket n counts latencies below 2^n microseconds (and at
+// least 2^(n-1)). The last bucket also counts everything above it.
+#define EVENTLATENCY_BUCKETS 32
+
+/*!
+    Delivery latency histograms
+
+    Counts the time from when an event is taken in for delivery by the
+    daemon until a client (tcp/ip, driver, websocket, REST...) takes it
+    out of its input queue, with one log2 histogram for each of the
+    priorities in the event head. Percentiles are given as the upper
+    bound of the bucket they fall in.
+
+    The object returned by getLatency() lives as long as the process.
+    All methods are thread safe.
+*/
+
+class CEventLatency
+{
+
+  public:
+    /// Constructor
+    CEventLatency();
+
+    /*!
+        Get the latency histograms
+        @return Reference to the histograms
+    */
+    static CEventLatency& getLatency(void);
+
+    /*!
+        Get a monotonic timestamp
+        @return Time in microseconds
+    */
+    static uint64_t now(void)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+    };
+
+    /*!
+        Count the latency for one delivered event
+        @param priority Priority of the event (0-7)
+        @param usec Latency in microseconds
+    */
+    void record(uint8_t priority, uint64_t usec);
+
+    /*!
+        Get the number of delivered events
+        @param priority Priority of the events (0-7)
+        @return Number of events
+    */
+    uint64_t getCount(uint8_t priority) const;
+
+    /*!
+        Get the number of events in one bucket of a histogram
+        @param priority Priority of the events (0-7)
+        @param bucket Bucket (0 - EVENTLATENCY_BUCKETS-1)
+        @return Number of events
+    */
+    uint64_t getBucket(uint8_t priority, int bucket) const;
+
+    /*!
+        Get a percentile of the latency
+        @param priority Priority of the events (0-7)
+        @param percent Percentile to get (0-100)
+        @return Latency in microseconds the given percent of the events
+            were delivered within. Zero if no events have been delivered.
+    */
+    uint64_t getPercentile(uint8_t priority, double percent) const;
+
+    /*!
+        Get the highest latency seen
+        @param priority Priority of the events (0-7)
+        @return Latency in microseconds
+    */
+    uint64_t getMax(uint8_t priority) const;
+
+  private:
+    // Histograms
+    std::atomic<uint64_t> m_buckets[EVENTLATENCY_PRIORITIES]
+                                   [EVENTLATENCY_BUCKETS];
+
+    // Highest latency for each priority
+    std::atomic<uint64_t> m_max[EVENTLATENCY_PRIORITIES];
+};
+
+#endif
@@ -0,0 +1,453 @@
+// eventpool.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <stdlib.h>
+#include <string.h>
+
+#include <vscphelper.h>
+
+#include "eventpool.h"
+
+// Block sizes for the classes. The event class has room for inline
+// data and is rounded up to keep blocks 16 byte aligned.
+static const size_t eventpool_block_size[EVENTPOOL_CLASS_COUNT] = {
+    (sizeof(vscpEvent) + EVENTPOOL_INLINE_DATA + 15) & ~(size_t)15,
+    VSCP_LEVEL1_MAXDATA,
+    16,
+    64,
+    VSCP_LEVEL2_MAXDATA
+};
+
+// Free blocks owned by one thread. Plain data so the thread local
+// instance needs no construction. Blocks and hits are handed over to
+// the pool when the thread ends.
+typedef struct
+{
+    // Free blocks for each class
+    void* blocks[EVENTPOOL_CLASS_COUNT][EVENTPOOL_THREAD_CACHE_SIZE];
+
+    // Number of free blocks for each class
+    int cnt[EVENTPOOL_CLASS_COUNT];
+
+    // Hits not yet added to the pool statistics
+    uint32_t cntHits[EVENTPOOL_CLASS_COUNT];
+
+    // Inline data allocations not yet added to the pool statistics
+    uint32_t cntInline;
+
+    // Set when the thread exit handler is registered
+    bool bRegistered;
+} eventPoolThreadCache;
+
+static thread_local eventPoolThreadCache eventpool_thread_cache;
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocator functions for vscphelper
+//
+
+static vscpEvent*
+eventpool_allocEvent(void)
+{
+    return CEventPool::getPool().allocEvent();
+}
+
+static bool
+eventpool_freeEvent(vscpEvent* pEvent)
+{
+    return CEventPool::getPool().freeEvent(pEvent);
+}
+
+static uint8_t*
+eventpool_allocData(vscpEvent* pEvent, uint16_t sizeData)
+{
+    return CEventPool::getPool().allocData(pEvent, sizeData);
+}
+
+static bool
+eventpool_freeData(vscpEvent* pEvent, uint8_t* pdata)
+{
+    return CEventPool::getPool().freeData(pEvent, pdata);
+}
+
+static const vscpEventAllocator eventpool_allocator = { eventpool_allocEvent,
+                                                        eventpool_freeEvent,
+                                                        eventpool_allocData,
+                                                        eventpool_freeData };
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CEventPool::CEventPool()
+{
+    for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+        m_slab[cls].pArena    = NULL;
+        m_slab[cls].pEnd      = NULL;
+        m_slab[cls].blockSize = eventpool_block_size[cls];
+        m_slab[cls].nBlocks   = 0;
+        m_slab[cls].pFreeList = NULL;
+        m_slab[cls].cntHits   = 0;
+        m_slab[cls].cntMisses = 0;
+        m_slab[cls].cntInline = 0;
+        pthread_mutex_init(&m_slab[cls].mutexFreeList, NULL);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CEventPool::~CEventPool()
+{
+    if (isActive()) {
+        pthread_key_delete(m_threadKey);
+    }
+
+    for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+        free(m_slab[cls].pArena);
+        pthread_mutex_destroy(&m_slab[cls].mutexFreeList);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getPool
+//
+
+CEventPool&
+CEventPool::getPool(void)
+{
+    // Never deleted so threads that end after main can still
+    // give back their blocks
+    static CEventPool* pPool = new CEventPool;
+    return *pPool;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// install
+//
+
+void
+CEventPool::install(void)
+{
+    vscp_setEventAllocator(&eventpool_allocator);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+bool
+CEventPool::init(uint32_t nBlocks)
+{
+    // Already initialized
+    if (isActive() || (0 == nBlocks)) {
+        return false;
+    }
+
+    // Get a call when a thread that has a cache ends
+    if (0 != pthread_key_create(&m_threadKey, releaseThreadCache)) {
+        return false;
+    }
+
+    for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+
+        slab& s = m_slab[cls];
+
+        s.pArena = (uint8_t*)malloc(s.blockSize * nBlocks);
+        if (NULL == s.pArena) {
+            pthread_key_delete(m_threadKey);
+            for (int i = 0; i < cls; i++) {
+                free(m_slab[i].pArena);
+                m_slab[i].pArena    = NULL;
+                m_slab[i].pEnd      = NULL;
+                m_slab[i].nBlocks   = 0;
+                m_slab[i].pFreeList = NULL;
+            }
+            return false;
+        }
+
+        s.pEnd    = s.pArena + s.blockSize * nBlocks;
+        s.nBlocks = nBlocks;
+
+        // Link all blocks into the free list
+        s.pFreeList = NULL;
+        for (uint32_t i = nBlocks; i > 0; i--) {
+            void* p     = s.pArena + s.blockSize * (i - 1);
+            *(void**)p  = s.pFreeList;
+            s.pFreeList = p;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getDataClass
+//
+
+int
+CEventPool::getDataClass(uint16_t sizeData)
+{
+    for (int cls = EVENTPOOL_CLASS_DATA8; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+        if (sizeData <= eventpool_block_size[cls]) {
+            return cls;
+        }
+    }
+
+    return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// takeBlocks
+//
+
+int
+CEventPool::takeBlocks(int cls, void** buf, int cnt)
+{
+    int n   = 0;
+    slab& s = m_slab[cls];
+
+    pthread_mutex_lock(&s.mutexFreeList);
+    while ((n < cnt) && (NULL != s.pFreeList)) {
+        buf[n++]    = s.pFreeList;
+        s.pFreeList = *(void**)s.pFreeList;
+    }
+    pthread_mutex_unlock(&s.mutexFreeList);
+
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// giveBlocks
+//
+
+void
+CEventPool::giveBlocks(int cls, void** buf, int cnt)
+{
+    slab& s = m_slab[cls];
+
+    pthread_mutex_lock(&s.mutexFreeList);
+    for (int i = 0; i < cnt; i++) {
+        *(void**)buf[i] = s.pFreeList;
+        s.pFreeList     = buf[i];
+    }
+    pthread_mutex_unlock(&s.mutexFreeList);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// releaseThreadCache
+//
+
+void
+CEventPool::releaseThreadCache(void* p)
+{
+    eventPoolThreadCache* pCache = (eventPoolThreadCache*)p;
+    CEventPool& pool             = getPool();
+
+    for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+        pool.giveBlocks(cls, pCache->blocks[cls], pCache->cnt[cls]);
+        pool.m_slab[cls].cntHits.fetch_add(pCache->cntHits[cls]);
+        pCache->cnt[cls]     = 0;
+        pCache->cntHits[cls] = 0;
+    }
+
+    pool.m_slab[EVENTPOOL_CLASS_EVENT].cntInline.fetch_add(pCache->cntInline);
+    pCache->cntInline = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// allocBlock
+//
+
+void*
+CEventPool::allocBlock(int cls)
+{
+    slab& s = m_slab[cls];
+
+    if (NULL == s.pArena) {
+        return NULL;
+    }
+
+    eventPoolThreadCache& cache = eventpool_thread_cache;
+
+    if (0 == cache.cnt[cls]) {
+
+        // Make sure the blocks are given back when the thread ends
+        if (!cache.bRegistered) {
+            pthread_setspecific(m_threadKey, &cache);
+            cache.bRegistered = true;
+        }
+
+        // Refill the cache with half of its size
+        cache.cnt[cls] =
+          takeBlocks(cls, cache.blocks[cls], EVENTPOOL_THREAD_CACHE_SIZE / 2);
+
+        s.cntHits.fetch_add(cache.cntHits[cls], std::memory_order_relaxed);
+        cache.cntHits[cls] = 0;
+        m_slab[EVENTPOOL_CLASS_EVENT].cntInline.fetch_add(
+          cache.cntInline,
+          std::memory_order_relaxed);
+        cache.cntInline = 0;
+
+        if (0 == cache.cnt[cls]) {
+            s.cntMisses.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+    }
+
+    cache.cntHits[cls]++;
+    return cache.blocks[cls][--cache.cnt[cls]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// freeBlock
+//
+
+bool
+CEventPool::freeBlock(int cls, void* p)
+{
+    slab& s = m_slab[cls];
+
+    // Must be a block from this slab. Never true for a pool that is
+    // not allocated.
+    if (((uint8_t*)p < s.pArena) || ((uint8_t*)p >= s.pEnd)) {
+        return false;
+    }
+
+    eventPoolThreadCache& cache = eventpool_thread_cache;
+
+    // Make sure the blocks are given back when the thread ends
+    if (!cache.bRegistered) {
+        pthread_setspecific(m_threadKey, &cache);
+        cache.bRegistered = true;
+    }
+
+    // Hand half of a full cache back to the pool
+    if (EVENTPOOL_THREAD_CACHE_SIZE == cache.cnt[cls]) {
+        giveBlocks(cls,
+                   cache.blocks[cls] + EVENTPOOL_THREAD_CACHE_SIZE / 2,
+                   EVENTPOOL_THREAD_CACHE_SIZE / 2);
+        cache.cnt[cls] = EVENTPOOL_THREAD_CACHE_SIZE / 2;
+    }
+
+    cache.blocks[cls][cache.cnt[cls]++] = p;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// allocEvent
+//
+
+vscpEvent*
+CEventPool::allocEvent(void)
+{
+    return (vscpEvent*)allocBlock(EVENTPOOL_CLASS_EVENT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// freeEvent
+//
+
+bool
+CEventPool::freeEvent(vscpEvent* pEvent)
+{
+    return freeBlock(EVENTPOOL_CLASS_EVENT, pEvent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// allocData
+//
+
+uint8_t*
+CEventPool::allocData(vscpEvent* pEvent, uint16_t sizeData)
+{
+    // Store small payloads in the event block
+    if ((sizeData <= EVENTPOOL_INLINE_DATA) && isPoolEvent(pEvent)) {
+        eventpool_thread_cache.cntInline++;
+        return getInlineData(pEvent);
+    }
+
+    int cls = getDataClass(sizeData);
+
+    // Too large for the pool
+    if (cls < 0) {
+        if (isActive()) {
+            m_slab[EVENTPOOL_CLASS_DATA512].cntMisses.fetch_add(
+              1,
+              std::memory_order_relaxed);
+        }
+        return NULL;
+    }
+
+    return (uint8_t*)allocBlock(cls);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// freeData
+//
+
+bool
+CEventPool::freeData(vscpEvent* pEvent, uint8_t* pdata)
+{
+    // Inline data goes with the event block
+    if ((getInlineData(pEvent) == pdata) && isPoolEvent(pEvent)) {
+        return true;
+    }
+
+    for (int cls = EVENTPOOL_CLASS_DATA8; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+        if (freeBlock(cls, pdata)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getStatistics
+//
+
+bool
+CEventPool::getStatistics(int cls, eventPoolStatistics* pStatistics)
+{
+    // Check pointer
+    if (NULL == pStatistics) {
+        return false;
+    }
+
+    if ((cls < 0) || (cls >= EVENTPOOL_CLASS_COUNT)) {
+        return false;
+    }
+
+    pStatistics->blockSize = m_slab[cls].blockSize;
+    pStatistics->nBlocks   = m_slab[cls].nBlocks;
+    pStatistics->cntHits   = m_slab[cls].cntHits.load();
+    pStatistics->cntMisses = m_slab[cls].cntMisses.load();
+    pStatistics->cntInline = m_slab[cls].cntInline.load();
+
+    return true;
+}
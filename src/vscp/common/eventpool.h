@@ -0,0 +1,246 @@
+// eventpool.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#if !defined(EVENTPOOL_H__INCLUDED_)
+#define EVENTPOOL_H__INCLUDED_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <vscp.h>
+
+// Block classes of the pool
+#define EVENTPOOL_CLASS_EVENT   0 // vscpEvent structures
+#define EVENTPOOL_CLASS_DATA8   1 // Data up to VSCP_LEVEL1_MAXDATA bytes
+#define EVENTPOOL_CLASS_DATA16  2 // Data up to 16 bytes
+#define EVENTPOOL_CLASS_DATA64  3 // Data up to 64 bytes
+#define EVENTPOOL_CLASS_DATA512 4 // Data up to VSCP_LEVEL2_MAXDATA bytes
+#define EVENTPOOL_CLASS_COUNT   5
+
+// Data bytes stored inside the event block. Room for a Level I event
+// and for a Level I event sent over Level II (GUID + data).
+#define EVENTPOOL_INLINE_DATA (16 + VSCP_LEVEL1_MAXDATA)
+
+// Max number of free blocks of each class a thread keeps for itself.
+// Half of them are handed back to the pool when the cache is full.
+#define EVENTPOOL_THREAD_CACHE_SIZE 64
+
+/*!
+    Statistics for one block class of the event pool
+*/
+typedef struct
+{
+    uint32_t blockSize; // Size of a block in bytes
+    uint32_t nBlocks;   // Number of blocks in the pool
+    uint64_t cntHits;   // Allocations served by the pool
+    uint64_t cntMisses; // Allocations that had to use the heap
+    uint64_t cntInline; // Data stored in the event block (event class)
+} eventPoolStatistics;
+
+/*!
+    Slab allocator for events and event data
+
+    Each block class has one contiguous slab that is split into fixed
+    size blocks. Free blocks are kept in a list for the class. Each
+    thread keeps a small cache of free blocks for each class so that
+    the list lock is only taken when the cache runs empty or full.
+    Hits are counted in the thread cache and added to the statistics
+    when the cache goes to the list, so they lag a little behind.
+
+    A block belongs to the pool if its address is inside the slab for
+    its class. Memory that does not belong to the pool is refused by
+    the free methods and must be returned to the heap by the caller.
+    Allocations the pool can't serve (empty pool, data larger than
+    VSCP_LEVEL2_MAXDATA) return NULL and are counted as misses.
+
+    Event blocks have room for EVENTPOOL_INLINE_DATA data bytes after
+    the vscpEvent structure. Data for an event from the pool that fits
+    is stored there and pdata points into the event block, so most
+    Level I events need a single block. The vscpEvent layout seen by
+    drivers and other users of pdata is unchanged.
+
+    The pool returned by getPool() lives as long as the process. It
+    is set up with init() and then made the allocator for
+    vscp_newEvent/vscp_deleteEvent with install().
+*/
+
+class CEventPool
+{
+
+  public:
+    /// Constructor
+    CEventPool();
+
+    /// Destructor
+    ~CEventPool();
+
+    /*!
+        Allocate the slabs. Can only be called once.
+        @param nBlocks Number of blocks in each class.
+        @return true on success
+    */
+    bool init(uint32_t nBlocks);
+
+    /*!
+        Check if the pool is allocated
+        @return true if the pool is in use.
+    */
+    bool isActive(void) const { return (NULL != m_slab[0].pArena); };
+
+    /*!
+        Allocate an event structure
+        @return Pointer to event or NULL if the pool is empty.
+    */
+    vscpEvent* allocEvent(void);
+
+    /*!
+        Return an event structure to the pool
+        @param pEvent Event to free
+        @return true if the event belonged to the pool.
+    */
+    bool freeEvent(vscpEvent* pEvent);
+
+    /*!
+        Allocate event data
+        @param pEvent Event the data is for
+        @param sizeData Number of bytes needed
+        @return Pointer to data or NULL if no block is available.
+    */
+    uint8_t* allocData(vscpEvent* pEvent, uint16_t sizeData);
+
+    /*!
+        Return event data to the pool
+        @param pEvent Event the data belongs to
+        @param pdata Data to free
+        @return true if the data belonged to the pool.
+    */
+    bool freeData(vscpEvent* pEvent, uint8_t* pdata);
+
+    /*!
+        Get statistics for a block class
+        @param cls Block class (EVENTPOOL_CLASS_xxx)
+        @param pStatistics Pointer to structure that will get the
+            statistics.
+        @return true on success
+    */
+    bool getStatistics(int cls, eventPoolStatistics* pStatistics);
+
+    /*!
+        Get the block class to use for event data
+        @param sizeData Number of bytes needed
+        @return Block class or -1 if the data is too large for the pool.
+    */
+    static int getDataClass(uint16_t sizeData);
+
+    /*!
+        Get the one pool of the process
+        @return Reference to the pool
+    */
+    static CEventPool& getPool(void);
+
+    /*!
+        Make the process pool the allocator used by vscp_newEvent,
+        vscp_newEventData, vscp_deleteEvent and vscp_deleteEvent_v2.
+        Must be called before any events are created.
+    */
+    static void install(void);
+
+  private:
+    // Check if an event is a block from the event slab
+    bool isPoolEvent(const vscpEvent* pEvent) const
+    {
+        const uint8_t* p = (const uint8_t*)pEvent;
+        return ((p >= m_slab[EVENTPOOL_CLASS_EVENT].pArena) &&
+                (p < m_slab[EVENTPOOL_CLASS_EVENT].pEnd));
+    };
+
+    // Get the inline data area of an event block
+    static uint8_t* getInlineData(vscpEvent* pEvent)
+    {
+        return (uint8_t*)pEvent + sizeof(vscpEvent);
+    };
+
+    // Take a block of a class from the thread cache/free list
+    void* allocBlock(int cls);
+
+    // Return a block to the thread cache/free list
+    bool freeBlock(int cls, void* p);
+
+    // Move up to cnt blocks from the free list of a class to buf
+    int takeBlocks(int cls, void** buf, int cnt);
+
+    // Put cnt blocks from buf on the free list of a class
+    void giveBlocks(int cls, void** buf, int cnt);
+
+    // Give the blocks in the cache of a thread that ends back to the pool
+    static void releaseThreadCache(void* p);
+
+    // Not copyable
+    CEventPool(const CEventPool&);
+    CEventPool& operator=(const CEventPool&);
+
+  private:
+    struct slab
+    {
+        // Memory for all blocks of the class
+        uint8_t* pArena;
+
+        // End of the arena
+        uint8_t* pEnd;
+
+        // Size of a block
+        size_t blockSize;
+
+        // Number of blocks
+        uint32_t nBlocks;
+
+        // First free block. Each free block holds a pointer to the
+        // next one.
+        void* pFreeList;
+
+        // Protects the free list
+        pthread_mutex_t mutexFreeList;
+
+        // Statistics
+        std::atomic<uint64_t> cntHits;
+        std::atomic<uint64_t> cntMisses;
+        std::atomic<uint64_t> cntInline;
+
+        // Keep slabs on separate cache lines
+        char pad[64];
+    };
+
+    slab m_slab[EVENTPOOL_CLASS_COUNT];
+
+    // Key that gets the cache of threads that have used the pool
+    pthread_key_t m_threadKey;
+};
+
+#endif
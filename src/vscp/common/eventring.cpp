@@ -0,0 +1,246 @@
+// eventring.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdlib.h>
+
+#include <vscphelper.h>
+
+#include "eventring.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CEventRing::CEventRing()
+  : m_slots(NULL)
+  , m_mask(0)
+  , m_tail(0)
+  , m_head(0)
+  , m_cntOverruns(0)
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CEventRing::~CEventRing()
+{
+    vscpEvent* pEvent;
+
+    if (NULL == m_slots) {
+        return;
+    }
+
+    // Delete events that never was taken out of the ring
+    while (NULL != (pEvent = pop())) {
+        vscp_deleteEvent_v2(&pEvent);
+    }
+
+    delete[] m_slots;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+bool
+CEventRing::init(uint32_t capacity)
+{
+    // Already initialized
+    if (NULL != m_slots) {
+        return false;
+    }
+
+    // Round up to power of two (and at least two slots)
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    m_slots = new slot[size];
+    if (NULL == m_slots) {
+        return false;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        m_slots[i].seq.store(i, std::memory_order_relaxed);
+        m_slots[i].pEvent = NULL;
+    }
+
+    m_mask = size - 1;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+
+bool
+CEventRing::push(vscpEvent* pEvent)
+{
+    slot* pSlot;
+    size_t pos;
+
+    if ((NULL == m_slots) || (NULL == pEvent)) {
+        return false;
+    }
+
+    pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+        pSlot         = &m_slots[pos & m_mask];
+        size_t seq    = pSlot->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (0 == diff) {
+            // Slot is free - try to claim it
+            if (m_tail.compare_exchange_weak(pos,
+                                             pos + 1,
+                                             std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // The ring is full
+            m_cntOverruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            // Another producer claimed the slot
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Publish the event to the consumer
+    pSlot->pEvent = pEvent;
+    pSlot->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+// The consumer frees the slots in order so all slots between the tail
+// and the head one lap ahead are free.
+//
+
+size_t
+CEventRing::push(vscpEvent** ppEvents, size_t count)
+{
+    size_t pos;
+    size_t n;
+
+    if ((NULL == m_slots) || (NULL == ppEvents) || (0 == count)) {
+        return 0;
+    }
+
+    pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t free = (head + m_mask + 1) - pos;
+
+        // Tail has moved past what we read - try again
+        if (free > (m_mask + 1)) {
+            pos = m_tail.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        n = (count < free) ? count : free;
+        if (0 == n) {
+            break;
+        }
+
+        if (m_tail.compare_exchange_weak(pos,
+                                         pos + n,
+                                         std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    // Publish the events to the consumer
+    for (size_t i = 0; i < n; i++) {
+        slot* pSlot   = &m_slots[(pos + i) & m_mask];
+        pSlot->pEvent = ppEvents[i];
+        pSlot->seq.store(pos + i + 1, std::memory_order_release);
+    }
+
+    if (n < count) {
+        m_cntOverruns.fetch_add(count - n, std::memory_order_relaxed);
+    }
+
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pop
+//
+
+vscpEvent*
+CEventRing::pop(void)
+{
+    vscpEvent* pEvent;
+
+    if (NULL == m_slots) {
+        return NULL;
+    }
+
+    size_t pos  = m_head.load(std::memory_order_relaxed);
+    slot* pSlot = &m_slots[pos & m_mask];
+    size_t seq  = pSlot->seq.load(std::memory_order_acquire);
+
+    // Nothing published in this slot yet
+    if (seq != (pos + 1)) {
+        return NULL;
+    }
+
+    pEvent        = pSlot->pEvent;
+    pSlot->pEvent = NULL;
+
+    // Free the slot for the next lap around the ring. The head is
+    // released so a batch push that reads it sees the slot as free.
+    pSlot->seq.store(pos + m_mask + 1, std::memory_order_release);
+    m_head.store(pos + 1, std::memory_order_release);
+
+    return pEvent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// size
+//
+
+size_t
+CEventRing::size(void) const
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t head = m_head.load(std::memory_order_relaxed);
+
+    return (tail > head) ? (tail - head) : 0;
+}
@@ -0,0 +1,165 @@
+// eventring.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(EVENTRING_H__INCLUDED_)
+#define EVENTRING_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <vscp.h>
+
+/*!
+    Bounded lock free event ring
+
+    A fixed size ring of event pointers that any number of threads can
+    put events into and one thread take events out of. No locks are
+    used. Each slot has a sequence number that tells if the slot is
+    free for the producer that has claimed it or holds an event ready
+    for the consumer.
+
+    The ring does not block. A push to a full ring fails and the
+    caller keeps the event. Failed pushes are counted as overruns.
+
+    An event that is pushed by a producer that has claimed its slot
+    but not yet published it hides the events after it from the
+    consumer. Each producer must therefore signal the consumer after
+    a successful push and the consumer should pop until the ring is
+    empty every time it is signaled.
+*/
+
+class CEventRing
+{
+
+  public:
+    /// Constructor
+    CEventRing();
+
+    /// Destructor
+    ~CEventRing();
+
+    /*!
+        Allocate the ring. Must be called before the ring is used and
+        can only be called once.
+        @param capacity Max number of events in the ring. Is rounded
+            up to the nearest power of two.
+        @return true on success
+    */
+    bool init(uint32_t capacity);
+
+    /*!
+        Put an event in the ring. Can be called by any thread.
+        @param pEvent Event to put in the ring. The ring owns the
+            event on success.
+        @return true on success, false if the ring is full in which
+            case the caller still owns the event.
+    */
+    bool push(vscpEvent* pEvent);
+
+    /*!
+        Put a number of events in the ring. The slots for all of them
+        are claimed at once so the events are kept together in the
+        ring. Can be called by any thread.
+        @param ppEvents Events to put in the ring. The ring owns the
+            events that are put in it.
+        @param count Number of events.
+        @return Number of events put in the ring. These are the first
+            ones in ppEvents, the caller still owns the rest. Less than
+            count if the ring is full.
+    */
+    size_t push(vscpEvent** ppEvents, size_t count);
+
+    /*!
+        Take the oldest event out of the ring. Must only be called by
+        one thread.
+        @return Pointer to event or NULL if no event is available.
+    */
+    vscpEvent* pop(void);
+
+    /*!
+        Get the number of events in the ring. Only an estimate when
+        other threads use the ring.
+        @return Number of events.
+    */
+    size_t size(void) const;
+
+    /*!
+        Get the max number of events the ring can hold
+        @return Capacity
+    */
+    size_t getCapacity(void) const { return m_mask + 1; };
+
+    /*!
+        Get the number of events that has been rejected because the
+        ring was full.
+        @return Number of overruns
+    */
+    uint32_t getOverruns(void) const { return m_cntOverruns.load(); };
+
+  private:
+    // Not copyable
+    CEventRing(const CEventRing&);
+    CEventRing& operator=(const CEventRing&);
+
+  private:
+    struct slot
+    {
+        // Sequence number for the slot
+        std::atomic<size_t> seq;
+
+        // Event in the slot
+        vscpEvent* pEvent;
+    };
+
+    // The slots
+    slot* m_slots;
+
+    // Capacity - 1
+    size_t m_mask;
+
+    // Padding so the producers and the consumer don't share cache
+    // lines with each other
+    char m_pad0[64];
+
+    // Position for next push. Written by all producers.
+    std::atomic<size_t> m_tail;
+
+    char m_pad1[64 - sizeof(size_t)];
+
+    // Position for next pop. Only written by the consumer.
+    std::atomic<size_t> m_head;
+
+    char m_pad2[64 - sizeof(size_t)];
+
+    // Number of failed push operations
+    std::atomic<uint32_t> m_cntOverruns;
+};
+
+#endif
@@ -0,0 +1,183 @@
+// linescanner.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <ctype.h>
+#include <string.h>
+
+#include "linescanner.h"
+
+// Initial size of the buffer
+#define LINESCANNER_INITIAL_SIZE 1024
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CLineScanner::CLineScanner()
+  : m_posRead(0)
+  , m_posScan(0)
+  , m_posEnd(0)
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CLineScanner::~CLineScanner()
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getWriteBuffer
+//
+
+char*
+CLineScanner::getWriteBuffer(size_t len)
+{
+    if ((m_buf.size() - m_posEnd) < len) {
+
+        // Move the unconsumed data to the start if that makes room and
+        // less is moved than has been consumed since last time.
+        size_t nLeft = m_posEnd - m_posRead;
+        if (m_posRead && (nLeft <= m_posRead) &&
+            ((m_buf.size() - nLeft) >= len)) {
+            memmove(&m_buf[0], &m_buf[m_posRead], nLeft);
+            m_posScan -= m_posRead;
+            m_posEnd = nLeft;
+            m_posRead = 0;
+        } else {
+            size_t newSize = m_buf.size() ? (2 * m_buf.size())
+                                          : LINESCANNER_INITIAL_SIZE;
+            while ((newSize - m_posEnd) < len) {
+                newSize *= 2;
+            }
+            m_buf.resize(newSize);
+        }
+    }
+
+    return &m_buf[m_posEnd];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// commitWrite
+//
+
+void
+CLineScanner::commitWrite(size_t len)
+{
+    m_posEnd += len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// append
+//
+
+void
+CLineScanner::append(const char* pData, size_t len)
+{
+    if (0 == len) {
+        return;
+    }
+
+    memcpy(getWriteBuffer(len), pData, len);
+    commitWrite(len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getLine
+//
+
+bool
+CLineScanner::getLine(const char** ppLine, size_t* pLen)
+{
+    if (m_posScan >= m_posEnd) {
+        return false;
+    }
+
+    const char* pStart = m_buf.data();
+    const char* pEnd =
+      (const char*)memchr(pStart + m_posScan, '\n', m_posEnd - m_posScan);
+    if (NULL == pEnd) {
+        m_posScan = m_posEnd;
+        return false;
+    }
+
+    *ppLine = pStart + m_posRead;
+    *pLen   = pEnd - *ppLine;
+    trim(ppLine, pLen);
+
+    m_posRead = m_posScan = (pEnd - pStart) + 1;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// consume
+//
+
+void
+CLineScanner::consume(size_t len)
+{
+    if (len > size()) {
+        len = size();
+    }
+
+    m_posRead += len;
+    if (m_posScan < m_posRead) {
+        m_posScan = m_posRead;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CLineScanner::clear(void)
+{
+    m_posRead = m_posScan = m_posEnd = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// trim
+//
+
+void
+CLineScanner::trim(const char** ppStr, size_t* pLen)
+{
+    while (*pLen && isspace((unsigned char)**ppStr)) {
+        (*ppStr)++;
+        (*pLen)--;
+    }
+
+    while (*pLen && isspace((unsigned char)(*ppStr)[*pLen - 1])) {
+        (*pLen)--;
+    }
+}
@@ -0,0 +1,140 @@
+// linescanner.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#if !defined(LINESCANNER_H__INCLUDED_)
+#define LINESCANNER_H__INCLUDED_
+
+#include <stddef.h>
+
+#include <string>
+
+/*!
+    Line scanner for received data
+
+    Data read from a socket is added at the end of the buffer and
+    complete lines are taken from the start. A line is returned as a
+    pointer into the buffer and a length, nothing is copied. The scan
+    for the end of a line continues where the last scan stopped so a
+    line that arrives in many reads is only scanned once.
+
+    Consumed data is not removed on each line. The unconsumed data is
+    moved to the start of the buffer first when more room is needed and
+    the consumed part is at least as large as what is left. Each byte
+    is thus moved a bounded number of times and handling a large burst
+    of lines is linear in its size. The buffer is kept contiguous (not
+    a wrap around ring) so every line can be returned in one piece.
+
+    Data that is not lines (binary frames) can be taken from the same
+    buffer with data(), size() and consume().
+*/
+
+class CLineScanner
+{
+
+  public:
+    /// Constructor
+    CLineScanner();
+
+    /// Destructor
+    ~CLineScanner();
+
+    /*!
+        Get room to write received data to.
+        @param len Number of bytes that will be written at most.
+        @return Pointer to where data should be written. Call
+            commitWrite with the number of bytes actually written.
+     */
+    char* getWriteBuffer(size_t len);
+
+    /*!
+        Add bytes written to the buffer returned by getWriteBuffer.
+        @param len Number of bytes written.
+     */
+    void commitWrite(size_t len);
+
+    /*!
+        Add received data.
+        @param pData Data to add.
+        @param len Number of bytes to add.
+     */
+    void append(const char* pData, size_t len);
+
+    /*!
+        Get the next complete line ("\n" or "\r\n" terminated).
+        Whitespace at the start and the end of the line and the line
+        ending is removed.
+        @param ppLine Set to the start of the line. The line is not NULL
+            terminated and is valid until the scanner is changed.
+        @param pLen Set to the length of the line.
+        @return true if a line was returned, false if there is no
+            complete line.
+     */
+    bool getLine(const char** ppLine, size_t* pLen);
+
+    /*!
+        Get unconsumed data.
+        @return Pointer to the first unconsumed byte.
+     */
+    const char* data(void) const { return m_buf.data() + m_posRead; };
+
+    /*!
+        Get the number of unconsumed bytes.
+     */
+    size_t size(void) const { return m_posEnd - m_posRead; };
+
+    /*!
+        Consume data taken with data()
+        @param len Number of bytes to consume.
+     */
+    void consume(size_t len);
+
+    /// Remove all data
+    void clear(void);
+
+    /*!
+        Remove whitespace at the start and end of a string that is
+        given as a pointer and a length.
+        @param ppStr Pointer to string start. Updated.
+        @param pLen Pointer to string length. Updated.
+     */
+    static void trim(const char** ppStr, size_t* pLen);
+
+  private:
+    /// The buffer. Its size is the allocated room.
+    std::string m_buf;
+
+    /// Position of first unconsumed byte
+    size_t m_posRead;
+
+    /// Position where the scan for the next line ending continues
+    size_t m_posScan;
+
+    /// Position after the last received byte
+    size_t m_posEnd;
+};
+
+#endif
@@ -1199,23 +1199,16 @@ lua_vscp_getEvent(struct lua_State* L)
     // Check the client queue
     if (pClientItem->m_bOpen && pClientItem->m_clientInputQueue.size()) {
 
-        std::deque<vscpEvent*>::iterator it;
-        vscpEvent* pEvent;
-
-        pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-        pEvent = pClientItem->m_clientInputQueue.front();
-        pClientItem->m_clientInputQueue.pop_front();
-        if (NULL == pEvent) {
-            return luaL_error(L, "vscp.getEvent: Failed to get event.");
-        }
-        pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+        CSharedEvent* pSharedEvent = pClientItem->m_clientInputQueue.pop();
 
-        if (NULL == pEvent) {
+        if (NULL == pSharedEvent) {
             return luaL_error(L,
                               "vscp.getEvent: Allocation error when "
                               "getting event from client!");
         }
 
+        const vscpEvent* pEvent = pSharedEvent->getEvent();
+
         if (vscp_doLevel2Filter(pEvent, &pClientItem->m_filter)) {
 
             // Write it out
@@ -1223,6 +1216,7 @@ lua_vscp_getEvent(struct lua_State* L)
             switch (format) {
                 case 0: // String
                     if (!vscp_convertEventToString(strResult, pEvent)) {
+                        pSharedEvent->release();
                         return luaL_error(L,
                                           "vscp.getEvent: Failed to "
                                           "convert event to string form.");
@@ -1231,6 +1225,7 @@ lua_vscp_getEvent(struct lua_State* L)
 
                 case 1: // XML
                     if (!vscp_convertEventToXML(strResult, pEvent)) {
+                        pSharedEvent->release();
                         return luaL_error(L,
                                           "vscp.getEvent: Failed to "
                                           "convert event to XML form.");
@@ -1239,6 +1234,7 @@ lua_vscp_getEvent(struct lua_State* L)
 
                 case 2: // JSON
                     if (!vscp_convertEventToJSON(strResult, pEvent)) {
+                        pSharedEvent->release();
                         return luaL_error(L,
                                           "vscp.getEvent: Failed to "
                                           "convert event to JSON form.");
@@ -1247,7 +1243,7 @@ lua_vscp_getEvent(struct lua_State* L)
             }
 
             // Event is not needed anymore
-            vscp_deleteEvent(pEvent);
+            pSharedEvent->release();
 
             lua_pushlstring(
               L, (const char*)strResult.c_str(), strResult.length());
@@ -1257,6 +1253,9 @@ lua_vscp_getEvent(struct lua_State* L)
 
         } // Valid pEvent pointer
 
+        // Filtered out
+        pSharedEvent->release();
+
     } // events available
 
     // No events available
@@ -1387,7 +1386,7 @@ lua_vscp_setFilter(struct lua_State* L)
     }
 
     // Set the filter
-    vscp_copyVSCPFilter(&pClientItem->m_filter, &filter);
+    gpobj->m_clientList.setClientFilter(pClientItem, &filter);
 
     return 1;
 }
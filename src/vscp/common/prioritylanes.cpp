@@ -0,0 +1,174 @@
+// prioritylanes.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <vscphelper.h>
+
+#include "prioritylanes.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CPriorityLanes::CPriorityLanes()
+  : m_maskActive(0)
+  , m_count(0)
+  , m_nBypass(0)
+  , m_lastBoost(0)
+  , m_nextLane(-1)
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CPriorityLanes::~CPriorityLanes()
+{
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// push
+//
+
+void
+CPriorityLanes::push(CSharedEvent* pSharedEvent)
+{
+    if (NULL == pSharedEvent) {
+        return;
+    }
+
+    int lane = vscp_getEventPriority(pSharedEvent->getEvent());
+
+    m_lanes[lane].push_back(pSharedEvent);
+    m_maskActive |= (1 << lane);
+    m_count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// selectLane
+//
+
+int
+CPriorityLanes::selectLane(void)
+{
+    if (-1 != m_nextLane) {
+        return m_nextLane;
+    }
+
+    if (0 == m_maskActive) {
+        return -1;
+    }
+
+    int lane = __builtin_ctz(m_maskActive);
+
+    // Give a waiting lower priority lane its turn. Lanes after the one
+    // served last time go first.
+    uint32_t lower = m_maskActive & ~((2u << lane) - 1);
+    if (lower && (m_nBypass >= PRIORITY_STARVATION_LIMIT)) {
+        uint32_t next = lower & ~((2u << m_lastBoost) - 1);
+        lane          = __builtin_ctz(next ? next : lower);
+    }
+
+    return lane;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pop
+//
+
+CSharedEvent*
+CPriorityLanes::pop(void)
+{
+    int lane = selectLane();
+    if (-1 == lane) {
+        return NULL;
+    }
+
+    int highest    = __builtin_ctz(m_maskActive);
+    uint32_t lower = m_maskActive & ~((2u << highest) - 1);
+
+    if (lane != highest) {
+        // Starvation protection kicked in
+        m_nBypass   = 0;
+        m_lastBoost = lane;
+    }
+    else if (lower) {
+        m_nBypass++;
+    }
+    else {
+        m_nBypass = 0;
+    }
+
+    CSharedEvent* pSharedEvent = m_lanes[lane].front();
+    m_lanes[lane].pop_front();
+    if (m_lanes[lane].empty()) {
+        m_maskActive &= ~(1 << lane);
+    }
+    m_count--;
+    m_nextLane = -1;
+
+    return pSharedEvent;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// front
+//
+
+CSharedEvent*
+CPriorityLanes::front(void)
+{
+    m_nextLane = selectLane();
+    if (-1 == m_nextLane) {
+        return NULL;
+    }
+
+    return m_lanes[m_nextLane].front();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CPriorityLanes::clear(void)
+{
+    for (int i = 0; i < PRIORITY_LANES; i++) {
+        std::deque<CSharedEvent*>::iterator it;
+        for (it = m_lanes[i].begin(); it != m_lanes[i].end(); ++it) {
+            (*it)->release();
+        }
+        m_lanes[i].clear();
+    }
+
+    m_maskActive = 0;
+    m_count      = 0;
+    m_nBypass    = 0;
+    m_nextLane   = -1;
+}
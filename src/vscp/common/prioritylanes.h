@@ -0,0 +1,144 @@
+// prioritylanes.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(PRIORITYLANES_H__INCLUDED_)
+#define PRIORITYLANES_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+
+#include <sharedevent.h>
+
+// One lane for each of the priorities in the VSCP head
+#define PRIORITY_LANES 8
+
+// Max number of events taken from higher priority lanes in a row while
+// a lower priority lane has events waiting
+#define PRIORITY_STARVATION_LIMIT 16
+
+/*!
+    Priority lanes
+
+    Shared events sorted by the priority bits in the event head, one
+    FIFO lane for each priority. Events are taken from the highest
+    priority (lowest number) lane that has events so an alarm does not
+    have to wait for a flood of low priority events to be delivered.
+    Events with the same priority are delivered in the order they were
+    queued.
+
+    To keep low priority events moving, one event is taken from a lower
+    priority lane after PRIORITY_STARVATION_LIMIT events in a row has
+    been taken ahead of it. The waiting lanes take turns for this.
+
+    The lanes are owned by one thread and are not thread safe.
+*/
+
+class CPriorityLanes
+{
+
+  public:
+    /// Constructor
+    CPriorityLanes();
+
+    /// Destructor - Release all queued events
+    ~CPriorityLanes();
+
+    /*!
+        Put an event last in the lane for its priority
+        @param pSharedEvent Event to queue. The lanes take over the
+            reference.
+    */
+    void push(CSharedEvent* pSharedEvent);
+
+    /*!
+        Take the next event out of the lanes
+        @return Pointer to event (the reference now belongs to the
+            caller) or NULL if all lanes are empty.
+    */
+    CSharedEvent* pop(void);
+
+    /*!
+        Get the next event without taking it out of the lanes. The next
+        call to pop returns the same event even if events with higher
+        priority are pushed in between.
+        @return Pointer to event (still owned by the lanes) or NULL if
+            all lanes are empty.
+    */
+    CSharedEvent* front(void);
+
+    /*!
+        Take out and release all events
+    */
+    void clear(void);
+
+    /*!
+        Get the number of events in all lanes
+        @return Number of events.
+    */
+    size_t size(void) const { return m_count; };
+
+    /*!
+        Check if all lanes are empty
+        @return true if there are no events.
+    */
+    bool empty(void) const { return (0 == m_count); };
+
+  private:
+    /*!
+        Find the lane the next event should be taken from
+        @return Lane or -1 if all lanes are empty.
+    */
+    int selectLane(void);
+
+    // Not copyable
+    CPriorityLanes(const CPriorityLanes&);
+    CPriorityLanes& operator=(const CPriorityLanes&);
+
+  private:
+    // The lanes, index is the priority
+    std::deque<CSharedEvent*> m_lanes[PRIORITY_LANES];
+
+    // Bit n is set when lane n has events
+    uint32_t m_maskActive;
+
+    // Number of events in all lanes
+    size_t m_count;
+
+    // Events taken in a row while lower priority events waited
+    uint32_t m_nBypass;
+
+    // Lower priority lane that was served last to prevent starvation
+    int m_lastBoost;
+
+    // Lane selected by front() or -1
+    int m_nextLane;
+};
+
+#endif
@@ -0,0 +1,242 @@
+// restdecoder.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "restdecoder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CRestDecoder::CRestDecoder(const char* const* pNames,
+                           size_t cnt,
+                           size_t maxSize)
+  : m_pNames(pNames)
+  , m_values(cnt > RESTDECODER_MAX_PARAMS ? RESTDECODER_MAX_PARAMS : cnt)
+  , m_maxSize(maxSize)
+{
+    clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CRestDecoder::~CRestDecoder() {}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CRestDecoder::clear(void)
+{
+    for (size_t i = 0; i < m_values.size(); i++) {
+        m_values[i].clear();
+    }
+
+    m_found   = 0;
+    m_size    = 0;
+    m_state   = STATE_NAME;
+    m_nameLen = 0;
+    m_pValue  = NULL;
+    m_hex     = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// endName
+//
+
+void
+CRestDecoder::endName(void)
+{
+    m_pValue = NULL;
+
+    if (m_nameLen > RESTDECODER_MAX_NAME) {
+        return; // Too long to be one we know
+    }
+
+    m_name[m_nameLen] = '\0';
+    for (size_t i = 0; i < m_values.size(); i++) {
+        if (0 == strcasecmp(m_name, m_pNames[i])) {
+            // Only the first occurrence is used
+            if (!(m_found & ((uint64_t)1 << i))) {
+                m_found |= ((uint64_t)1 << i);
+                m_pValue = &m_values[i];
+            }
+            return;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// flushPercent
+//
+
+void
+CRestDecoder::flushPercent(void)
+{
+    if (STATE_PERCENT == m_state) {
+        putValue('%');
+    } else if (STATE_PERCENT_HEX == m_state) {
+        putValue('%');
+        putValue(m_hex);
+    }
+
+    m_state = STATE_VALUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// endValue
+//
+
+void
+CRestDecoder::endValue(void)
+{
+    flushPercent();
+    m_pValue  = NULL;
+    m_nameLen = 0;
+    m_state   = STATE_NAME;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// hexval
+//
+
+static int
+hexval(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+
+    return tolower((unsigned char)c) - 'a' + 10;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// feed
+//
+
+bool
+CRestDecoder::feed(const char* pData, size_t len)
+{
+    if ((NULL == pData) || (0 == len)) {
+        return true;
+    }
+
+    m_size += len;
+    if (m_maxSize && (m_size > m_maxSize)) {
+        return false;
+    }
+
+    size_t pos = 0;
+    while (pos < len) {
+
+        char c = pData[pos];
+
+        switch (m_state) {
+
+            case STATE_NAME:
+                if ('&' == c) {
+                    m_nameLen = 0; // A name without a value
+                } else if ('=' == c) {
+                    endName();
+                    m_state = STATE_VALUE;
+                } else if (m_nameLen < RESTDECODER_MAX_NAME) {
+                    m_name[m_nameLen++] = c;
+                } else {
+                    m_nameLen = RESTDECODER_MAX_NAME + 1;
+                }
+                pos++;
+                break;
+
+            case STATE_VALUE:
+                if ('&' == c) {
+                    endValue();
+                    pos++;
+                } else if ('%' == c) {
+                    m_state = STATE_PERCENT;
+                    pos++;
+                } else if ('+' == c) {
+                    putValue(' ');
+                    pos++;
+                } else {
+                    // Bytes that need no decoding are added in one go
+                    size_t end = pos + 1;
+                    while ((end < len) && ('&' != pData[end]) &&
+                           ('%' != pData[end]) && ('+' != pData[end])) {
+                        end++;
+                    }
+                    if (NULL != m_pValue) {
+                        m_pValue->append(pData + pos, end - pos);
+                    }
+                    pos = end;
+                }
+                break;
+
+            case STATE_PERCENT:
+                if (isxdigit((unsigned char)c)) {
+                    m_hex   = c;
+                    m_state = STATE_PERCENT_HEX;
+                    pos++;
+                } else {
+                    flushPercent(); // c is handled as a value byte
+                }
+                break;
+
+            case STATE_PERCENT_HEX:
+                if (isxdigit((unsigned char)c)) {
+                    putValue((char)((hexval(m_hex) << 4) | hexval(c)));
+                    m_state = STATE_VALUE;
+                    pos++;
+                } else {
+                    flushPercent(); // c is handled as a value byte
+                }
+                break;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// finish
+//
+
+void
+CRestDecoder::finish(void)
+{
+    if (STATE_NAME != m_state) {
+        endValue();
+    }
+
+    m_nameLen = 0;
+}
@@ -0,0 +1,176 @@
+// restdecoder.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(RESTDECODER_H__INCLUDED_)
+#define RESTDECODER_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Max number of parameters a decoder knows
+#define RESTDECODER_MAX_PARAMS 64
+
+// Max length of a parameter name
+#define RESTDECODER_MAX_NAME 32
+
+/*!
+    Streaming decoder for REST parameters
+
+    Decodes "name=value&name=value" data (a query string or an
+    application/x-www-form-urlencoded body) as it arrives, in pieces of
+    any size, so a body never has to be read into one buffer. Only
+    parameters in the table of names the decoder is created with are
+    kept. Values of other parameters are skipped without being stored.
+
+    Names are matched without regard to case and the first occurrence
+    of a parameter is used. Values are decoded as by mg_get_var, "+"
+    is a space and "%xx" a hex coded byte. A "%" that is not followed
+    by two hex digits is kept as is.
+
+    Values are kept in strings that are reused by the next request when
+    the decoder is cleared, so a decoder that is reused does not
+    allocate once its strings are large enough.
+*/
+
+class CRestDecoder
+{
+
+  public:
+    /*!
+        Constructor
+        @param pNames Table with the names of the parameters to keep.
+            The index of a name is the index used to get its value.
+        @param cnt Number of names in the table, at most
+            RESTDECODER_MAX_PARAMS.
+        @param maxSize Max number of data bytes that is decoded. Zero
+            is no limit.
+    */
+    CRestDecoder(const char* const* pNames, size_t cnt, size_t maxSize = 0);
+
+    /// Destructor
+    ~CRestDecoder();
+
+    /// Forget all parameters and start over
+    void clear(void);
+
+    /*!
+        Decode a piece of data.
+        @param pData Data.
+        @param len Number of bytes.
+        @return true on success, false if more than the max number of
+            bytes has been fed to the decoder.
+    */
+    bool feed(const char* pData, size_t len);
+
+    /*!
+        Tell that all data has been fed. The last value is completed.
+    */
+    void finish(void);
+
+    /*!
+        Check if a parameter was found with a value.
+        @param idx Index of parameter name.
+        @return true if found with a non empty value.
+    */
+    bool isSet(size_t idx) const
+    {
+        return (idx < m_values.size()) && m_values[idx].length();
+    }
+
+    /*!
+        Get (or set) a parameter value. Parameters that was not found
+        have an empty value.
+        @param idx Index of parameter name.
+        @return Reference to the value.
+    */
+    std::string& operator[](size_t idx) { return m_values[idx]; }
+
+    /// Number of data bytes fed to the decoder
+    size_t getSize(void) const { return m_size; }
+
+  private:
+    /// Look up the name collected so far
+    void endName(void);
+
+    /// Add a decoded byte to the value being collected
+    void putValue(char c)
+    {
+        if (NULL != m_pValue) {
+            m_pValue->push_back(c);
+        }
+    }
+
+    /// Add whatever is pending of a % sequence to the value as is
+    void flushPercent(void);
+
+    /// End the value being collected
+    void endValue(void);
+
+  private:
+    /// Parameter names
+    const char* const* m_pNames;
+
+    /// Values, one for each name
+    std::vector<std::string> m_values;
+
+    /// Bit set for each parameter found (the first one is used)
+    uint64_t m_found;
+
+    /// Max number of bytes decoded (zero for no limit)
+    size_t m_maxSize;
+
+    /// Bytes decoded
+    size_t m_size;
+
+    /// Decoder states
+    enum
+    {
+        STATE_NAME = 0,
+        STATE_VALUE,
+        STATE_PERCENT,    // "%" seen
+        STATE_PERCENT_HEX // "%" and one hex digit seen
+    } m_state;
+
+    /// Name being collected
+    char m_name[RESTDECODER_MAX_NAME + 1];
+
+    /// Length of the name being collected, longer than the max if
+    /// too long to be known
+    size_t m_nameLen;
+
+    /// Value being collected, NULL if the value is not kept
+    std::string* m_pValue;
+
+    /// The hex digit of a pending %x
+    char m_hex;
+};
+
+#endif // RESTDECODER_H__INCLUDED_
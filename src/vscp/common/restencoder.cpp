@@ -0,0 +1,160 @@
+// restencoder.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <civetweb.h>
+
+#include "restencoder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CRestEncoder::CRestEncoder(struct mg_connection* conn, bool bChunked)
+  : m_conn(conn)
+  , m_bChunked(bChunked)
+  , m_bConnected(NULL != conn)
+  , m_len(0)
+{
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CRestEncoder::~CRestEncoder()
+{
+    flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// send
+//
+
+void
+CRestEncoder::send(const char* pData, size_t len)
+{
+    if (!m_bConnected || (0 == len)) {
+        return;
+    }
+
+    int rv;
+    if (m_bChunked) {
+        rv = mg_send_chunk(m_conn, pData, (unsigned int)len);
+    } else {
+        rv = mg_write(m_conn, pData, len);
+    }
+
+    if (rv <= 0) {
+        m_bConnected = false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// flush
+//
+
+bool
+CRestEncoder::flush(void)
+{
+    send(m_buf, m_len);
+    m_len = 0;
+
+    return m_bConnected;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// write
+//
+
+void
+CRestEncoder::write(const char* pData, size_t len)
+{
+    if ((NULL == pData) || !m_bConnected) {
+        return;
+    }
+
+    if (len > (sizeof(m_buf) - m_len)) {
+        flush();
+
+        // Too large to buffer
+        if (len >= sizeof(m_buf)) {
+            send(pData, len);
+            return;
+        }
+    }
+
+    memcpy(m_buf + m_len, pData, len);
+    m_len += len;
+}
+
+void
+CRestEncoder::write(const char* pstr)
+{
+    if (NULL != pstr) {
+        write(pstr, strlen(pstr));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// printf
+//
+
+void
+CRestEncoder::printf(const char* pFormat, ...)
+{
+    va_list ap;
+
+    if (!m_bConnected) {
+        return;
+    }
+
+    // Try to format straight into the buffer
+    va_start(ap, pFormat);
+    int len = vsnprintf(m_buf + m_len, sizeof(m_buf) - m_len, pFormat, ap);
+    va_end(ap);
+
+    if (len < 0) {
+        return;
+    }
+
+    if ((size_t)len < (sizeof(m_buf) - m_len)) {
+        m_len += len;
+        return;
+    }
+
+    // Did not fit
+    std::string str(len + 1, '\0');
+    va_start(ap, pFormat);
+    vsnprintf(&str[0], str.length(), pFormat, ap);
+    va_end(ap);
+    write(str.c_str(), len);
+}
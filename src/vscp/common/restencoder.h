@@ -0,0 +1,119 @@
+// restencoder.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(RESTENCODER_H__INCLUDED_)
+#define RESTENCODER_H__INCLUDED_
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include <string>
+
+struct mg_connection;
+
+// Size of the output buffer of an encoder
+#define RESTENCODER_BUFFER_SIZE (16 * 1024)
+
+/*!
+    Streaming encoder for REST responses
+
+    Collects the output of a response in a fixed buffer and writes it to
+    the connection each time the buffer is full, so a response of any
+    size is written in large pieces without being put together in memory
+    first. Data larger than the buffer is written straight through. With
+    chunked transfer encoding each write is sent as a chunk.
+
+    When a write to the connection fails the encoder stops writing and
+    the rest of the response is dropped.
+*/
+
+class CRestEncoder
+{
+
+  public:
+    /*!
+        Constructor
+        @param conn Connection to write to.
+        @param bChunked true to send the data as chunks.
+    */
+    CRestEncoder(struct mg_connection* conn, bool bChunked = false);
+
+    /// Destructor. Writes what is left in the buffer.
+    ~CRestEncoder();
+
+    /*!
+        Add data to the response.
+        @param pData Data.
+        @param len Number of bytes.
+    */
+    void write(const char* pData, size_t len);
+
+    /// Add a string to the response
+    void write(const char* pstr);
+
+    /// Add a string to the response
+    void write(const std::string& str) { write(str.c_str(), str.length()); }
+
+    /*!
+        Add formatted text to the response.
+        @param pFormat printf format.
+    */
+    void printf(const char* pFormat, ...)
+      __attribute__((format(printf, 2, 3)));
+
+    /*!
+        Write the buffer to the connection.
+        @return true on success, false if the connection has failed.
+    */
+    bool flush(void);
+
+    /// false if a write to the connection has failed
+    bool isConnected(void) const { return m_bConnected; }
+
+  private:
+    /// Write data to the connection
+    void send(const char* pData, size_t len);
+
+  private:
+    /// Connection
+    struct mg_connection* m_conn;
+
+    /// true to send chunks
+    bool m_bChunked;
+
+    /// false when a write has failed
+    bool m_bConnected;
+
+    /// Bytes in the buffer
+    size_t m_len;
+
+    /// The buffer
+    char m_buf[RESTENCODER_BUFFER_SIZE];
+};
+
+#endif // RESTENCODER_H__INCLUDED_
@@ -33,6 +33,7 @@
 #define _POSIX
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -70,7 +71,10 @@
 #include <controlobject.h>
 #include <devicelist.h>
 #include <devicethread.h>
+#include <eventbatch.h>
 #include <mdf.h>
+#include <restdecoder.h>
+#include <restencoder.h>
 #include <version.h>
 #include <vscp.h>
 #include <vscp_aes.h>
@@ -93,6 +97,15 @@ using json = nlohmann::json;
 
 extern CControlObject* gpobj;
 
+// Names of the request parameters (REST_PARAM_*)
+static const char* const restsrv_paramNames[REST_PARAMS] = {
+    "op", "format", "vscpuser", "vscpsecret", "vscpsession", "vscpevent",
+    "count", "wait", "stream", "vscpfilter", "vscpmask", "variable", "value",
+    "type", "persistent", "accessright", "note", "listlong", "regex", "unit",
+    "sensoridx", "level", "zone", "subzone", "guid", "name", "from", "to",
+    "url", "eventformat", "datetime", "vscpevents"
+};
+
 // Prototypes
 
 void
@@ -116,6 +129,12 @@ restsrv_doSendEvent(struct mg_connection* conn,
                     int format,
                     vscpEvent* pEvent);
 
+void
+restsrv_doSendEvents(struct mg_connection* conn,
+                     struct restsrv_session* pSession,
+                     int format,
+                     std::string& strEvents);
+
 void
 restsrv_doReceiveEvent(struct mg_connection* conn,
                        struct restsrv_session* pSession,
@@ -123,10 +142,15 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
                        size_t count);
 
 void
-restsrv_doReceiveEvent(struct mg_connection* conn,
+restsrv_waitForEvents(struct restsrv_session* pSession, long wait);
+
+void
+restsrv_doStreamEvents(struct mg_connection* conn,
                        struct restsrv_session* pSession,
                        int format,
-                       size_t count);
+                       int stream,
+                       size_t count,
+                       long duration);
 
 void
 restsrv_doSetFilter(struct mg_connection* conn,
@@ -326,6 +350,11 @@ const char* rest_errors[][REST_FORMAT_COUNT + 1] = {
       REST_XML_ERROR_VARIABLE_NOT_DELETE,
       REST_JSON_ERROR_VARIABLE_NOT_DELETE,
       REST_JSONP_ERROR_VARIABLE_NOT_DELETE },
+    { REST_PLAIN_ERROR_RATE_LIMITED,
+      REST_CSV_ERROR_RATE_LIMITED,
+      REST_XML_ERROR_RATE_LIMITED,
+      REST_JSON_ERROR_RATE_LIMITED,
+      REST_JSONP_ERROR_RATE_LIMITED },
 
 };
 
@@ -345,6 +374,11 @@ restsrv_error(struct mg_connection* conn,
 {
     int returncode = 200;
 
+    // Tell the client to back off
+    if (REST_ERROR_CODE_RATE_LIMITED == errorcode) {
+        returncode = 429;
+    }
+
     if (__VSCP_DEBUG_REST) {
         syslog(LOG_DEBUG,
                "REST: error format=%d errorcode=%d",
@@ -432,6 +466,9 @@ restsrv_sendHeader(struct mg_connection* conn, int format, int returncode)
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_get_session
 //
+// The session is pinned so it is not expired while the request uses it.
+// It must be released with restsrv_release_session.
+//
 
 struct restsrv_session*
 restsrv_get_session(struct mg_connection* conn, std::string& sid)
@@ -450,30 +487,38 @@ restsrv_get_session(struct mg_connection* conn, std::string& sid)
     }
 
     // find existing session
-    pthread_mutex_lock(&gpobj->m_mutex_restSession);
-    std::list<struct restsrv_session*>::iterator iter;
-    for (iter = gpobj->m_rest_sessions.begin();
-         iter != gpobj->m_rest_sessions.end();
-         ++iter) {
-        struct restsrv_session* pSession = *iter;
-        if (0 == strcmp((const char*)sid.c_str(), pSession->m_sid)) {
-            pSession->m_lastActiveTime = time(NULL);
-            pthread_mutex_unlock(&gpobj->m_mutex_restSession);
-            if (__VSCP_DEBUG_REST) {
-                syslog(LOG_DEBUG, "REST: get_session, Session found.");
-            }
-            return pSession;
+    struct restsrv_session* pSession =
+      (struct restsrv_session*)gpobj->m_rest_sessions.find(sid.c_str());
+    if (NULL != pSession) {
+        pSession->m_lastActiveTime = time(NULL);
+        if (__VSCP_DEBUG_REST) {
+            syslog(LOG_DEBUG, "REST: get_session, Session found.");
         }
+        return pSession;
     }
-    pthread_mutex_unlock(&gpobj->m_mutex_restSession);
 
     syslog(LOG_ERR, "REST: get_session, Session not found.");
     return NULL;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_release_session
+//
+
+void
+restsrv_release_session(struct restsrv_session* pSession)
+{
+    if (NULL != pSession) {
+        gpobj->m_rest_sessions.release(pSession->m_sid);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_add_session
 //
+// The new session is pinned in the same way as restsrv_get_session
+// pins it.
+//
 
 restsrv_session*
 restsrv_add_session(struct mg_connection* conn, CUserItem* pUserItem)
@@ -541,8 +586,7 @@ restsrv_add_session(struct mg_connection* conn, CUserItem* pUserItem)
     pSession->m_pClientItem->m_pUserItem    = pUserItem;
     vscp_clearVSCPFilter(&pSession->m_pClientItem->m_filter); // Clear filter
     pSession->m_pClientItem->m_bOpen = false; // Start out closed
-    pSession->m_pClientItem->m_type =
-      CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEBSOCKET;
+    pSession->m_pClientItem->m_type = CLIENT_ITEM_INTERFACE_TYPE_CLIENT_REST;
     pSession->m_pClientItem->m_strDeviceName = ("Internal REST server client.");
     pSession->m_pClientItem->m_strDeviceName += ("|Started at ");
     pSession->m_pClientItem->m_strDeviceName +=
@@ -562,51 +606,62 @@ restsrv_add_session(struct mg_connection* conn, CUserItem* pUserItem)
     }
     pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
 
-    // Add to linked list
-    pthread_mutex_lock(&gpobj->m_mutex_restSession);
-    gpobj->m_rest_sessions.push_back(pSession);
-    pthread_mutex_unlock(&gpobj->m_mutex_restSession);
+    // Add to session table
+    if (!gpobj->m_rest_sessions.add(pSession->m_sid, pSession, true)) {
+        pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
+        gpobj->removeClient(pSession->m_pClientItem);
+        pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
+        delete pSession;
+        syslog(LOG_ERR, "REST server: new session, Failed to add session.");
+        return NULL;
+    }
 
     return pSession;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// websrv_expire_sessions
+// restsrv_expire_sessions
 //
 
 void
-restsrv_expire_sessions(struct mg_connection* conn)
+restsrv_expire_sessions(void)
 {
-    time_t now;
-
-    now = time(NULL);
-
-    pthread_mutex_lock(&gpobj->m_mutex_restSession);
+    std::deque<void*> expired;
 
-    std::list<struct restsrv_session*>::iterator it;
+    if (0 == gpobj->m_rest_sessions.expire(expired)) {
+        return;
+    }
 
-    try {
-        for (it = gpobj->m_rest_sessions.begin();
-             it != gpobj->m_rest_sessions.end();
-             /* inline */) {
-            struct restsrv_session* pSession = *it;
-            if ((now - pSession->m_lastActiveTime) > (60 * 60)) {
-                it = gpobj->m_rest_sessions.erase(it);
-                if (__VSCP_DEBUG_REST) {
-                    syslog(LOG_DEBUG, "REST: Session expired");
-                }
-                delete pSession;
-            } else {
-                ++it;
-            }
+    pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
+    for (size_t i = 0; i < expired.size(); i++) {
+        struct restsrv_session* pSession = (struct restsrv_session*)expired[i];
+        if (__VSCP_DEBUG_REST) {
+            syslog(LOG_DEBUG, "REST: Session expired");
         }
-    } catch (...) {
-        syslog(LOG_ERR, "Exception expire_session");
+        gpobj->removeClient(pSession->m_pClientItem);
+        delete pSession;
     }
-
-    pthread_mutex_unlock(&gpobj->m_mutex_restSession);
+    pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_session_pin
+//
+// Releases the session of a request when the request handler returns.
+//
+
+class restsrv_session_pin
+{
+  public:
+    restsrv_session_pin() : m_pSession(NULL) {}
+    ~restsrv_session_pin() { restsrv_release_session(m_pSession); }
+
+    void set(struct restsrv_session* pSession) { m_pSession = pSession; }
+
+  private:
+    struct restsrv_session* m_pSession;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // websrv_restapi
 //
@@ -614,22 +669,16 @@ restsrv_expire_sessions(struct mg_connection* conn)
 int
 websrv_restapi(struct mg_connection* conn, void* cbdata)
 {
-    char bufBody[32000]; // Buffer for body (POST) data
-    int len_post_data;
-    const char* pParams = NULL; // Pointer to query data or POST data
-    int lenParam        = 0;
-    char buf[2048];
+    char buf[4096];
     char date[64];
     std::string str;
     time_t curtime = time(NULL);
     long format    = REST_FORMAT_PLAIN;
-    std::map<std::string, std::string> keypairs;
     struct mg_context* ctx;
     const struct mg_request_info* reqinfo;
     struct restsrv_session* pSession = NULL;
     CUserItem* pUserItem             = NULL;
-
-    memset(bufBody, 0, sizeof(bufBody));
+    restsrv_session_pin pin;
 
     // Check pointer
     if (!conn || !(ctx = mg_get_context(conn)) ||
@@ -648,215 +697,123 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     // Make string with GMT time
     vscp_getTimeString(date, sizeof(date), &curtime);
 
-    // Set defaults
-    keypairs["FORMAT"] = "plain";
-    keypairs["OP"]     = "open";
+    // Parameters are decoded as they are read
+    CRestDecoder keypairs(restsrv_paramNames, REST_PARAMS, REST_MAX_BODY_SIZE);
 
     if (NULL != strstr(method, "POST")) {
 
         const char* pHeader;
+        bool bTooLarge = false;
+        int len;
+
+        pHeader = mg_get_header(conn, "Content-Type");
+        if ((NULL != pHeader) &&
+            ((0 == strncasecmp(pHeader,
+                               REST_MIME_TYPE_JSON,
+                               strlen(REST_MIME_TYPE_JSON))) ||
+             (0 == strncasecmp(pHeader,
+                               REST_MIME_TYPE_NDJSON,
+                               strlen(REST_MIME_TYPE_NDJSON))))) {
+
+            // The body is JSON events (sendevents) which are kept as
+            // they are. Parameters are in the query string.
+            if (NULL != reqinfo->query_string) {
+                keypairs.feed(reqinfo->query_string,
+                              strlen(reqinfo->query_string));
+                keypairs.finish();
+            }
 
-        // read POST data
-        len_post_data = mg_read(conn, bufBody, sizeof(bufBody));
+            std::string& strEvents = keypairs[REST_PARAM_VSCPEVENTS];
+            strEvents.clear();
+            if ((reqinfo->content_length > 0) &&
+                (reqinfo->content_length <= REST_MAX_BODY_SIZE)) {
+                strEvents.reserve(reqinfo->content_length);
+            }
+
+            while (0 < (len = mg_read(conn, buf, sizeof(buf)))) {
+                if (strEvents.length() + len > REST_MAX_BODY_SIZE) {
+                    bTooLarge = true;
+                    break;
+                }
+                strEvents.append(buf, len);
+            }
+
+        } else {
+
+            // Parameters are in the body which is decoded a piece at a time
+            while (0 < (len = mg_read(conn, buf, sizeof(buf)))) {
+                if (!keypairs.feed(buf, len)) {
+                    bTooLarge = true;
+                    break;
+                }
+            }
+            keypairs.finish();
+        }
+
+        if (bTooLarge) {
+            syslog(LOG_ERR,
+                   "REST: restapi - body larger than %d bytes.",
+                   REST_MAX_BODY_SIZE);
+            websrv_sendheader(conn, 413, REST_MIME_TYPE_PLAIN);
+            mg_write(conn,
+                     REST_PLAIN_ERROR_TOO_LARGE,
+                     strlen(REST_PLAIN_ERROR_TOO_LARGE));
+            return WEB_ERROR;
+        }
+
+        // user, password and session are taken from the headers
+        keypairs[REST_PARAM_VSCPUSER].clear();
+        keypairs[REST_PARAM_VSCPSECRET].clear();
+        keypairs[REST_PARAM_VSCPSESSION].clear();
 
         // user
         if (NULL != (pHeader = mg_get_header(conn, "vscpuser"))) {
-            memset(buf, 0, sizeof(buf));
-            strncpy(buf, pHeader, std::min(sizeof(buf) - 1, strlen(pHeader)));
-            keypairs["VSCPUSER"] = std::string(buf);
+            keypairs[REST_PARAM_VSCPUSER] = pHeader;
         }
 
         // password
         if (NULL != (pHeader = mg_get_header(conn, "vscpsecret"))) {
-            memset(buf, 0, sizeof(buf));
-            strncpy(buf, pHeader, std::min(sizeof(buf) - 1, strlen(pHeader)));
-            keypairs["VSCPSECRET"] = std::string(buf);
+            keypairs[REST_PARAM_VSCPSECRET] = pHeader;
         }
 
         // session
         if (NULL != (pHeader = mg_get_header(conn, "vscpsession"))) {
-            memset(buf, 0, sizeof(buf));
-            strncpy(buf, pHeader, std::min(sizeof(buf) - 1, strlen(pHeader)));
-            keypairs["VSCPSESSION"] = std::string(buf);
+            keypairs[REST_PARAM_VSCPSESSION] = pHeader;
         }
 
-        pParams  = bufBody; // Parameters is in the body
-        lenParam = len_post_data;
-
     } else {
 
         // get parameters for get
         if (NULL != reqinfo->query_string) {
-
-            if (0 < mg_get_var(reqinfo->query_string,
-                               strlen(reqinfo->query_string),
-                               "vscpuser",
-                               buf,
-                               sizeof(buf))) {
-                keypairs["VSCPUSER"] = std::string(buf);
-            }
-
-            if (0 < mg_get_var(reqinfo->query_string,
-                               strlen(reqinfo->query_string),
-                               "vscpsecret",
-                               buf,
-                               sizeof(buf))) {
-                keypairs["VSCPSECRET"] = std::string(buf);
-            }
-
-            if (0 < mg_get_var(reqinfo->query_string,
-                               strlen(reqinfo->query_string),
-                               "vscpsession",
-                               buf,
-                               sizeof(buf))) {
-                keypairs["VSCPSESSION"] = std::string(buf);
-            }
-
-            pParams  = reqinfo->query_string; // Parameters is in query string
-            lenParam = strlen(reqinfo->query_string);
+            keypairs.feed(reqinfo->query_string,
+                          strlen(reqinfo->query_string));
+            keypairs.finish();
         }
     }
 
-    // format
-    if (0 < mg_get_var(pParams, lenParam, "format", buf, sizeof(buf))) {
-        keypairs["FORMAT"] = vscp_upper(std::string(buf));
+    // Defaults
+    if (!keypairs.isSet(REST_PARAM_FORMAT)) {
+        keypairs[REST_PARAM_FORMAT] = "plain";
     }
 
-    // op
-    if (0 < mg_get_var(pParams, lenParam, "op", buf, sizeof(buf))) {
-        keypairs["OP"] = vscp_makeUpper_copy(std::string(buf));
+    if (!keypairs.isSet(REST_PARAM_OP)) {
+        keypairs[REST_PARAM_OP] = "open";
     }
 
-    // vscpevent
-    if (0 < mg_get_var(pParams, lenParam, "vscpevent", buf, sizeof(buf))) {
-        keypairs["VSCPEVENT"] = std::string(buf);
-    }
-
-    // count
-    if (0 < mg_get_var(pParams, lenParam, "count", buf, sizeof(buf))) {
-        keypairs["COUNT"] = std::string(buf);
-    }
-
-    // vscpfilter
-    if (0 < mg_get_var(pParams, lenParam, "vscpfilter", buf, sizeof(buf))) {
-        keypairs["VSCPFILTER"] = std::string(buf);
-    }
-
-    // vscpmask
-    if (0 < mg_get_var(pParams, lenParam, "vscpmask", buf, sizeof(buf))) {
-        keypairs["VSCPMASK"] = std::string(buf);
-    }
-
-    // variable
-    if (0 < mg_get_var(pParams, lenParam, "variable", buf, sizeof(buf))) {
-        keypairs["VARIABLE"] = std::string(buf);
-    }
-
-    // value
-    if (0 < mg_get_var(pParams, lenParam, "value", buf, sizeof(buf))) {
-        keypairs["VALUE"] = std::string(buf);
-    }
-
-    // type (number or string)
-    if (0 < mg_get_var(pParams, lenParam, "type", buf, sizeof(buf))) {
-        keypairs["TYPE"] = std::string(buf);
-    }
-
-    // persistent
-    if (0 < mg_get_var(pParams, lenParam, "persistent", buf, sizeof(buf))) {
-        keypairs["PERSISTENT"] = std::string(buf);
-    }
-
-    // access-right  (hex or decimal)
-    if (0 < mg_get_var(pParams, lenParam, "accessright", buf, sizeof(buf))) {
-        keypairs["ACCESSRIGHT"] = std::string(buf);
-    }
-
-    // note
-    if (0 < mg_get_var(pParams, lenParam, "note", buf, sizeof(buf))) {
-        keypairs["NOTE"] = std::string(buf);
-    }
-
-    // listlong
-    if (0 < mg_get_var(pParams, lenParam, "listlong", buf, sizeof(buf))) {
-        keypairs["LISTLONG"] = std::string(buf);
-    }
-
-    // regex
-    if (0 < mg_get_var(pParams, lenParam, "regex", buf, sizeof(buf))) {
-        keypairs[("REGEX")] = std::string(buf);
-    }
-
-    // unit
-    if (0 < mg_get_var(pParams, lenParam, "unit", buf, sizeof(buf))) {
-        keypairs["UNIT"] = std::string(buf);
-    }
-
-    // sensoridx
-    if (0 < mg_get_var(pParams, lenParam, "sensoridx", buf, sizeof(buf))) {
-        keypairs["SENSORINDEX"] = std::string(buf);
-    }
-
-    // level  ( VSCP level 1 or 2 )
-    if (0 < mg_get_var(pParams, lenParam, "level", buf, sizeof(buf))) {
-        keypairs["LEVEL"] = std::string(buf);
-    }
-
-    // zone
-    if (0 < mg_get_var(pParams, lenParam, "zone", buf, sizeof(buf))) {
-        keypairs["ZONE"] = std::string(buf);
-    }
-
-    // subzone
-    if (0 < mg_get_var(pParams, lenParam, "subzone", buf, sizeof(buf))) {
-        keypairs["SUBZONE"] = std::string(buf);
-    }
-
-    // guid
-    if (0 < mg_get_var(pParams, lenParam, "guid", buf, sizeof(buf))) {
-        keypairs["GUID"] = std::string(buf);
-    }
-
-    // name
-    if (0 < mg_get_var(pParams, lenParam, "name", buf, sizeof(buf))) {
-        keypairs["NAME"] = std::string(buf);
-    }
-
-    // from
-    if (0 < mg_get_var(pParams, lenParam, "from", buf, sizeof(buf))) {
-        keypairs["FROM"] = std::string(buf);
-    }
-
-    // to
-    if (0 < mg_get_var(pParams, lenParam, "to", buf, sizeof(buf))) {
-        keypairs["TO"] = std::string(buf);
-    }
-
-    // url
-    if (0 < mg_get_var(pParams, lenParam, "url", buf, sizeof(buf))) {
-        keypairs["URL"] = std::string(buf);
-    }
-
-    // eventformat
-    if (0 < mg_get_var(pParams, lenParam, "eventformat", buf, sizeof(buf))) {
-        keypairs["EVENTFORMAT"] = std::string(buf);
-    }
-
-    // datetime
-    if (0 < mg_get_var(pParams, lenParam, "datetime", buf, sizeof(buf))) {
-        keypairs["DATETIME"] = std::string(buf);
-    }
+    vscp_makeUpper(keypairs[REST_PARAM_FORMAT]);
+    vscp_makeUpper(keypairs[REST_PARAM_OP]);
+    vscp_makeUpper(keypairs[REST_PARAM_STREAM]);
 
     // Get format
-    if ("PLAIN" == keypairs["FORMAT"]) {
+    if ("PLAIN" == keypairs[REST_PARAM_FORMAT]) {
         format = REST_FORMAT_PLAIN;
-    } else if ("CSV" == keypairs["FORMAT"]) {
+    } else if ("CSV" == keypairs[REST_PARAM_FORMAT]) {
         format = REST_FORMAT_CSV;
-    } else if ("XML" == keypairs["FORMAT"]) {
+    } else if ("XML" == keypairs[REST_PARAM_FORMAT]) {
         format = REST_FORMAT_XML;
-    } else if ("JSON" == keypairs["FORMAT"]) {
+    } else if ("JSON" == keypairs[REST_PARAM_FORMAT]) {
         format = REST_FORMAT_JSON;
-    } else if ("JSONP" == keypairs["FORMAT"]) {
+    } else if ("JSONP" == keypairs[REST_PARAM_FORMAT]) {
         format = REST_FORMAT_JSONP;
     } else {
 
@@ -874,24 +831,25 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     }
 
     // If we have a session key we try to get the session
-    if (("") != keypairs["VSCPSESSION"]) {
+    if (("") != keypairs[REST_PARAM_VSCPSESSION]) {
 
         // Get session
-        pSession = restsrv_get_session(conn, keypairs["VSCPSESSION"]);
+        pSession = restsrv_get_session(conn, keypairs[REST_PARAM_VSCPSESSION]);
+        pin.set(pSession);
     }
 
     if (NULL == pSession) {
 
         // Get user
-        pUserItem = gpobj->m_userList.getUser(keypairs["VSCPUSER"]);
+        pUserItem = gpobj->m_userList.getUser(keypairs[REST_PARAM_VSCPUSER]);
 
         // Check if user is valid
         if (NULL == pUserItem) {
 
-            std::string strErr =
-              vscp_str_format("[REST Client] Host [%s] Invalid user [%s]",
-                              std::string(reqinfo->remote_addr).c_str(),
-                              (const char*)keypairs[("VSCPUSER")].c_str());
+            std::string strErr = vscp_str_format(
+              "[REST Client] Host [%s] Invalid user [%s]",
+              std::string(reqinfo->remote_addr).c_str(),
+              (const char*)keypairs[REST_PARAM_VSCPUSER].c_str());
 
             syslog(LOG_ERR, "%s", strErr.c_str());
 
@@ -912,7 +870,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
             std::string strErr = vscp_str_format(
               "[REST Client] Host [%s] NOT allowed to connect. User [%s]",
               reqinfo->remote_addr,
-              (const char*)keypairs["VSCPUSER"].c_str());
+              (const char*)keypairs[REST_PARAM_VSCPUSER].c_str());
 
             syslog(LOG_ERR, "%s", strErr.c_str());
 
@@ -927,15 +885,15 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         // Is this an authorised user?
         pthread_mutex_lock(&gpobj->m_mutex_UserList);
         CUserItem* pValidUser =
-          gpobj->m_userList.validateUser(keypairs["VSCPUSER"],
-                                         keypairs["VSCPSECRET"]);
+          gpobj->m_userList.validateUser(keypairs[REST_PARAM_VSCPUSER],
+                                         keypairs[REST_PARAM_VSCPSECRET]);
         pthread_mutex_unlock(&gpobj->m_mutex_UserList);
 
         if (NULL == pValidUser) {
 
             std::string strErr = vscp_str_format(
               "[REST Client] User [%s] NOT allowed to connect. Client [%s]",
-              (const char*)keypairs["VSCPUSER"].c_str(),
+              (const char*)keypairs[REST_PARAM_VSCPUSER].c_str(),
               reqinfo->remote_addr);
 
             syslog(LOG_ERR, "%s", strErr.c_str());
@@ -954,7 +912,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
 
             std::string strErr = vscp_str_format(
               ("[REST Client] Unable to create new session for user [%s]\n"),
-              (const char*)keypairs[("VSCPUSER")].c_str());
+              (const char*)keypairs[REST_PARAM_VSCPUSER].c_str());
 
             syslog(LOG_ERR, "%s", strErr.c_str());
 
@@ -965,9 +923,11 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
 
             return WEB_ERROR;
         }
+        pin.set(pSession);
 
         // Only the "open" command is allowed here
-        if (("1" == keypairs["OP"]) || ("OPEN" == keypairs["OP"])) {
+        if (("1" == keypairs[REST_PARAM_OP]) ||
+            ("OPEN" == keypairs[REST_PARAM_OP])) {
 
             if (__VSCP_DEBUG_REST) {
                 syslog(LOG_DEBUG, "REST: restapi - doOpen format=%ld", format);
@@ -982,7 +942,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
 
         std::string strErr = vscp_str_format(
           "[REST Client] Unable to create new session for user [%s]",
-          (const char*)keypairs[("VSCPUSER")].c_str());
+          (const char*)keypairs[REST_PARAM_VSCPUSER].c_str());
 
         syslog(LOG_ERR, "%s", strErr.c_str());
 
@@ -1002,7 +962,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         std::string strErr = vscp_str_format(
           ("[REST Client] Host [%s] NOT allowed to connect. User [%s]\n"),
           std::string(reqinfo->remote_addr).c_str(),
-          (const char*)keypairs[("VSCPUSER")].c_str());
+          (const char*)keypairs[REST_PARAM_VSCPUSER].c_str());
 
         syslog(LOG_ERR, "%s", strErr.c_str());
 
@@ -1017,14 +977,15 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
 
     std::string strErr = vscp_str_format(
       ("[REST Client] User [%s] Host [%s] allowed to connect. \n"),
-      (const char*)keypairs[("VSCPUSER")].c_str(),
+      (const char*)keypairs[REST_PARAM_VSCPUSER].c_str(),
       std::string(reqinfo->remote_addr).c_str());
     syslog(LOG_DEBUG, "%s", strErr.c_str());
 
     //   *************************************************************
     //   * * * * * * * *  Status (hold session open)   * * * * * * * *
     //   *************************************************************
-    if ((("0") == keypairs[("OP")]) || (("STATUS") == keypairs[("OP")])) {
+    if ((("0") == keypairs[REST_PARAM_OP]) ||
+        (("STATUS") == keypairs[REST_PARAM_OP])) {
         try {
             restsrv_doStatus(conn, pSession, format);
         } catch (...) {
@@ -1035,7 +996,8 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //  ********************************************
     //  * * * * * * * * open session * * * * * * * *
     //  ********************************************
-    else if ((("1") == keypairs[("OP")]) || (("OPEN") == keypairs[("OP")])) {
+    else if ((("1") == keypairs[REST_PARAM_OP]) ||
+             (("OPEN") == keypairs[REST_PARAM_OP])) {
         try {
             restsrv_doOpen(conn, pSession, format);
         } catch (...) {
@@ -1047,7 +1009,8 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //   **********************************************
     //   * * * * * * * * close session  * * * * * * * *
     //   **********************************************
-    else if ((("2") == keypairs[("OP")]) || (("CLOSE") == keypairs[("OP")])) {
+    else if ((("2") == keypairs[REST_PARAM_OP]) ||
+             (("CLOSE") == keypairs[REST_PARAM_OP])) {
         try {
             restsrv_doClose(conn, pSession, format);
         } catch (...) {
@@ -1058,12 +1021,13 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //  ********************************************
     //   * * * * * * * * Send event  * * * * * * * *
     //  ********************************************
-    else if ((("3") == keypairs[("OP")]) ||
-             (("SENDEVENT") == keypairs[("OP")])) {
+    else if ((("3") == keypairs[REST_PARAM_OP]) ||
+             (("SENDEVENT") == keypairs[REST_PARAM_OP])) {
         vscpEvent vscpevent;
-        if (("") != keypairs[("VSCPEVENT")]) {
+        if (("") != keypairs[REST_PARAM_VSCPEVENT]) {
             try {
-                vscp_convertStringToEvent(&vscpevent, keypairs[("VSCPEVENT")]);
+                vscp_convertStringToEvent(&vscpevent,
+                                          keypairs[REST_PARAM_VSCPEVENT]);
                 restsrv_doSendEvent(conn, pSession, format, &vscpevent);
             } catch (...) {
                 syslog(LOG_ERR,
@@ -1078,14 +1042,46 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //  ********************************************
     //   * * * * * * * * Read event  * * * * * * * *
     //  ********************************************
-    else if ((("4") == keypairs[("OP")]) ||
-             (("READEVENT") == keypairs[("OP")])) {
+    else if ((("4") == keypairs[REST_PARAM_OP]) ||
+             (("READEVENT") == keypairs[REST_PARAM_OP])) {
         long count = 1;
-        if (("") != keypairs[("COUNT")]) {
-            count = std::stoul(keypairs["COUNT"]);
+        if (("") != keypairs[REST_PARAM_COUNT]) {
+            count = std::stoul(keypairs[REST_PARAM_COUNT]);
+        }
+
+        // Max time to wait for events (long poll) or, for a stream,
+        // the time to stream
+        long wait = 0;
+        if (("") != keypairs[REST_PARAM_WAIT]) {
+            wait = vscp_readStringValue(keypairs[REST_PARAM_WAIT]);
+        }
+
+        // Stream events as they arrive. EventSource clients ask for
+        // Server-Sent Events in the Accept header
+        int stream = REST_STREAM_NONE;
+        const char* pAccept = mg_get_header(conn, "Accept");
+        if (("CHUNKED" == keypairs[REST_PARAM_STREAM]) ||
+            ("1" == keypairs[REST_PARAM_STREAM])) {
+            stream = REST_STREAM_CHUNKED;
+        } else if (("SSE" == keypairs[REST_PARAM_STREAM]) ||
+                   ((NULL != pAccept) &&
+                    (NULL != strstr(pAccept, REST_MIME_TYPE_SSE)))) {
+            stream = REST_STREAM_SSE;
         }
+
         try {
-            restsrv_doReceiveEvent(conn, pSession, format, count);
+            if (REST_STREAM_NONE != stream) {
+                // No count means stream until told to stop
+                if (("") == keypairs[REST_PARAM_COUNT]) {
+                    count = 0;
+                }
+                restsrv_doStreamEvents(
+                  conn, pSession, format, stream, count, wait);
+            } else {
+                restsrv_waitForEvents(
+                  pSession, std::min(wait, (long)REST_MAX_WAIT_TIME));
+                restsrv_doReceiveEvent(conn, pSession, format, count);
+            }
         } catch (...) {
             syslog(LOG_ERR,
                    "REST: Exception occurred doing restsrv_doReceiveEvent");
@@ -1095,20 +1091,21 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //   **************************************************
     //   * * * * * * * *     Set filter    * * * * * * * *
     //   **************************************************
-    else if ((("5") == keypairs[("OP")]) ||
-             (("SETFILTER") == keypairs[("OP")])) {
+    else if ((("5") == keypairs[REST_PARAM_OP]) ||
+             (("SETFILTER") == keypairs[REST_PARAM_OP])) {
 
         vscpEventFilter vscpfilter;
         vscp_clearVSCPFilter(&vscpfilter);
 
-        if (("") != keypairs[("VSCPFILTER")]) {
-            vscp_readFilterFromString(&vscpfilter, keypairs[("VSCPFILTER")]);
+        if (("") != keypairs[REST_PARAM_VSCPFILTER]) {
+            vscp_readFilterFromString(&vscpfilter,
+                                      keypairs[REST_PARAM_VSCPFILTER]);
         } else {
             restsrv_error(conn, pSession, format, REST_ERROR_CODE_MISSING_DATA);
         }
 
-        if (("") != keypairs[("VSCPMASK")]) {
-            vscp_readMaskFromString(&vscpfilter, keypairs[("VSCPMASK")]);
+        if (("") != keypairs[REST_PARAM_VSCPMASK]) {
+            vscp_readMaskFromString(&vscpfilter, keypairs[REST_PARAM_VSCPMASK]);
         } else {
             restsrv_error(conn, pSession, format, REST_ERROR_CODE_MISSING_DATA);
         }
@@ -1125,8 +1122,8 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //   ****************************************************
     //   * * * * * * * *  clear input queue   * * * * * * * *
     //   ****************************************************
-    else if ((("6") == keypairs[("OP")]) ||
-             (("CLEARQUEUE") == keypairs[("OP")])) {
+    else if ((("6") == keypairs[REST_PARAM_OP]) ||
+             (("CLEARQUEUE") == keypairs[REST_PARAM_OP])) {
         try {
             restsrv_doClearQueue(conn, pSession, format);
         } catch (...) {
@@ -1140,25 +1137,26 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //   *************************************************
     //   value,unit=0,sensor=0
     //
-    else if ((("10") == keypairs[("OP")]) ||
-             (("MEASUREMENT") == keypairs[("OP")])) {
+    else if ((("10") == keypairs[REST_PARAM_OP]) ||
+             (("MEASUREMENT") == keypairs[REST_PARAM_OP])) {
 
-        if ((("") != keypairs[("VALUE")]) && (("") != keypairs[("TYPE")])) {
+        if ((("") != keypairs[REST_PARAM_VALUE]) &&
+            (("") != keypairs[REST_PARAM_TYPE])) {
 
             try {
                 restsrv_doWriteMeasurement(conn,
                                            pSession,
                                            format,
-                                           keypairs[("DATETIME")],
-                                           keypairs[("GUID")],
-                                           keypairs[("LEVEL")],
-                                           keypairs[("TYPE")],
-                                           keypairs[("VALUE")],
-                                           keypairs[("UNIT")],
-                                           keypairs[("SENSORIDX")],
-                                           keypairs[("ZONE")],
-                                           keypairs[("SUBZONE")],
-                                           keypairs[("SUBZONE")]);
+                                           keypairs[REST_PARAM_DATETIME],
+                                           keypairs[REST_PARAM_GUID],
+                                           keypairs[REST_PARAM_LEVEL],
+                                           keypairs[REST_PARAM_TYPE],
+                                           keypairs[REST_PARAM_VALUE],
+                                           keypairs[REST_PARAM_UNIT],
+                                           keypairs[REST_PARAM_SENSORINDEX],
+                                           keypairs[REST_PARAM_ZONE],
+                                           keypairs[REST_PARAM_SUBZONE],
+                                           keypairs[REST_PARAM_SUBZONE]);
             } catch (...) {
                 syslog(
                   LOG_ERR,
@@ -1172,11 +1170,13 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     //   *******************************************
     //   * * * * * * * * Fetch MDF  * * * * * * * *
     //   *******************************************
-    else if ((("12") == keypairs[("OP")]) || (("MDF") == keypairs[("OP")])) {
+    else if ((("12") == keypairs[REST_PARAM_OP]) ||
+             (("MDF") == keypairs[REST_PARAM_OP])) {
 
-        if (("") != keypairs[("URL")]) {
+        if (("") != keypairs[REST_PARAM_URL]) {
             try {
-                restsrv_doFetchMDF(conn, pSession, format, keypairs[("URL")]);
+                restsrv_doFetchMDF(
+                  conn, pSession, format, keypairs[REST_PARAM_URL]);
             } catch (...) {
                 syslog(LOG_ERR,
                        "REST: Exception occurred doing restsrv_doFetchMDF");
@@ -1186,6 +1186,29 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         }
     }
 
+    //  *********************************************
+    //   * * * * * * * * Send events  * * * * * * * *
+    //  *********************************************
+    //   JSON array or newline delimited JSON events
+    //
+    else if ((("13") == keypairs[REST_PARAM_OP]) ||
+             (("SENDEVENTS") == keypairs[REST_PARAM_OP])) {
+
+        if (("") != keypairs[REST_PARAM_VSCPEVENTS]) {
+            try {
+                restsrv_doSendEvents(conn,
+                                     pSession,
+                                     format,
+                                     keypairs[REST_PARAM_VSCPEVENTS]);
+            } catch (...) {
+                syslog(LOG_ERR,
+                       "REST: Exception occurred doing restsrv_doSendEvents");
+            }
+        } else {
+            restsrv_error(conn, pSession, format, REST_ERROR_CODE_MISSING_DATA);
+        }
+    }
+
     // Unrecognised operation
 
     else {
@@ -1601,6 +1624,14 @@ restsrv_doSendEvent(struct mg_connection* conn,
 
     if (NULL != pSession) {
 
+        // Over the rate limit of the session or the user
+        if ((NULL != pSession->m_pClientItem) &&
+            (0 == gpobj->admitEvents(pSession->m_pClientItem))) {
+            restsrv_error(conn, pSession, format, REST_ERROR_CODE_RATE_LIMITED);
+            vscp_deleteEvent(pEvent);
+            return;
+        }
+
         // Level II events between 512-1023 is recognised by the daemon and
         // sent to the correct interface as Level I events if the interface
         // is addressed by the client.
@@ -1628,35 +1659,27 @@ restsrv_doSendEvent(struct mg_connection* conn,
                     // Lock client
                     pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
 
-                    // If the client queue is full for this client then the
-                    // client will not receive the message
-                    if (pSession->m_pClientItem->m_clientInputQueue.size() <=
-                        gpobj->m_maxItemsInClientReceiveQueue) {
+                    vscpEvent* pNewEvent;
+                    if (vscp_newEvent(&pNewEvent)) {
 
-                        vscpEvent* pNewEvent = new (vscpEvent);
-                        if (NULL != pNewEvent) {
-
-                            vscp_copyEvent(pNewEvent, pEvent);
-
-                            // Add the new event to the input queue
-                            pthread_mutex_lock(&pSession->m_pClientItem
-                                                  ->m_mutexClientInputQueue);
-                            pSession->m_pClientItem->m_clientInputQueue
-                              .push_back(pNewEvent);
-                            pthread_mutex_unlock(&pSession->m_pClientItem
-                                                    ->m_mutexClientInputQueue);
-                            sem_post(
-                              &pSession->m_pClientItem->m_semClientInputQueue);
+                        vscp_copyEvent(pNewEvent, pEvent);
 
-                            bSent = true;
-                        } else {
-                            bSent = false;
-                        }
+                        // Add the new event to the input queue. If the
+                        // client queue is full for this client then the
+                        // client will not receive the message
+                        CSharedEvent* pSharedEvent =
+                          new CSharedEvent(pNewEvent);
+                        uint8_t shard = gpobj->m_clientList.getShard(
+                          pSession->m_pClientItem);
+                        gpobj->m_clientList.lockShard(shard);
+                        gpobj->sendEventToClient(pSession->m_pClientItem,
+                                                 pSharedEvent);
+                        gpobj->m_clientList.unlockShard(shard);
+                        pSharedEvent->release();
 
-                    } else {
-                        // Overrun - No room for event
-                        // vscp_deleteEvent( pEvent );
                         bSent = true;
+                    } else {
+                        bSent = false;
                     }
 
                     // Unlock client
@@ -1674,23 +1697,17 @@ restsrv_doSendEvent(struct mg_connection* conn,
                 // Set client id
                 pEvent->obid = pSession->m_pClientItem->m_clientID;
 
-                // There must be room in the send queue
-                if (gpobj->m_maxItemsInClientReceiveQueue >
-                    gpobj->m_clientOutputQueue.size()) {
+                vscpEvent* pNewEvent = NULL;
+                if (vscp_newEvent(&pNewEvent)) {
+                    vscp_copyEvent(pNewEvent, pEvent);
+                }
 
-                    vscpEvent* pNewEvent = new (vscpEvent);
-                    if (NULL != pNewEvent) {
-                        vscp_copyEvent(pNewEvent, pEvent);
+                // There must be room in the send queue
+                if ((NULL != pNewEvent) &&
+                    gpobj->postClientOutputEvent(pSession->m_pClientItem,
+                                                 pNewEvent)) {
 
-                        pthread_mutex_lock(&gpobj->m_mutex_ClientOutputQueue);
-                        gpobj->m_clientOutputQueue.push_back(pNewEvent);
-                        pthread_mutex_unlock(&gpobj->m_mutex_ClientOutputQueue);
-                        sem_post(&gpobj->m_semClientOutputQueue);
-
-                        bSent = true;
-                    } else {
-                        bSent = false;
-                    }
+                    bSent = true;
 
                     restsrv_error(conn,
                                   pSession,
@@ -1698,6 +1715,7 @@ restsrv_doSendEvent(struct mg_connection* conn,
                                   REST_ERROR_CODE_SUCCESS);
 
                 } else {
+                    vscp_deleteEvent_v2(&pNewEvent);
                     restsrv_error(conn,
                                   pSession,
                                   format,
@@ -1724,9 +1742,237 @@ restsrv_doSendEvent(struct mg_connection* conn,
     return;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_doSendEvents
+//
+// A batch of events is checked and sent in one go. The reply has the
+// number of events sent and the index and status of each event that
+// was not sent.
+//
+
+void
+restsrv_doSendEvents(struct mg_connection* conn,
+                     struct restsrv_session* pSession,
+                     int format,
+                     std::string& strEvents)
+{
+    // Check pointer
+    if (NULL == conn)
+        return;
+
+    if ((NULL == pSession) || (NULL == pSession->m_pClientItem)) {
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
+        return;
+    }
+
+    CEventBatch batch;
+    if (!batch.parse(strEvents.data(), strEvents.length())) {
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_MISSING_DATA);
+        return;
+    }
+
+    // The JSON is not needed anymore
+    std::string().swap(strEvents);
+
+    batch.check(pSession->m_pClientItem->m_pUserItem);
+    batch.send(pSession->m_pClientItem);
+
+    // Nothing sent because of the rate limit, tell the client to back off
+    size_t nRateLimited = 0;
+    for (size_t i = 0; i < batch.getCount(); i++) {
+        if (EVENTBATCH_RATE_LIMITED == batch.getStatus(i)) {
+            nRateLimited++;
+        }
+    }
+
+    if (!batch.getSent() && nRateLimited &&
+        (nRateLimited == batch.getFailed())) {
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_RATE_LIMITED);
+        return;
+    }
+
+    // Send header
+    if (REST_FORMAT_PLAIN == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
+    } else if (REST_FORMAT_CSV == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_CSV);
+    } else if (REST_FORMAT_XML == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
+    } else if (REST_FORMAT_JSONP == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
+    } else {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
+    }
+
+    CRestEncoder out(conn);
+
+    // Plain / CSV
+    if ((REST_FORMAT_PLAIN == format) || (REST_FORMAT_CSV == format)) {
+
+        const char* pFailed; // Failed event lines
+        if (REST_FORMAT_PLAIN == format) {
+            out.write("1 1 Success \r\n");
+            out.printf("%zu events received %zu sent %zu failed\r\n",
+                       batch.getCount(),
+                       batch.getSent(),
+                       batch.getFailed());
+            pFailed = "- ";
+        } else {
+            out.write("success-code,error-code,message,"
+                      "description,Event\r\n1,1,Success,Success."
+                      ",NULL\r\n");
+            out.printf("1,2,Info,%zu events received %zu sent %zu "
+                       "failed,NULL\r\n",
+                       batch.getCount(),
+                       batch.getSent(),
+                       batch.getFailed());
+            out.printf("1,4,Count,%zu,NULL\r\n", batch.getCount());
+            out.printf("1,5,Sent,%zu,NULL\r\n", batch.getSent());
+            pFailed = "1,3,Failed,";
+        }
+
+        for (size_t i = 0; i < batch.getCount(); i++) {
+            uint8_t status = batch.getStatus(i);
+            if (EVENTBATCH_OK != status) {
+                out.printf("%s%zu,%d,%s\r\n",
+                           pFailed,
+                           i,
+                           (int)status,
+                           CEventBatch::getStatusText(status));
+            }
+        }
+    }
+
+    // XML
+    else if (REST_FORMAT_XML == format) {
+
+        out.write(XML_HEADER "<vscp-rest success = \"true\" "
+                             "code = \"1\" message = \"Success\" "
+                             "description = \"Success.\" >");
+        out.printf("<count>%zu</count><sent>%zu</sent><failed>",
+                   batch.getCount(),
+                   batch.getSent());
+
+        for (size_t i = 0; i < batch.getCount(); i++) {
+            uint8_t status = batch.getStatus(i);
+            if (EVENTBATCH_OK != status) {
+                out.printf("<event index = \"%zu\" code = \"%d\" "
+                           "error = \"%s\" />",
+                           i,
+                           (int)status,
+                           CEventBatch::getStatusText(status));
+            }
+        }
+
+        out.write("</failed></vscp-rest>");
+    }
+
+    // JSON / JSONP
+    else {
+
+        // typeof handler === 'function' &&
+        if (REST_FORMAT_JSONP == format) {
+            out.write(REST_JSONP_START);
+        }
+
+        // Keys in the same (sorted) order as json::dump() use
+        out.printf("{\"code\":1,\"count\":%zu,"
+                   "\"description\":\"Success\",\"failed\":",
+                   batch.getCount());
+        out.write(batch.getFailedJSON());
+        out.printf(",\"message\":\"success\",\"sent\":%zu,\"success\":true}",
+                   batch.getSent());
+
+        if (REST_FORMAT_JSONP == format) {
+            out.write(REST_JSONP_END);
+        }
+    }
+
+    out.flush();
+    mg_write(conn, "", 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_convertEventToXML
+//
+// Event element of an XML reply
+//
+
+static bool
+restsrv_convertEventToXML(std::string& strXML, const vscpEvent* pEvent)
+{
+    std::string str;
+
+    strXML = "<event>";
+    strXML += vscp_str_format("<head>%d</head>", pEvent->head);
+    strXML += vscp_str_format("<vscpclass>%d</vscpclass>", pEvent->vscp_class);
+    strXML += vscp_str_format("<vscptype>%d</vscptype>", pEvent->vscp_type);
+    strXML +=
+      vscp_str_format("<obid>%lu</obid>", (unsigned long)pEvent->obid);
+
+    vscp_getDateStringFromEvent(str, pEvent);
+    strXML += "<datetime>" + str + "</datetime>";
+
+    strXML += vscp_str_format("<timestamp>%lu</timestamp>",
+                              (unsigned long)pEvent->timestamp);
+
+    vscp_writeGuidToString(str, pEvent);
+    strXML += "<guid>" + str + "</guid>";
+
+    strXML += vscp_str_format("<sizedata>%d</sizedata>", pEvent->sizeData);
+
+    vscp_writeDataToString(str, pEvent);
+    strXML += "<data>" + str + "</data>";
+
+    if (vscp_convertEventToString(str, pEvent)) {
+        strXML += "<raw>" + str + "</raw>";
+    }
+
+    strXML += "</event>";
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_convertEventToJSON
+//
+// Event object of a JSON reply
+//
+
+static bool
+restsrv_convertEventToJSON(std::string& strJSON, const vscpEvent* pEvent)
+{
+    std::string str;
+    json ev;
+
+    ev["head"]      = pEvent->head;
+    ev["vscpclass"] = pEvent->vscp_class;
+    ev["vscptype"]  = pEvent->vscp_type;
+    vscp_getDateStringFromEvent(str, pEvent);
+    ev["datetime"]  = (const char*)str.c_str();
+    ev["timestamp"] = pEvent->timestamp;
+    ev["obid"]      = pEvent->obid;
+    vscp_writeGuidToString(str, pEvent);
+    ev["guid"]     = (const char*)str.c_str();
+    ev["sizedata"] = pEvent->sizeData;
+    ev["data"]     = json::array();
+    for (uint16_t j = 0; j < pEvent->sizeData; j++) {
+        ev["data"].push_back(pEvent->pdata[j]);
+    }
+
+    strJSON = ev.dump();
+
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_doReceiveEvent
 //
+// The events are taken out of the queue in one go and written straight
+// to the connection through an encoder. For JSON the count of events
+// and errors comes before the events in the reply so the events are
+// rendered first and written when the counts are known.
+//
 
 void
 restsrv_doReceiveEvent(struct mg_connection* conn,
@@ -1738,504 +1984,581 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
     if (NULL == conn)
         return;
 
-    if (NULL != pSession) {
+    if (NULL == pSession) {
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
+        return;
+    }
 
-        if (!pSession->m_pClientItem->m_clientInputQueue.empty()) {
+    CClientItem* pClientItem = pSession->m_pClientItem;
 
-            char wrkbuf[32000];
-            std::string out;
-            size_t cntAvailable =
-              pSession->m_pClientItem->m_clientInputQueue.size();
+    // Queue is empty
+    if (pClientItem->m_clientInputQueue.empty()) {
+        restsrv_error(conn,
+                      pSession,
+                      format,
+                      RESR_ERROR_CODE_INPUT_QUEUE_EMPTY);
+        return;
+    }
 
-            // Plain
-            if (REST_FORMAT_PLAIN == format) {
+    size_t cntAvailable = pClientItem->m_clientInputQueue.size();
+    size_t cnt          = std::min(count, cntAvailable);
 
-                // Send header
-                websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
+    // Send header
+    if (REST_FORMAT_PLAIN == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
+    } else if (REST_FORMAT_CSV == format) {
+        websrv_sendheader(
+          conn, 200, /*REST_MIME_TYPE_CSV*/ REST_MIME_TYPE_PLAIN);
+    } else if (REST_FORMAT_XML == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
+    } else if (REST_FORMAT_JSONP == format) {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
+    } else {
+        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
+    }
 
-                if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
+    CRestEncoder out(conn);
 
-                    sprintf(wrkbuf, "1 1 Success \r\n");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                    sprintf(wrkbuf,
-#if WIN32
-                            "%zd events requested of %zd available "
-                            "(unfiltered) %zu will be retrieved\r\n",
-#else
-                            "%zd events requested of %zd available "
-                            "(unfiltered) %lu will be retrieved\r\n",
-#endif
-                            count,
-                            pSession->m_pClientItem->m_clientInputQueue.size(),
-                            std::min(count, cntAvailable));
-
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                    for (unsigned int i = 0; i < std::min(count, cntAvailable);
-                         i++) {
-
-                        vscpEvent* pEvent;
-
-                        pthread_mutex_lock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-                        pEvent =
-                          pSession->m_pClientItem->m_clientInputQueue.front();
-                        pSession->m_pClientItem->m_clientInputQueue.pop_front();
-                        pthread_mutex_unlock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-
-                        if (NULL != pEvent) {
-
-                            if (vscp_doLevel2Filter(
-                                  pEvent,
-                                  &pSession->m_pClientItem->m_filter)) {
-
-                                std::string str;
-                                if (vscp_convertEventToString(str, pEvent)) {
-
-                                    // Write it out
-                                    strcpy((char*)wrkbuf, (const char*)"- ");
-                                    strcat((char*)wrkbuf,
-                                           (const char*)str.c_str());
-                                    strcat((char*)wrkbuf, "\r\n");
-                                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                                } else {
-                                    strcpy(
-                                      (char*)wrkbuf,
-                                      "- Malformed event (internal error)\r\n");
-                                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                                }
-                            } else {
-                                strcpy((char*)wrkbuf,
-                                       "- Event filtered out\r\n");
-                                mg_write(conn, wrkbuf, strlen(wrkbuf));
-                            }
-
-                            // Remove the event
-                            vscp_deleteEvent(pEvent);
-
-                        } // Valid pEvent pointer
-                        else {
-                            strcpy((char*)wrkbuf,
-                                   "- Event could not be fetched (internal "
-                                   "error)\r\n");
-                            mg_write(conn, wrkbuf, strlen(wrkbuf));
-                        }
-                    }    // for
-                } else { // no events available
-                    sprintf(wrkbuf, REST_PLAIN_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                }
+    // No events available
+    if (!pClientItem->m_bOpen || !cntAvailable) {
 
+        if (REST_FORMAT_PLAIN == format) {
+            out.write(REST_PLAIN_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+        } else if (REST_FORMAT_CSV == format) {
+            out.write(REST_CSV_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+        } else if (REST_FORMAT_XML == format) {
+            out.write(REST_XML_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+        } else if (REST_FORMAT_JSONP == format) {
+            out.write(REST_JSONP_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+        } else {
+            out.write(REST_JSON_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+        }
+
+        out.flush();
+        mg_write(conn, "", 0);
+        return;
+    }
+
+    // Take the events out of the queue
+    std::vector<CSharedEvent*> events(cnt);
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+    for (size_t i = 0; i < cnt; i++) {
+        events[i] = pClientItem->m_clientInputQueue.pop();
+    }
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+
+    // Plain / CSV
+    if ((REST_FORMAT_PLAIN == format) || (REST_FORMAT_CSV == format)) {
+
+        const char* pPrefix; // Info lines
+        const char* pData;   // Event lines
+        if (REST_FORMAT_PLAIN == format) {
+            out.write("1 1 Success \r\n");
+            out.printf("%zu events requested of %zu available "
+                       "(unfiltered) %zu will be retrieved\r\n",
+                       count,
+                       cntAvailable,
+                       cnt);
+            pPrefix = "- ";
+            pData   = "- ";
+        } else {
+            out.write("success-code,error-code,message,"
+                      "description,Event\r\n1,1,Success,Success."
+                      ",NULL\r\n");
+            out.printf("1,2,Info,%zu events requested of %zu available "
+                       "(unfiltered) %zu will be retrieved,NULL\r\n",
+                       count,
+                       cntAvailable,
+                       cnt);
+            out.printf("1,4,Count,%zu,NULL\r\n", cnt);
+            pPrefix = "1,2,Info,";
+            pData   = "1,3,Data,Event,";
+        }
+
+        for (size_t i = 0; i < cnt; i++) {
+
+            CSharedEvent* pSharedEvent = events[i];
+
+            if (NULL == pSharedEvent) {
+                out.write(pPrefix);
+                out.write("Event could not be fetched (internal error)\r\n");
+                continue;
             }
 
-            // CSV
-            else if (REST_FORMAT_CSV == format) {
-
-                // Send header
-                websrv_sendheader(conn,
-                                  200,
-                                  /*REST_MIME_TYPE_CSV*/ REST_MIME_TYPE_PLAIN);
-
-                if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
-
-                    sprintf(wrkbuf,
-                            "success-code,error-code,message,"
-                            "description,Event\r\n1,1,Success,Success."
-                            ",NULL\r\n");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                    sprintf(wrkbuf,
-#if WIN32
-                            "1,2,Info,%zd events requested of %d available "
-                            "(unfiltered) %zu will be retrieved,NULL\r\n",
-#else
-                            "1,2,Info,%zd events requested of %lu available "
-                            "(unfiltered) %lu will be retrieved,NULL\r\n",
-#endif
-                            count,
-                            (unsigned long)cntAvailable,
-                            (unsigned long)std::min(count, cntAvailable));
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                    sprintf(wrkbuf,
-                            "1,4,Count,%zu,NULL\r\n",
-                            std::min(count, cntAvailable));
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                    for (unsigned int i = 0; i < std::min(count, cntAvailable);
-                         i++) {
-
-                        vscpEvent* pEvent;
-
-                        pthread_mutex_lock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-                        pEvent =
-                          pSession->m_pClientItem->m_clientInputQueue.front();
-                        pSession->m_pClientItem->m_clientInputQueue.pop_front();
-                        pthread_mutex_unlock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-
-                        if (NULL != pEvent) {
-
-                            if (vscp_doLevel2Filter(
-                                  pEvent,
-                                  &pSession->m_pClientItem->m_filter)) {
-
-                                std::string str;
-                                if (vscp_convertEventToString(str, pEvent)) {
-
-                                    // Write it out
-                                    memset((char*)wrkbuf, 0, sizeof(wrkbuf));
-                                    strcpy((char*)wrkbuf,
-                                           (const char*)"1,3,Data,Event,");
-                                    strcat((char*)wrkbuf,
-                                           (const char*)str.c_str());
-                                    strcat((char*)wrkbuf, "\r\n");
-                                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                                } else {
-                                    strcpy((char*)wrkbuf,
-                                           "1,2,Info,Malformed event (internal "
-                                           "error)\r\n");
-                                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                                }
-                            } else {
-                                strcpy((char*)wrkbuf,
-                                       "1,2,Info,Event filtered out\r\n");
-                                mg_write(conn, wrkbuf, strlen(wrkbuf));
-                            }
-
-                            // Remove the event
-                            vscp_deleteEvent(pEvent);
-
-                        } // Valid pEvent pointer
-                        else {
-                            strcpy((char*)wrkbuf,
-                                   "1,2,Info,Event could not be fetched "
-                                   "(internal error)\r\n");
-                            mg_write(conn, wrkbuf, strlen(wrkbuf));
-                        }
-                    }    // for
-                } else { // no events available
-                    sprintf(wrkbuf, REST_CSV_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
+            if (vscp_doLevel2Filter(pSharedEvent->getEvent(),
+                                    &pClientItem->m_filter)) {
+
+                const std::string* pstr = pSharedEvent->getString();
+                if (NULL != pstr) {
+                    out.write(pData);
+                    out.write(*pstr);
+                    out.write("\r\n", 2);
+                } else {
+                    out.write(pPrefix);
+                    out.write("Malformed event (internal error)\r\n");
                 }
 
+            } else {
+                out.write(pPrefix);
+                out.write("Event filtered out\r\n");
             }
 
-            // XML
-            else if (REST_FORMAT_XML == format) {
-
-                int filtered = 0;
-                int errors   = 0;
-
-                // Send header
-                websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
-
-                if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
-
-                    sprintf(wrkbuf,
-                            XML_HEADER "<vscp-rest success = \"true\" "
-                                       "code = \"1\" message = \"Success\" "
-                                       "description = \"Success.\" >");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                    sprintf(wrkbuf,
-                            "<info>%zd events requested of %lu available "
-                            "(unfiltered) %zu will be retrieved</info>",
-                            count,
-                            cntAvailable,
-                            std::min(count, cntAvailable));
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                    sprintf(wrkbuf,
-                            "<count>%zu</count>",
-                            std::min(count, cntAvailable));
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                    for (unsigned int i = 0;
-                         i < std::min((unsigned long)count, cntAvailable);
-                         i++) {
-
-                        vscpEvent* pEvent;
-
-                        pthread_mutex_lock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-                        pEvent =
-                          pSession->m_pClientItem->m_clientInputQueue.front();
-                        pSession->m_pClientItem->m_clientInputQueue.pop_front();
-                        pthread_mutex_unlock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-
-                        if (NULL != pEvent) {
-
-                            if (vscp_doLevel2Filter(
-                                  pEvent,
-                                  &pSession->m_pClientItem->m_filter)) {
-
-                                std::string str;
-
-                                // Write it out
-                                strcpy((char*)wrkbuf, (const char*)"<event>");
-
-                                // head
-                                strcat((char*)wrkbuf, (const char*)"<head>");
-                                strcat((char*)wrkbuf,
-                                       vscp_str_format(("%d"), pEvent->head)
-                                         .c_str());
-                                strcat((char*)wrkbuf, (const char*)"</head>");
-
-                                // class
-                                strcat((char*)wrkbuf,
-                                       (const char*)"<vscpclass>");
-                                strcat(
-                                  (char*)wrkbuf,
-                                  vscp_str_format(("%d"), pEvent->vscp_class)
-                                    .c_str());
-                                strcat((char*)wrkbuf,
-                                       (const char*)"</vscpclass>");
-
-                                // type
-                                strcat((char*)wrkbuf,
-                                       (const char*)"<vscptype>");
-                                strcat(
-                                  (char*)wrkbuf,
-                                  vscp_str_format(("%d"), pEvent->vscp_type)
-                                    .c_str());
-                                strcat((char*)wrkbuf,
-                                       (const char*)"</vscptype>");
-
-                                // obid
-                                strcat((char*)wrkbuf, (const char*)"<obid>");
-                                strcat((char*)wrkbuf,
-                                       vscp_str_format(("%lu"), pEvent->obid)
-                                         .c_str());
-                                strcat((char*)wrkbuf, (const char*)"</obid>");
-
-                                // datetime
-                                strcat((char*)wrkbuf,
-                                       (const char*)"<datetime>");
-                                std::string dt;
-                                vscp_getDateStringFromEvent(dt, pEvent);
-                                strcat(
-                                  (char*)wrkbuf,
-                                  vscp_str_format("%s", dt.c_str()).c_str());
-                                strcat((char*)wrkbuf,
-                                       (const char*)"</datetime>");
-
-                                // timestamp
-                                strcat((char*)wrkbuf,
-                                       (const char*)"<timestamp>");
-                                strcat(
-                                  (char*)wrkbuf,
-                                  vscp_str_format(("%lu"), pEvent->timestamp)
-                                    .c_str());
-                                strcat((char*)wrkbuf,
-                                       (const char*)"</timestamp>");
-
-                                // guid
-                                strcat((char*)wrkbuf, (const char*)"<guid>");
-                                vscp_writeGuidToString(str, pEvent);
-                                strcat((char*)wrkbuf, (const char*)str.c_str());
-                                strcat((char*)wrkbuf, (const char*)"</guid>");
-
-                                // sizedate
-                                strcat((char*)wrkbuf,
-                                       (const char*)"<sizedata>");
-                                strcat((char*)wrkbuf,
-                                       vscp_str_format(("%d"), pEvent->sizeData)
-                                         .c_str());
-                                strcat((char*)wrkbuf,
-                                       (const char*)"</sizedata>");
-
-                                // data
-                                strcat((char*)wrkbuf, (const char*)"<data>");
-                                vscp_writeDataToString(str, pEvent);
-                                strcat((char*)wrkbuf, (const char*)str.c_str());
-                                strcat((char*)wrkbuf, (const char*)"</data>");
-
-                                if (vscp_convertEventToString(str, pEvent)) {
-                                    strcat((char*)wrkbuf, (const char*)"<raw>");
-                                    strcat((char*)wrkbuf,
-                                           (const char*)str.c_str());
-                                    strcat((char*)wrkbuf,
-                                           (const char*)"</raw>");
-                                }
-
-                                strcat((char*)wrkbuf, "</event>");
-                                mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                            } else {
-                                filtered++;
-                            }
-
-                            // Remove the event
-                            vscp_deleteEvent(pEvent);
-
-                        } // Valid pEvent pointer
-                        else {
-                            errors++;
-                        }
-                    } // for
-
-                    strcpy((char*)wrkbuf, (const char*)"<filtered>");
-                    strcat((char*)wrkbuf,
-                           vscp_str_format(("%d"), filtered).c_str());
-                    strcat((char*)wrkbuf, (const char*)"</filtered>");
-
-                    strcat((char*)wrkbuf, (const char*)"<errors>");
-                    strcat((char*)wrkbuf,
-                           vscp_str_format(("%d"), errors).c_str());
-                    strcat((char*)wrkbuf, (const char*)"</errors>");
-
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                    // End tag
-                    strcpy((char*)wrkbuf, "</vscp-rest>");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-                } else { // no events available
-
-                    sprintf(wrkbuf, REST_XML_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
+            // Remove the event
+            pSharedEvent->release();
+        }
+
+    }
+
+    // XML
+    else if (REST_FORMAT_XML == format) {
+
+        int filtered = 0;
+        int errors   = 0;
+
+        out.write(XML_HEADER "<vscp-rest success = \"true\" "
+                             "code = \"1\" message = \"Success\" "
+                             "description = \"Success.\" >");
+        out.printf("<info>%zu events requested of %zu available "
+                   "(unfiltered) %zu will be retrieved</info>",
+                   count,
+                   cntAvailable,
+                   cnt);
+        out.printf("<count>%zu</count>", cnt);
+
+        for (size_t i = 0; i < cnt; i++) {
+
+            CSharedEvent* pSharedEvent = events[i];
+
+            if (NULL == pSharedEvent) {
+                errors++;
+                continue;
+            }
+
+            if (vscp_doLevel2Filter(pSharedEvent->getEvent(),
+                                    &pClientItem->m_filter)) {
+
+                // The event element is rendered once for all sessions
+                // that receive it
+                const std::string* pstr =
+                  pSharedEvent->getRendering(SHAREDEVENT_RENDER_REST_XML,
+                                             restsrv_convertEventToXML);
+                if (NULL != pstr) {
+                    out.write(*pstr);
+                } else {
+                    errors++;
                 }
 
+            } else {
+                filtered++;
             }
 
-            // JSON / JSONP
-            else if ((REST_FORMAT_JSON == format) ||
-                     (REST_FORMAT_JSONP == format)) {
+            // Remove the event
+            pSharedEvent->release();
+        }
+
+        out.printf("<filtered>%d</filtered><errors>%d</errors></vscp-rest>",
+                   filtered,
+                   errors);
+    }
+
+    // JSON / JSONP
+    else {
+
+        int filtered = 0;
+        int errors   = 0;
+        std::vector<const std::string*> rendered;
+        rendered.reserve(cnt);
+
+        for (size_t i = 0; i < cnt; i++) {
 
-                int sentEvents = 0;
-                int filtered   = 0;
-                int errors     = 0;
-                json output;
+            CSharedEvent* pSharedEvent = events[i];
 
-                // Send header
-                if (REST_FORMAT_JSONP == format) {
-                    websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
+            if (NULL == pSharedEvent) {
+                errors++;
+                continue;
+            }
+
+            if (vscp_doLevel2Filter(pSharedEvent->getEvent(),
+                                    &pClientItem->m_filter)) {
+
+                // The event object is rendered once for all sessions
+                // that receive it. It lives as long as the event.
+                const std::string* pstr =
+                  pSharedEvent->getRendering(SHAREDEVENT_RENDER_REST_JSON,
+                                             restsrv_convertEventToJSON);
+                if (NULL != pstr) {
+                    rendered.push_back(pstr);
                 } else {
-                    websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
+                    errors++;
                 }
 
-                if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
+            } else {
+                filtered++;
+            }
+        }
 
-                    // typeof handler === 'function' &&
-                    if (REST_FORMAT_JSONP == format) {
-                        std::string str =
-                          ("typeof handler === 'function' && handler(");
-                        mg_write(conn, (const char*)str.c_str(), str.length());
-                    }
+        std::string strInfo =
+          vscp_str_format("%zu events requested of %zu available "
+                          "(unfiltered) %zu will be retrieved",
+                          count,
+                          cntAvailable,
+                          cnt);
 
-                    output["success"]     = true;
-                    output["code"]        = 1;
-                    output["message"]     = "success";
-                    output["description"] = "Success";
-                    output["info"]        = (const char*)vscp_str_format(
-                                       "%zd events requested of %lu available "
-                                       "(unfiltered) %zd will be retrieved",
-                                       count,
-                                       cntAvailable,
-                                       std::min(count, cntAvailable))
-                                       .c_str();
-
-                    for (unsigned int i = 0; i < std::min(count, cntAvailable);
-                         i++) {
-
-                        vscpEvent* pEvent;
-
-                        pthread_mutex_lock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-                        pEvent =
-                          pSession->m_pClientItem->m_clientInputQueue.front();
-                        pSession->m_pClientItem->m_clientInputQueue.pop_front();
-                        pthread_mutex_unlock(
-                          &pSession->m_pClientItem->m_mutexClientInputQueue);
-
-                        if (NULL != pEvent) {
-
-                            if (vscp_doLevel2Filter(
-                                  pEvent,
-                                  &pSession->m_pClientItem->m_filter)) {
-
-                                std::string str;
-                                json ev;
-                                ev["head"]      = pEvent->head;
-                                ev["vscpclass"] = pEvent->vscp_class;
-                                ev["vscptype"]  = pEvent->vscp_type;
-                                vscp_getDateStringFromEvent(str, pEvent);
-                                ev["datetime"]  = (const char*)str.c_str();
-                                ev["timestamp"] = pEvent->timestamp;
-                                ev["obid"]      = pEvent->obid;
-                                vscp_writeGuidToString(str, pEvent);
-                                ev["guid"]     = (const char*)str.c_str();
-                                ev["sizedata"] = pEvent->sizeData;
-                                ev["data"]     = json::array();
-                                for (uint16_t j = 0; j < pEvent->sizeData;
-                                     j++) {
-                                    ev["data"].push_back(pEvent->pdata[j]);
-                                }
-
-                                // Add event to event array
-                                output["event"].push_back(ev);
-
-                                sentEvents++;
-
-                            } else {
-                                filtered++;
-                            }
-
-                            // Remove the event
-                            vscp_deleteEvent(pEvent);
-
-                        } // Valid pEvent pointer
-                        else {
-                            errors++;
-                        }
-
-                    } // for
-
-                    // Mark end
-                    output["count"]    = sentEvents;
-                    output["filtered"] = filtered;
-                    output["errors"]   = errors;
-
-                    std::string s = output.dump();
-                    mg_write(conn, s.c_str(), s.length());
-
-                    if (REST_FORMAT_JSONP == format) {
-                        mg_write(conn, ");", 2);
-                    }
+        // typeof handler === 'function' &&
+        if (REST_FORMAT_JSONP == format) {
+            out.write(REST_JSONP_START);
+        }
 
-                }      // if open and data
-                else { // no events available
+        // The reply is put together around the rendered events with the
+        // keys in the same (sorted) order as json::dump() use
+        out.printf("{\"code\":1,\"count\":%d,"
+                   "\"description\":\"Success\","
+                   "\"errors\":%d,",
+                   (int)rendered.size(),
+                   errors);
+        if (rendered.size()) {
+            out.write("\"event\":[");
+            for (size_t i = 0; i < rendered.size(); i++) {
+                if (i) {
+                    out.write(",", 1);
+                }
+                out.write(*rendered[i]);
+            }
+            out.write("],");
+        }
+        out.printf("\"filtered\":%d,\"info\":", filtered);
+        out.write(json(strInfo).dump());
+        out.write(",\"message\":\"success\",\"success\":true}");
 
-                    if (REST_FORMAT_JSON == format) {
-                        sprintf(wrkbuf,
-                                REST_JSON_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-                    } else {
-                        sprintf(wrkbuf,
-                                REST_JSONP_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-                    }
+        if (REST_FORMAT_JSONP == format) {
+            out.write(REST_JSONP_END);
+        }
 
-                    mg_write(conn, wrkbuf, strlen(wrkbuf));
-                }
+        // Remove the events
+        for (size_t i = 0; i < cnt; i++) {
+            if (NULL != events[i]) {
+                events[i]->release();
+            }
+        }
+    }
 
-            } // format
+    out.flush();
+    mg_write(conn, "", 0);
+}
 
-            mg_write(conn, "", 0);
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_park
+//
+// Requests that wait for events (long poll and streams) each hold a web
+// server thread. At most half of the threads are allowed to wait so
+// there always are threads left for other requests.
+//
 
-        } else { // Queue is empty
-            restsrv_error(conn,
-                          pSession,
-                          format,
-                          RESR_ERROR_CODE_INPUT_QUEUE_EMPTY);
+static std::atomic<int> restsrv_nParked(0);
+
+static bool
+restsrv_park(void)
+{
+    int max = std::max(1, gpobj->m_web_num_threads / 2);
+    if (restsrv_nParked.fetch_add(1) >= max) {
+        restsrv_nParked--;
+        return false;
+    }
+
+    return true;
+}
+
+static void
+restsrv_unpark(void)
+{
+    restsrv_nParked--;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_waitForEvents
+//
+// Wait (long poll) until there are events in the input queue of the
+// session, the channel is closed or wait milliseconds has passed.
+//
+
+void
+restsrv_waitForEvents(struct restsrv_session* pSession, long wait)
+{
+    if ((NULL == pSession) || (wait <= 0)) {
+        return;
+    }
+
+    CClientItem* pClientItem = pSession->m_pClientItem;
+    if (!pClientItem->m_clientInputQueue.empty()) {
+        return;
+    }
+
+    // Answer right away if too many requests already wait
+    if (!restsrv_park()) {
+        syslog(LOG_DEBUG, "REST: Too many waiting requests, no wait.");
+        return;
+    }
+
+    uint32_t start = vscp_getMsTimeStamp();
+    while (!gpobj->m_bQuit && pClientItem->m_bOpen) {
+
+        long elapsed = (long)(vscp_getMsTimeStamp() - start);
+        if (elapsed >= wait) {
+            break;
         }
 
+        if (pClientItem->m_clientInputQueue.wait(
+              (int)std::min(wait - elapsed, (long)REST_WAIT_SLICE))) {
+            break;
+        }
+    }
+
+    restsrv_unpark();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_streamEvent
+//
+// Add an event to the chunk that is sent to a stream.
+//
+
+static bool
+restsrv_streamEvent(std::string& strChunk,
+                    CSharedEvent* pSharedEvent,
+                    int format,
+                    int stream)
+{
+    const std::string* pstr;
+
+    // All renderings are shared with other receivers of the event
+    if (REST_FORMAT_XML == format) {
+        pstr = pSharedEvent->getRendering(SHAREDEVENT_RENDER_REST_XML,
+                                          restsrv_convertEventToXML);
+    } else if (REST_FORMAT_JSON == format) {
+        pstr = pSharedEvent->getRendering(SHAREDEVENT_RENDER_REST_JSON,
+                                          restsrv_convertEventToJSON);
     } else {
+        pstr = pSharedEvent->getString();
+    }
+
+    if (NULL == pstr) {
+        return false;
+    }
+
+    if (REST_STREAM_SSE == stream) {
+        strChunk += "data: ";
+        strChunk += *pstr;
+        strChunk += "\n\n";
+    } else if (REST_FORMAT_PLAIN == format) {
+        strChunk += "- ";
+        strChunk += *pstr;
+        strChunk += "\r\n";
+    } else if (REST_FORMAT_CSV == format) {
+        strChunk += "1,3,Data,Event,";
+        strChunk += *pstr;
+        strChunk += "\r\n";
+    } else {
+        strChunk += *pstr;
+        strChunk += "\r\n";
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_doStreamEvents
+//
+// Keep the response open and send events as they arrive with chunked
+// transfer encoding. With chunked streams the events are sent as in
+// readevent, plain and CSV one event per line, XML as event elements in
+// one vscp-rest element and JSON as one event object per line. With
+// Server-Sent Events each event is sent as a "data:" line.
+//
+// The stream ends after count events (zero for no limit), after
+// duration milliseconds (zero for no limit), when the channel is closed
+// or when the client goes away. An idle stream writes an empty line
+// (a comment for SSE) every REST_STREAM_KEEPALIVE seconds.
+//
+// The stream holds a pin on its session for as long as it runs so the
+// session is never expired under it however long it streams.
+//
+
+void
+restsrv_doStreamEvents(struct mg_connection* conn,
+                       struct restsrv_session* pSession,
+                       int format,
+                       int stream,
+                       size_t count,
+                       long duration)
+{
+    char date[64];
+    time_t curtime = time(NULL);
+    const char* pmime;
+    std::string strChunk;
+
+    // Check pointer
+    if (NULL == conn) {
+        return;
+    }
+
+    if (NULL == pSession) {
         restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
+        return;
     }
 
-    return;
+    // A stream can not be wrapped in a JSONP handler call
+    if (REST_FORMAT_JSONP == format) {
+        restsrv_error(conn,
+                      pSession,
+                      format,
+                      REST_ERROR_CODE_UNSUPPORTED_FORMAT);
+        return;
+    }
+
+    CClientItem* pClientItem = pSession->m_pClientItem;
+    if (!pClientItem->m_bOpen) {
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
+        return;
+    }
+
+    if (!restsrv_park()) {
+        syslog(LOG_ERR, "REST: Too many waiting requests, stream refused.");
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_NO_ROOM);
+        return;
+    }
+
+    // Keep the session while streaming
+    if (NULL == gpobj->m_rest_sessions.find(pSession->m_sid)) {
+        restsrv_unpark();
+        restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
+        return;
+    }
+
+    if (REST_STREAM_SSE == stream) {
+        pmime = REST_MIME_TYPE_SSE;
+    } else if (REST_FORMAT_XML == format) {
+        pmime = REST_MIME_TYPE_XML;
+    } else if (REST_FORMAT_JSON == format) {
+        pmime = REST_MIME_TYPE_JSON;
+    } else {
+        pmime = REST_MIME_TYPE_PLAIN;
+    }
+
+    vscp_getTimeString(date, sizeof(date), &curtime);
+    mg_printf(conn,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: %s\r\n"
+              "Date: %s\r\n"
+              "Transfer-Encoding: chunked\r\n"
+              "Cache-Control: no-cache\r\n"
+              "Cache-Control: no-store\r\n"
+              "Cache-Control: must-revalidate\r\n\r\n",
+              pmime,
+              date);
+
+    if (REST_STREAM_SSE == stream) {
+        ; // Events only
+    } else if (REST_FORMAT_PLAIN == format) {
+        strChunk = "1 1 Success \r\n";
+    } else if (REST_FORMAT_CSV == format) {
+        strChunk = "success-code,error-code,message,description,Event\r\n"
+                   "1,1,Success,Success.,NULL\r\n";
+    } else if (REST_FORMAT_XML == format) {
+        strChunk = XML_HEADER "<vscp-rest success = \"true\" code = \"1\" "
+                              "message = \"Success\" "
+                              "description = \"Success.\" >\r\n";
+    }
+
+    size_t sent     = 0;
+    bool bConnected = true;
+    uint32_t start  = vscp_getMsTimeStamp();
+    uint32_t lastTx = start;
+    CSharedEvent* batch[REST_STREAM_BATCH];
+
+    while (!gpobj->m_bQuit && pClientItem->m_bOpen) {
+
+        long elapsed = (long)(vscp_getMsTimeStamp() - start);
+        if ((duration > 0) && (elapsed >= duration)) {
+            break;
+        }
+
+        // Take what is in the queue, a batch at a time
+        size_t cnt = 0;
+        pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+        while ((cnt < REST_STREAM_BATCH) &&
+               ((0 == count) || ((sent + cnt) < count))) {
+            CSharedEvent* pSharedEvent = pClientItem->m_clientInputQueue.pop();
+            if (NULL == pSharedEvent) {
+                break;
+            }
+            batch[cnt++] = pSharedEvent;
+        }
+        pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+
+        for (size_t i = 0; i < cnt; i++) {
+            if (vscp_doLevel2Filter(batch[i]->getEvent(),
+                                    &pClientItem->m_filter) &&
+                restsrv_streamEvent(strChunk, batch[i], format, stream)) {
+                sent++;
+            }
+            batch[i]->release();
+        }
+
+        // Everything that is ready goes out in one chunk
+        if (strChunk.length()) {
+            if (mg_send_chunk(conn,
+                              strChunk.c_str(),
+                              (unsigned int)strChunk.length()) < 0) {
+                bConnected = false;
+                break;
+            }
+            strChunk.clear();
+            lastTx                     = vscp_getMsTimeStamp();
+            pSession->m_lastActiveTime = time(NULL);
+        }
+
+        if ((count > 0) && (sent >= count)) {
+            break;
+        }
+
+        if (cnt) {
+            continue;
+        }
+
+        // Keep alive
+        if ((vscp_getMsTimeStamp() - lastTx) >= REST_STREAM_KEEPALIVE * 1000) {
+
+            const char* pkeepalive =
+              (REST_STREAM_SSE == stream) ? ":\n\n" : "\r\n";
+            if (mg_send_chunk(conn, pkeepalive, strlen(pkeepalive)) < 0) {
+                bConnected = false;
+                break;
+            }
+            lastTx                     = vscp_getMsTimeStamp();
+            pSession->m_lastActiveTime = time(NULL);
+        }
+
+        // Wait for events
+        long wait = REST_WAIT_SLICE;
+        if (duration > 0) {
+            wait = std::min(wait, duration - elapsed);
+        }
+        pClientItem->m_clientInputQueue.wait((int)wait);
+    }
+
+    if (bConnected) {
+        if ((REST_STREAM_SSE != stream) && (REST_FORMAT_XML == format)) {
+            mg_send_chunk(conn, "</vscp-rest>", 12);
+        }
+        mg_send_chunk(conn, "", 0); // Last chunk
+    }
+
+    restsrv_release_session(pSession);
+    restsrv_unpark();
+
+    if (__VSCP_DEBUG_REST) {
+        syslog(LOG_DEBUG, "REST: Stream ended, %zu events sent.", sent);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2250,11 +2573,8 @@ restsrv_doSetFilter(struct mg_connection* conn,
 {
     if (NULL != pSession) {
 
-        pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-        memcpy(&pSession->m_pClientItem->m_filter,
-               &vscpfilter,
-               sizeof(vscpEventFilter));
-        pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+        gpobj->m_clientList.setClientFilter(pSession->m_pClientItem,
+                                            &vscpfilter);
         restsrv_error(conn, pSession, format, REST_ERROR_CODE_SUCCESS);
     } else {
         restsrv_error(conn, pSession, format, REST_ERROR_CODE_INVALID_SESSION);
@@ -2278,15 +2598,7 @@ restsrv_doClearQueue(struct mg_connection* conn,
 
     if (NULL != pSession) {
 
-        std::deque<vscpEvent*>::iterator it;
-
         pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-        for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
-             it != pSession->m_pClientItem->m_clientInputQueue.end();
-             ++it) {
-            vscpEvent* pEvent = *it;
-            vscp_deleteEvent_v2(&pEvent);
-        }
         pSession->m_pClientItem->m_clientInputQueue.clear();
         pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
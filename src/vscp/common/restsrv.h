@@ -53,6 +53,31 @@ struct restsrv_session
     char m_remote_addr[48];
 };
 
+// Max time (milliseconds) a read event can wait for events (wait=ms)
+#define REST_MAX_WAIT_TIME 60000
+
+// A waiting read or a stream checks that it should go on at least this
+// often (milliseconds)
+#define REST_WAIT_SLICE 200
+
+// An idle stream writes a keep alive this often (seconds) which also
+// detects clients that have gone away
+#define REST_STREAM_KEEPALIVE 15
+
+// Max number of events a stream takes out of the queue at a time
+#define REST_STREAM_BATCH 64
+
+// Event streams (stream=chunked/sse)
+enum
+{
+    REST_STREAM_NONE = 0,
+    REST_STREAM_CHUNKED, // Chunked transfer, one event per line/element
+    REST_STREAM_SSE      // Server-Sent Events (text/event-stream)
+};
+
+// Max size (bytes) of the body of a POST request
+#define REST_MAX_BODY_SIZE (64 * 1024 * 1024)
+
 // Encapsulate a JSON block to make it JSONP
 #define REST_JSONP_START "typeof handler === 'function' && handler("
 #define REST_JSONP_END   ");"
@@ -77,7 +102,8 @@ enum
     REST_ERROR_CODE_INVALID_ORIGIN,
     REST_ERROR_CODE_INVALID_PASSWORD,
     REST_ERROR_CODE_MEMORY,
-    REST_ERROR_CODE_VARIABLE_NOT_DELETED
+    REST_ERROR_CODE_VARIABLE_NOT_DELETED,
+    REST_ERROR_CODE_RATE_LIMITED
 };
 
 // REST formats
@@ -91,6 +117,44 @@ enum
     REST_FORMAT_COUNT
 };
 
+// Request parameters (index in restsrv_paramNames)
+enum
+{
+    REST_PARAM_OP = 0,
+    REST_PARAM_FORMAT,
+    REST_PARAM_VSCPUSER,
+    REST_PARAM_VSCPSECRET,
+    REST_PARAM_VSCPSESSION,
+    REST_PARAM_VSCPEVENT,
+    REST_PARAM_COUNT,
+    REST_PARAM_WAIT,
+    REST_PARAM_STREAM,
+    REST_PARAM_VSCPFILTER,
+    REST_PARAM_VSCPMASK,
+    REST_PARAM_VARIABLE,
+    REST_PARAM_VALUE,
+    REST_PARAM_TYPE,
+    REST_PARAM_PERSISTENT,
+    REST_PARAM_ACCESSRIGHT,
+    REST_PARAM_NOTE,
+    REST_PARAM_LISTLONG,
+    REST_PARAM_REGEX,
+    REST_PARAM_UNIT,
+    REST_PARAM_SENSORINDEX,
+    REST_PARAM_LEVEL,
+    REST_PARAM_ZONE,
+    REST_PARAM_SUBZONE,
+    REST_PARAM_GUID,
+    REST_PARAM_NAME,
+    REST_PARAM_FROM,
+    REST_PARAM_TO,
+    REST_PARAM_URL,
+    REST_PARAM_EVENTFORMAT,
+    REST_PARAM_DATETIME,
+    REST_PARAM_VSCPEVENTS,
+    REST_PARAMS // Number of parameters
+};
+
 enum
 {
     REST_SUCCESS_CODE_SUCCESS = 1, // All is OK                message="success"
@@ -104,6 +168,8 @@ enum
 #define REST_MIME_TYPE_XML   "application/xml"
 #define REST_MIME_TYPE_JSON  "application/json"
 #define REST_MIME_TYPE_JSONP "application/javascript"
+#define REST_MIME_TYPE_SSE   "text/event-stream"
+#define REST_MIME_TYPE_NDJSON "application/x-ndjson"
 
 // Clear text Error messages
 #define REST_PLAIN_ERROR_SUCCESS "1 1 Success \r\n\r\nEverything is fine.\r\n"
@@ -154,6 +220,10 @@ enum
     "0 -17 Memory error \r\n\r\nOut of memory or other memory error.\r\n"
 #define REST_PLAIN_ERROR_VARIABLE_NOT_DELETE                                   \
     "0 -18 Variable delete error \r\n\r\nVariable could not be deleted.\r\n"
+#define REST_PLAIN_ERROR_RATE_LIMITED                                          \
+    "0 -19 Rate limited \r\n\r\nRate limit exceeded, try again later.\r\n"
+#define REST_PLAIN_ERROR_TOO_LARGE                                             \
+    "0 -20 Too large \r\n\r\nThe request body is too large.\r\n"
 
 #define REST_CSV_ERROR_SUCCESS                                                 \
     "success-code,error-code,message,description\r\n1,1,Success, Success."
@@ -213,6 +283,9 @@ enum
 #define REST_CSV_ERROR_VARIABLE_NOT_DELETE                                     \
     "success-code,error-code,message,description\r\n0,-18,Variable delete "    \
     "error, Variable could not be deleted."
+#define REST_CSV_ERROR_RATE_LIMITED                                            \
+    "success-code,error-code,message,description\r\n0,-19,Rate limited, "      \
+    "Rate limit exceeded, try again later."
 
 #define XML_HEADER "<?xml version = \"1.0\" encoding = \"UTF-8\" ?>"
 #define REST_XML_ERROR_SUCCESS                                                 \
@@ -279,6 +352,9 @@ enum
 #define REST_XML_ERROR_VARIABLE_NOT_DELETE                                     \
     "<vscp-rest success = \"false\" code = \"-18\" message = \"Variable "      \
     "delete error\" description = \"Variable could not be deleted.\" />"
+#define REST_XML_ERROR_RATE_LIMITED                                            \
+    "<vscp-rest success = \"false\" code = \"-19\" message = \"Rate "         \
+    "limited\" description = \"Rate limit exceeded, try again later.\" />"
 
 #define REST_JSON_ERROR_SUCCESS                                                \
     "{\"success\":true,\"code\":1,\"message\":\"success\",\"description\":"    \
@@ -345,6 +421,9 @@ enum
     "{\"success\":false,\"code\":-18,\"message\":\"Variable delete "           \
     "error\",\"description\":\"Variable delete error\" description = "         \
     "\"Variable could not be deleted.\"}"
+#define REST_JSON_ERROR_RATE_LIMITED                                           \
+    "{\"success\":false,\"code\":-19,\"message\":\"Rate "                     \
+    "limited\",\"description\":\"Rate limit exceeded, try again later.\"}"
 
 #define REST_JSONP_ERROR_SUCCESS                                               \
     "typeof handler === 'function' && handler(" REST_JSON_ERROR_SUCCESS ");"
@@ -399,8 +478,18 @@ enum
 #define REST_JSONP_ERROR_VARIABLE_NOT_DELETE                                   \
     "typeof handler === 'function' && "                                        \
     "handler(" REST_JSON_ERROR_VARIABLE_NOT_DELETE ");"
+#define REST_JSONP_ERROR_RATE_LIMITED                                          \
+    "typeof handler === 'function' && "                                        \
+    "handler(" REST_JSON_ERROR_RATE_LIMITED ");"
 
 int
 websrv_restapi(struct mg_connection* conn, void* cbdata);
 
+/*!
+    Remove REST sessions that has been idle for too long and the
+    clients they own. Called once a second from the main loop.
+*/
+void
+restsrv_expire_sessions(void);
+
 #endif // REST_H__INCLUDED_
\ No newline at end of file
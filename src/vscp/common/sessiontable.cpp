@@ -0,0 +1,395 @@
+// sessiontable.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <time.h>
+
+#include <functional>
+
+#include "sessiontable.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CSessionTable::CSessionTable(uint32_t timeout)
+  : m_timeout(timeout)
+  , m_gen(0)
+{
+    for (int i = 0; i < SESSIONTABLE_SHARDS; i++) {
+        pthread_mutex_init(&m_mutexShard[i], NULL);
+    }
+    pthread_mutex_init(&m_mutexWheel, NULL);
+    m_tick = now();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CSessionTable::~CSessionTable()
+{
+    for (int i = 0; i < SESSIONTABLE_SHARDS; i++) {
+        pthread_mutex_destroy(&m_mutexShard[i]);
+    }
+    pthread_mutex_destroy(&m_mutexWheel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// now
+//
+
+uint64_t
+CSessionTable::now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setTimeout
+//
+
+void
+CSessionTable::setTimeout(uint32_t timeout)
+{
+    m_timeout = timeout;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getShard
+//
+
+uint32_t
+CSessionTable::getShard(const std::string& sid)
+{
+    return std::hash<std::string>()(sid) % SESSIONTABLE_SHARDS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+bool
+CSessionTable::add(const char* sid, void* pSession, bool bPin)
+{
+    if ((NULL == sid) || (NULL == pSession)) {
+        return false;
+    }
+
+    timer t;
+    t.m_sid    = sid;
+    t.m_gen    = m_gen.fetch_add(1, std::memory_order_relaxed);
+    t.m_expire = now() + m_timeout;
+
+    entry e;
+    e.m_pSession   = pSession;
+    e.m_lastActive = t.m_expire - m_timeout;
+    e.m_gen        = t.m_gen;
+    e.m_nPin       = bPin ? 1 : 0;
+
+    uint32_t shard = getShard(t.m_sid);
+    pthread_mutex_lock(&m_mutexShard[shard]);
+    bool rv = m_shard[shard].insert(shard_map::value_type(t.m_sid, e)).second;
+    pthread_mutex_unlock(&m_mutexShard[shard]);
+
+    if (!rv) {
+        return false;
+    }
+
+    pthread_mutex_lock(&m_mutexWheel);
+    schedule(t);
+    pthread_mutex_unlock(&m_mutexWheel);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// find
+//
+
+void*
+CSessionTable::find(const char* sid)
+{
+    void* pSession = NULL;
+
+    if (NULL == sid) {
+        return NULL;
+    }
+
+    std::string strsid(sid);
+    uint32_t shard = getShard(strsid);
+    pthread_mutex_lock(&m_mutexShard[shard]);
+    shard_map::iterator it = m_shard[shard].find(strsid);
+    if (it != m_shard[shard].end()) {
+        it->second.m_lastActive = now();
+        it->second.m_nPin++;
+        pSession = it->second.m_pSession;
+    }
+    pthread_mutex_unlock(&m_mutexShard[shard]);
+
+    return pSession;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// release
+//
+
+bool
+CSessionTable::release(const char* sid)
+{
+    bool rv = false;
+
+    if (NULL == sid) {
+        return false;
+    }
+
+    std::string strsid(sid);
+    uint32_t shard = getShard(strsid);
+    pthread_mutex_lock(&m_mutexShard[shard]);
+    shard_map::iterator it = m_shard[shard].find(strsid);
+    if (it != m_shard[shard].end()) {
+        it->second.m_lastActive = now();
+        if (it->second.m_nPin) {
+            it->second.m_nPin--;
+        }
+        rv = true;
+    }
+    pthread_mutex_unlock(&m_mutexShard[shard]);
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// touch
+//
+
+bool
+CSessionTable::touch(const char* sid)
+{
+    bool rv = false;
+
+    if (NULL == sid) {
+        return false;
+    }
+
+    std::string strsid(sid);
+    uint32_t shard = getShard(strsid);
+    pthread_mutex_lock(&m_mutexShard[shard]);
+    shard_map::iterator it = m_shard[shard].find(strsid);
+    if (it != m_shard[shard].end()) {
+        it->second.m_lastActive = now();
+        rv                      = true;
+    }
+    pthread_mutex_unlock(&m_mutexShard[shard]);
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// remove
+//
+// The timer of the session is left in the wheel and dropped when it
+// fires and the session is not found.
+//
+
+void*
+CSessionTable::remove(const char* sid)
+{
+    void* pSession = NULL;
+
+    if (NULL == sid) {
+        return NULL;
+    }
+
+    std::string strsid(sid);
+    uint32_t shard = getShard(strsid);
+    pthread_mutex_lock(&m_mutexShard[shard]);
+    shard_map::iterator it = m_shard[shard].find(strsid);
+    if (it != m_shard[shard].end()) {
+        pSession = it->second.m_pSession;
+        m_shard[shard].erase(it);
+    }
+    pthread_mutex_unlock(&m_mutexShard[shard]);
+
+    return pSession;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// size
+//
+
+size_t
+CSessionTable::size(void)
+{
+    size_t cnt = 0;
+
+    for (int i = 0; i < SESSIONTABLE_SHARDS; i++) {
+        pthread_mutex_lock(&m_mutexShard[i]);
+        cnt += m_shard[i].size();
+        pthread_mutex_unlock(&m_mutexShard[i]);
+    }
+
+    return cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// schedule
+//
+// A timer goes on the lowest level where its expiry tick is less than
+// a full turn of the level away. It is moved down a level each time the
+// level above turns to its slot. Timers further away than the wheel
+// covers are put in the last slot they can reach and are scheduled
+// again when they get there.
+//
+
+void
+CSessionTable::schedule(timer& t)
+{
+    // Never schedule at or before the current tick, that slot is done
+    if (t.m_expire <= m_tick) {
+        t.m_expire = m_tick + 1;
+    }
+
+    uint64_t expire = t.m_expire;
+    uint64_t delta  = expire - m_tick;
+
+    for (int level = 0; level < SESSIONTABLE_WHEEL_LEVELS; level++) {
+
+        int shift = level * SESSIONTABLE_WHEEL_BITS;
+        if ((delta >> shift) < SESSIONTABLE_WHEEL_SLOTS) {
+            m_wheel[level][(expire >> shift) & (SESSIONTABLE_WHEEL_SLOTS - 1)]
+              .push_back(t);
+            return;
+        }
+    }
+
+    // Out of range
+    int shift = (SESSIONTABLE_WHEEL_LEVELS - 1) * SESSIONTABLE_WHEEL_BITS;
+    expire    = m_tick + ((uint64_t)SESSIONTABLE_WHEEL_SLOTS << shift) - 1;
+    m_wheel[SESSIONTABLE_WHEEL_LEVELS - 1]
+           [(expire >> shift) & (SESSIONTABLE_WHEEL_SLOTS - 1)]
+             .push_back(t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// cascade
+//
+
+void
+CSessionTable::cascade(int level)
+{
+    int slot =
+      (m_tick >> (level * SESSIONTABLE_WHEEL_BITS)) &
+      (SESSIONTABLE_WHEEL_SLOTS - 1);
+
+    std::vector<timer> timers;
+    timers.swap(m_wheel[level][slot]);
+
+    for (size_t i = 0; i < timers.size(); i++) {
+        schedule(timers[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fire
+//
+
+size_t
+CSessionTable::fire(std::deque<void*>& expired)
+{
+    size_t cnt = 0;
+
+    std::vector<timer> timers;
+    timers.swap(m_wheel[0][m_tick & (SESSIONTABLE_WHEEL_SLOTS - 1)]);
+
+    for (size_t i = 0; i < timers.size(); i++) {
+
+        timer& t       = timers[i];
+        uint32_t shard = getShard(t.m_sid);
+        bool bSchedule = false;
+
+        pthread_mutex_lock(&m_mutexShard[shard]);
+        shard_map::iterator it = m_shard[shard].find(t.m_sid);
+        if ((it != m_shard[shard].end()) && (it->second.m_gen == t.m_gen)) {
+            uint64_t expire = it->second.m_lastActive + m_timeout;
+            if (it->second.m_nPin) {
+                // In use, check again a timeout from now
+                t.m_expire = m_tick + m_timeout;
+                bSchedule  = true;
+            } else if (expire <= m_tick) {
+                expired.push_back(it->second.m_pSession);
+                m_shard[shard].erase(it);
+                cnt++;
+            } else {
+                // Used since it was scheduled
+                t.m_expire = expire;
+                bSchedule  = true;
+            }
+        }
+        pthread_mutex_unlock(&m_mutexShard[shard]);
+
+        if (bSchedule) {
+            schedule(t);
+        }
+    }
+
+    return cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// expire
+//
+
+size_t
+CSessionTable::expire(std::deque<void*>& expired)
+{
+    size_t cnt       = 0;
+    uint64_t current = now();
+
+    pthread_mutex_lock(&m_mutexWheel);
+
+    while (m_tick < current) {
+
+        m_tick++;
+
+        // Higher levels turn when the level below has done a full turn
+        for (int level = SESSIONTABLE_WHEEL_LEVELS - 1; level > 0; level--) {
+            uint64_t mask = ((uint64_t)1 << (level * SESSIONTABLE_WHEEL_BITS)) - 1;
+            if (0 == (m_tick & mask)) {
+                cascade(level);
+            }
+        }
+
+        cnt += fire(expired);
+    }
+
+    pthread_mutex_unlock(&m_mutexWheel);
+
+    return cnt;
+}
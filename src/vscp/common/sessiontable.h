@@ -0,0 +1,212 @@
+// sessiontable.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(SESSIONTABLE_H__INCLUDED_)
+#define SESSIONTABLE_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Number of shards the sessions are spread over. Each shard has its
+// own lock so lookups for different sessions seldom wait on each other.
+#define SESSIONTABLE_SHARDS 16
+
+// Slots on each level of the timer wheel (power of two)
+#define SESSIONTABLE_WHEEL_BITS  6
+#define SESSIONTABLE_WHEEL_SLOTS (1 << SESSIONTABLE_WHEEL_BITS)
+
+// Levels in the timer wheel. With one second ticks three levels of 64
+// slots covers 64^3 seconds (about three days).
+#define SESSIONTABLE_WHEEL_LEVELS 3
+
+/*!
+    Session table
+
+    Holds the sessions of the web server and the REST interface keyed
+    on their session id. The sessions are spread over a number of
+    shards, each a hash map with its own lock, so a lookup is O(1) and
+    only waits for lookups of sessions in the same shard.
+
+    Idle sessions are expired with a hierarchical timer wheel with one
+    second ticks. A lookup only notes the time the session was used and
+    does not touch the wheel. When the timer of a session fires its last
+    active time is checked and the session is either expired or put
+    back in the wheel at its new expiry time. So each lookup is O(1)
+    and a session is handled by the wheel at most a few times in each
+    timeout period however often it is used.
+
+    A session that is found is pinned until it is released. Pinned
+    sessions are never expired so a request can use a session for as
+    long as it runs without it being deleted under it.
+
+    The table does not own the sessions. Expired sessions are handed
+    back to the caller that deletes them.
+*/
+
+class CSessionTable
+{
+
+  public:
+    /*!
+        Constructor
+        @param timeout Seconds a session can be idle before it expires.
+    */
+    CSessionTable(uint32_t timeout = 60 * 60);
+
+    /// Destructor
+    ~CSessionTable();
+
+    /*!
+        Set the time a session can be idle before it expires. Sessions
+        already in the table get the new timeout when their timer fires.
+        @param timeout Idle time in seconds.
+    */
+    void setTimeout(uint32_t timeout);
+
+    /// Get the idle time (seconds) before a session expires
+    uint32_t getTimeout(void) { return m_timeout; }
+
+    /*!
+        Add a session.
+        @param sid Session id.
+        @param pSession Pointer to the session.
+        @param bPin Add the session pinned. It must then be released
+            with release() when it is no longer used.
+        @return true on success, false if the sid is already in use.
+    */
+    bool add(const char* sid, void* pSession, bool bPin = false);
+
+    /*!
+        Find a session, mark it as active and pin it so it is not
+        expired while it is used. Each session found must be released
+        with release().
+        @param sid Session id.
+        @return Pointer to the session or NULL if not found.
+    */
+    void* find(const char* sid);
+
+    /*!
+        Release a session pinned by find() or add(). The session is
+        marked as active so its idle time starts now.
+        @param sid Session id.
+        @return true if the session was found.
+    */
+    bool release(const char* sid);
+
+    /*!
+        Mark a session as active. The session is not pinned.
+        @param sid Session id.
+        @return true if the session was found.
+    */
+    bool touch(const char* sid);
+
+    /*!
+        Take a session out of the table.
+        @param sid Session id.
+        @return Pointer to the session or NULL if not found.
+    */
+    void* remove(const char* sid);
+
+    /*!
+        Advance the timer wheel to the current time and take out the
+        sessions that have been idle longer than the timeout.
+        @param expired Expired sessions are added here. They are no
+            longer in the table and should be deleted by the caller.
+        @return Number of sessions expired.
+    */
+    size_t expire(std::deque<void*>& expired);
+
+    /// Get the number of sessions in the table
+    size_t size(void);
+
+    /// Get monotonic time in seconds
+    static uint64_t now(void);
+
+  private:
+    // A session in a shard
+    struct entry
+    {
+        void* m_pSession;
+        uint64_t m_lastActive; // Time (s) the session was last used
+        uint32_t m_gen;        // Tells a removed and added sid apart
+        uint32_t m_nPin;       // Number of users, never expired if set
+    };
+
+    // A timer in the wheel
+    struct timer
+    {
+        std::string m_sid;
+        uint64_t m_expire; // Tick the timer fires at
+        uint32_t m_gen;
+    };
+
+    typedef std::unordered_map<std::string, entry> shard_map;
+
+    /// Get the shard for a session id
+    uint32_t getShard(const std::string& sid);
+
+    /// Put a timer in the wheel (wheel locked)
+    void schedule(timer& t);
+
+    /// Move the timers of a slot on a higher level down (wheel locked)
+    void cascade(int level);
+
+    /// Handle the timers that fire at the current tick (wheel locked)
+    size_t fire(std::deque<void*>& expired);
+
+  private:
+    /// Idle time (s) before a session expires
+    uint32_t m_timeout;
+
+    /// Generation for the next added session
+    std::atomic<uint32_t> m_gen;
+
+    /// Protects each shard
+    pthread_mutex_t m_mutexShard[SESSIONTABLE_SHARDS];
+
+    /// Sessions in each shard
+    shard_map m_shard[SESSIONTABLE_SHARDS];
+
+    /// Protects the wheel
+    pthread_mutex_t m_mutexWheel;
+
+    /// Current tick of the wheel (seconds)
+    uint64_t m_tick;
+
+    /// The timer wheel
+    std::vector<timer> m_wheel[SESSIONTABLE_WHEEL_LEVELS]
+                              [SESSIONTABLE_WHEEL_SLOTS];
+};
+
+#endif // SESSIONTABLE_H__INCLUDED_
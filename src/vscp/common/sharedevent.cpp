@@ -0,0 +1,150 @@
+// sharedevent.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdlib.h>
+
+#include <eventlatency.h>
+#include <vscphelper.h>
+
+#include "sharedevent.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CSharedEvent::CSharedEvent(vscpEvent* pEvent)
+  : m_refcnt(1)
+  , m_pEvent(pEvent)
+  , m_created(CEventLatency::now())
+{
+    for (int i = 0; i < SHAREDEVENT_RENDERINGS; i++) {
+        m_renderings[i] = NULL;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CSharedEvent::~CSharedEvent()
+{
+    for (int i = 0; i < SHAREDEVENT_RENDERINGS; i++) {
+        delete m_renderings[i].load();
+    }
+
+    vscp_deleteEvent_v2(&m_pEvent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addRef
+//
+
+void
+CSharedEvent::addRef(void)
+{
+    m_refcnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// release
+//
+
+void
+CSharedEvent::release(void)
+{
+    if (1 == m_refcnt.fetch_sub(1, std::memory_order_acq_rel)) {
+        delete this;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getRendering
+//
+// No lock is taken. Two clients that ask for the same rendering at the same
+// time may both make it, the first one to publish it wins and the other
+// throws its copy away.
+//
+
+const std::string*
+CSharedEvent::getRendering(int rendering, SHAREDEVENT_RENDER render)
+{
+    if ((rendering < 0) || (rendering >= SHAREDEVENT_RENDERINGS) ||
+        (NULL == render)) {
+        return NULL;
+    }
+
+    std::string* pstr = m_renderings[rendering].load(std::memory_order_acquire);
+    if (NULL != pstr) {
+        return pstr;
+    }
+
+    pstr = new std::string;
+    if (!render(*pstr, m_pEvent)) {
+        delete pstr;
+        return NULL;
+    }
+
+    std::string* pExpected = NULL;
+    if (!m_renderings[rendering].compare_exchange_strong(
+          pExpected, pstr, std::memory_order_acq_rel)) {
+        delete pstr;
+        pstr = pExpected;
+    }
+
+    return pstr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getString
+//
+
+const std::string*
+CSharedEvent::getString(void)
+{
+    return getRendering(SHAREDEVENT_RENDER_STRING, vscp_convertEventToString);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getJSON
+//
+
+const std::string*
+CSharedEvent::getJSON(void)
+{
+    return getRendering(SHAREDEVENT_RENDER_JSON, vscp_convertEventToJSON);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getXML
+//
+
+const std::string*
+CSharedEvent::getXML(void)
+{
+    return getRendering(SHAREDEVENT_RENDER_XML, vscp_convertEventToXML);
+}
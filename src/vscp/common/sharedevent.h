@@ -0,0 +1,167 @@
+// sharedevent.h: interface for the CSharedEvent class.
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(SHAREDEVENT_H__INCLUDED_)
+#define SHAREDEVENT_H__INCLUDED_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include <vscp.h>
+
+// Text renderings of a shared event
+#define SHAREDEVENT_RENDER_STRING    0 // vscp_convertEventToString (CSV)
+#define SHAREDEVENT_RENDER_JSON      1 // vscp_convertEventToJSON
+#define SHAREDEVENT_RENDER_XML       2 // vscp_convertEventToXML
+#define SHAREDEVENT_RENDER_REST_JSON 3 // Event object of the REST interface
+#define SHAREDEVENT_RENDER_REST_XML  4 // Event element of the REST interface
+#define SHAREDEVENT_RENDERINGS       5
+
+/*!
+    Function that renders an event as text
+    @param str String that will get the rendering
+    @param pEvent Event to render
+    @return true on success
+*/
+typedef bool (*SHAREDEVENT_RENDER)(std::string& str, const vscpEvent* pEvent);
+
+/*!
+    Shared, reference counted event
+
+    An event that is delivered to several clients is wrapped in one
+    shared event and the same object is put in the input queue of every
+    client that should receive it. Each queue holds one reference. The
+    event itself is immutable once it has been shared, a client that
+    need to change it must make its own copy.
+
+    The object is created with a reference count of one that belongs
+    to the creator. The object and the event it holds is deleted when
+    the last reference is released.
+
+    Text renderings of the event (CSV, JSON, XML...) are made the first
+    time a client ask for them and are then kept with the event, so each
+    rendering is made once no matter how many clients receive the event.
+    Any thread holding a reference can ask for a rendering.
+*/
+
+class CSharedEvent
+{
+
+  public:
+    /*!
+        Create a shared event that takes over ownership of an event.
+        @param pEvent Pointer to an event allocated with new. The event
+            and its data will be deleted when the last reference is
+            released.
+    */
+    CSharedEvent(vscpEvent* pEvent);
+
+    /*!
+        Add a reference to the shared event
+    */
+    void addRef(void);
+
+    /*!
+        Release a reference to the shared event. The shared event is
+        deleted when the last reference is released and must not be
+        used after this call.
+    */
+    void release(void);
+
+    /*!
+        Get the number of references currently held
+        @return Reference count
+    */
+    int getRefCount(void) const { return m_refcnt.load(); };
+
+    /*!
+        Get the shared event
+        @return Pointer to the (read only) event.
+    */
+    const vscpEvent* getEvent(void) const { return m_pEvent; };
+
+    /*!
+        Get the time the shared event was created. Used to measure how
+        long it takes to deliver the event.
+        @return Monotonic time in microseconds
+    */
+    uint64_t getCreated(void) const { return m_created; };
+
+    /*!
+        Get a text rendering of the event. The rendering is made on the
+        first call and the same string is returned after that.
+        @param rendering Rendering (SHAREDEVENT_RENDER_...)
+        @param render Function that makes the rendering
+        @return Pointer to the (read only) rendering that lives as long
+            as the shared event or NULL if the event could not be rendered.
+    */
+    const std::string* getRendering(int rendering, SHAREDEVENT_RENDER render);
+
+    /*!
+        Get the event as a string (vscp_convertEventToString)
+        @return Pointer to the rendering or NULL on failure.
+    */
+    const std::string* getString(void);
+
+    /*!
+        Get the event as JSON (vscp_convertEventToJSON)
+        @return Pointer to the rendering or NULL on failure.
+    */
+    const std::string* getJSON(void);
+
+    /*!
+        Get the event as XML (vscp_convertEventToXML)
+        @return Pointer to the rendering or NULL on failure.
+    */
+    const std::string* getXML(void);
+
+  private:
+    /// Destructor - Use release()
+    ~CSharedEvent();
+
+    // Not copyable
+    CSharedEvent(const CSharedEvent&);
+    CSharedEvent& operator=(const CSharedEvent&);
+
+  private:
+    // Reference count
+    std::atomic<int> m_refcnt;
+
+    // The event
+    vscpEvent* m_pEvent;
+
+    // Monotonic time (microseconds) the shared event was created
+    uint64_t m_created;
+
+    // Renderings made so far (NULL if not made yet)
+    std::atomic<std::string*> m_renderings[SHAREDEVENT_RENDERINGS];
+};
+
+#endif
@@ -30,14 +30,18 @@
 // https://stackoverflow.com/questions/3919420/tutorial-on-using-openssl-with-pthreads
 //
 
+#include <algorithm>
 #include <list>
 #include <string>
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <syslog.h>
@@ -53,6 +57,8 @@
 #endif
 
 #include <controlobject.h>
+#include <eventlatency.h>
+#include <eventpool.h>
 #include <version.h>
 #include <vscp.h>
 #include <vscp_debug.h>
@@ -63,11 +69,45 @@
 
 #define TCPIPSRV_INACTIVITY_TIMOUT (3600 * 12)
 
+// Max time in seconds a client has to finish the SSL handshake
+#define TCPIPSRV_HANDSHAKE_TIMEOUT 10
+
+// Max time in milliseconds a worker waits for connection activity
+#define TCPIPSRV_WORKER_POLL_TIMEOUT 500
+
+// Max number of epoll events handled for each wait
+#define TCPIPSRV_WORKER_MAX_EVENTS 64
+
+// Max number of events sent to one client in receive loop before the
+// worker serves the other connections
+#define TCPIPSRV_RCVLOOP_BATCH 256
+
+// Events for a receive loop client are collected in an output buffer of
+// this size before they are written with one call
+#define TCPIPSRV_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+// Max number of bytes of replies and events waiting for a client that
+// does not read. No more commands from the client are read or executed
+// while there is more than this.
+#define TCPIPSRV_OUTPUT_LIMIT (4 * TCPIPSRV_OUTPUT_BUFFER_SIZE)
+
+// Size of each read from a client socket
+#define TCPIPSRV_INPUT_READ_SIZE 8192
+
+// Max number of bytes read from one client before its commands are
+// executed and the worker serves the other connections. The rest is
+// read on the next wakeup.
+#define TCPIPSRV_INPUT_READ_LIMIT (64 * 1024)
+
+// Tag in epoll data for the client input queue eventfd (the socket of the
+// same connection use the untagged pointer)
+#define TCPIPSRV_EPOLL_TAG_QUEUE 1
+
 // Worker threads
 void*
 tcpipListenThread(void* pData);
 void*
-tcpipClientThread(void* pData);
+tcpipWorkerThread(void* pData);
 
 ///////////////////////////////////////////////////////////////////////////////
 //                                  GLOBALS
@@ -80,8 +120,8 @@ tcpipClientThread(void* pData);
 ///////////////////////////////////////////////////////////////////////////////
 // tcpipListenThreadObj
 //
-// This thread listens for connection on a TCP socket and starts a new thread
-// to handle client requests
+// This thread listens for connection on a TCP socket and hands them over to
+// the worker threads that serve client requests
 //
 
 tcpipListenThreadObj::tcpipListenThreadObj(CControlObject* pobj)
@@ -94,8 +134,17 @@ tcpipListenThreadObj::tcpipListenThreadObj(CControlObject* pobj)
     // Init. the server comtext structure
     memset(&m_srvctx, 0, sizeof(struct server_context));
 
+    // Events for receive loop clients are collected before they are
+    // written so Nagle's algorithm would only add delay
+    m_srvctx.config_tcp_nodelay = 1;
+
     m_nStopTcpIpSrv = VSCP_TCPIP_SRV_RUN;
     m_idCounter     = 0;
+    m_nWorkers      = DEFAULT_TCPIP_WORKERS;
+
+    m_cntHandshakes        = 0;
+    m_cntHandshakesResumed = 0;
+    m_cntHandshakesFailed  = 0;
 
     pthread_mutex_init(&m_mutexTcpClientList, NULL);
 }
@@ -105,6 +154,22 @@ tcpipListenThreadObj::~tcpipListenThreadObj()
     pthread_mutex_destroy(&m_mutexTcpClientList);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// setWorkers
+//
+
+void
+tcpipListenThreadObj::setWorkers(uint8_t n)
+{
+    if (n < 1) {
+        n = 1;
+    } else if (n > VSCP_TCPIP_MAX_WORKERS) {
+        n = VSCP_TCPIP_MAX_WORKERS;
+    }
+
+    m_nWorkers = n;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // tcpipListenThread
 //
@@ -114,7 +179,6 @@ tcpipListenThread(void* pData)
 {
     size_t i;
     struct stcp_connection* conn;
-    struct socket* psocket;
     struct stcp_secure_options opts;
     struct pollfd* pfd;
     memset(&opts, 0, sizeof(opts));
@@ -158,7 +222,7 @@ tcpipListenThread(void* pData)
 
     // CA file
     if (pObj->m_tcpip_ssl_ca_file.length()) {
-        opts.chain = strdup((const char*)pObj->m_tcpip_ssl_ca_file.c_str());
+        opts.ca_file = strdup((const char*)pObj->m_tcpip_ssl_ca_file.c_str());
     }
 
     opts.verify_depth        = pObj->m_tcpip_ssl_verify_depth;
@@ -173,9 +237,14 @@ tcpipListenThread(void* pData)
 
     opts.short_trust = pObj->m_tcpip_ssl_short_trust ? 1 : 0;
 
+    // Session resumption
+    opts.session_cache_size = pObj->m_tcpip_ssl_session_cache_size;
+    opts.session_timeout    = pObj->m_tcpip_ssl_session_timeout;
+    opts.session_tickets    = pObj->m_tcpip_ssl_session_tickets ? 1 : 0;
+
     // Init. SSL subsystem
     if (pObj->m_tcpip_ssl_certificate.length()) {
-        if (0 == stcp_init_ssl(pListenObj->m_srvctx.ssl_ctx, &opts)) {
+        if (0 == stcp_init_ssl(&pListenObj->m_srvctx.ssl_ctx, &opts)) {
             syslog(LOG_ERR, "[TCP/IP srv thread] Failed to init. ssl.\n");
             return NULL;
         }
@@ -190,7 +259,35 @@ tcpipListenThread(void* pData)
         return NULL;
     }
 
-    syslog(LOG_DEBUG, "[TCP/IP srv listen thread] Started.");
+    // Start the worker threads that serve the connections
+    for (i = 0; i < pListenObj->m_nWorkers; i++) {
+
+        tcpipWorkerObj* pWorker = new tcpipWorkerObj(pListenObj);
+        if (!pWorker->init()) {
+            delete pWorker;
+            break;
+        }
+
+        if (pthread_create(
+              &pWorker->m_workerThread, NULL, tcpipWorkerThread, pWorker)) {
+            syslog(LOG_ERR,
+                   "[TCP/IP srv] -- Failed to start tcp/ip worker thread.");
+            delete pWorker;
+            break;
+        }
+
+        pListenObj->m_workers.push_back(pWorker);
+    }
+
+    if (!pListenObj->m_workers.size()) {
+        syslog(LOG_ERR, "[TCP/IP srv thread] No worker threads. Terminating.");
+        stcp_close_all_listening_sockets(&pListenObj->m_srvctx);
+        return NULL;
+    }
+
+    syslog(LOG_DEBUG,
+           "[TCP/IP srv listen thread] Started with %d worker(s).",
+           (int)pListenObj->m_workers.size());
 
     while (!pListenObj->m_nStopTcpIpSrv) {
 
@@ -232,7 +329,37 @@ tcpipListenThread(void* pData)
                                     &pListenObj->m_srvctx.listening_sockets[i],
                                     &(conn->client))) {
 
-                        stcp_init_client_connection(conn, &opts);
+                        // Refuse the connection if there are too many
+                        // clients. Done before the connection is set up
+                        // so no handshake is made for it. The reply is
+                        // only written on plain connections.
+                        pthread_mutex_lock(&pListenObj->m_mutexTcpClientList);
+                        size_t nClients = pListenObj->m_tcpip_clientList.size();
+                        pthread_mutex_unlock(
+                          &pListenObj->m_mutexTcpClientList);
+
+                        if (nClients >= pObj->m_tcpip_maxConnections) {
+                            syslog(LOG_ERR,
+                                   "[TCP/IP srv] -- Connection refused, max "
+                                   "number of clients (%u) connected.",
+                                   (unsigned)pObj->m_tcpip_maxConnections);
+                            if (!conn->client.is_ssl) {
+                                send(conn->client.sock,
+                                     MSG_MAX_NUMBER_OF_CLIENTS,
+                                     strlen(MSG_MAX_NUMBER_OF_CLIENTS),
+                                     MSG_NOSIGNAL | MSG_DONTWAIT);
+                            }
+                            close(conn->client.sock);
+                            conn->client.sock = INVALID_SOCKET;
+                            stcp_close_connection(conn);
+                            conn = NULL;
+                            continue;
+                        }
+
+                        // The SSL handshake of a secure connection is
+                        // done by the worker so a slow or hostile client
+                        // can't hold up accepting other connections
+                        stcp_init_client_connection(conn, NULL);
                         syslog(LOG_DEBUG, "[TCP/IP srv] -- Connection accept.");
 
 #ifdef WITH_WRAP
@@ -259,46 +386,43 @@ tcpipListenThread(void* pData)
                         }
 #endif
 
-                        // Create the thread object
+                        // Create the connection object
                         tcpipClientObj* pClientObj =
                           new tcpipClientObj(pListenObj);
                         if (NULL == pClientObj) {
                             syslog(LOG_ERR,
                                    "[TCP/IP srv] -- Memory problem when "
-                                   "creating client thread.");
+                                   "creating client object.");
                             stcp_close_connection(conn);
                             conn = NULL;
                             continue;
                         }
 
-                        pClientObj->m_conn    = conn;
-                        pClientObj->m_pParent = pListenObj;
-
-                        syslog(
-                          LOG_DEBUG,
-                          "Controlobject: Starting client tcp/ip thread...");
-
-                        if (pthread_create(&pClientObj->m_tcpipClientThread,
-                                           NULL,
-                                           tcpipClientThread,
-                                           pClientObj)) {
-                            syslog(LOG_ERR,
-                                   "[TCP/IP srv] -- Failed to run client "
-                                   "tcp/ip client thread.");
-                            delete pClientObj;
-                            stcp_close_connection(conn);
-                            conn = NULL;
-                            continue;
-                        }
+                        pClientObj->m_conn         = conn;
+                        pClientObj->m_pParent      = pListenObj;
+                        pClientObj->m_bHandshake   = conn->client.is_ssl;
+                        pClientObj->m_timeAccepted = CEventLatency::now();
 
                         // Add conn to list of active connections
                         pthread_mutex_lock(&pListenObj->m_mutexTcpClientList);
                         pListenObj->m_tcpip_clientList.push_back(pClientObj);
                         pthread_mutex_unlock(&pListenObj->m_mutexTcpClientList);
 
+                        // Hand it over to the least loaded worker
+                        tcpipWorkerObj* pWorker = pListenObj->m_workers[0];
+                        for (size_t j = 1; j < pListenObj->m_workers.size();
+                             j++) {
+                            if (pListenObj->m_workers[j]->m_nConnections <
+                                pWorker->m_nConnections) {
+                                pWorker = pListenObj->m_workers[j];
+                            }
+                        }
+
+                        pWorker->addConnection(pClientObj);
+
                     } else {
-                        delete psocket;
-                        psocket = NULL;
+                        stcp_close_connection(conn);
+                        conn = NULL;
                     }
                 }
 
@@ -312,33 +436,55 @@ tcpipListenThread(void* pData)
 
     syslog(LOG_DEBUG, "[TCP/IP srv listen thread] Preparing Exit.");
 
-    // Wait for clients to terminate
-    int loopCnt = 0;
-    while (true) {
-
-        pthread_mutex_lock(&pListenObj->m_mutexTcpClientList);
-        if (!pListenObj->m_tcpip_clientList.size())
-            break;
-        pthread_mutex_unlock(&pListenObj->m_mutexTcpClientList);
-
-        loopCnt++;
-        sleep(1); // Give them some time
+    // Wait for the workers to close their connections and terminate
+    std::vector<tcpipWorkerObj*>::iterator itWorker;
+    for (itWorker = pListenObj->m_workers.begin();
+         itWorker != pListenObj->m_workers.end();
+         ++itWorker) {
+        pthread_join((*itWorker)->m_workerThread, NULL);
+        delete *itWorker;
     }
+    pListenObj->m_workers.clear();
 
     stcp_close_all_listening_sockets(&pListenObj->m_srvctx);
 
+    if (NULL != pListenObj->m_srvctx.ssl_ctx) {
+        SSL_CTX_free(pListenObj->m_srvctx.ssl_ctx);
+        pListenObj->m_srvctx.ssl_ctx = NULL;
+    }
+
+    // Report how the SSL handshakes went
+    if (pListenObj->m_cntHandshakes || pListenObj->m_cntHandshakesFailed) {
+        CEventLatency& latency = pListenObj->m_handshakeLatency;
+        syslog(LOG_INFO,
+               "[TCP/IP srv] SSL handshakes=%llu resumed=%llu failed=%llu "
+               "full p50<%lluus p99<%lluus resumed p50<%lluus p99<%lluus",
+               (unsigned long long)pListenObj->m_cntHandshakes,
+               (unsigned long long)pListenObj->m_cntHandshakesResumed,
+               (unsigned long long)pListenObj->m_cntHandshakesFailed,
+               (unsigned long long)latency.getPercentile(
+                 VSCP_TCPIP_HANDSHAKE_FULL, 50),
+               (unsigned long long)latency.getPercentile(
+                 VSCP_TCPIP_HANDSHAKE_FULL, 99),
+               (unsigned long long)latency.getPercentile(
+                 VSCP_TCPIP_HANDSHAKE_RESUMED, 50),
+               (unsigned long long)latency.getPercentile(
+                 VSCP_TCPIP_HANDSHAKE_RESUMED, 99));
+    }
+
     // * * * Deallocate allocated security options * * *
 
+    // stcp_init_ssl use the certificate as chain if no chain is set
+    if ((NULL != opts.chain) && (opts.chain != opts.pem)) {
+        free((void*)opts.chain);
+    }
+    opts.chain = NULL;
+
     if (NULL != opts.pem) {
         free((void*)opts.pem);
         opts.pem = NULL;
     }
 
-    if (NULL != opts.chain) {
-        free((void*)opts.chain);
-        opts.chain = NULL;
-    }
-
     if (NULL != opts.ca_path) {
         free((void*)opts.ca_path);
         opts.ca_path = NULL;
@@ -364,34 +510,53 @@ tcpipListenThread(void* pData)
 }
 
 // ****************************************************************************
-//                              Client thread
+//                              Client connection
 // ****************************************************************************
 
 ///////////////////////////////////////////////////////////////////////////////
 // tcpipClientObj
 //
-// This thread listens for connection on a TCP socket and starts a new thread
-// to handle client requests
+// One client connection. It is served by one of the worker threads.
 //
 
 tcpipClientObj::tcpipClientObj(tcpipListenThreadObj* pParent)
 {
     m_pClientItem = NULL;
-    m_strResponse.clear();  // For clearness
-    m_rv           = 0;     // No error code
-    m_bReceiveLoop = false; // Not in receive loop
-    m_conn         = NULL;  // No connection yet
-    m_pObj         = NULL;
-    pParent        = pParent;
+    m_input.clear();          // For clearness
+    m_rv             = 0;     // No error code
+    m_bReceiveLoop   = false; // Not in receive loop
+    m_bBinary        = false; // Not in binary mode
+    m_conn           = NULL;  // No connection yet
+    m_pObj           = NULL;
+    m_pParent        = pParent;
+    m_pWorker        = NULL;
+    m_bClosed        = false;
+    m_bHandshake     = false;
+    m_timeAccepted   = 0;
+    m_bQueueArmed    = false;
+    m_bWantWrite     = false;
+    m_bPending       = false;
+    m_outPos         = 0;
+    m_bInputPaused   = false;
+    m_bReadStopped   = false;
+    m_nRetrieveLeft  = 0;
+    m_nRetrieved     = 0;
+    m_bRetrieveBlock = false;
+    m_nBlockLeft     = 0;
+    m_nBlockIndex    = 0;
 
     if (NULL != pParent) {
         m_pObj = pParent->getControlObject();
     }
+
+    if (NULL != m_pObj) {
+        m_commandHistory.setDepth(m_pObj->m_tcpip_commandHistory);
+    }
 }
 
 tcpipClientObj::~tcpipClientObj()
 {
-    m_commandArray.clear(); // TODO remove strings
+    clearBlock();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -409,11 +574,7 @@ tcpipClientObj::write(std::string& str, bool bAddCRLF)
         str += std::string("\r\n");
     }
 
-    m_rv = stcp_write(m_conn, (const char*)str.c_str(), str.length());
-    if (m_rv != str.length())
-        return false;
-
-    return true;
+    return write((const char*)str.c_str(), str.length());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -427,10 +588,34 @@ tcpipClientObj::write(const char* buf, size_t len)
     if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
         return false;
 
-    m_rv = stcp_write(m_conn, (const char*)buf, len);
-    if (m_rv != len)
-        return false;
+    // Added after events not yet sent so the order is kept
+    if (m_bBinary) {
+
+        // In binary mode text is sent in reply frames
+        while (len) {
+
+            size_t size = len;
+            if (size > (VSCP_BINARY_MAX_FRAME - 1)) {
+                size = VSCP_BINARY_MAX_FRAME - 1;
+            }
+
+            m_outBuf += (char)(((size + 1) >> 8) & 0xff);
+            m_outBuf += (char)((size + 1) & 0xff);
+            m_outBuf +=
+              (char)SET_VSCP_MULTICAST_TYPE(VSCP_BINARY_TYPE_REPLY,
+                                            VSCP_ENCRYPTION_NONE);
+            m_outBuf.append(buf, size);
+
+            buf += size;
+            len -= size;
+        }
+
+    } else {
+        m_outBuf.append(buf, len);
+    }
 
+    // The worker writes the output buffer when the socket can take it.
+    // Replies to commands received together are sent together.
     return true;
 }
 
@@ -441,20 +626,15 @@ tcpipClientObj::write(const char* buf, size_t len)
 bool
 tcpipClientObj::read(std::string& str)
 {
-    size_t pos;
+    const char* pLine;
+    size_t len;
 
     // Must be connected
     if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
         return false;
 
-    if (m_strResponse.npos != (pos = m_strResponse.find('\n'))) {
-
-        // Get the string
-        str = m_strResponse.substr(pos + 1);
-        vscp_trim(str);
-
-        // Remove string from buffer
-        m_strResponse = m_strResponse.substr(m_strResponse.length() - pos - 1);
+    if (m_input.getLine(&pLine, &len)) {
+        str.assign(pLine, len);
     }
 
     return true;
@@ -465,7 +645,7 @@ tcpipClientObj::read(std::string& str)
 //
 
 int
-tcpipClientObj::CommandHandler(std::string& strCommand)
+tcpipClientObj::CommandHandler(const char* pCommand, size_t len)
 {
     // Must be connected
     if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state) {
@@ -486,7 +666,7 @@ tcpipClientObj::CommandHandler(std::string& strCommand)
         return VSCP_TCPIP_RV_CLOSE; // Close connection
     }
 
-    m_pClientItem->m_currentCommand = strCommand;
+    m_pClientItem->m_currentCommand.assign(pCommand, len);
     vscp_trim(m_pClientItem->m_currentCommand);
 
     // If nothing to handle just return
@@ -530,6 +710,32 @@ tcpipClientObj::CommandHandler(std::string& strCommand)
         write(MSG_QUIT_LOOP, strlen(MSG_QUIT_LOOP));
     }
 
+    //*********************************************************************
+    //                             Binary
+    //*********************************************************************
+
+    else if (m_pClientItem->CommandStartsWith(("binary"))) {
+        if (checkPrivilege(VSCP_USER_RIGHT_ALLOW_RCV_EVENT)) {
+            try {
+                m_pClientItem->m_timeRcvLoop = time(NULL);
+                handleClientBinary();
+            } catch (...) {
+                syslog(LOG_ERR, "TCPIP: Exception occurred handleClientBinary");
+            }
+        }
+    }
+
+    //*********************************************************************
+    //                             Quitbinary
+    //*********************************************************************
+
+    else if (m_pClientItem->CommandStartsWith(("quitbinary"))) {
+        // The reply is the last frame
+        write(MSG_QUIT_BINARY, strlen(MSG_QUIT_BINARY));
+        m_bBinary      = false;
+        m_bReceiveLoop = false;
+    }
+
     //*********************************************************************
     //                             Username
     //*********************************************************************
@@ -606,6 +812,21 @@ tcpipClientObj::CommandHandler(std::string& strCommand)
         }
     }
 
+    //*********************************************************************
+    //                          Send block of events
+    //*********************************************************************
+
+    else if (m_pClientItem->CommandStartsWith(("sendn"))) {
+        if (checkPrivilege(VSCP_USER_RIGHT_ALLOW_SEND_EVENT)) {
+            try {
+                handleClientSendBlock();
+            } catch (...) {
+                syslog(LOG_ERR,
+                       "TCPIP: Exception occurred handleClientSendBlock");
+            }
+        }
+    }
+
     //*********************************************************************
     //                             Send event
     //*********************************************************************
@@ -620,6 +841,21 @@ tcpipClientObj::CommandHandler(std::string& strCommand)
         }
     }
 
+    //*********************************************************************
+    //                         Read block of events
+    //*********************************************************************
+
+    else if (m_pClientItem->CommandStartsWith(("retrn"))) {
+        if (checkPrivilege(VSCP_USER_RIGHT_ALLOW_RCV_EVENT)) {
+            try {
+                handleClientReceiveBlock();
+            } catch (...) {
+                syslog(LOG_ERR,
+                       "TCPIP: Exception occurred handleClientReceiveBlock");
+            }
+        }
+    }
+
     //*********************************************************************
     //                            Read event
     //*********************************************************************
@@ -1365,9 +1601,6 @@ tcpipClientObj::handleClientSend(void)
     if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
         return;
 
-    // Set timestamp block for event
-    vscp_setEventDateTimeBlockToNow(&event);
-
     if (NULL == m_pObj) {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -1384,12 +1617,29 @@ tcpipClientObj::handleClientSend(void)
         return;
     }
 
+    if (!getEventFromString(event, m_pClientItem->m_currentCommand)) {
+        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
+        return;
+    }
+
+    sendEventFromClient(event);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getEventFromString
+//
+
+bool
+tcpipClientObj::getEventFromString(vscpEvent& event,
+                                   const std::string& strEvent)
+{
+    // Set timestamp block for event
+    vscp_setEventDateTimeBlockToNow(&event);
+    event.pdata = NULL;
+
     std::string str;
     std::deque<std::string> tokens;
-    vscp_split(tokens, m_pClientItem->m_currentCommand, ",");
-
-    // If first character is $ user request us to send content from
-    // a variable
+    vscp_split(tokens, strEvent, ",");
 
     if (!tokens.empty()) {
         // Get Head
@@ -1398,8 +1648,7 @@ tcpipClientObj::handleClientSend(void)
         vscp_trim(str);
         event.head = vscp_readStringValue(str);
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get Class
@@ -1408,8 +1657,7 @@ tcpipClientObj::handleClientSend(void)
         tokens.pop_front();
         event.vscp_class = vscp_readStringValue(str);
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get Type
@@ -1418,8 +1666,7 @@ tcpipClientObj::handleClientSend(void)
         tokens.pop_front();
         event.vscp_type = vscp_readStringValue(str);
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get OBID  -  Kept here to be compatible with receive
@@ -1428,8 +1675,7 @@ tcpipClientObj::handleClientSend(void)
         tokens.pop_front();
         event.obid = vscp_readStringValue(str);
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get date/time - can be empty
@@ -1455,8 +1701,7 @@ tcpipClientObj::handleClientSend(void)
         }
 
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get Timestamp - can be empty
@@ -1470,8 +1715,7 @@ tcpipClientObj::handleClientSend(void)
             event.timestamp = vscp_makeTimeStamp();
         }
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Get GUID
@@ -1494,14 +1738,12 @@ tcpipClientObj::handleClientSend(void)
             }
         }
     } else {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     // Handle data
     if (512 < tokens.size()) {
-        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-        return;
+        return false;
     }
 
     event.sizeData = tokens.size();
@@ -1510,11 +1752,9 @@ tcpipClientObj::handleClientSend(void)
 
         unsigned int index = 0;
 
-        event.pdata = new uint8_t[event.sizeData];
-
-        if (NULL == event.pdata) {
-            write(MSG_INTERNAL_MEMORY_ERROR, strlen(MSG_INTERNAL_MEMORY_ERROR));
-            return;
+        if (!vscp_newEventData(&event, event.sizeData)) {
+            event.pdata = NULL;
+            return false;
         }
 
         while (!tokens.empty() && (event.sizeData > index)) {
@@ -1524,135 +1764,130 @@ tcpipClientObj::handleClientSend(void)
         }
 
         if (!tokens.empty()) {
-            write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
-
-            delete[] event.pdata;
+            vscp_deleteEvent(&event);
             event.pdata = NULL;
-            return;
+            return false;
         }
     } else {
         // No data
         event.pdata = NULL;
     }
 
-    // Check if we are allowed top send CLASS1.PROTOCOL events
-    if ((VSCP_CLASS1_PROTOCOL == event.vscp_class) &&
-        !checkPrivilege(VSCP_USER_RIGHT_ALLOW_SEND_L1CTRL_EVENT)) {
+    return true;
 
-        std::string strErr = vscp_str_format(
-          ("[TCP/IP srv] User [%s] not allowed to send event class=%d "
-           "type=%d.\n"),
-          (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
-          event.vscp_class,
-          event.vscp_type);
+}
 
-        syslog(LOG_ERR, "%s", strErr.c_str());
+///////////////////////////////////////////////////////////////////////////////
+// handleClientSendFrame
+//
 
-        write(MSG_MOT_ALLOWED_TO_SEND_EVENT,
-              strlen(MSG_MOT_ALLOWED_TO_SEND_EVENT));
+void
+tcpipClientObj::handleClientSendFrame(const uint8_t* pFrame, size_t len)
+{
+    vscpEvent event;
 
-        if (NULL != event.pdata) {
-            delete[] event.pdata;
-            event.pdata = NULL;
-        }
+    if (NULL == m_pClientItem) {
+        write(MSG_INTERNAL_ERROR, strlen(MSG_INTERNAL_ERROR));
+        return;
+    }
 
+    // Must be accredited to do this
+    if (!m_pClientItem->bAuthenticated) {
+        write(MSG_NOT_ACCREDITED, strlen(MSG_NOT_ACCREDITED));
         return;
     }
 
-    // Check if we are allowed top send CLASS1.PROTOCOL events
-    if ((VSCP_CLASS1_PROTOCOL == event.vscp_class) &&
-        !checkPrivilege(VSCP_CLASS2_LEVEL1_PROTOCOL)) {
+    event.pdata = NULL;
+    if (!vscp_getEventFromFrame(&event, pFrame, len)) {
+        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
+        return;
+    }
 
-        std::string strErr = vscp_str_format(
-          ("[TCP/IP srv] User [%s] not allowed to send event class=%d "
-           "type=%d.\n"),
-          (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
-          event.vscp_class,
-          event.vscp_type);
+    // Check if i/f GUID should be used
+    if (vscp_isGUIDEmpty(event.GUID)) {
+        m_pClientItem->m_guid.writeGUID(event.GUID);
+    }
 
-        syslog(LOG_ERR, "%s", strErr.c_str());
+    sendEventFromClient(event);
+}
 
-        write(MSG_MOT_ALLOWED_TO_SEND_EVENT,
-              strlen(MSG_MOT_ALLOWED_TO_SEND_EVENT));
+///////////////////////////////////////////////////////////////////////////////
+// isAllowedToSend
+//
 
-        if (NULL != event.pdata) {
-            delete[] event.pdata;
-            event.pdata = NULL;
-        }
+bool
+tcpipClientObj::isAllowedToSend(const vscpEvent& event)
+{
+    bool bAllowed = true;
 
-        return;
+    if ((NULL == m_pClientItem) || (NULL == m_pClientItem->m_pUserItem)) {
+        return false;
     }
 
-    // Check if we are allowed top send CLASS2.PROTOCOL events
-    if ((VSCP_CLASS2_PROTOCOL == event.vscp_class) &&
-        !checkPrivilege(VSCP_USER_RIGHT_ALLOW_SEND_L2CTRL_EVENT)) {
+    unsigned long rights = m_pClientItem->m_pUserItem->getUserRights();
 
-        std::string strErr = vscp_str_format(
-          ("[TCP/IP srv] User [%s] not allowed to send event class=%d "
-           "type=%d.\n"),
-          (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
-          event.vscp_class,
-          event.vscp_type);
+    // Check if we are allowed top send CLASS1.PROTOCOL events
+    if ((VSCP_CLASS1_PROTOCOL == event.vscp_class) &&
+        (!(rights & VSCP_USER_RIGHT_ALLOW_SEND_L1CTRL_EVENT) ||
+         !(rights & VSCP_CLASS2_LEVEL1_PROTOCOL))) {
+        bAllowed = false;
+    }
 
-        syslog(LOG_ERR, "%s", strErr.c_str());
+    // Check if we are allowed top send CLASS2.PROTOCOL events
+    else if ((VSCP_CLASS2_PROTOCOL == event.vscp_class) &&
+             !(rights & VSCP_USER_RIGHT_ALLOW_SEND_L2CTRL_EVENT)) {
+        bAllowed = false;
+    }
 
-        write(MSG_MOT_ALLOWED_TO_SEND_EVENT,
-              strlen(MSG_MOT_ALLOWED_TO_SEND_EVENT));
+    // Check if we are allowed top send CLASS2.HLO events
+    else if ((VSCP_CLASS2_HLO == event.vscp_class) &&
+             !(rights & VSCP_USER_RIGHT_ALLOW_SEND_HLO_EVENT)) {
+        bAllowed = false;
+    }
 
-        if (NULL != event.pdata) {
-            delete[] event.pdata;
-            event.pdata = NULL;
-        }
+    // Check if this user is allowed to send this event
+    else if (!m_pClientItem->m_pUserItem->isUserAllowedToSendEvent(
+               event.vscp_class,
+               event.vscp_type)) {
+        bAllowed = false;
+    }
 
-        return;
+    if (!bAllowed) {
+        syslog(LOG_ERR,
+               "[TCP/IP srv] User [%s] not allowed to send event class=%d "
+               "type=%d.",
+               (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
+               event.vscp_class,
+               event.vscp_type);
     }
 
-    // Check if we are allowed top send CLASS2.HLO events
-    if ((VSCP_CLASS2_HLO == event.vscp_class) &&
-        !checkPrivilege(VSCP_USER_RIGHT_ALLOW_SEND_HLO_EVENT)) {
+    return bAllowed;
+}
 
-        std::string strErr = vscp_str_format(
-          ("[TCP/IP srv] User [%s] not allowed to send event class=%d "
-           "type=%d.\n"),
-          (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
-          event.vscp_class,
-          event.vscp_type);
+///////////////////////////////////////////////////////////////////////////////
+// sendEventFromClient
+//
 
-        syslog(LOG_ERR, "%s", strErr.c_str());
+void
+tcpipClientObj::sendEventFromClient(vscpEvent& event)
+{
+    if (!isAllowedToSend(event)) {
 
         write(MSG_MOT_ALLOWED_TO_SEND_EVENT,
               strlen(MSG_MOT_ALLOWED_TO_SEND_EVENT));
 
         if (NULL != event.pdata) {
-            delete[] event.pdata;
+            vscp_deleteEvent(&event);
             event.pdata = NULL;
         }
 
         return;
     }
 
-    // Check if this user is allowed to send this event
-    if (!m_pClientItem->m_pUserItem->isUserAllowedToSendEvent(
-          event.vscp_class,
-          event.vscp_type)) {
-
-        std::string strErr = vscp_str_format(
-          ("[TCP/IP srv] User [%s] not allowed to send event class=%d "
-           "type=%d.\n"),
-          (const char*)m_pClientItem->m_pUserItem->getUserName().c_str(),
-          event.vscp_class,
-          event.vscp_type);
-
-        syslog(LOG_ERR, "%s", strErr.c_str());
-
-        write(MSG_MOT_ALLOWED_TO_SEND_EVENT,
-              strlen(MSG_MOT_ALLOWED_TO_SEND_EVENT));
-
-        if (NULL != event.pdata) {
-            delete[] event.pdata;
-            event.pdata = NULL;
-        }
-
+    // Over the rate limit of the client or the user
+    if (0 == m_pObj->admitEvents(m_pClientItem)) {
+        vscp_deleteEvent(&event);
+        write(MSG_RATE_LIMITED, strlen(MSG_RATE_LIMITED));
         return;
     }
 
@@ -1693,25 +1928,58 @@ tcpipClientObj::handleClientReceive(void)
         cnt = 1; // No arg is "read one"
     }
 
-    // Read cnt messages
-    while (cnt) {
+    if (!m_pClientItem->m_bOpen) {
+        write(MSG_NO_MSG, strlen(MSG_NO_MSG));
+        return;
+    }
 
-        std::string strOut;
+    // Read cnt messages
+    m_nRetrieveLeft  = cnt;
+    m_nRetrieved     = 0;
+    m_bRetrieveBlock = false;
+    retrieveEvents();
+}
 
-        if (!m_pClientItem->m_bOpen) {
-            write(MSG_NO_MSG, strlen(MSG_NO_MSG));
-            return;
-        } else {
-            if (false == sendOneEventFromQueue()) {
-                return;
-            }
+///////////////////////////////////////////////////////////////////////////////
+// retrieveEvents
+//
+// Events for "retr" and "retrn" are formatted straight into the output
+// buffer. What does not fit below the output limit is added when the
+// client has taken the rest. The reply is written when all is done.
+//
+
+void
+tcpipClientObj::retrieveEvents(void)
+{
+    while (m_nRetrieveLeft && !isOutputFull()) {
+
+        CSharedEvent* pqueueEvent = m_pClientItem->m_clientInputQueue.pop();
+        if (NULL == pqueueEvent) {
+            break; // Queue is empty
         }
 
-        cnt--;
+        formatEvent(m_outBuf, pqueueEvent);
+        pqueueEvent->release();
+        m_nRetrieveLeft--;
+        m_nRetrieved++;
+    }
 
-    } // while
+    // Continued when there is room
+    if (m_nRetrieveLeft && isOutputFull()) {
+        return;
+    }
 
-    write(MSG_OK, strlen(MSG_OK));
+    if (m_bRetrieveBlock) {
+        std::string str =
+          vscp_str_format("+OK - %u event(s) retrieved.\r\n", m_nRetrieved);
+        write(str.c_str(), str.length());
+    } else if (m_nRetrieveLeft) {
+        write(MSG_NO_MSG, strlen(MSG_NO_MSG));
+    } else {
+        write(MSG_OK, strlen(MSG_OK));
+    }
+
+    m_nRetrieveLeft = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1721,27 +1989,16 @@ tcpipClientObj::handleClientReceive(void)
 bool
 tcpipClientObj::sendOneEventFromQueue(bool bStatusMsg)
 {
-    std::string strOut;
-
     // Must be connected
     if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
         return false;
 
-    if (m_pClientItem->m_clientInputQueue.size()) {
-
-        vscpEvent* pqueueEvent;
-        pthread_mutex_lock(&m_pClientItem->m_mutexClientInputQueue);
-        {
-            pqueueEvent = m_pClientItem->m_clientInputQueue.front();
-            m_pClientItem->m_clientInputQueue.pop_front();
-        }
-        pthread_mutex_unlock(&m_pClientItem->m_mutexClientInputQueue);
-
-        vscp_convertEventToString(strOut, pqueueEvent);
-        strOut += ("\r\n");
-        write(strOut.c_str(), strlen(strOut.c_str()));
+    CSharedEvent* pqueueEvent = m_pClientItem->m_clientInputQueue.pop();
+    if (NULL != pqueueEvent) {
 
-        vscp_deleteEvent_v2(&pqueueEvent);
+        // Sent with the reply that follows
+        formatEvent(m_outBuf, pqueueEvent);
+        pqueueEvent->release();
 
     } else {
         if (bStatusMsg) {
@@ -1754,6 +2011,205 @@ tcpipClientObj::sendOneEventFromQueue(bool bStatusMsg)
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// handleClientSendBlock
+//
+
+void
+tcpipClientObj::handleClientSendBlock(void)
+{
+    // Must be connected
+    if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
+        return;
+
+    // Must be accredited to do this
+    if (!m_pClientItem->bAuthenticated) {
+        write(MSG_NOT_ACCREDITED, strlen(MSG_NOT_ACCREDITED));
+        return;
+    }
+
+    uint32_t cnt = vscp_readStringValue(m_pClientItem->m_currentCommand);
+    if ((0 == cnt) || (cnt > VSCP_TCPIP_MAX_BLOCK_EVENTS)) {
+        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
+        return;
+    }
+
+    clearBlock();
+    m_blockEvents.reserve(cnt);
+    m_blockIndex.reserve(cnt);
+
+    // The events of the block are the next cnt lines or frames
+    m_nBlockLeft = cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addBlockLine
+//
+
+void
+tcpipClientObj::addBlockLine(const char* pLine, size_t len)
+{
+    vscpEvent* pEvent = NULL;
+
+    if (vscp_newEvent(&pEvent)) {
+        m_strEvent.assign(pLine, len);
+        if (!getEventFromString(*pEvent, m_strEvent)) {
+            vscp_deleteEvent_v2(&pEvent);
+        }
+    }
+
+    addBlockEvent(pEvent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addBlockFrame
+//
+
+void
+tcpipClientObj::addBlockFrame(const uint8_t* pFrame, size_t len)
+{
+    vscpEvent* pEvent = NULL;
+
+    if ((VSCP_BINARY_TYPE_EVENT == GET_VSCP_MULTICAST_PACKET_TYPE(pFrame[0])) &&
+        (VSCP_ENCRYPTION_NONE ==
+         GET_VSCP_MULTICAST_PACKET_ENCRYPTION(pFrame[0])) &&
+        vscp_newEvent(&pEvent)) {
+
+        if (!vscp_getEventFromFrame(pEvent, pFrame, len)) {
+            vscp_deleteEvent_v2(&pEvent);
+        }
+    }
+
+    addBlockEvent(pEvent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addBlockEvent
+//
+
+void
+tcpipClientObj::addBlockEvent(vscpEvent* pEvent)
+{
+    size_t index = m_nBlockIndex++;
+
+    if (NULL == pEvent) {
+        m_blockFailed.push_back(index);
+    } else if (!isAllowedToSend(*pEvent)) {
+        vscp_deleteEvent_v2(&pEvent);
+        m_blockFailed.push_back(index);
+    } else {
+        m_blockEvents.push_back(pEvent);
+        m_blockIndex.push_back(index);
+    }
+
+    if (0 == --m_nBlockLeft) {
+        sendBlock();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendBlock
+//
+
+void
+tcpipClientObj::sendBlock(void)
+{
+    std::vector<size_t> failed;
+    size_t nSent = 0;
+
+    // Events over the rate limit fail. They are the last ones so the
+    // client can send them again later in the same order.
+    size_t nAdmitted =
+      m_pObj->admitEvents(m_pClientItem, (uint32_t)m_blockEvents.size());
+    bool bThrottled = (nAdmitted < m_blockEvents.size());
+    for (size_t i = nAdmitted; i < m_blockEvents.size(); i++) {
+        vscp_deleteEvent_v2(&m_blockEvents[i]);
+        m_blockFailed.push_back(m_blockIndex[i]);
+    }
+    m_blockEvents.resize(nAdmitted);
+    m_blockIndex.resize(nAdmitted);
+
+    if (!m_blockEvents.empty()) {
+        nSent = m_pObj->sendEvents(m_pClientItem, m_blockEvents, failed);
+    }
+
+    // Events the daemon could not take. Index in the block.
+    for (size_t i = 0; i < failed.size(); i++) {
+        m_blockFailed.push_back(m_blockIndex[failed[i]]);
+    }
+
+    std::string str;
+    if (m_blockFailed.empty()) {
+        str = vscp_str_format("+OK - %zu event(s) sent.\r\n", nSent);
+    } else {
+        std::sort(m_blockFailed.begin(), m_blockFailed.end());
+        str = vscp_str_format("-OK - %zu event(s) sent, %sfailed:",
+                              nSent,
+                              bThrottled ? "rate limited, " : "");
+        for (size_t i = 0; i < m_blockFailed.size(); i++) {
+            str += vscp_str_format(
+              "%s%zu", (0 == i) ? " " : ",", m_blockFailed[i]);
+        }
+        str += "\r\n";
+    }
+
+    clearBlock();
+
+    write(str.c_str(), str.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clearBlock
+//
+
+void
+tcpipClientObj::clearBlock(void)
+{
+    for (size_t i = 0; i < m_blockEvents.size(); i++) {
+        vscp_deleteEvent_v2(&m_blockEvents[i]);
+    }
+
+    m_blockEvents.clear();
+    m_blockIndex.clear();
+    m_blockFailed.clear();
+    m_nBlockLeft  = 0;
+    m_nBlockIndex = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// handleClientReceiveBlock
+//
+
+void
+tcpipClientObj::handleClientReceiveBlock(void)
+{
+    // Must be connected
+    if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
+        return;
+
+    // Must be accredited to do this
+    if (!m_pClientItem->bAuthenticated) {
+        write(MSG_NOT_ACCREDITED, strlen(MSG_NOT_ACCREDITED));
+        return;
+    }
+
+    if (!m_pClientItem->m_bOpen) {
+        write(MSG_NO_MSG, strlen(MSG_NO_MSG));
+        return;
+    }
+
+    // No argument is "all queued events"
+    uint32_t cnt = vscp_readStringValue(m_pClientItem->m_currentCommand);
+    if (0 == cnt) {
+        cnt = m_pClientItem->m_clientInputQueue.size();
+    }
+
+    m_nRetrieveLeft  = cnt;
+    m_nRetrieved     = 0;
+    m_bRetrieveBlock = true;
+    retrieveEvents();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // handleClientDataAvailable
 //
@@ -1797,16 +2253,7 @@ tcpipClientObj::handleClientClearInputQueue(void)
         return;
     }
 
-    pthread_mutex_lock(&m_pClientItem->m_mutexClientInputQueue);
-    std::deque<vscpEvent*>::iterator iter;
-    for (iter = m_pClientItem->m_clientInputQueue.begin();
-         iter != m_pClientItem->m_clientInputQueue.end();
-         ++iter) {
-        vscpEvent* pEvent = *iter;
-        vscp_deleteEvent_v2(&pEvent);
-    }
     m_pClientItem->m_clientInputQueue.clear();
-    pthread_mutex_unlock(&m_pClientItem->m_mutexClientInputQueue);
 
     write(MSG_QUEUE_CLEARED, strlen(MSG_QUEUE_CLEARED));
 }
@@ -1830,6 +2277,78 @@ tcpipClientObj::handleClientGetStatistics(void)
         return;
     }
 
+    // 'STAT POOL' - Event pool statistics. One line for each block
+    // size with size,blocks,hits,misses,inline
+    if (m_pClientItem->CommandStartsWith("pool")) {
+
+        std::string str;
+        eventPoolStatistics stat;
+        for (int cls = 0; cls < EVENTPOOL_CLASS_COUNT; cls++) {
+            CEventPool::getPool().getStatistics(cls, &stat);
+            str += vscp_str_format("%u,%u,%llu,%llu,%llu\r\n",
+                                   (unsigned)stat.blockSize,
+                                   (unsigned)stat.nBlocks,
+                                   (unsigned long long)stat.cntHits,
+                                   (unsigned long long)stat.cntMisses,
+                                   (unsigned long long)stat.cntInline);
+        }
+        str += MSG_OK;
+
+        write(str.c_str(), str.length());
+        return;
+    }
+
+    // 'STAT LATENCY' - Delivery latency. One line for each priority
+    // with priority,events,p50,p90,p99,max in microseconds
+    if (m_pClientItem->CommandStartsWith("latency")) {
+
+        std::string str;
+        CEventLatency& latency = CEventLatency::getLatency();
+        for (uint8_t prio = 0; prio < EVENTLATENCY_PRIORITIES; prio++) {
+            str += vscp_str_format(
+              "%d,%llu,%llu,%llu,%llu,%llu\r\n",
+              prio,
+              (unsigned long long)latency.getCount(prio),
+              (unsigned long long)latency.getPercentile(prio, 50),
+              (unsigned long long)latency.getPercentile(prio, 90),
+              (unsigned long long)latency.getPercentile(prio, 99),
+              (unsigned long long)latency.getMax(prio));
+        }
+        str += MSG_OK;
+
+        write(str.c_str(), str.length());
+        return;
+    }
+
+    // 'STAT SSL' - SSL handshakes. One line for full handshakes and one
+    // for resumed sessions with type,handshakes,p50,p90,p99,max in
+    // microseconds from accept, then failed,count
+    if (m_pClientItem->CommandStartsWith("ssl")) {
+
+        std::string str;
+        CEventLatency& latency = m_pParent->m_handshakeLatency;
+        const char* types[]    = { "full", "resumed" };
+        uint8_t slots[]        = { VSCP_TCPIP_HANDSHAKE_FULL,
+                                   VSCP_TCPIP_HANDSHAKE_RESUMED };
+        for (int i = 0; i < 2; i++) {
+            str += vscp_str_format(
+              "%s,%llu,%llu,%llu,%llu,%llu\r\n",
+              types[i],
+              (unsigned long long)latency.getCount(slots[i]),
+              (unsigned long long)latency.getPercentile(slots[i], 50),
+              (unsigned long long)latency.getPercentile(slots[i], 90),
+              (unsigned long long)latency.getPercentile(slots[i], 99),
+              (unsigned long long)latency.getMax(slots[i]));
+        }
+        str += vscp_str_format(
+          "failed,%llu\r\n",
+          (unsigned long long)m_pParent->m_cntHandshakesFailed);
+        str += MSG_OK;
+
+        write(str.c_str(), str.length());
+        return;
+    }
+
     sprintf(outbuf,
             "%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n%s",
             m_pClientItem->m_statistics.cntBusOff,
@@ -1920,7 +2439,14 @@ tcpipClientObj::handleClientSetChannelGUID(void)
 
     vscp_trim(m_pClientItem->m_currentCommand);
 
-    m_pClientItem->m_guid.getFromString(m_pClientItem->m_currentCommand);
+    cguid guid;
+    guid.getFromString(m_pClientItem->m_currentCommand);
+
+    // Keep the GUID index of the client list up to date
+    pthread_mutex_lock(&m_pObj->m_clientList.m_mutexItemList);
+    m_pObj->m_clientList.setClientGUID(m_pClientItem, guid);
+    pthread_mutex_unlock(&m_pObj->m_clientList.m_mutexItemList);
+
     write(MSG_OK, strlen(MSG_OK));
 }
 
@@ -1992,6 +2518,7 @@ tcpipClientObj::handleClientSetFilter(void)
     }
 
     std::string str;
+    vscpEventFilter filter = m_pClientItem->m_filter;
     vscp_trim(m_pClientItem->m_currentCommand);
     std::deque<std::string> tokens;
     vscp_split(tokens, m_pClientItem->m_currentCommand, ",");
@@ -2000,7 +2527,7 @@ tcpipClientObj::handleClientSetFilter(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.filter_priority = vscp_readStringValue(str);
+        filter.filter_priority = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2010,7 +2537,7 @@ tcpipClientObj::handleClientSetFilter(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.filter_class = vscp_readStringValue(str);
+        filter.filter_class = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2020,7 +2547,7 @@ tcpipClientObj::handleClientSetFilter(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.filter_type = vscp_readStringValue(str);
+        filter.filter_type = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2030,12 +2557,15 @@ tcpipClientObj::handleClientSetFilter(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        vscp_getGuidFromStringToArray(m_pClientItem->m_filter.filter_GUID, str);
+        vscp_getGuidFromStringToArray(filter.filter_GUID, str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
     }
 
+    // Activate the new filter
+    m_pObj->m_clientList.setClientFilter(m_pClientItem, &filter);
+
     write(MSG_OK, strlen(MSG_OK));
 }
 
@@ -2057,6 +2587,7 @@ tcpipClientObj::handleClientSetMask(void)
     }
 
     std::string str;
+    vscpEventFilter filter = m_pClientItem->m_filter;
     vscp_trim(m_pClientItem->m_currentCommand);
     std::deque<std::string> tokens;
     vscp_split(tokens, m_pClientItem->m_currentCommand, ",");
@@ -2065,7 +2596,7 @@ tcpipClientObj::handleClientSetMask(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.mask_priority = vscp_readStringValue(str);
+        filter.mask_priority = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2075,7 +2606,7 @@ tcpipClientObj::handleClientSetMask(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.mask_class = vscp_readStringValue(str);
+        filter.mask_class = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2085,7 +2616,7 @@ tcpipClientObj::handleClientSetMask(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        m_pClientItem->m_filter.mask_type = vscp_readStringValue(str);
+        filter.mask_type = vscp_readStringValue(str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
@@ -2095,12 +2626,15 @@ tcpipClientObj::handleClientSetMask(void)
     if (!tokens.empty()) {
         str = tokens.front();
         tokens.pop_front();
-        vscp_getGuidFromStringToArray(m_pClientItem->m_filter.mask_GUID, str);
+        vscp_getGuidFromStringToArray(filter.mask_GUID, str);
     } else {
         write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
         return;
     }
 
+    // Activate the new mask
+    m_pObj->m_clientList.setClientFilter(m_pClientItem, &filter);
+
     write(MSG_OK, strlen(MSG_OK));
 }
 
@@ -2205,9 +2739,9 @@ tcpipClientObj::handleClientPassword(void)
     }
 
     // Copy in the user filter
-    memcpy(&m_pClientItem->m_filter,
-           m_pClientItem->m_pUserItem->getUserFilter(),
-           sizeof(vscpEventFilter));
+    m_pObj->m_clientList.setClientFilter(
+      m_pClientItem,
+      m_pClientItem->m_pUserItem->getUserFilter());
 
     std::string strErr = vscp_str_format(
       ("[TCP/IP srv] Host [%s] User [%s] allowed to connect.\n"),
@@ -2269,6 +2803,27 @@ tcpipClientObj::handleClientRcvLoop(void)
     return;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// handleClientBinary
+//
+
+void
+tcpipClientObj::handleClientBinary(void)
+{
+    // Must be connected
+    if (STCP_CONN_STATE_CONNECTED != m_conn->conn_state)
+        return;
+
+    // Last text reply. Everything after this is framed.
+    write(MSG_BINARY_MODE, strlen(MSG_BINARY_MODE));
+    m_bBinary = true;
+
+    // Events are streamed as in the receive loop
+    m_bReceiveLoop = true;
+
+    return;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // handleClientTest
 //
@@ -2474,10 +3029,14 @@ tcpipClientObj::handleClientHelp(void)
         str += "CHALLENGE 'token' - Get session id.  \r\n";
         str += "SEND 'event'      - Send an event.   \r\n";
         str += "RETR 'count'      - Retrive n events from input queue.   \r\n";
+        str += "SENDN 'count'     - Send a block of events.\r\n";
+        str += "RETRN 'count'     - Retrieve a block of events.\r\n";
         str +=
           "RCVLOOP           - Will retrieve events in an endless loop until "
           "the connection is closed by the client or QUITLOOP is sent.\r\n";
         str += "QUITLOOP          - Terminate RCVLOOP.\r\n";
+        str += "BINARY            - Enter binary framed mode.\r\n";
+        str += "QUITBINARY        - Terminate BINARY.\r\n";
         str += "CDTA/CHKDATA      - Check if there is data in the input "
                "queue.\r\n";
         str += "CLRA/CLRALL       - Clear input queue.\r\n";
@@ -2505,6 +3064,10 @@ tcpipClientObj::handleClientHelp(void)
         std::string str =
           "'NOOP' Does absolutely nothing but giving a success in return.\r\n";
         write((const char*)str.c_str(), str.length());
+    } else if (m_pClientItem->CommandStartsWith(("quitbinary"))) {
+        std::string str = "'QUITBINARY' - Leave binary mode and go back to "
+                          "text commands.\r\n";
+        write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith(("quit"))) {
         std::string str = "'QUIT' Quit a session with the VSCP daemon and "
                           "closes the m_connection.\r\n";
@@ -2523,6 +3086,15 @@ tcpipClientObj::handleClientHelp(void)
         std::string str = "'QUIT' Quit a session with the VSCP daemon and "
                           "closes the m_connection.\r\n";
         write((const char*)str.c_str(), str.length());
+    } else if (m_pClientItem->CommandStartsWith(("sendn"))) {
+        std::string str = "'SENDN count' - Send a block of 'count' events. "
+                          "The command is followed by 'count' events, one "
+                          "on each line given as for 'SEND' (an event "
+                          "frame each in binary mode). ";
+        str += "One reply is given for the whole block. If some of the "
+               "events could not be sent the reply is '-OK' followed by "
+               "the index (first is 0) of each of them.\r\n";
+        write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith(("send"))) {
         std::string str = "'SEND event'.\r\nThe event is given as "
                           "'head,class,type,obid,datetime,time-stamp,GUID,"
@@ -2533,6 +3105,12 @@ tcpipClientObj::handleClientHelp(void)
         str += "the GUID of the interface will be used. \r\nThe GUID should "
                "be given on the form MSB-byte:MSB-byte-1:MSB-byte-2. \r\n";
         write((const char*)str.c_str(), str.length());
+    } else if (m_pClientItem->CommandStartsWith(("retrn"))) {
+        std::string str = "'RETRN count' - Retrieve up to 'count' events "
+                          "(all queued if no argument) followed by one "
+                          "reply with the number of events retrieved. ";
+        str += "Events are retrived as for 'RETR'.\r\n";
+        write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith(("retr"))) {
         std::string str = "'RETR count' - Retrieve one (if no argument) or "
                           "'count' event(s). ";
@@ -2550,6 +3128,14 @@ tcpipClientObj::handleClientHelp(void)
     } else if (m_pClientItem->CommandStartsWith(("quitloop"))) {
         std::string str = "'QUITLOOP' - End 'RCVLOOP' event receives.\r\n";
         write((const char*)str.c_str(), str.length());
+    } else if (m_pClientItem->CommandStartsWith(("binary"))) {
+        std::string str = "'BINARY' - Enter binary mode. Every frame is "
+                          "preceded by a two byte length (MSB first). ";
+        str += "The first frame byte is the packet type in the high nibble. "
+               "0 = event (UDP frame format), 1 = command, 2 = reply. ";
+        str += "Events are streamed as for 'RCVLOOP'. Terminate with "
+               "'QUITBINARY' sent as a command frame.\r\n";
+        write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith("cdta") ||
                m_pClientItem->CommandStartsWith("chkdata")) {
         std::string str = "'CDTA' or 'CHKDATA' - Check if there is events in "
@@ -2560,7 +3146,10 @@ tcpipClientObj::handleClientHelp(void)
         std::string str = "'CLRA' or 'CLRALL' - Clear input queue.\r\n";
         write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith(("stat"))) {
-        std::string str = "'STAT' - Get statistical information.\r\n";
+        std::string str = "'STAT' - Get statistical information.\r\n"
+                          "'STAT POOL' - Get event pool statistics.\r\n"
+                          "'STAT LATENCY' - Get delivery latency for each "
+                          "priority.\r\n";
         write((const char*)str.c_str(), str.length());
     } else if (m_pClientItem->CommandStartsWith("info")) {
         std::string str = "'INFO' - Get status information.\r\n";
@@ -2635,64 +3224,55 @@ tcpipClientObj::handleClientHelp(void)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Entry
+// open
 //
 
-void*
-tcpipClientThread(void* pData)
+bool
+tcpipClientObj::open(void)
 {
-    tcpipClientObj* ptcpipobj = (tcpipClientObj*)pData;
-    if (NULL == ptcpipobj) {
-        syslog(LOG_ERR,
-               "[TCP/IP srv client thread] Error, "
-               "Client thread object not initialized.");
-        return NULL;
-    }
-
-    if (NULL == ptcpipobj->m_pParent) {
+    if (NULL == m_pParent) {
         syslog(LOG_ERR,
-               "[TCP/IP srv client thread] Error, "
+               "[TCP/IP srv client] Error, "
                "Control object not initialized.");
-        return NULL;
+        return false;
     }
 
-    syslog(LOG_DEBUG, "[TCP/IP srv client thread] Thread started.");
-
-    ptcpipobj->m_pClientItem = new CClientItem();
-    if (NULL == ptcpipobj->m_pClientItem) {
+    m_pClientItem = new CClientItem();
+    if (NULL == m_pClientItem) {
         syslog(LOG_ERR,
-               "[TCP/IP srv client thread] Memory error, "
+               "[TCP/IP srv client] Memory error, "
                "Cant allocate client structure.");
-        return NULL;
+        return false;
     }
 
     vscpdatetime now;
-    ptcpipobj->m_pClientItem->m_bOpen = true;
-    ptcpipobj->m_pClientItem->m_type  = CLIENT_ITEM_INTERFACE_TYPE_CLIENT_TCPIP;
-    ptcpipobj->m_pClientItem->m_strDeviceName = ("Remote TCP/IP Server. [");
-    ptcpipobj->m_pClientItem->m_strDeviceName +=
-      ptcpipobj->m_pObj->m_strTcpInterfaceAddress;
-    ptcpipobj->m_pClientItem->m_strDeviceName += ("]|Started at ");
-    ptcpipobj->m_pClientItem->m_strDeviceName += now.getISODateTime();
+    m_pClientItem->m_bOpen         = true;
+    m_pClientItem->m_type          = CLIENT_ITEM_INTERFACE_TYPE_CLIENT_TCPIP;
+    m_pClientItem->m_strDeviceName = ("Remote TCP/IP Server. [");
+    m_pClientItem->m_strDeviceName += m_pObj->m_strTcpInterfaceAddress;
+    m_pClientItem->m_strDeviceName += ("]|Started at ");
+    m_pClientItem->m_strDeviceName += now.getISODateTime();
 
     // Start of activity
-    ptcpipobj->m_pClientItem->m_clientActivity = time(NULL);
+    m_pClientItem->m_clientActivity = time(NULL);
 
     // Add the client to the Client List
-    pthread_mutex_lock(&ptcpipobj->m_pObj->m_clientList.m_mutexItemList);
-    if (!ptcpipobj->m_pObj->addClient(ptcpipobj->m_pClientItem)) {
+    pthread_mutex_lock(&m_pObj->m_clientList.m_mutexItemList);
+    if (!m_pObj->addClient(m_pClientItem)) {
         // Failed to add client
-        delete ptcpipobj->m_pClientItem;
-        ptcpipobj->m_pClientItem = NULL;
-        pthread_mutex_unlock(&ptcpipobj->m_pObj->m_clientList.m_mutexItemList);
+        delete m_pClientItem;
+        m_pClientItem = NULL;
+        pthread_mutex_unlock(&m_pObj->m_clientList.m_mutexItemList);
         syslog(LOG_ERR,
-               "TCP/IP server: Failed to add client. Terminating thread.");
-        return NULL;
+               "TCP/IP server: Failed to add client. Closing connection.");
+        return false;
     }
-    pthread_mutex_unlock(&ptcpipobj->m_pObj->m_clientList.m_mutexItemList);
+    pthread_mutex_unlock(&m_pObj->m_clientList.m_mutexItemList);
 
     // Clear the filter (Allow everything )
-    vscp_clearVSCPFilter(&ptcpipobj->m_pClientItem->m_filter);
+    vscpEventFilter filter;
+    vscp_clearVSCPFilter(&filter);
+    m_pObj->m_clientList.setClientFilter(m_pClientItem, &filter);
 
     // Send welcome message
     std::string str = std::string(MSG_WELCOME);
@@ -2702,203 +3282,947 @@ tcpipClientThread(void* pData)
     str += std::string(VSCPD_COPYRIGHT);
     str += std::string("\r\n");
     str += std::string(MSG_OK);
-    ptcpipobj->write((const char*)str.c_str(), str.length());
+    write((const char*)str.c_str(), str.length());
 
     syslog(LOG_DEBUG, "[TCP/IP srv] Ready to serve client.");
 
-    // Enter command loop
-    char buf[8192];
-    struct pollfd fd;
-    while (!ptcpipobj->m_pParent->m_nStopTcpIpSrv) {
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// close
+//
 
-        // Check for client inactivity
-        if ((time(NULL) - ptcpipobj->m_pClientItem->m_clientActivity) >
-            TCPIPSRV_INACTIVITY_TIMOUT) {
-            syslog(
-              LOG_INFO,
-              "[TCP/IP srv client thread] Client closed due to inactivity.");
-            break;
-        }
+void
+tcpipClientObj::close(void)
+{
+    // Remove the client from the client queue
+    if (NULL != m_pParent) {
+        pthread_mutex_lock(&m_pParent->m_mutexTcpClientList);
+        m_pParent->m_tcpip_clientList.remove(this);
+        pthread_mutex_unlock(&m_pParent->m_mutexTcpClientList);
+    }
 
-        // * * * Receiveloop * * *
-        if (ptcpipobj->m_bReceiveLoop) {
+    // Close the connection
+    if (NULL != m_conn) {
+        stcp_close_connection(m_conn);
+        m_conn = NULL;
+    }
 
-            // Wait for data
-            vscp_sem_wait(&ptcpipobj->m_pClientItem->m_semClientInputQueue, 10);
+    if (NULL != m_pClientItem) {
 
-            // Send everything in the queue
-            while (ptcpipobj->sendOneEventFromQueue(false))
-                ;
+        // Close the channel
+        m_pClientItem->m_bOpen = false;
 
-            // Send '+OK<CR><LF>' every two seconds to indicate that the
-            // link is open
-            if ((time(NULL) - ptcpipobj->m_pClientItem->m_timeRcvLoop) > 2) {
-                ptcpipobj->m_pClientItem->m_timeRcvLoop    = time(NULL);
-                ptcpipobj->m_pClientItem->m_clientActivity = time(NULL);
-                ptcpipobj->write("+OK\r\n", 5);
-            }
+        // Remove the client from the Client List
+        pthread_mutex_lock(&m_pObj->m_clientList.m_mutexItemList);
+        m_pObj->removeClient(m_pClientItem);
+        pthread_mutex_unlock(&m_pObj->m_clientList.m_mutexItemList);
 
-        } else {
+        m_pClientItem = NULL;
+    }
 
-            // Set poll
-            fd.fd      = ptcpipobj->m_conn->client.sock;
-            fd.events  = POLLIN;
-            fd.revents = 0;
-
-            // Wait for data
-            if (stcp_poll(&fd,
-                          1,
-                          500,
-                          &(ptcpipobj->m_pParent->m_nStopTcpIpSrv)) < 0) {
-                continue; // Nothing
-            }
+    m_pParent = NULL;
 
-            // Data in?
-            if (!(fd.revents & POLLIN)) {
-                continue;
-            }
-        }
+    if (__VSCP_DEBUG_TCP) {
+        syslog(LOG_INFO, "[TCP/IP srv client] Closed.");
+    }
+}
 
-        // Read possible data from client
-        //      If in receive loop we know we have delay
-        //      in event waiting above.
-        memset(buf, 0, sizeof(buf));
-        int nRead = stcp_read(ptcpipobj->m_conn,
-                              buf,
-                              sizeof(buf),
-                              (ptcpipobj->m_bReceiveLoop) ? 0 : 0);
+///////////////////////////////////////////////////////////////////////////////
+// handleInput
+//
+
+int
+tcpipClientObj::handleInput(void)
+{
+    int nRead;
+    size_t nTotal = 0;
+
+    // Read what the client has sent so far. A short read means there
+    // is nothing more right now.
+    do {
 
-        if (0 == nRead) {
-            ; // Nothing more to read - Check for command and continue -> below
-        } else if (nRead < 0) {
+        char* pBuf = m_input.getWriteBuffer(TCPIPSRV_INPUT_READ_SIZE);
+        nRead      = stcp_read(m_conn, pBuf, TCPIPSRV_INPUT_READ_SIZE, 0);
+
+        if (nRead < 0) {
 
             if (STCP_ERROR_TIMEOUT == nRead) {
-                ptcpipobj->m_rv = VSCP_ERROR_TIMEOUT;
+                m_rv = VSCP_ERROR_TIMEOUT;
             } else if (STCP_ERROR_STOPPED == nRead) {
-                ptcpipobj->m_rv = VSCP_ERROR_STOPPED;
-                continue;
+                m_rv = VSCP_ERROR_STOPPED;
+                return VSCP_TCPIP_RV_OK;
             }
-            break;
+            return VSCP_TCPIP_RV_CLOSE;
         } else if (nRead > 0) {
-            ptcpipobj->m_strResponse += std::string(buf, nRead);
+            m_input.commitWrite(nRead);
+            nTotal += nRead;
         }
 
-        // Record client activity
-        ptcpipobj->m_pClientItem->m_clientActivity = time(NULL);
+    } while ((TCPIPSRV_INPUT_READ_SIZE == nRead) &&
+             (nTotal < TCPIPSRV_INPUT_READ_LIMIT));
 
-        // get data up to "\r\n" if any
-        size_t pos;
-        if (ptcpipobj->m_strResponse.npos !=
-            (pos = ptcpipobj->m_strResponse.find("\n"))) {
+    // Record client activity
+    m_pClientItem->m_clientActivity = time(NULL);
 
-            // Get the command
-            std::string strCommand =
-              vscp_str_left(ptcpipobj->m_strResponse, pos + 1);
+    return handleCommands();
+}
 
-            // Save the unhandled part
-            ptcpipobj->m_strResponse =
-              vscp_str_right(ptcpipobj->m_strResponse,
-                             ptcpipobj->m_strResponse.length() - pos - 1);
+///////////////////////////////////////////////////////////////////////////////
+// handleCommands
+//
 
-            // Remove whitespace
-            vscp_trim(strCommand);
+int
+tcpipClientObj::handleCommands(void)
+{
+    // Execute all complete commands (up to "\r\n") or frames. A
+    // command can switch mode so check it for each of them. Replies
+    // are collected and written together after the last command so a
+    // client that pipelines its commands gets all replies, in command
+    // order, in one write. Commands are left in the input buffer while
+    // the client does not take its replies.
+    int rv         = VSCP_TCPIP_RV_OK;
+    m_bInputPaused = false;
 
-            // If nothing to do do nothing - pretty obious if you think about it
-            if (0 == strCommand.length())
-                continue;
+    while (true) {
 
-            // Check for repeat command
-            // +    - repear last command
-            // +n   - Repeat n-th command
-            // ++
-            if (ptcpipobj->m_commandArray.size() && ('+' == strCommand[0])) {
-
-                if (vscp_startsWith(strCommand, "++", &strCommand)) {
-                    for (int i = ptcpipobj->m_commandArray.size() - 1; i >= 0;
-                         i--) {
-                        std::string str = vscp_str_format(
-                          "%d - %s",
-                          ptcpipobj->m_commandArray.size() - i - 1,
-                          ptcpipobj->m_commandArray[i]);
-                        vscp_trim(str);
-                        ptcpipobj->write(str, true);
-                    }
-                    continue;
-                }
+        // A "retr" or "retrn" that did not fit is done first
+        if (m_nRetrieveLeft) {
+            retrieveEvents();
+        }
 
-                // Get pos
-                unsigned int n = 0;
-                if (strCommand.length() > 1) {
-                    strCommand = strCommand.substr(strCommand.length() - 1);
-                    n          = vscp_readStringValue(strCommand);
-                }
+        if (isOutputFull()) {
+            m_bInputPaused = true;
+            break;
+        }
 
-                // Pos must be within range
-                if (n > ptcpipobj->m_commandArray.size()) {
-                    n = ptcpipobj->m_commandArray.size() - 1;
-                }
+        if (m_bBinary) {
 
-                // Get the command
-                strCommand =
-                  ptcpipobj
-                    ->m_commandArray[ptcpipobj->m_commandArray.size() - n - 1];
+            if (m_input.size() < 2) {
+                break;
+            }
 
-                // Write out the command
-                ptcpipobj->write(strCommand, true);
+            const uint8_t* p = (const uint8_t*)m_input.data();
+            size_t len       = (p[0] << 8) + p[1];
+            if (m_input.size() < (2 + len)) {
+                break;
             }
 
-            ptcpipobj->m_commandArray.push_back(
-              strCommand); // put at beginning of list
-            if (ptcpipobj->m_commandArray.size() >
-                VSCP_TCPIP_COMMAND_LIST_MAX) {
-                ptcpipobj->m_commandArray
-                  .pop_front(); // Remove last inserted item
+            // The frame stays in place until more data is read
+            m_input.consume(2 + len);
+
+            // Frames that belong to a block of events
+            if (m_nBlockLeft && len) {
+                addBlockFrame(p + 2, len);
+                continue;
             }
 
-            // Execute command
-            if (VSCP_TCPIP_RV_CLOSE == ptcpipobj->CommandHandler(strCommand)) {
+            if (VSCP_TCPIP_RV_CLOSE == handleFrame(p + 2, len)) {
+                rv = VSCP_TCPIP_RV_CLOSE;
                 break;
             }
+
+            continue;
         }
 
-    } // while
+        // Get the command
+        const char* pCommand;
+        size_t len;
+        if (!m_input.getLine(&pCommand, &len)) {
+            break;
+        }
 
-    // Remove the client from the client queue
-    pthread_mutex_lock(&ptcpipobj->m_pParent->m_mutexTcpClientList);
-    std::list<tcpipClientObj*>::iterator it;
-    for (it = ptcpipobj->m_pParent->m_tcpip_clientList.begin();
-         it != ptcpipobj->m_pParent->m_tcpip_clientList.end();
-         ++it) {
+        // If nothing to do do nothing - pretty obious if you think about it
+        if (0 == len) {
+            continue;
+        }
 
-        tcpipClientObj* pclient             = *it; // TODO check
-        struct stcp_connection* stored_conn = pclient->m_conn;
-        if (stored_conn->client.id == ptcpipobj->m_conn->client.id) {
-            ptcpipobj->m_pParent->m_tcpip_clientList.erase(it);
+        // Lines that belong to a block of events
+        if (m_nBlockLeft) {
+            addBlockLine(pCommand, len);
+            continue;
+        }
+
+        if (VSCP_TCPIP_RV_CLOSE == handleCommandLine(pCommand, len)) {
+            rv = VSCP_TCPIP_RV_CLOSE;
             break;
         }
     }
-    pthread_mutex_unlock(&ptcpipobj->m_pParent->m_mutexTcpClientList);
 
-    // Close the connection
-    stcp_close_connection(ptcpipobj->m_conn);
-    ptcpipobj->m_conn = NULL;
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// handleFrame
+//
+
+int
+tcpipClientObj::handleFrame(const uint8_t* pFrame, size_t len)
+{
+    // Empty frames can be used as keepalive
+    if (0 == len) {
+        return VSCP_TCPIP_RV_OK;
+    }
+
+    // Encrypted frames are not supported on this link
+    if (VSCP_ENCRYPTION_NONE != GET_VSCP_MULTICAST_PACKET_ENCRYPTION(pFrame[0])) {
+        write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
+        return VSCP_TCPIP_RV_OK;
+    }
+
+    switch (GET_VSCP_MULTICAST_PACKET_TYPE(pFrame[0])) {
+
+        case VSCP_BINARY_TYPE_EVENT:
+            handleClientSendFrame(pFrame, len);
+            break;
+
+        case VSCP_BINARY_TYPE_COMMAND: {
+            const char* pCommand = (const char*)pFrame + 1;
+            len--;
+            CLineScanner::trim(&pCommand, &len);
+            if (0 == len) {
+                break;
+            }
+            return handleCommandLine(pCommand, len);
+        }
+
+        default:
+            write(MSG_PARAMETER_ERROR, strlen(MSG_PARAMETER_ERROR));
+            break;
+    }
+
+    return VSCP_TCPIP_RV_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// handleCommandLine
+//
+
+int
+tcpipClientObj::handleCommandLine(const char* pCommand, size_t len)
+{
+    std::string strCommand;
+
+    // Check for repeat command
+    // +    - repeat last command
+    // +n   - Repeat n-th command (0 is the last one)
+    // ++   - List saved commands
+    if (m_commandHistory.size() && ('+' == pCommand[0])) {
+
+        if ((len > 1) && ('+' == pCommand[1])) {
+            for (size_t i = 0; i < m_commandHistory.size(); i++) {
+                std::string str = vscp_str_format(
+                  "%zu - %s", i, m_commandHistory.get(i)->c_str());
+                write(str, true);
+            }
+            return VSCP_TCPIP_RV_OK;
+        }
+
+        // Get pos
+        size_t n = 0;
+        if (len > 1) {
+            n = vscp_readStringValue(std::string(pCommand + 1, len - 1));
+        }
+
+        // Pos must be within range
+        if (n >= m_commandHistory.size()) {
+            n = m_commandHistory.size() - 1;
+        }
+
+        // Get the command. Copied as the slot is reused by add below.
+        strCommand = *m_commandHistory.get(n);
+
+        // Write out the command
+        write(strCommand, true);
+
+        pCommand = strCommand.c_str();
+        len      = strCommand.length();
+    }
+
+    m_commandHistory.add(pCommand, len);
+
+    // Execute command
+    return CommandHandler(pCommand, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// formatEvent
+//
+
+void
+tcpipClientObj::formatEvent(std::string& strOut, CSharedEvent* pSharedEvent)
+{
+    const vscpEvent* pEvent = pSharedEvent->getEvent();
+
+    if (m_bBinary) {
+
+        // Length + event frame
+        uint8_t buf[2 + VSCP_BINARY_MAX_EVENT_FRAME];
+        size_t size =
+          1 + VSCP_MULTICAST_PACKET0_HEADER_LENGTH + pEvent->sizeData + 2;
+
+        if (vscp_writeEventToFrame(
+              buf + 2,
+              sizeof(buf) - 2,
+              SET_VSCP_MULTICAST_TYPE(VSCP_BINARY_TYPE_EVENT,
+                                      VSCP_ENCRYPTION_NONE),
+              pEvent)) {
+            buf[0] = (size >> 8) & 0xff;
+            buf[1] = size & 0xff;
+            strOut.append((const char*)buf, 2 + size);
+        }
+
+    } else {
+        const std::string* pstr = pSharedEvent->getString();
+        if (NULL != pstr) {
+            strOut += *pstr;
+            strOut += "\r\n";
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fillOutput
+//
+
+int
+tcpipClientObj::fillOutput(int maxEvents)
+{
+    int cnt = 0;
+
+    // Allocated first time it is needed and then reused
+    if (m_outBuf.capacity() < TCPIPSRV_OUTPUT_BUFFER_SIZE) {
+        m_outBuf.reserve(TCPIPSRV_OUTPUT_BUFFER_SIZE);
+    }
+
+    while ((cnt < maxEvents) &&
+           (m_outBuf.length() < TCPIPSRV_OUTPUT_BUFFER_SIZE)) {
+
+        CSharedEvent* pqueueEvent = m_pClientItem->m_clientInputQueue.pop();
+        if (NULL == pqueueEvent) {
+            break;
+        }
+
+        formatEvent(m_outBuf, pqueueEvent);
+        pqueueEvent->release();
+        cnt++;
+    }
+
+    return cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isOutputFull
+//
+
+bool
+tcpipClientObj::isOutputFull(void)
+{
+    return ((m_outBuf.length() - m_outPos) >= TCPIPSRV_OUTPUT_LIMIT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// flushOutput
+//
+
+int
+tcpipClientObj::flushOutput(void)
+{
+    while (m_outPos < m_outBuf.length()) {
+
+        int n = stcp_write_nonblocking(
+          m_conn, m_outBuf.data() + m_outPos, m_outBuf.length() - m_outPos);
+        if (n < 0) {
+            return -1;
+        } else if (0 == n) {
+            return 0;
+        }
+
+        m_outPos += n;
+    }
+
+    // Keep the allocated space
+    m_outBuf.clear();
+    m_outPos = 0;
+
+    return 1;
+}
+
+// ****************************************************************************
+//                              Worker thread
+// ****************************************************************************
+
+///////////////////////////////////////////////////////////////////////////////
+// tcpipWorkerObj
+//
+
+tcpipWorkerObj::tcpipWorkerObj(tcpipListenThreadObj* pParent)
+{
+    m_pParent          = pParent;
+    m_fdEpoll          = -1;
+    m_fdWakeup         = -1;
+    m_nConnections     = 0;
+    m_lastHouseKeeping = time(NULL);
+
+    pthread_mutex_init(&m_mutexNewConnections, NULL);
+}
+
+tcpipWorkerObj::~tcpipWorkerObj()
+{
+    if (-1 != m_fdWakeup) {
+        close(m_fdWakeup);
+    }
+
+    if (-1 != m_fdEpoll) {
+        close(m_fdEpoll);
+    }
+
+    pthread_mutex_destroy(&m_mutexNewConnections);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+bool
+tcpipWorkerObj::init(void)
+{
+    struct epoll_event ev;
+
+    m_fdEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 == m_fdEpoll) {
+        syslog(LOG_ERR, "[TCP/IP srv] -- Failed to create epoll set.");
+        return false;
+    }
+
+    m_fdWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (-1 == m_fdWakeup) {
+        syslog(LOG_ERR, "[TCP/IP srv] -- Failed to create worker eventfd.");
+        return false;
+    }
+
+    // The wake up descriptor is the only one with zero in data
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.u64 = 0;
+    if (-1 == epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, m_fdWakeup, &ev)) {
+        syslog(LOG_ERR, "[TCP/IP srv] -- Failed to add worker eventfd.");
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addConnection
+//
+
+void
+tcpipWorkerObj::addConnection(tcpipClientObj* pClientObj)
+{
+    uint64_t one = 1;
+
+    pClientObj->m_pWorker = this;
+    m_nConnections++;
+
+    pthread_mutex_lock(&m_mutexNewConnections);
+    m_newConnections.push_back(pClientObj);
+    pthread_mutex_unlock(&m_mutexNewConnections);
+
+    if (sizeof(one) != write(m_fdWakeup, &one, sizeof(one))) {
+        ; // Counter is already signaled
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// openNewConnections
+//
+
+void
+tcpipWorkerObj::openNewConnections(void)
+{
+    std::deque<tcpipClientObj*> newConnections;
+    struct epoll_event ev;
+
+    pthread_mutex_lock(&m_mutexNewConnections);
+    newConnections.swap(m_newConnections);
+    pthread_mutex_unlock(&m_mutexNewConnections);
+
+    while (newConnections.size()) {
+
+        tcpipClientObj* pClientObj = newConnections.front();
+        newConnections.pop_front();
+
+        m_connections.push_back(pClientObj);
+        pClientObj->m_itWorker = --m_connections.end();
+
+        // Secure connections are opened when the handshake is done
+        if (!pClientObj->m_bHandshake && !pClientObj->open()) {
+            closeConnection(pClientObj);
+            continue;
+        }
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN;
+        ev.data.ptr = pClientObj;
+        if (-1 == epoll_ctl(m_fdEpoll,
+                            EPOLL_CTL_ADD,
+                            pClientObj->m_conn->client.sock,
+                            &ev)) {
+            syslog(LOG_ERR,
+                   "[TCP/IP srv] -- Failed to add connection to epoll set.");
+            closeConnection(pClientObj);
+            continue;
+        }
+
+        // The client hello is often already here. Else the welcome
+        // message is sent.
+        if (pClientObj->m_bHandshake) {
+            serviceHandshake(pClientObj);
+        } else {
+            serviceReceiveLoop(pClientObj);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// serviceHandshake
+//
+
+void
+tcpipWorkerObj::serviceHandshake(tcpipClientObj* pClientObj)
+{
+    int rv = stcp_ssl_accept_nonblocking(pClientObj->m_conn,
+                                         m_pParent->m_srvctx.ssl_ctx);
+
+    // Wait for the client or for room to write
+    if (STCP_SSL_HANDSHAKE_WANT_READ == rv) {
+        if (pClientObj->m_bWantWrite) {
+            setSocketEvents(pClientObj, false);
+        }
+        return;
+    } else if (STCP_SSL_HANDSHAKE_WANT_WRITE == rv) {
+        if (!pClientObj->m_bWantWrite) {
+            setSocketEvents(pClientObj, true);
+        }
+        return;
+    } else if (STCP_SSL_HANDSHAKE_DONE != rv) {
+        m_pParent->m_cntHandshakesFailed++;
+        syslog(LOG_ERR,
+               "[TCP/IP srv] -- SSL handshake failed with %s.",
+               pClientObj->m_conn->remote_addr);
+        closeConnection(pClientObj);
+        return;
+    }
+
+    pClientObj->m_bHandshake = false;
+    if (pClientObj->m_bWantWrite) {
+        setSocketEvents(pClientObj, false);
+    }
+
+    bool bResumed = stcp_ssl_session_reused(pClientObj->m_conn);
+    m_pParent->m_handshakeLatency.record(
+      bResumed ? VSCP_TCPIP_HANDSHAKE_RESUMED : VSCP_TCPIP_HANDSHAKE_FULL,
+      CEventLatency::now() - pClientObj->m_timeAccepted);
+    m_pParent->m_cntHandshakes++;
+    if (bResumed) {
+        m_pParent->m_cntHandshakesResumed++;
+    }
+
+    if (!pClientObj->open()) {
+        closeConnection(pClientObj);
+        return;
+    }
+
+    // Welcome message
+    serviceReceiveLoop(pClientObj);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// serviceInput
+//
+
+void
+tcpipWorkerObj::serviceInput(tcpipClientObj* pClientObj)
+{
+    if (VSCP_TCPIP_RV_CLOSE == pClientObj->handleInput()) {
+        pClientObj->flushOutput(); // Last reply if the socket can take it
+        closeConnection(pClientObj);
+        return;
+    }
+
+    // Send the replies. The commands may also have entered or left the
+    // receive loop.
+    serviceReceiveLoop(pClientObj);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// serviceReceiveLoop
+//
+
+void
+tcpipWorkerObj::serviceReceiveLoop(tcpipClientObj* pClientObj)
+{
+    struct epoll_event ev;
+
+    if (pClientObj->m_bClosed) {
+        return;
+    }
+
+    // Replies and events are collected in the output buffer and written
+    // with one call. Don't block the worker on a client that does not
+    // read. What is left is sent when the socket can take more. Wait
+    // until the client has taken what we sent last time.
+    int rv = 0;
+    if (!pClientObj->m_bWantWrite) {
+
+        rv = pClientObj->flushOutput();
+
+        // Commands left when the client did not take its replies. One
+        // round for each turn of the connection.
+        if ((rv > 0) && pClientObj->m_bInputPaused) {
+            if (VSCP_TCPIP_RV_CLOSE == pClientObj->handleCommands()) {
+                pClientObj->flushOutput();
+                closeConnection(pClientObj);
+                return;
+            }
+            rv = pClientObj->flushOutput();
+        }
+    }
+
+    CClientQueue& queue = pClientObj->m_pClientItem->m_clientInputQueue;
+
+    // Not (or no longer) in receive loop
+    if (!pClientObj->m_bReceiveLoop && pClientObj->m_bQueueArmed) {
+        epoll_ctl(m_fdEpoll, EPOLL_CTL_DEL, queue.getEventFd(), NULL);
+        pClientObj->m_bQueueArmed = false;
+    }
+
+    // Just entered receive loop - wake up when events arrive
+    if (pClientObj->m_bReceiveLoop && !pClientObj->m_bQueueArmed) {
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN;
+        ev.data.u64 = (uint64_t)(uintptr_t)pClientObj | TCPIPSRV_EPOLL_TAG_QUEUE;
+        if (-1 ==
+            epoll_ctl(m_fdEpoll, EPOLL_CTL_ADD, queue.getEventFd(), &ev)) {
+            syslog(LOG_ERR,
+                   "[TCP/IP srv] -- Failed to add client queue to epoll set.");
+            closeConnection(pClientObj);
+            return;
+        }
+
+        pClientObj->m_bQueueArmed = true;
+    }
+
+    int cnt = 0;
+    while ((rv > 0) && pClientObj->m_bReceiveLoop) {
+
+        if (cnt >= TCPIPSRV_RCVLOOP_BATCH) {
+            break;
+        }
+
+        int n = pClientObj->fillOutput(TCPIPSRV_RCVLOOP_BATCH - cnt);
+
+        // Queue is empty
+        if (0 == n) {
+            break;
+        }
+
+        cnt += n;
+        rv = pClientObj->flushOutput();
+    }
+
+    if (rv < 0) {
+        closeConnection(pClientObj);
+        return;
+    }
+
+    // Wait for room if not all was written
+    setSocketEvents(pClientObj, (0 == rv));
+
+    // More commands left to execute after the other connections
+    if ((rv > 0) && pClientObj->m_bInputPaused && !pClientObj->m_bPending) {
+        pClientObj->m_bPending = true;
+        m_pending.push_back(pClientObj);
+    }
+
+    if ((0 == rv) || !pClientObj->m_bReceiveLoop) {
+        return;
+    }
+
+    // Let the other connections in before sending more, or go to sleep
+    // if the queue is empty. If events came in after the last check
+    // the queue is served again after this round.
+    if ((cnt >= TCPIPSRV_RCVLOOP_BATCH) || !queue.prepareWait()) {
+        if (!pClientObj->m_bPending) {
+            pClientObj->m_bPending = true;
+            m_pending.push_back(pClientObj);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// houseKeeping
+//
+
+void
+tcpipWorkerObj::houseKeeping(void)
+{
+    time_t now = time(NULL);
+
+    std::list<tcpipClientObj*>::iterator it = m_connections.begin();
+    while (it != m_connections.end()) {
+
+        tcpipClientObj* pClientObj = *it;
+        ++it; // closeConnection removes the connection from the list
+
+        // Not opened yet
+        if (pClientObj->m_bHandshake) {
+            if ((CEventLatency::now() - pClientObj->m_timeAccepted) >
+                (uint64_t)TCPIPSRV_HANDSHAKE_TIMEOUT * 1000000) {
+                m_pParent->m_cntHandshakesFailed++;
+                syslog(LOG_INFO,
+                       "[TCP/IP srv worker] SSL handshake timed out.");
+                closeConnection(pClientObj);
+            }
+            continue;
+        }
+
+        // Check for client inactivity
+        if ((now - pClientObj->m_pClientItem->m_clientActivity) >
+            TCPIPSRV_INACTIVITY_TIMOUT) {
+            syslog(LOG_INFO,
+                   "[TCP/IP srv worker] Client closed due to inactivity.");
+            closeConnection(pClientObj);
+            continue;
+        }
+
+        // Send '+OK<CR><LF>' every two seconds to indicate that the
+        // link is open. There is no text keepalive in binary mode and
+        // none is needed while events are waiting for the socket.
+        if (pClientObj->m_bReceiveLoop &&
+            ((now - pClientObj->m_pClientItem->m_timeRcvLoop) > 2)) {
+            pClientObj->m_pClientItem->m_timeRcvLoop    = now;
+            pClientObj->m_pClientItem->m_clientActivity = now;
+            if (!pClientObj->m_bBinary && !pClientObj->m_bWantWrite) {
+                pClientObj->write("+OK\r\n", 5);
+                serviceReceiveLoop(pClientObj);
+            }
+        }
+    }
+
+    m_lastHouseKeeping = now;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// closeConnection
+//
+
+void
+tcpipWorkerObj::closeConnection(tcpipClientObj* pClientObj)
+{
+    if (pClientObj->m_bClosed) {
+        return;
+    }
 
-    // Close the channel
-    ptcpipobj->m_pClientItem->m_bOpen = false;
+    pClientObj->m_bClosed = true;
+
+    if (NULL != pClientObj->m_conn) {
+        epoll_ctl(
+          m_fdEpoll, EPOLL_CTL_DEL, pClientObj->m_conn->client.sock, NULL);
+    }
+
+    if (pClientObj->m_bQueueArmed) {
+        epoll_ctl(m_fdEpoll,
+                  EPOLL_CTL_DEL,
+                  pClientObj->m_pClientItem->m_clientInputQueue.getEventFd(),
+                  NULL);
+        pClientObj->m_bQueueArmed = false;
+    }
+
+    m_connections.erase(pClientObj->m_itWorker);
+    m_closed.push_back(pClientObj);
+    m_nConnections--;
+}
 
-    // Remove the client from the Client List
-    pthread_mutex_lock(&ptcpipobj->m_pObj->m_clientList.m_mutexItemList);
-    ptcpipobj->m_pObj->removeClient(ptcpipobj->m_pClientItem);
-    pthread_mutex_unlock(&ptcpipobj->m_pObj->m_clientList.m_mutexItemList);
+///////////////////////////////////////////////////////////////////////////////
+// deleteClosedConnections
+//
+
+void
+tcpipWorkerObj::deleteClosedConnections(void)
+{
+    if (!m_closed.size()) {
+        return;
+    }
+
+    // Closed connections may still wait for their turn to send
+    std::vector<tcpipClientObj*>::iterator itPending = m_pending.begin();
+    while (itPending != m_pending.end()) {
+        if ((*itPending)->m_bClosed) {
+            itPending = m_pending.erase(itPending);
+        } else {
+            ++itPending;
+        }
+    }
 
-    ptcpipobj->m_pClientItem = NULL;
-    ptcpipobj->m_pParent     = NULL;
+    std::vector<tcpipClientObj*>::iterator it;
+    for (it = m_closed.begin(); it != m_closed.end(); ++it) {
+        (*it)->close();
+        delete *it;
+    }
+
+    m_closed.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setSocketEvents
+//
+
+void
+tcpipWorkerObj::setSocketEvents(tcpipClientObj* pClientObj, bool bWrite)
+{
+    struct epoll_event ev;
+
+    // Nothing more is read from a client that does not take its replies
+    bool bRead = !pClientObj->m_bInputPaused;
+
+    if ((bWrite == pClientObj->m_bWantWrite) &&
+        (bRead != pClientObj->m_bReadStopped)) {
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = (bRead ? EPOLLIN : 0) | (bWrite ? EPOLLOUT : 0);
+    ev.data.ptr = pClientObj;
+    epoll_ctl(m_fdEpoll, EPOLL_CTL_MOD, pClientObj->m_conn->client.sock, &ev);
+
+    pClientObj->m_bWantWrite   = bWrite;
+    pClientObj->m_bReadStopped = !bRead;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// tcpipWorkerThread
+//
+// Serve connections handed over by the listen thread. Commands are read and
+// executed when the socket is readable and connections in receive loop are
+// fed when their client input queue is signaled.
+//
+
+void*
+tcpipWorkerThread(void* pData)
+{
+    struct epoll_event events[TCPIPSRV_WORKER_MAX_EVENTS];
+
+    tcpipWorkerObj* pWorker = (tcpipWorkerObj*)pData;
+    if (NULL == pWorker) {
+        syslog(LOG_ERR,
+               "[TCP/IP srv worker] Error, "
+               "Worker object not initialized.");
+        return NULL;
+    }
+
+    if (__VSCP_DEBUG_TCP) {
+        syslog(LOG_DEBUG, "[TCP/IP srv worker] Thread started.");
+    }
+
+    while (!pWorker->m_pParent->m_nStopTcpIpSrv) {
+
+        // Don't sleep if there are events left to send
+        int n = epoll_wait(pWorker->m_fdEpoll,
+                           events,
+                           TCPIPSRV_WORKER_MAX_EVENTS,
+                           pWorker->m_pending.size()
+                             ? 0
+                             : TCPIPSRV_WORKER_POLL_TIMEOUT);
+        if ((n < 0) && (EINTR != errno)) {
+            syslog(LOG_ERR, "[TCP/IP srv worker] epoll_wait failed.");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+
+            uint64_t data = events[i].data.u64;
+
+            // New connections from the listen thread
+            if (0 == data) {
+                uint64_t cnt;
+                while (sizeof(cnt) ==
+                       read(pWorker->m_fdWakeup, &cnt, sizeof(cnt))) {
+                    ;
+                }
+                pWorker->openNewConnections();
+                continue;
+            }
+
+            tcpipClientObj* pClientObj = (tcpipClientObj*)(uintptr_t)(
+              data & ~(uint64_t)TCPIPSRV_EPOLL_TAG_QUEUE);
+            if (pClientObj->m_bClosed) {
+                continue;
+            }
+
+            // Secure connection that is still in its handshake
+            if (pClientObj->m_bHandshake) {
+                pWorker->serviceHandshake(pClientObj);
+                continue;
+            }
+
+            // Events for a connection in receive loop
+            if (data & TCPIPSRV_EPOLL_TAG_QUEUE) {
+                pClientObj->m_pClientItem->m_clientInputQueue.finishWait();
+                pWorker->serviceReceiveLoop(pClientObj);
+                continue;
+            }
+
+            // Client can take more events
+            if (events[i].events & EPOLLOUT) {
+                pWorker->setSocketEvents(pClientObj, false);
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                pWorker->serviceInput(pClientObj);
+            } else {
+                pWorker->serviceReceiveLoop(pClientObj);
+            }
+        }
+
+        // Connections that have more events to send
+        std::vector<tcpipClientObj*> pending;
+        pending.swap(pWorker->m_pending);
+        std::vector<tcpipClientObj*>::iterator it;
+        for (it = pending.begin(); it != pending.end(); ++it) {
+            (*it)->m_bPending = false;
+            pWorker->serviceReceiveLoop(*it);
+        }
+
+        if (time(NULL) != pWorker->m_lastHouseKeeping) {
+            pWorker->houseKeeping();
+        }
+
+        pWorker->deleteClosedConnections();
+
+    } // while
+
+    // Close all connections, also the ones never taken over
+    pthread_mutex_lock(&pWorker->m_mutexNewConnections);
+    while (pWorker->m_newConnections.size()) {
+        tcpipClientObj* pClientObj = pWorker->m_newConnections.front();
+        pWorker->m_newConnections.pop_front();
+        pWorker->m_connections.push_back(pClientObj);
+        pClientObj->m_itWorker = --pWorker->m_connections.end();
+    }
+    pthread_mutex_unlock(&pWorker->m_mutexNewConnections);
+
+    while (pWorker->m_connections.size()) {
+        pWorker->closeConnection(pWorker->m_connections.front());
+    }
 
-    // Delete the client object
-    delete ptcpipobj;
+    pWorker->deleteClosedConnections();
 
     if (__VSCP_DEBUG_TCP) {
-        syslog(LOG_INFO, "[TCP/IP srv client thread] Exit.");
+        syslog(LOG_INFO, "[TCP/IP srv worker] Exit.");
     }
 
     return NULL;
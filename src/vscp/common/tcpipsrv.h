@@ -31,14 +31,24 @@
 
 #include <sockettcp.h>
 
+#include <atomic>
+#include <deque>
+#include <list>
+#include <vector>
+
 #include "clientlist.h"
+#include "commandhistory.h"
+#include "eventlatency.h"
+#include "linescanner.h"
 #include "controlobject.h"
 #include "userlist.h"
 
 #define VSCP_TCPIP_SRV_RUN  0
 #define VSCP_TCPIP_SRV_STOP 1
 
-#define VSCP_TCPIP_COMMAND_LIST_MAX 200 // Max number of saved old commands
+#define VSCP_TCPIP_COMMAND_LIST_MAX 200 // Default number of saved old commands
+
+#define VSCP_TCPIP_MAX_BLOCK_EVENTS 4096 // Max number of events in SENDN
 
 #define VSCP_TCPIP_RV_OK    0
 #define VSCP_TCPIP_RV_ERROR -1
@@ -46,6 +56,16 @@
 
 #define VSCP_TCP_MAX_CLIENTS 1024
 
+#define VSCP_TCPIP_MAX_WORKERS 64 // Max number of connection worker threads
+
+// Default SSL session cache size and seconds a session can be resumed
+#define VSCP_TCPIP_SSL_SESSION_CACHE_SIZE 20480
+#define VSCP_TCPIP_SSL_SESSION_TIMEOUT    300
+
+// Handshake latency histogram slots
+#define VSCP_TCPIP_HANDSHAKE_FULL    0 // Full handshake
+#define VSCP_TCPIP_HANDSHAKE_RESUMED 1 // Resumed session
+
 #define MSG_WELCOME       "Welcome to the VSCP daemon.\r\n"
 #define MSG_OK            "+OK - Success.\r\n"
 #define MSG_GOODBY        "+OK - Connection closed by client.\r\n"
@@ -56,11 +76,15 @@
 #define MSG_RECEIVE_LOOP                                                       \
     "+OK - Receive loop entered. QUITLOOP to terminate.\r\n"
 #define MSG_QUIT_LOOP "+OK - Quit receive loop.\r\n"
+#define MSG_BINARY_MODE                                                        \
+    "+OK - Binary mode entered. QUITBINARY to terminate.\r\n"
+#define MSG_QUIT_BINARY "+OK - Quit binary mode.\r\n"
 
 #define MSG_ERROR           "-OK - Error\r\n"
 #define MSG_UNKNOWN_COMMAND "-OK - Unknown command\r\n"
 #define MSG_PARAMETER_ERROR "-OK - Invalid parameter or format\r\n"
 #define MSG_BUFFER_FULL     "-OK - Buffer Full\r\n"
+#define MSG_RATE_LIMITED    "-OK - Rate limit exceeded, try again later.\r\n"
 #define MSG_NO_MSG          "-OK - No event(s) available\r\n"
 
 #define MSG_PASSWORD_ERROR "-OK - Invalid username or password.\r\n"
@@ -122,6 +146,7 @@ typedef const char* (*COMMAND_METHOD)(void);
 
 // Forward declarations
 class tcpipClientObj;
+class tcpipWorkerObj;
 
 /*!
     Class that defines one command
@@ -160,12 +185,24 @@ class tcpipListenThreadObj
     void setControlObjectPointer(CControlObject* pobj) { m_pObj = pobj; };
     CControlObject* getControlObject(void) { return m_pObj; };
 
+    /*!
+        Set number of worker threads that serve the connections
+        @param n Number of workers (1 - VSCP_TCPIP_MAX_WORKERS)
+    */
+    void setWorkers(uint8_t n);
+
     // This mutex protects the clientlist
     pthread_mutex_t m_mutexTcpClientList;
 
     // List with active tcp/ip clients
     std::list<tcpipClientObj*> m_tcpip_clientList;
 
+    // Worker threads that serve the connections
+    std::vector<tcpipWorkerObj*> m_workers;
+
+    // Number of worker threads
+    uint8_t m_nWorkers;
+
     // Listening port
     std::string m_strListeningPort;
 
@@ -175,6 +212,16 @@ class tcpipListenThreadObj
     // Counter for client id's
     unsigned long m_idCounter;
 
+    // SSL handshakes done by the workers, the ones that resumed a
+    // session and the ones that failed or timed out
+    std::atomic<uint64_t> m_cntHandshakes;
+    std::atomic<uint64_t> m_cntHandshakesResumed;
+    std::atomic<uint64_t> m_cntHandshakesFailed;
+
+    // Time from accept to finished handshake in microseconds. Slot
+    // VSCP_TCPIP_HANDSHAKE_FULL/VSCP_TCPIP_HANDSHAKE_RESUMED.
+    CEventLatency m_handshakeLatency;
+
     int m_nStopTcpIpSrv;
 
     // Pointer to the mother of all things
@@ -184,8 +231,131 @@ class tcpipListenThreadObj
 // ----------------------------------------------------------------------------
 
 /*!
-    This class implement the worker thread for
-    the vscpd connections on the TCP interface
+    This class implement a worker thread for the vscpd connections on
+    the TCP interface
+
+    Each worker serve many connections with an epoll loop. A connection
+    belongs to one worker for its whole life so the connection is only
+    touched by one thread. The listen thread accept new connections and
+    hand them to the worker with the fewest connections.
+
+    A connection in receive loop also has the eventfd of its client input
+    queue in the epoll set so the worker wakes up when events arrive.
+*/
+
+class tcpipWorkerObj
+{
+
+  public:
+    /// Constructor
+    tcpipWorkerObj(tcpipListenThreadObj* pParent);
+
+    /// Destructor
+    ~tcpipWorkerObj();
+
+    /*!
+        Create the epoll set and the wake up descriptor
+        @return true on success
+    */
+    bool init(void);
+
+    /*!
+        Give a new connection to the worker. Called by the listen thread.
+        @param pClientObj Connection to serve. The worker owns it from now.
+    */
+    void addConnection(tcpipClientObj* pClientObj);
+
+    /*!
+        Take over connections queued by the listen thread
+    */
+    void openNewConnections(void);
+
+    /*!
+        Continue the SSL handshake of a secure connection and open the
+        connection when it is done
+        @param pClientObj Connection
+    */
+    void serviceHandshake(tcpipClientObj* pClientObj);
+
+    /*!
+        Read and execute commands from a connection
+        @param pClientObj Connection
+    */
+    void serviceInput(tcpipClientObj* pClientObj);
+
+    /*!
+        Write replies and send queued events to a connection in receive
+        loop and set up what to wait for next. Also handles enter/exit of
+        receive loop and the commands left when the output was full.
+        @param pClientObj Connection
+    */
+    void serviceReceiveLoop(tcpipClientObj* pClientObj);
+
+    /*!
+        Receive loop keep alive messages, inactivity timeout and
+        handshake timeout
+    */
+    void houseKeeping(void);
+
+    /*!
+        Close a connection. The object is deleted when the events
+        from the current epoll_wait have been handled.
+        @param pClientObj Connection
+    */
+    void closeConnection(tcpipClientObj* pClientObj);
+
+    /*!
+        Delete closed connections
+    */
+    void deleteClosedConnections(void);
+
+    /*!
+        Set the events to wait for on the connection socket
+        @param pClientObj Connection
+        @param bWrite true to also wait for the socket to be writable.
+            The socket is not read while the input is paused.
+    */
+    void setSocketEvents(tcpipClientObj* pClientObj, bool bWrite);
+
+    // Listen thread object
+    tcpipListenThreadObj* m_pParent;
+
+    // epoll set
+    int m_fdEpoll;
+
+    // Wakes the worker when there are new connections
+    int m_fdWakeup;
+
+    // Connections from the listen thread not yet taken over
+    std::deque<tcpipClientObj*> m_newConnections;
+
+    // Protects m_newConnections
+    pthread_mutex_t m_mutexNewConnections;
+
+    // Connections served by this worker
+    std::list<tcpipClientObj*> m_connections;
+
+    // Connections in receive loop with more events to send
+    std::vector<tcpipClientObj*> m_pending;
+
+    // Connections closed during the current round
+    std::vector<tcpipClientObj*> m_closed;
+
+    // Number of connections (read by the listen thread)
+    std::atomic<size_t> m_nConnections;
+
+    // Time of last house keeping
+    time_t m_lastHouseKeeping;
+
+    // The worker thread
+    pthread_t m_workerThread;
+};
+
+// ----------------------------------------------------------------------------
+
+/*!
+    This class implement one connection on the TCP interface. The
+    connection is served by a tcpipWorkerObj.
 */
 
 class tcpipClientObj
@@ -209,7 +379,8 @@ class tcpipClientObj
     bool write(std::string& str, bool bAddCRLF = false);
 
     /*!
-     * Write string to client
+     * Write string to client. It is added to the output buffer that the
+     * worker writes when the socket can take it.
      * @param buf Pointer to string to write
      * @param len Number of characters to write.
      * @return True on success, false on failure
@@ -225,11 +396,87 @@ class tcpipClientObj
      */
     bool read(std::string& str);
 
+    /*!
+        Set up the client and send the welcome message. Called by the
+        worker when it takes over the connection.
+        @return true on success, false if the connection should be closed.
+    */
+    bool open(void);
+
+    /*!
+        Remove the client and close the connection
+    */
+    void close(void);
+
+    /*!
+        Read what the client has sent and execute all complete commands
+        @return VSCP_TCPIP_RV_CLOSE if the connection should be closed,
+            else VSCP_TCPIP_RV_OK.
+    */
+    int handleInput(void);
+
+    /*!
+        Execute the complete commands in the input buffer. Stops with
+        m_bInputPaused set if the output buffer is full.
+        @return VSCP_TCPIP_RV_CLOSE if the connection should be closed,
+            else VSCP_TCPIP_RV_OK.
+    */
+    int handleCommands(void);
+
+    /*!
+        Execute one command line. Handles the '+' repeat commands and
+        the command history.
+        @param pCommand Command line without line end. Need not be NULL
+            terminated.
+        @param len Length of command line.
+        @return VSCP_TCPIP_RV_CLOSE if the connection should be closed.
+    */
+    int handleCommandLine(const char* pCommand, size_t len);
+
+    /*!
+        Execute one binary mode frame
+        @param pFrame Frame without the length.
+        @param len Size of frame.
+        @return VSCP_TCPIP_RV_CLOSE if the connection should be closed.
+    */
+    int handleFrame(const uint8_t* pFrame, size_t len);
+
+    /*!
+        Add an event to an output string. A text line is added or in
+        binary mode a length prefixed frame. The text line is rendered
+        once for all clients that receive the shared event.
+        @param strOut String the event is added to.
+        @param pSharedEvent Event to add.
+    */
+    void formatEvent(std::string& strOut, CSharedEvent* pSharedEvent);
+
+    /*!
+        Move events from the client input queue to the output buffer
+        @param maxEvents Max number of events to move.
+        @return Number of events moved.
+    */
+    int fillOutput(int maxEvents);
+
+    /*!
+        Write what the socket can take right now of the output buffer
+        @return 1 when all is written, 0 if the socket is full and -1 on
+            error.
+    */
+    int flushOutput(void);
+
+    /*!
+        Check if the output waiting for the client is over the limit
+        @return true if no more output should be added.
+    */
+    bool isOutputFull(void);
+
     /*!
         When a command is received on the TCP/IP interface the command handler
        is called.
+        @param pCommand Command line. Need not be NULL terminated.
+        @param len Length of command line.
     */
-    int CommandHandler(std::string& strCommand);
+    int CommandHandler(const char* pCommand, size_t len);
 
     /*!
         Check if a user has been verified
@@ -249,11 +496,86 @@ class tcpipClientObj
     */
     void handleClientSend(void);
 
+    /*!
+        Client send event in a binary mode frame
+        @param pFrame Event frame.
+        @param len Size of frame.
+    */
+    void handleClientSendFrame(const uint8_t* pFrame, size_t len);
+
+    /*!
+        Check that the client may send the event and send it. The
+        result is written to the client. Event data is deallocated.
+        @param event Event to send.
+    */
+    void sendEventFromClient(vscpEvent& event);
+
+    /*!
+        Read an event given on the form used by the send command
+        @param event Event that get the values. Event data is allocated.
+        @param strEvent Event as a string.
+        @return true on success. On failure no event data is allocated.
+    */
+    bool getEventFromString(vscpEvent& event, const std::string& strEvent);
+
+    /*!
+        Check that the logged in user may send an event. Denied events
+        are logged but nothing is written to the client.
+        @param event Event to check.
+        @return true if the event may be sent.
+    */
+    bool isAllowedToSend(const vscpEvent& event);
+
+    /*!
+        Client send block of events (SENDN). Sets up the block that the
+        events on the following lines or frames are collected in.
+    */
+    void handleClientSendBlock(void);
+
+    /*!
+        Add an event given as a text line to the current block
+        @param pLine Event line. Need not be NULL terminated.
+        @param len Length of line.
+    */
+    void addBlockLine(const char* pLine, size_t len);
+
+    /*!
+        Add an event given as a binary mode frame to the current block
+        @param pFrame Frame without the length.
+        @param len Size of frame.
+    */
+    void addBlockFrame(const uint8_t* pFrame, size_t len);
+
+    /*!
+        Check and add an event to the current block. The block is sent
+        when its last event has been added.
+        @param pEvent Event to add or NULL if the event was invalid. The
+            block takes over the event.
+    */
+    void addBlockEvent(vscpEvent* pEvent);
+
+    /*!
+        Send the events of the current block with one call to the
+        control object and write the result for the whole block.
+    */
+    void sendBlock(void);
+
+    /*!
+        Delete the events of the current block and end it
+    */
+    void clearBlock(void);
+
     /*!
         Client receive
     */
     void handleClientReceive(void);
 
+    /*!
+        Add the events left of a "retr" or "retrn" command to the output
+        buffer and write the reply when all are added
+    */
+    void retrieveEvents(void);
+
     /*!
         sendOneEventFromQueue
         @param 	bStatusMsg True if response messages (+OK/-OK) should be sent.
@@ -262,6 +584,11 @@ class tcpipClientObj
     */
     bool sendOneEventFromQueue(bool bStatusMsg = true);
 
+    /*!
+        Client receive block of events (RETRN)
+    */
+    void handleClientReceiveBlock(void);
+
     /*!
         Client DataAvailable
     */
@@ -332,6 +659,11 @@ class tcpipClientObj
     */
     void handleClientRcvLoop(void);
 
+    /*!
+        Handle Binary (enter binary mode)
+    */
+    void handleClientBinary(void);
+
     /*!
           Client Help
       */
@@ -403,8 +735,30 @@ class tcpipClientObj
     // Client connection
     struct stcp_connection* m_conn;
 
-    // TCP/IP client thread
-    pthread_t m_tcpipClientThread;
+    // Worker that serve the connection
+    tcpipWorkerObj* m_pWorker;
+
+    // Position in the worker connection list
+    std::list<tcpipClientObj*>::iterator m_itWorker;
+
+    // Set when the connection is closed and waiting to be deleted
+    bool m_bClosed;
+
+    // The SSL handshake is not done yet. The connection is opened
+    // when it is.
+    bool m_bHandshake;
+
+    // Time the connection was accepted (CEventLatency::now())
+    uint64_t m_timeAccepted;
+
+    // The client input queue eventfd is in the epoll set
+    bool m_bQueueArmed;
+
+    // Waiting for the socket to be writable before sending more events
+    bool m_bWantWrite;
+
+    // In the worker list of connections with more events to send
+    bool m_bPending;
 
     /// Parent object
     tcpipListenThreadObj* m_pParent;
@@ -418,7 +772,7 @@ class tcpipClientObj
     // All input is added to the receive buf. as it is
     // received. Commands are then fetched from this buffer
     // as we go
-    std::string m_strResponse;
+    CLineScanner m_input;
 
     // Saved return value for last sockettcp operation
     size_t m_rv;
@@ -426,8 +780,44 @@ class tcpipClientObj
     // Flag for receive loop active
     bool m_bReceiveLoop;
 
-    // List of old commands
-    std::deque<std::string> m_commandArray;
+    // Flag for binary mode active
+    bool m_bBinary;
+
+    // Events waiting to be written to the client and the number of
+    // bytes of it already written
+    std::string m_outBuf;
+    size_t m_outPos;
+
+    // Set when the commands are not executed because the client does
+    // not take its replies. The socket is not read while it is set.
+    bool m_bInputPaused;
+
+    // The socket is not in the epoll set for reading
+    bool m_bReadStopped;
+
+    // Events left and events sent so far for the current "retr" (or
+    // "retrn" if m_bRetrieveBlock is set) command
+    uint32_t m_nRetrieveLeft;
+    uint32_t m_nRetrieved;
+    bool m_bRetrieveBlock;
+
+    // Reused for event parsing
+    std::string m_strEvent;
+
+    // Old commands for "+", "+n" and "++"
+    CCommandHistory m_commandHistory;
+
+    // Number of events still to come in the current SENDN block and the
+    // number of events that has been given so far
+    uint32_t m_nBlockLeft;
+    uint32_t m_nBlockIndex;
+
+    // Valid events of the block and their index in the block
+    std::vector<vscpEvent*> m_blockEvents;
+    std::vector<size_t> m_blockIndex;
+
+    // Index in the block of events that could not be sent
+    std::vector<size_t> m_blockFailed;
 };
 
 #endif
@@ -0,0 +1,159 @@
+// tokenbucket.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <time.h>
+
+#include "tokenbucket.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+//
+
+CTokenBucket::CTokenBucket()
+  : m_rate(0)
+  , m_burst(0)
+  , m_tokens(0)
+  , m_lastRefill(0)
+  , m_cntThrottled(0)
+{
+    pthread_mutex_init(&m_mutex, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+//
+
+CTokenBucket::~CTokenBucket()
+{
+    pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// now
+//
+
+uint64_t
+CTokenBucket::now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setRate
+//
+
+void
+CTokenBucket::setRate(uint32_t rate, uint32_t burst)
+{
+    pthread_mutex_lock(&m_mutex);
+    m_burst      = (0 == burst) ? rate : burst;
+    m_tokens     = m_burst;
+    m_lastRefill = now();
+    m_rate.store(rate, std::memory_order_relaxed);
+    pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// refill
+//
+// Only whole tokens are added. The time for the part of a token that is
+// left is not counted as used so slow rates are not rounded down to zero.
+//
+
+void
+CTokenBucket::refill(void)
+{
+    uint64_t rate = m_rate.load(std::memory_order_relaxed);
+    uint64_t t    = now();
+
+    if (m_tokens >= m_burst) {
+        m_lastRefill = t;
+        return;
+    }
+
+    uint64_t add = (t - m_lastRefill) * rate / 1000000;
+    if (0 == add) {
+        return;
+    }
+
+    if (add >= m_burst - m_tokens) {
+        m_tokens     = m_burst;
+        m_lastRefill = t;
+    }
+    else {
+        m_tokens += (uint32_t)add;
+        m_lastRefill += add * 1000000 / rate;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// take
+//
+
+uint32_t
+CTokenBucket::take(uint32_t count)
+{
+    if (!isLimited()) {
+        return count;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+
+    refill();
+
+    uint32_t n = (count < m_tokens) ? count : m_tokens;
+    m_tokens -= n;
+
+    pthread_mutex_unlock(&m_mutex);
+
+    if (n < count) {
+        m_cntThrottled.fetch_add(count - n, std::memory_order_relaxed);
+    }
+
+    return n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// giveBack
+//
+
+void
+CTokenBucket::giveBack(uint32_t count)
+{
+    if (!isLimited() || (0 == count)) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+
+    m_tokens = (count < m_burst - m_tokens) ? m_tokens + count : m_burst;
+
+    pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,123 @@
+// tokenbucket.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2020 Ake Hedman, Grodans Paradis AB
+// <info@grodansparadis.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(TOKENBUCKET_H__INCLUDED_)
+#define TOKENBUCKET_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+
+/*!
+    Token bucket rate limiter
+
+    The bucket holds up to burst tokens and is refilled with rate
+    tokens each second. Each event that is let through takes one
+    token. When the bucket is empty events are refused until it has
+    been refilled. A rate of zero means no limit and is checked
+    without taking the lock so unlimited buckets cost next to nothing.
+
+    Can be used by any number of threads.
+*/
+
+class CTokenBucket
+{
+
+  public:
+    /// Constructor
+    CTokenBucket();
+
+    /// Destructor
+    ~CTokenBucket();
+
+    /*!
+        Set the rate of the bucket. The bucket is filled.
+        @param rate Number of tokens added each second. Zero
+            means no limit.
+        @param burst Max number of tokens in the bucket. Zero
+            sets it to rate.
+    */
+    void setRate(uint32_t rate, uint32_t burst = 0);
+
+    /// Get the rate (tokens/second), zero if no limit
+    uint32_t getRate(void) { return m_rate.load(std::memory_order_relaxed); }
+
+    /// Get the max number of tokens in the bucket
+    uint32_t getBurst(void) { return m_burst; }
+
+    /// true if the bucket limits the rate
+    bool isLimited(void) { return (0 != getRate()); }
+
+    /*!
+        Take tokens from the bucket.
+        @param count Number of tokens wanted.
+        @return Number of tokens granted, zero to count.
+    */
+    uint32_t take(uint32_t count = 1);
+
+    /*!
+        Put back tokens that was taken but not used.
+        @param count Number of tokens to put back.
+    */
+    void giveBack(uint32_t count);
+
+    /// Get the number of tokens that has been refused
+    uint64_t getThrottled(void)
+    {
+        return m_cntThrottled.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// Refill the bucket for the time since the last refill (locked)
+    void refill(void);
+
+    /// Get monotonic time in microseconds
+    static uint64_t now(void);
+
+  private:
+    /// Protects the tokens and the time of the last refill
+    pthread_mutex_t m_mutex;
+
+    /// Tokens added each second, zero for no limit
+    std::atomic<uint32_t> m_rate;
+
+    /// Max number of tokens
+    uint32_t m_burst;
+
+    /// Tokens in the bucket
+    uint32_t m_tokens;
+
+    /// Time of last refill (us). Rest of a token is kept here
+    uint64_t m_lastRefill;
+
+    /// Number of tokens refused
+    std::atomic<uint64_t> m_cntThrottled;
+};
+
+#endif // TOKENBUCKET_H__INCLUDED_
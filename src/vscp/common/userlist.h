@@ -32,6 +32,7 @@
 #include <iostream>
 #include <map>
 
+#include <tokenbucket.h>
 #include <vscp.h>
 #include <vscphelper.h>
 
@@ -274,6 +275,13 @@ class CUserItem
     void setUserRights(const uint32_t rights) { m_userRights = rights; };
     std::string getUserRightsAsString(void);
 
+    /*!
+        Get the rate limit for events sent by this user. Shared by
+        all connections the user has open.
+        @return Reference to the token bucket of the user.
+    */
+    CTokenBucket& getRateLimit(void) { return m_rateLimit; };
+
     // --------------------------------
     // * * * Allowed events list * * *
     // --------------------------------
@@ -495,6 +503,12 @@ class CUserItem
         Filter associated with this user
     */
     vscpEventFilter m_filterVSCP;
+
+    /*!
+        Rate limit (events/second) for events sent by this
+        user on all interfaces. No limit by default.
+    */
+    CTokenBucket m_rateLimit;
 };
 
 class CUserList
@@ -362,6 +362,22 @@ extern "C"
 #define GET_VSCP_MULTICAST_PACKET_TYPE(type)       ((type >> 4) & 0x0f)
 #define GET_VSCP_MULTICAST_PACKET_ENCRYPTION(type) ((type)&0x0f)
 
+    /* * * * Binary mode on the tcp/ip interface */
+
+/* In binary mode each frame is preceded by its length as two bytes     */
+/* (MSB first). The first byte of the frame is the packet type as for   */
+/* multicast frames. Event frames use the multicast packet0 format.     */
+#define VSCP_BINARY_TYPE_EVENT   0 /* Event (same as multicast) */
+#define VSCP_BINARY_TYPE_COMMAND 1 /* Text command, client to server */
+#define VSCP_BINARY_TYPE_REPLY   2 /* Text reply, server to client */
+
+/* Max size of a binary mode frame (length not included) */
+#define VSCP_BINARY_MAX_FRAME 0xffff
+
+/* Size of a binary mode event frame with max data (length not included) */
+#define VSCP_BINARY_MAX_EVENT_FRAME                                            \
+    (1 + VSCP_MULTICAST_PACKET0_HEADER_LENGTH + VSCP_MAX_DATA + 2)
+
 /* Multicast proxy CLASS=1026, TYPE=3  */
 /* https://www.vscp.org/docs/vscpspec/doku.php?id=class2.information#type_3_0x0003_level_ii_proxy_node_heartbeat
  */
@@ -37,12 +37,12 @@ extern uint32_t m_gdebugArray[8];
 #define VSCP_DEBUG1_AUTOMATION (1 << 1) // Automation debug info
 #define VSCP_DEBUG1_CONFIG     (1 << 2) // Configuration
 
-#define __VSCP_DEBUG_EXTRA (m_gdebugArray[DBG_GENERAL] | VSCP_DEBUG1_EXTRA)
+#define __VSCP_DEBUG_EXTRA (m_gdebugArray[DBG_GENERAL] & VSCP_DEBUG1_EXTRA)
 
 #define __VSCP_DEBUG_AUTOMATION                                                \
-    (m_gdebugArray[DBG_GENERAL] | VSCP_DEBUG1_AUTOMATION)
+    (m_gdebugArray[DBG_GENERAL] & VSCP_DEBUG1_AUTOMATION)
 
-#define __VSCP_DEBUG_CONFIG (m_gdebugArray[DBG_GENERAL] | VSCP_DEBUG1_CONFIG)
+#define __VSCP_DEBUG_CONFIG (m_gdebugArray[DBG_GENERAL] & VSCP_DEBUG1_CONFIG)
 
 #define DEBUG_GENERAL_ALL m_gdebugArray[DBG_GENERAL] = 0xFFFFFFFF
 
@@ -53,11 +53,11 @@ extern uint32_t m_gdebugArray[8];
 #define VSCP_DEBUG2_TCP_RX (1 << 2)
 #define VSCP_DEBUG2_TCP_TX (1 << 3)
 
-#define __VSCP_DEBUG_TCP (m_gdebugArray[DBG_TCPIP] | VSCP_DEBUG2_TCP)
+#define __VSCP_DEBUG_TCP (m_gdebugArray[DBG_TCPIP] & VSCP_DEBUG2_TCP)
 
-#define __VSCP_DEBUG_TCP_RX (m_gdebugArray[DBG_TCPIP] | VSCP_DEBUG2_TCP_RX)
+#define __VSCP_DEBUG_TCP_RX (m_gdebugArray[DBG_TCPIP] & VSCP_DEBUG2_TCP_RX)
 
-#define __VSCP_DEBUG_TCP_TX (m_gdebugArray[DBG_TCPIP] | VSCP_DEBUG2_TCP_TX)
+#define __VSCP_DEBUG_TCP_TX (m_gdebugArray[DBG_TCPIP] & VSCP_DEBUG2_TCP_TX)
 
 // * * * Web server
 
@@ -67,12 +67,12 @@ extern uint32_t m_gdebugArray[8];
 #define VSCP_DEBUG3_REST          (1 << 2) // REST client i/f debug info
 #define VSCP_DEBUG3_WEBSRV_ACCESS (1 << 3) // Web server access
 
-#define __VSCP_DEBUG_WEBSRV (m_gdebugArray[DBG_WEBSRV] | VSCP_DEBUG3_WEBSRV)
+#define __VSCP_DEBUG_WEBSRV (m_gdebugArray[DBG_WEBSRV] & VSCP_DEBUG3_WEBSRV)
 
-#define __VSCP_DEBUG_REST (m_gdebugArray[DBG_WEBSRV] | VSCP_DEBUG3_REST)
+#define __VSCP_DEBUG_REST (m_gdebugArray[DBG_WEBSRV] & VSCP_DEBUG3_REST)
 
 #define __VSCP_DEBUG_WEBSRV_ACCESS                                             \
-    (m_gdebugArray[DBG_WEBSRV] | VSCP_DEBUG3_WEBSRV_ACCESS)
+    (m_gdebugArray[DBG_WEBSRV] & VSCP_DEBUG3_WEBSRV_ACCESS)
 
 //  * * * Web sockets
 #define VSCP_DEBUG4_ALL            0xFFFFFFFF
@@ -83,16 +83,16 @@ extern uint32_t m_gdebugArray[8];
 #define VSCP_DEBUG4_WEBSOCKET_PING (1 << 4) // Websocket ping/pong
 
 #define __VSCP_DEBUG_WEBSOCKET                                                 \
-    (m_gdebugArray[DBG_WEBSOCK] | VSCP_DEBUG4_WEBSOCKET)
+    (m_gdebugArray[DBG_WEBSOCK] & VSCP_DEBUG4_WEBSOCKET)
 
 #define __VSCP_DEBUG_WEBSOCKET_RX                                              \
-    (m_gdebugArray[DBG_WEBSOCK] | VSCP_DEBUG4_WEBSOCKET_RX)
+    (m_gdebugArray[DBG_WEBSOCK] & VSCP_DEBUG4_WEBSOCKET_RX)
 
 #define __VSCP_DEBUG_WEBSOCKET_TX                                              \
-    (m_gdebugArray[DBG_WEBSOCK] | VSCP_DEBUG4_WEBSOCKET_TX)
+    (m_gdebugArray[DBG_WEBSOCK] & VSCP_DEBUG4_WEBSOCKET_TX)
 
 #define __VSCP_DEBUG_WEBSOCKET_PING                                            \
-    (m_gdebugArray[DBG_WEBSOCK] | VSCP_DEBUG4_WEBSOCKET_PING)
+    (m_gdebugArray[DBG_WEBSOCK] & VSCP_DEBUG4_WEBSOCKET_PING)
 
 // * * * Drivers
 #define VSCP_DEBUG5_ALL        0xFFFFFFFF
@@ -104,21 +104,21 @@ extern uint32_t m_gdebugArray[8];
 #define VSCP_DEBUG5_DRIVER2_RX (1 << 5)
 #define VSCP_DEBUG5_DRIVER2_TX (1 << 6)
 
-#define __VSCP_DEBUG_DRIVER1 (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER1)
+#define __VSCP_DEBUG_DRIVER1 (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER1)
 
-#define __VSCP_DEBUG_DRIVER2 (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER2)
+#define __VSCP_DEBUG_DRIVER2 (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER2)
 
 #define __VSCP_DEBUG_DRIVER1_RX                                                \
-    (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER1_RX)
+    (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER1_RX)
 
 #define __VSCP_DEBUG_DRIVER1_TX                                                \
-    (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER1_TX)
+    (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER1_TX)
 
 #define __VSCP_DEBUG_DRIVER2_RX                                                \
-    (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER2_RX)
+    (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER2_RX)
 
 #define __VSCP_DEBUG_DRIVER2_TX                                                \
-    (m_gdebugArray[DBG_DRV] | VSCP_DEBUG5_DRIVER2_TX)
+    (m_gdebugArray[DBG_DRV] & VSCP_DEBUG5_DRIVER2_TX)
 
 #define VSCP_DEBUG6_ALL 0xFFFFFFFF
 
@@ -756,6 +756,10 @@ vscp_parseISOCombined(struct tm* ptm, std::string& dt)
 {
     size_t pos;
     std::string isodt = dt.c_str();
+    int year, month;
+
+    static const int daysInMonth[] = { 31, 28, 31, 30, 31, 30,
+                                       31, 31, 30, 31, 30, 31 };
 
     // Check pointer
     if (NULL == ptm)
@@ -763,27 +767,38 @@ vscp_parseISOCombined(struct tm* ptm, std::string& dt)
 
     try {
         // year
-        ptm->tm_year = stoi(isodt.c_str(), &pos) - 1900;
+        year = stoi(isodt.c_str(), &pos);
+        if ((pos >= isodt.length()) || ('-' != isodt[pos]))
+            return false;
         pos++; // Move past '-'
         isodt = isodt.substr(pos);
 
         // month
-        ptm->tm_mon = stoi(isodt.c_str(), &pos);
+        month = stoi(isodt.c_str(), &pos);
+        if ((pos >= isodt.length()) || ('-' != isodt[pos]))
+            return false;
         pos++; // Move past '-'
         isodt = isodt.substr(pos);
 
         // day
         ptm->tm_mday = stoi(isodt.c_str(), &pos);
+        if ((pos >= isodt.length()) ||
+            (('T' != isodt[pos]) && (' ' != isodt[pos])))
+            return false;
         pos++; // Move past 'T' or ' '
         isodt = isodt.substr(pos);
 
         // hour
         ptm->tm_hour = stoi(isodt.c_str(), &pos);
+        if ((pos >= isodt.length()) || (':' != isodt[pos]))
+            return false;
         pos++; // Move past ':'
         isodt = isodt.substr(pos);
 
         // minute
         ptm->tm_min = stoi(isodt.c_str(), &pos);
+        if ((pos >= isodt.length()) || (':' != isodt[pos]))
+            return false;
         pos++; // Move past ':'
         isodt = isodt.substr(pos);
 
@@ -793,6 +808,26 @@ vscp_parseISOCombined(struct tm* ptm, std::string& dt)
         return false;
     }
 
+    // Check ranges
+    if ((year < 0) || (year > 9999) || (month < 1) || (month > 12)) {
+        return false;
+    }
+
+    int days = daysInMonth[month - 1];
+    if ((2 == month) &&
+        ((0 == (year % 4)) && ((0 != (year % 100)) || (0 == (year % 400))))) {
+        days++; // Leap year
+    }
+
+    if ((ptm->tm_mday < 1) || (ptm->tm_mday > days) || (ptm->tm_hour < 0) ||
+        (ptm->tm_hour > 23) || (ptm->tm_min < 0) || (ptm->tm_min > 59) ||
+        (ptm->tm_sec < 0) || (ptm->tm_sec > 59)) {
+        return false;
+    }
+
+    ptm->tm_year = year - 1900;
+    ptm->tm_mon  = month - 1; // tm months are 0-11
+
     return true;
 }
 
@@ -2236,7 +2271,7 @@ vscp_convertLevel1MeasuremenToLevel2Double(vscpEvent* pEvent)
                 val64 = VSCP_UINT64_SWAP_ON_LE(val64);
                 memcpy(p + 4, &val64, sizeof(val64));
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = p;
 
@@ -2247,7 +2282,7 @@ vscp_convertLevel1MeasuremenToLevel2Double(vscpEvent* pEvent)
                 val64 = VSCP_UINT64_SWAP_ON_LE(val64);
                 memcpy(p + 4, &val64, sizeof(val64));
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = p;
 
@@ -2258,7 +2293,7 @@ vscp_convertLevel1MeasuremenToLevel2Double(vscpEvent* pEvent)
                 val64 = VSCP_UINT64_SWAP_ON_LE(val64);
                 memcpy(p + 4, &val64, sizeof(val64));
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = p;
 
@@ -2276,7 +2311,7 @@ vscp_convertLevel1MeasuremenToLevel2Double(vscpEvent* pEvent)
                 val64 = VSCP_UINT64_SWAP_ON_LE(val64);
                 memcpy(p + 4, &val64, sizeof(val64));
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = p;
 
@@ -2294,7 +2329,7 @@ vscp_convertLevel1MeasuremenToLevel2Double(vscpEvent* pEvent)
                 val64 = VSCP_UINT64_SWAP_ON_LE(val64);
                 memcpy(p + 4, &val64, sizeof(val64));
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = p;
 
@@ -2355,7 +2390,7 @@ vscp_convertLevel1MeasuremenToLevel2String(vscpEvent* pEvent)
                 // Copy in the value string
                 strcpy(p + 4, (const char*)strval.c_str());
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = (uint8_t*)p;
 
@@ -2366,7 +2401,7 @@ vscp_convertLevel1MeasuremenToLevel2String(vscpEvent* pEvent)
                 // Copy in the value string
                 strcpy(p + 4, (const char*)strval.c_str());
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = (uint8_t*)p;
 
@@ -2377,7 +2412,7 @@ vscp_convertLevel1MeasuremenToLevel2String(vscpEvent* pEvent)
                 // Copy in the value string
                 strcpy(p + 4, (const char*)strval.c_str());
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = (uint8_t*)p;
 
@@ -2395,7 +2430,7 @@ vscp_convertLevel1MeasuremenToLevel2String(vscpEvent* pEvent)
                 // Copy in the value string
                 strcpy(p + 4, (const char*)strval.c_str());
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = (uint8_t*)p;
 
@@ -2413,7 +2448,7 @@ vscp_convertLevel1MeasuremenToLevel2String(vscpEvent* pEvent)
                 // Copy in the value string
                 strcpy(p + 4, (const char*)strval.c_str());
 
-                delete[] pEvent->pdata;
+                vscp_deleteEvent(pEvent);
 
                 pEvent->pdata = (uint8_t*)p;
 
@@ -3098,14 +3133,12 @@ vscp_convertEventExToEvent(vscpEvent* pEvent, const vscpEventEx* pEventEx)
     if (pEventEx->sizeData > VSCP_LEVEL2_MAXDATA)
         return false;
 
+    // Allocate memory for data
+    if (!vscp_newEventData(pEvent, pEventEx->sizeData))
+        return false;
+
     if (pEventEx->sizeData) {
-        // Allocate memory for data
-        if (NULL == (pEvent->pdata = new uint8_t[pEventEx->sizeData]))
-            return false;
         memcpy(pEvent->pdata, pEventEx->data, pEventEx->sizeData);
-    } else {
-        // No data
-        pEvent->pdata = NULL;
     }
 
     // Convert
@@ -3161,16 +3194,12 @@ vscp_copyEvent(vscpEvent* pEventTo, const vscpEvent* pEventFrom)
 
     memcpy(pEventTo->GUID, pEventFrom->GUID, 16);
 
-    if (pEventFrom->sizeData) {
-
-        pEventTo->pdata = new unsigned char[pEventFrom->sizeData];
-        if (NULL == pEventTo->pdata) {
-            return false;
-        }
+    if (!vscp_newEventData(pEventTo, pEventFrom->sizeData)) {
+        return false;
+    }
 
+    if (pEventFrom->sizeData) {
         memcpy(pEventTo->pdata, pEventFrom->pdata, pEventFrom->sizeData);
-    } else {
-        pEventTo->pdata = NULL;
     }
 
     return true;
@@ -3217,6 +3246,19 @@ vscp_copyEventEx(vscpEventEx* pEventTo, const vscpEventEx* pEventFrom)
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// vscp_setEventAllocator
+//
+
+// Allocator for events and event data. The heap is used if NULL.
+static const vscpEventAllocator* gpEventAllocator = NULL;
+
+void
+vscp_setEventAllocator(const vscpEventAllocator* pAllocator)
+{
+    gpEventAllocator = pAllocator;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // vscp_newEvent
 //
@@ -3224,7 +3266,15 @@ vscp_copyEventEx(vscpEventEx* pEventTo, const vscpEventEx* pEventFrom)
 bool
 vscp_newEvent(vscpEvent** ppEvent)
 {
-    *ppEvent = new vscpEvent;
+    *ppEvent = NULL;
+    if (NULL != gpEventAllocator) {
+        *ppEvent = gpEventAllocator->allocEvent();
+    }
+
+    if (NULL == *ppEvent) {
+        *ppEvent = new vscpEvent;
+    }
+
     if (NULL == *ppEvent)
         return false;
 
@@ -3235,6 +3285,34 @@ vscp_newEvent(vscpEvent** ppEvent)
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// vscp_newEventData
+//
+
+bool
+vscp_newEventData(vscpEvent* pEvent, uint16_t sizeData)
+{
+    // Check pointer
+    if (NULL == pEvent)
+        return false;
+
+    pEvent->sizeData = sizeData;
+    pEvent->pdata    = NULL;
+
+    if (0 == sizeData)
+        return true;
+
+    if (NULL != gpEventAllocator) {
+        pEvent->pdata = gpEventAllocator->allocData(pEvent, sizeData);
+    }
+
+    if (NULL == pEvent->pdata) {
+        pEvent->pdata = new uint8_t[sizeData];
+    }
+
+    return (NULL != pEvent->pdata);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // deleteVSCPevent
 //
@@ -3247,7 +3325,10 @@ vscp_deleteEvent(vscpEvent* pEvent)
         return;
 
     if (NULL != pEvent->pdata) {
-        delete[] pEvent->pdata;
+        if ((NULL == gpEventAllocator) ||
+            !gpEventAllocator->freeData(pEvent, pEvent->pdata)) {
+            delete[] pEvent->pdata;
+        }
         pEvent->pdata = NULL;
     }
 }
@@ -3266,7 +3347,10 @@ vscp_deleteEvent_v2(vscpEvent** ppEvent)
     vscp_deleteEvent(*ppEvent);
 
     // Delete the event and mark it as unused.
-    delete *ppEvent;
+    if ((NULL == gpEventAllocator) ||
+        !gpEventAllocator->freeEvent(*ppEvent)) {
+        delete *ppEvent;
+    }
     *ppEvent = NULL;
 }
 
@@ -3334,7 +3418,7 @@ vscp_getDateStringFromEventEx(std::string& dt, const vscpEventEx* pEventEx)
 //
 
 bool
-vscp_convertEventToJSON(std::string& strJSON, vscpEvent* pEvent)
+vscp_convertEventToJSON(std::string& strJSON, const vscpEvent* pEvent)
 {
     std::string strguid;
     std::string strdata;
@@ -3447,14 +3531,10 @@ vscp_convertJSONToEvent(vscpEvent* pEvent, std::string& strJSON)
             if (data_array.size() > VSCP_MAX_DATA)
                 return false;
 
-            pEvent->sizeData = data_array.size();
-            if (0 == pEvent->sizeData) {
-                pEvent->pdata = NULL;
-            } else {
-                pEvent->pdata = new uint8_t[data_array.size()];
-                if (NULL == pEvent->pdata)
-                    return false;
+            if (!vscp_newEventData(pEvent, data_array.size()))
+                return false;
 
+            if (pEvent->sizeData) {
                 // memcpy( pEvent->pdata, &data_array[ 0 ], data_array.size() );
                 // C++11 variant of above
                 memcpy(pEvent->pdata, data_array.data(), data_array.size());
@@ -3609,7 +3689,7 @@ vscp_convertJSONToEventEx(vscpEventEx* pEventEx, std::string& strJSON)
 //
 
 bool
-vscp_convertEventToXML(std::string& strXML, vscpEvent* pEvent)
+vscp_convertEventToXML(std::string& strXML, const vscpEvent* pEvent)
 {
     std::string strguid;
     std::string strdata;
@@ -3881,7 +3961,7 @@ vscp_convertXMLToEventEx(vscpEventEx* pEventEx, std::string& strXML)
 //
 
 bool
-vscp_convertEventToHTML(std::string& strHTML, vscpEvent* pEvent)
+vscp_convertEventToHTML(std::string& strHTML, const vscpEvent* pEvent)
 {
     std::string strguid;
     std::string strdata;
@@ -4692,12 +4772,8 @@ vscp_convertCanalToEvent(vscpEvent* pvscpEvent,
 
     if (pcanalMsg->sizeData > 0) {
 
-        // Allocate storage for data
-        pvscpEvent->pdata = new uint8_t[pcanalMsg->sizeData];
-
-        if (NULL != pvscpEvent->pdata) {
-            // Assign size (max 8 bytes it's CAN... )
-            pvscpEvent->sizeData = pcanalMsg->sizeData;
+        // Allocate storage for data (max 8 bytes it's CAN... )
+        if (vscp_newEventData(pvscpEvent, pcanalMsg->sizeData)) {
             memcpy(pvscpEvent->pdata, pcanalMsg->data, pcanalMsg->sizeData);
         } else {
             pvscpEvent->sizeData = 0;
@@ -5146,33 +5222,73 @@ vscp_setEventExDateTimeBlockToNow(vscpEventEx* pEventEx)
 bool
 vscp_convertEventToString(std::string& str, const vscpEvent* pEvent)
 {
+    static const char hexdigits[] = "0123456789ABCDEF";
+
     // Check pointer
     if (NULL == pEvent)
         return false;
 
-    std::string dt;
-    vscp_getDateStringFromEvent(dt, pEvent);
+    // Written directly to the string as this is done for every event
+    // sent to tcp/ip clients. Room for the head part, the GUID and
+    // "0xnn," for each data byte.
+    str.resize(128 + 48 + 5 * pEvent->sizeData);
+    char* p = &str[0];
 
     // head,class,type,obid,datetime,timestamp
-    str = vscp_str_format("%hu,%hu,%hu,%lu,%s,%lu,",
-                          (unsigned short)pEvent->head,
-                          (unsigned short)pEvent->vscp_class,
-                          (unsigned short)pEvent->vscp_type,
-                          (unsigned long)pEvent->obid,
-                          (const char*)dt.c_str(),
-                          (unsigned long)pEvent->timestamp);
+    if (pEvent->year || pEvent->month || pEvent->day || pEvent->hour ||
+        pEvent->minute || pEvent->second) {
+        p += snprintf(p,
+                      128,
+                      "%hu,%hu,%hu,%lu,%04d-%02d-%02dT%02d:%02d:%02dZ,%lu,",
+                      (unsigned short)pEvent->head,
+                      (unsigned short)pEvent->vscp_class,
+                      (unsigned short)pEvent->vscp_type,
+                      (unsigned long)pEvent->obid,
+                      (int)pEvent->year,
+                      (int)pEvent->month,
+                      (int)pEvent->day,
+                      (int)pEvent->hour,
+                      (int)pEvent->minute,
+                      (int)pEvent->second,
+                      (unsigned long)pEvent->timestamp);
+    } else {
+        p += snprintf(p,
+                      128,
+                      "%hu,%hu,%hu,%lu,,%lu,",
+                      (unsigned short)pEvent->head,
+                      (unsigned short)pEvent->vscp_class,
+                      (unsigned short)pEvent->vscp_type,
+                      (unsigned long)pEvent->obid,
+                      (unsigned long)pEvent->timestamp);
+    }
 
-    std::string strGUID;
-    vscp_writeGuidToString(strGUID, pEvent);
-    str += strGUID;
-    if (pEvent->sizeData) {
-        str += ",";
+    // GUID
+    for (int i = 0; i < 16; i++) {
+        if (i) {
+            *p++ = ':';
+        }
+        *p++ = hexdigits[pEvent->GUID[i] >> 4];
+        *p++ = hexdigits[pEvent->GUID[i] & 0x0f];
+    }
 
-        std::string strData;
-        vscp_writeDataToString(strData, pEvent);
-        str += strData;
+    // Data
+    if (pEvent->sizeData) {
+        *p++ = ',';
+        if (NULL != pEvent->pdata) {
+            for (int i = 0; i < pEvent->sizeData; i++) {
+                if (i) {
+                    *p++ = ',';
+                }
+                *p++ = '0';
+                *p++ = 'x';
+                *p++ = hexdigits[pEvent->pdata[i] >> 4];
+                *p++ = hexdigits[pEvent->pdata[i] & 0x0f];
+            }
+        }
     }
 
+    str.resize(p - &str[0]);
+
     return true;
 }
 
@@ -5291,7 +5407,7 @@ vscp_convertStringToEvent(vscpEvent* pEvent, const std::string& strEvent)
             memset(&tm, 0, sizeof(tm));
             vscp_parseISOCombined(&tm, str);
             pEvent->year   = tm.tm_year + 1900;
-            pEvent->month  = tm.tm_mon;
+            pEvent->month  = tm.tm_mon + 1;
             pEvent->day    = tm.tm_mday;
             pEvent->hour   = tm.tm_hour;
             pEvent->minute = tm.tm_min;
@@ -5336,16 +5452,12 @@ vscp_convertStringToEvent(vscpEvent* pEvent, const std::string& strEvent)
     }
 
     // OK add in the data
+    if (!vscp_newEventData(pEvent, pEvent->sizeData)) {
+        return false;
+    }
+
     if (pEvent->sizeData) {
-        uint8_t* pData = new uint8_t[pEvent->sizeData];
-        if (NULL != pData) {
-            memcpy(pData, data, pEvent->sizeData);
-            pEvent->pdata = pData;
-        } else {
-            return false;
-        }
-    } else {
-        pEvent->pdata = NULL;
+        memcpy(pEvent->pdata, data, pEvent->sizeData);
     }
 
     return true;
@@ -5370,7 +5482,7 @@ vscp_convertStringToEventEx(vscpEventEx* pEventEx, const std::string& strEvent)
 
     // Remove possible data
     if (event.sizeData)
-        delete[] event.pdata;
+        vscp_deleteEvent(&event);
 
     return rv;
 }
@@ -5966,6 +6078,10 @@ vscp_getEventFromFrame(vscpEvent* pEvent, const uint8_t* buf, size_t len)
     if (NULL == buf)
         return false;
 
+    // Must at least hold the header and the CRC
+    if (len < (1 + VSCP_MULTICAST_PACKET0_HEADER_LENGTH + 2))
+        return false;
+
     //  0           Packet type & encryption settings
     //  1           HEAD MSB
     //  2           HEAD LSB
@@ -5992,12 +6108,19 @@ vscp_getEventFromFrame(vscpEvent* pEvent, const uint8_t* buf, size_t len)
     //  + DATA ) len - 1     CRC LSB
     // if encrypted with AES128/192/256 16.bytes IV here.
 
+    uint16_t sizeData =
+      ((uint16_t)buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_MSB] << 8) +
+      buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_LSB];
+
+    // No more data than a Level II event can hold
+    if (sizeData > VSCP_LEVEL2_MAXDATA)
+        return false;
+
     size_t calcFrameSize =
       1 +                                    // packet type & encryption
       VSCP_MULTICAST_PACKET0_HEADER_LENGTH + // header
       2 +                                    // CRC
-      ((uint16_t)buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_MSB] << 8) +
-      buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_LSB];
+      sizeData;                              // data
 
     // The buffer must hold a frame
     if (len < calcFrameSize)
@@ -6027,28 +6150,24 @@ vscp_getEventFromFrame(vscpEvent* pEvent, const uint8_t* buf, size_t len)
             return false;
     }
 
-    pEvent->sizeData =
-      ((uint16_t)buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_MSB] << 8) +
-      buf[VSCP_MULTICAST_PACKET0_POS_VSCP_SIZE_LSB];
-
     // Allocate data
-    if (NULL == (pEvent->pdata = new uint8_t[pEvent->sizeData])) {
+    if (!vscp_newEventData(pEvent, sizeData)) {
         return false;
     }
 
     // copy in data
-    memcpy(pEvent->pdata,
-           buf + VSCP_MULTICAST_PACKET0_POS_VSCP_DATA,
-           pEvent->sizeData);
+    if (sizeData) {
+        memcpy(pEvent->pdata,
+               buf + VSCP_MULTICAST_PACKET0_POS_VSCP_DATA,
+               sizeData);
+    }
 
     // Head
     pEvent->head = ((uint16_t)buf[VSCP_MULTICAST_PACKET0_POS_HEAD_MSB] << 8) +
                    buf[VSCP_MULTICAST_PACKET0_POS_HEAD_LSB];
 
     // Copy in GUID
-    memcpy(pEvent->GUID,
-           buf + VSCP_MULTICAST_PACKET0_POS_VSCP_GUID,
-           pEvent->sizeData);
+    memcpy(pEvent->GUID, buf + VSCP_MULTICAST_PACKET0_POS_VSCP_GUID, 16);
 
     // Set CRC
     pEvent->crc = crcFrame;
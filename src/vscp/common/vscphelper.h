@@ -589,7 +589,10 @@ extern "C"
 
         @param dt Datestring to parse.
         @param ptm Pointer to tm structure that will receive result.
-        @return True on success, false on failure.
+            The month is 0-11 and the year counted from 1900 as
+            in all tm structures.
+        @return True on success, false on failure or if a field is out
+            of range.
     */
     bool vscp_parseISOCombined(struct tm* ptm, std::string& dt);
 
@@ -1140,16 +1143,53 @@ extern "C"
     bool vscp_convertEventExToEvent(vscpEvent* pEvent,
                                     const vscpEventEx* pEventEx);
 
+    /*!
+        \struct vscpEventAllocator
+        \brief Memory allocator used for events and event data
+
+        The alloc functions return NULL when the allocator can't serve
+        the request and the free functions return false when the memory
+        does not belong to the allocator. The heap is used in both cases.
+        Data is allocated for a given event so the allocator can store
+        small payloads inside the event block itself.
+    */
+    typedef struct
+    {
+        vscpEvent* (*allocEvent)(void);
+        bool (*freeEvent)(vscpEvent* pEvent);
+        uint8_t* (*allocData)(vscpEvent* pEvent, uint16_t sizeData);
+        bool (*freeData)(vscpEvent* pEvent, uint8_t* pdata);
+    } vscpEventAllocator;
+
+    /*!
+     * Set the allocator used by vscp_newEvent, vscp_newEventData,
+     * vscp_deleteEvent and vscp_deleteEvent_v2. Must be set before
+     * any events are created and not be changed while events
+     * allocated by it are alive.
+     * @param pAllocator Pointer to allocator or NULL to use the heap.
+     */
+    void vscp_setEventAllocator(const vscpEventAllocator* pAllocator);
+
     /*!
      * Create a standard VSCP event
      * @param ppEvent Pointer to a pointer toa standard VSCP event.
      * @return True if the event was created successfully,
      *              false otherwise.
      */
-    bool vscp_newVSCPevent(vscpEvent** ppEvent);
+    bool vscp_newEvent(vscpEvent** ppEvent);
+
+    /*!
+     * Allocate the data part of an event. Any data already set for
+     * the event is not freed.
+     * @param pEvent Pointer to event.
+     * @param sizeData Number of data bytes. pdata is set to NULL
+     *              if zero.
+     * @return True on success, false otherwise.
+     */
+    bool vscp_newEventData(vscpEvent* pEvent, uint16_t sizeData);
 
     /*!
-        Delete a standard VSCP event
+        Delete the data of a standard VSCP event
         */
     void vscp_deleteEvent(vscpEvent* pEvent);
 
@@ -1214,7 +1254,7 @@ extern "C"
     /*!
      * Convert VSCP Event to JSON formated string
      */
-    bool vscp_convertEventToJSON(std::string& strJSON, vscpEvent* pEvent);
+    bool vscp_convertEventToJSON(std::string& strJSON, const vscpEvent* pEvent);
 
     /*!
      * Convert VSCP EventEx to JSON formated string
@@ -1235,7 +1275,7 @@ extern "C"
     /*!
      * Convert VSCP Event to XML formated string
      */
-    bool vscp_convertEventToXML(std::string& strXML, vscpEvent* pEvent);
+    bool vscp_convertEventToXML(std::string& strXML, const vscpEvent* pEvent);
 
     /*!
      * Convert XML string to event
@@ -1255,7 +1295,7 @@ extern "C"
     /*!
      * Convert VSCP Event to HTML formated string
      */
-    bool vscp_convertEventToHTML(std::string& strHTML, vscpEvent* pEvent);
+    bool vscp_convertEventToHTML(std::string& strHTML, const vscpEvent* pEvent);
 
     /*!
      * Convert VSCP EventEx to HTML formated string
@@ -40,6 +40,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <crc.h>
 #include <version.h>
 #include <vscp.h>
 #include <vscpdatetime.h>
@@ -51,6 +52,22 @@
 // Undef if debug messages is not wanted
 //#define DEBUG_LIB_VSCP_HELPER   1
 
+// Size of each read of server data
+#define TCPIP_READ_SIZE 8192
+
+///////////////////////////////////////////////////////////////////////////////
+// lineStartsWith
+//
+// Check the start of a line from the line scanner
+//
+
+static bool
+lineStartsWith(const char* pLine, size_t len, const char* pPrefix)
+{
+    size_t lenPrefix = strlen(pPrefix);
+    return ((len >= lenPrefix) && (0 == memcmp(pLine, pPrefix, lenPrefix)));
+}
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -58,6 +75,7 @@
 VscpRemoteTcpIf::VscpRemoteTcpIf()
 {
     m_bModeReceiveLoop = false;
+    m_bModeBinary = false;
     m_responseTimeOut = TCPIP_DEFAULT_RESPONSE_TIMEOUT;
     m_innerResponseTimeout = TCPIP_DEFAULT_INNER_RESPONSE_TIMEOUT;
 
@@ -85,55 +103,168 @@ VscpRemoteTcpIf::~VscpRemoteTcpIf()
 bool
 VscpRemoteTcpIf::checkReturnValue(bool bClear)
 {
-    bool rv = false;
-    char buf[8192];
+    const char* pLine;
+    size_t len;
 
     if (bClear)
         doClrInputQueue();
 
     uint32_t start = vscp_getMsTimeStamp();
-    while (((vscp_getMsTimeStamp() - start) < m_responseTimeOut)) {
+    while (true) {
 
-        memset(buf, 0, sizeof(buf));
-        int nRead = stcp_read(m_conn, buf, sizeof(buf), m_innerResponseTimeout);
+        // A reply ends with a "+OK", "-OK" or "+ERR" line. The lines are
+        // added to the input array as they arrive.
+        while (m_response.getLine(&pLine, &len)) {
 
-        if (nRead < 0) {
-            if (STCP_ERROR_TIMEOUT == nRead) {
-                // rv = VSCP_ERROR_TIMEOUT;
-                rv = false;
-                break;
-            } else if (STCP_ERROR_STOPPED == nRead) {
-                // rv = VSCP_ERROR_STOPPED;
-                rv = false;
-                break;
+            m_inputStrArray.push_back(std::string(pLine, len));
+
+            if (lineStartsWith(pLine, len, "+OK")) {
+                return true;
             }
-            break;
+
+            if (lineStartsWith(pLine, len, "-OK") ||
+                lineStartsWith(pLine, len, "+ERR")) {
+                return false;
+            }
+        }
+
+        if ((vscp_getMsTimeStamp() - start) >= m_responseTimeOut) {
+            return false;
+        }
+
+        if (m_bModeBinary) {
+            if (!readFrames(m_innerResponseTimeout)) {
+                return false;
+            }
+            continue;
+        }
+
+        char* pBuf = m_response.getWriteBuffer(TCPIP_READ_SIZE);
+        int nRead =
+          stcp_read(m_conn, pBuf, TCPIP_READ_SIZE, m_innerResponseTimeout);
+        if (nRead < 0) {
+            return false;
         } else if (nRead > 0) {
             m_lastResponseTime =
               vscp_getMsTimeStamp(); // Save last response time
-            m_strResponse += std::string(buf, nRead);
+            m_response.commitWrite(nRead);
         }
 
-        // if err abort
-        if (NULL != strstr(buf, "+ERR"))
+    } // while
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// writeFrame
+//
+
+bool
+VscpRemoteTcpIf::writeFrame(uint8_t type, const uint8_t* pPayload, size_t len)
+{
+    std::string frame;
+    frame.reserve(3 + len);
+    if (!encodeFrame(frame, type, pPayload, len))
+        return false;
+
+    int n = stcp_write(m_conn, frame.c_str(), frame.length());
+    return (n == (int)frame.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// encodeFrame
+//
+
+bool
+VscpRemoteTcpIf::encodeFrame(std::string& strFrames,
+                             uint8_t type,
+                             const uint8_t* pPayload,
+                             size_t len)
+{
+    if ((len + 1) > VSCP_BINARY_MAX_FRAME)
+        return false;
+
+    strFrames += (char)(((len + 1) >> 8) & 0xff);
+    strFrames += (char)((len + 1) & 0xff);
+    strFrames += (char)SET_VSCP_MULTICAST_TYPE(type, VSCP_ENCRYPTION_NONE);
+    strFrames.append((const char*)pPayload, len);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readFrames
+//
+
+bool
+VscpRemoteTcpIf::readFrames(int timeout)
+{
+    char* pBuf = m_binaryBuffer.getWriteBuffer(TCPIP_READ_SIZE);
+    int nRead  = stcp_read(m_conn, pBuf, TCPIP_READ_SIZE, timeout);
+    if (STCP_ERROR_STOPPED == nRead) {
+        return false;
+    } else if (nRead > 0) {
+        m_lastResponseTime = vscp_getMsTimeStamp();
+        m_binaryBuffer.commitWrite(nRead);
+    }
+
+    parseFrames();
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// parseFrames
+//
+
+void
+VscpRemoteTcpIf::parseFrames(void)
+{
+    while (m_binaryBuffer.size() >= 2) {
+
+        const uint8_t* p = (const uint8_t*)m_binaryBuffer.data();
+        size_t len       = (p[0] << 8) + p[1];
+        if (m_binaryBuffer.size() < (2 + len)) {
             break;
+        }
 
-        // Check if we are done
-        // A line with "+OK bla bla bla bla bla bla bla bla \r\n"
-        // It can be hacked up.
-        if (m_strResponse.npos != m_strResponse.find("+OK")) {
+        const uint8_t* pFrame = p + 2;
+        if (len) {
+            switch (GET_VSCP_MULTICAST_PACKET_TYPE(pFrame[0])) {
+
+                case VSCP_BINARY_TYPE_EVENT: {
+                    vscpEvent* pEvent = new vscpEvent;
+                    pEvent->pdata = NULL;
+                    if (vscp_getEventFromFrame(pEvent, pFrame, len)) {
+                        m_binaryEventQueue.push_back(pEvent);
+                    } else {
+                        vscp_deleteEvent_v2(&pEvent);
+                    }
+                } break;
 
-            // We check only for "\n" as it also could have been
-            // broken up, even if rare
-            if (NULL != strstr(buf, "\n")) {
-                rv = true;
-                break;
+                case VSCP_BINARY_TYPE_REPLY:
+                    m_response.append((const char*)pFrame + 1, len - 1);
+                    break;
+
+                default:
+                    break;
             }
         }
 
-    } // while
+        m_binaryBuffer.consume(2 + len);
+    }
+}
 
-    return rv;
+///////////////////////////////////////////////////////////////////////////////
+// clearBinaryEventQueue
+//
+
+void
+VscpRemoteTcpIf::clearBinaryEventQueue(void)
+{
+    while (m_binaryEventQueue.size()) {
+        vscpEvent* pEvent = m_binaryEventQueue.front();
+        m_binaryEventQueue.pop_front();
+        vscp_deleteEvent_v2(&pEvent);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -197,10 +328,22 @@ VscpRemoteTcpIf::doCommand(const std::string& cmd)
 
     doClrInputQueue();
 
-    int n;
-    if (0 == (n = stcp_write(m_conn, (const char*)cmd.c_str(), cmd.length())) ||
-        n != (int)cmd.length()) {
-        return VSCP_ERROR_ERROR;
+    if (m_bModeBinary) {
+        // Commands are sent in frames without line ending
+        std::string strCmd = cmd;
+        vscp_trim(strCmd);
+        if (!writeFrame(VSCP_BINARY_TYPE_COMMAND,
+                        (const uint8_t*)strCmd.c_str(),
+                        strCmd.length())) {
+            return VSCP_ERROR_ERROR;
+        }
+    } else {
+        int n;
+        if (0 == (n = stcp_write(
+                    m_conn, (const char*)cmd.c_str(), cmd.length())) ||
+            n != (int)cmd.length()) {
+            return VSCP_ERROR_ERROR;
+        }
     }
 
     ret = checkReturnValue(true);
@@ -213,6 +356,248 @@ VscpRemoteTcpIf::doCommand(const std::string& cmd)
     return VSCP_ERROR_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// pipelineCommand
+//
+
+int
+VscpRemoteTcpIf::pipelineCommand(const std::string& cmd)
+{
+    if (m_bModeBinary) {
+        // Commands are sent in frames without line ending
+        std::string strCmd = cmd;
+        vscp_trim(strCmd);
+
+        std::string strFrame;
+        if (!encodeFrame(strFrame,
+                         VSCP_BINARY_TYPE_COMMAND,
+                         (const uint8_t*)strCmd.c_str(),
+                         strCmd.length())) {
+            return VSCP_ERROR_PARAMETER;
+        }
+        m_pipeline.push_back(strFrame);
+    } else {
+        m_pipeline.push_back(cmd);
+    }
+
+    return VSCP_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pipelineSend
+//
+
+int
+VscpRemoteTcpIf::pipelineSend(const vscpEvent* pEvent)
+{
+    if (NULL == pEvent)
+        return VSCP_ERROR_PARAMETER;
+
+    // Must be a valid data pointer if data
+    if ((pEvent->sizeData > 0) && (NULL == pEvent->pdata))
+        return VSCP_ERROR_PARAMETER;
+
+    // Validate datasize
+    if (pEvent->sizeData > VSCP_MAX_DATA)
+        return VSCP_ERROR_PARAMETER;
+
+    if (m_bModeBinary) {
+
+        uint8_t frame[VSCP_BINARY_MAX_EVENT_FRAME];
+        if (!vscp_writeEventToFrame(frame, sizeof(frame), 0, pEvent)) {
+            return VSCP_ERROR_PARAMETER;
+        }
+
+        // The type byte is added by encodeFrame
+        std::string strFrame;
+        encodeFrame(strFrame,
+                    VSCP_BINARY_TYPE_EVENT,
+                    frame + 1,
+                    VSCP_MULTICAST_PACKET0_HEADER_LENGTH + pEvent->sizeData +
+                      2);
+        m_pipeline.push_back(strFrame);
+
+        return VSCP_ERROR_SUCCESS;
+    }
+
+    std::string strBuf;
+    if (!vscp_convertEventToString(strBuf, pEvent)) {
+        return VSCP_ERROR_PARAMETER;
+    }
+
+    m_pipeline.push_back("send " + strBuf + "\r\n");
+
+    return VSCP_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pipelineSendEx
+//
+
+int
+VscpRemoteTcpIf::pipelineSendEx(const vscpEventEx* pEventEx)
+{
+    if (NULL == pEventEx)
+        return VSCP_ERROR_PARAMETER;
+
+    // Validate datasize
+    if (pEventEx->sizeData > VSCP_MAX_DATA)
+        return VSCP_ERROR_PARAMETER;
+
+    if (m_bModeBinary) {
+
+        uint8_t frame[VSCP_BINARY_MAX_EVENT_FRAME];
+        if (!vscp_writeEventExToFrame(frame, sizeof(frame), 0, pEventEx)) {
+            return VSCP_ERROR_PARAMETER;
+        }
+
+        // The type byte is added by encodeFrame
+        std::string strFrame;
+        encodeFrame(strFrame,
+                    VSCP_BINARY_TYPE_EVENT,
+                    frame + 1,
+                    VSCP_MULTICAST_PACKET0_HEADER_LENGTH + pEventEx->sizeData +
+                      2);
+        m_pipeline.push_back(strFrame);
+
+        return VSCP_ERROR_SUCCESS;
+    }
+
+    std::string strBuf;
+    if (!vscp_convertEventExToString(strBuf, pEventEx)) {
+        return VSCP_ERROR_PARAMETER;
+    }
+
+    m_pipeline.push_back("send " + strBuf + "\r\n");
+
+    return VSCP_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pipelineExecute
+//
+
+int
+VscpRemoteTcpIf::pipelineExecute(std::deque<int>& results,
+                                 std::deque<std::string>* pReplies)
+{
+    results.clear();
+    if (NULL != pReplies) {
+        pReplies->clear();
+    }
+
+    if (!isConnected()) {
+        m_pipeline.clear();
+        return VSCP_ERROR_CONNECTION;
+    }
+
+    // Not possible in receive loop
+    if (m_bModeReceiveLoop) {
+        m_pipeline.clear();
+        return VSCP_ERROR_PARAMETER;
+    }
+
+    doClrInputQueue();
+
+    int rv       = VSCP_ERROR_SUCCESS;
+    size_t nSent = 0; // Commands written to the daemon
+    std::string strOut;
+    std::string strReply;
+
+    uint32_t start = vscp_getMsTimeStamp();
+    while (results.size() < m_pipeline.size()) {
+
+        // Write more commands when half of the window is answered
+        if ((nSent < m_pipeline.size()) &&
+            ((nSent - results.size()) <= (TCPIP_PIPELINE_WINDOW / 2))) {
+
+            strOut.clear();
+            while ((nSent < m_pipeline.size()) &&
+                   ((nSent - results.size()) < TCPIP_PIPELINE_WINDOW)) {
+                strOut += m_pipeline[nSent++];
+            }
+
+            if ((int)strOut.length() !=
+                stcp_write(m_conn, strOut.c_str(), strOut.length())) {
+                rv = VSCP_ERROR_COMMUNICATION;
+                break;
+            }
+        }
+
+        // Wait for replies. The read does not wait as a read that waits
+        // returns first when the whole buffer is filled.
+        struct pollfd pfd;
+        pfd.fd      = m_conn->client.sock;
+        pfd.events  = POLLIN;
+        pfd.revents = 0;
+        if (stcp_poll(
+              &pfd, 1, TCPIP_PIPELINE_POLL_TIMEOUT, &m_conn->stop_flag) < 0) {
+            rv = VSCP_ERROR_COMMUNICATION;
+            break;
+        }
+
+        if (pfd.revents) {
+
+            CLineScanner& input = m_bModeBinary ? m_binaryBuffer : m_response;
+
+            // Zero bytes is not an error, with TLS the socket can be
+            // readable with only part of a record received
+            char* pBuf = input.getWriteBuffer(TCPIP_READ_SIZE);
+            int nRead  = stcp_read(m_conn, pBuf, TCPIP_READ_SIZE, 0);
+            if (nRead < 0) {
+                rv = VSCP_ERROR_COMMUNICATION;
+                break;
+            } else if (nRead > 0) {
+                m_lastResponseTime = vscp_getMsTimeStamp();
+                input.commitWrite(nRead);
+                if (m_bModeBinary) {
+                    parseFrames();
+                }
+            }
+        }
+
+        // Match complete replies in order
+        size_t nResults = results.size();
+        const char* pLine;
+        size_t len;
+        while (m_response.getLine(&pLine, &len)) {
+
+            // The reply is all lines up to and including the last one
+            if (NULL != pReplies) {
+                strReply.append(pLine, len);
+                strReply += "\r\n";
+            }
+
+            bool bOK = lineStartsWith(pLine, len, "+OK");
+            if (bOK || lineStartsWith(pLine, len, "-OK") ||
+                lineStartsWith(pLine, len, "+ERR")) {
+
+                results.push_back(bOK ? VSCP_ERROR_SUCCESS : VSCP_ERROR_ERROR);
+                if (!bOK) {
+                    rv = VSCP_ERROR_ERROR;
+                }
+
+                if (NULL != pReplies) {
+                    pReplies->push_back(strReply);
+                    strReply.clear();
+                }
+            }
+        }
+
+        // The timeout is for each reply
+        if (results.size() != nResults) {
+            start = vscp_getMsTimeStamp();
+        } else if ((vscp_getMsTimeStamp() - start) > m_responseTimeOut) {
+            rv = VSCP_ERROR_TIMEOUT;
+            break;
+        }
+    }
+
+    m_pipeline.clear();
+
+    return rv;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // getInputQueueCount
 //
@@ -230,7 +615,7 @@ VscpRemoteTcpIf::getInputQueueCount(void)
 void
 VscpRemoteTcpIf::doClrInputQueue(void)
 {
-    m_strResponse.clear();
+    m_response.clear();
     m_inputStrArray.clear();
 }
 
@@ -241,42 +626,17 @@ VscpRemoteTcpIf::doClrInputQueue(void)
 size_t
 VscpRemoteTcpIf::addInputStringArrayFromReply(bool bClear)
 {
-    std::string tempStr;
+    const char* pLine;
+    size_t len;
 
     if (bClear) {
         m_inputStrArray.clear();
     }
 
-    // If readBuffer have a "\r\n" pair at the end it just contains full
-    // reply rows. If not we need to leave ending part after "\r\n" pair
-    // in the read buffer.
-
-    // Get rest string that should not be handled now
-    // std::string tempStr = m_strResponse.AfterLast('\n');
-    size_t fpos = m_strResponse.find_first_of('\n');
-    if (fpos == m_strResponse.npos) {
-        tempStr = m_strResponse;
-    } else {
-        tempStr = m_strResponse.substr(fpos + 1);
-    }
-
-    // Get the string that should be parsed for inclusion in the string array
-    // std::string strToArray = m_strResponse.Left( m_strResponse.Length() -
-    // tempStr.Length() );
-    std::string strToArray =
-      m_strResponse.substr(0, m_strResponse.length() - tempStr.length());
-
-    // Set the readbuffer to the rest string
-    m_strResponse = tempStr;
-
-    // Parse the array string
-    std::deque<std::string> tokens;
-    vscp_split(tokens, strToArray, "\n");
-    while (tokens.size()) {
-        std::string str = tokens.front();
-        vscp_trim(str);
-        tokens.pop_front();
-        m_inputStrArray.push_back(str);
+    // Add all complete lines. A partial line at the end is kept until
+    // the rest of it is received.
+    while (m_response.getLine(&pLine, &len)) {
+        m_inputStrArray.push_back(std::string(pLine, len));
     }
 
     return m_inputStrArray.size();
@@ -474,7 +834,11 @@ VscpRemoteTcpIf::doCmdClose(void)
     }
 
     m_bModeReceiveLoop = false;
+    m_bModeBinary = false;
+    m_binaryBuffer.clear();
+    clearBinaryEventQueue();
     m_inputStrArray.clear();
+    m_pipeline.clear();
 
     return VSCP_ERROR_SUCCESS;
 }
@@ -537,6 +901,25 @@ VscpRemoteTcpIf::doCmdSend(const vscpEvent* pEvent)
     if (pEvent->sizeData > VSCP_MAX_DATA)
         return VSCP_ERROR_PARAMETER;
 
+    if (m_bModeBinary) {
+
+        uint8_t frame[VSCP_BINARY_MAX_EVENT_FRAME];
+        if (!vscp_writeEventToFrame(frame, sizeof(frame), 0, pEvent)) {
+            return VSCP_ERROR_PARAMETER;
+        }
+
+        // The type byte is added by writeFrame
+        doClrInputQueue();
+        if (!writeFrame(VSCP_BINARY_TYPE_EVENT,
+                        frame + 1,
+                        VSCP_MULTICAST_PACKET0_HEADER_LENGTH +
+                          pEvent->sizeData + 2)) {
+            return VSCP_ERROR_ERROR;
+        }
+
+        return checkReturnValue() ? VSCP_ERROR_SUCCESS : VSCP_ERROR_ERROR;
+    }
+
     // send head,class,type,obid,datetime,timestamp,GUID,data1,data2,data3....
     if (!vscp_convertEventToString(strBuf, pEvent)) {
         return VSCP_ERROR_PARAMETER;
@@ -580,6 +963,25 @@ VscpRemoteTcpIf::doCmdSendEx(const vscpEventEx* pEventEx)
     // std::string::Format("vscpclass=%d vscptype=%d"),
     // (int)pEventEx->vscp_class, (int)pEventEx->vscp_type ));
 
+    if (m_bModeBinary) {
+
+        uint8_t frame[VSCP_BINARY_MAX_EVENT_FRAME];
+        if (!vscp_writeEventExToFrame(frame, sizeof(frame), 0, pEventEx)) {
+            return VSCP_ERROR_PARAMETER;
+        }
+
+        // The type byte is added by writeFrame
+        doClrInputQueue();
+        if (!writeFrame(VSCP_BINARY_TYPE_EVENT,
+                        frame + 1,
+                        VSCP_MULTICAST_PACKET0_HEADER_LENGTH +
+                          pEventEx->sizeData + 2)) {
+            return VSCP_ERROR_ERROR;
+        }
+
+        return checkReturnValue() ? VSCP_ERROR_SUCCESS : VSCP_ERROR_ERROR;
+    }
+
     // send head,class,type,obid,datetime,timestamp,GUID,data1,data2,data3....
     if (!vscp_convertEventExToString(strBuf, pEventEx)) {
         return VSCP_ERROR_PARAMETER;
@@ -630,6 +1032,114 @@ VscpRemoteTcpIf::doCmdSendLevel1(const canalMsg* pCanalMsg)
     return doCmdSendEx(&event);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// doCmdSendBlockEx
+//
+
+int
+VscpRemoteTcpIf::doCmdSendBlockEx(const vscpEventEx* pEvents,
+                                  size_t count,
+                                  std::deque<size_t>* pFailed)
+{
+    int rv = VSCP_ERROR_SUCCESS;
+
+    if (!isConnected())
+        return VSCP_ERROR_CONNECTION;
+
+    // If in receive loop terminate
+    if (m_bModeReceiveLoop)
+        return VSCP_ERROR_PARAMETER;
+
+    if ((NULL == pEvents) || (0 == count))
+        return VSCP_ERROR_PARAMETER;
+
+    for (size_t first = 0; first < count; first += TCPIP_BLOCK_MAX_EVENTS) {
+
+        size_t n = count - first;
+        if (n > TCPIP_BLOCK_MAX_EVENTS) {
+            n = TCPIP_BLOCK_MAX_EVENTS;
+        }
+
+        // The command followed by the events, one line or frame each
+        std::string strBlock;
+        std::string strCmd = vscp_str_format("SENDN %zu", n);
+
+        if (m_bModeBinary) {
+            encodeFrame(strBlock,
+                        VSCP_BINARY_TYPE_COMMAND,
+                        (const uint8_t*)strCmd.c_str(),
+                        strCmd.length());
+        } else {
+            strBlock = strCmd + "\r\n";
+        }
+
+        for (size_t i = first; i < (first + n); i++) {
+
+            if (pEvents[i].sizeData > VSCP_MAX_DATA)
+                return VSCP_ERROR_PARAMETER;
+
+            if (m_bModeBinary) {
+
+                uint8_t frame[VSCP_BINARY_MAX_EVENT_FRAME];
+                if (!vscp_writeEventExToFrame(
+                      frame, sizeof(frame), 0, &pEvents[i])) {
+                    return VSCP_ERROR_PARAMETER;
+                }
+
+                // The type byte is added by encodeFrame
+                encodeFrame(strBlock,
+                            VSCP_BINARY_TYPE_EVENT,
+                            frame + 1,
+                            VSCP_MULTICAST_PACKET0_HEADER_LENGTH +
+                              pEvents[i].sizeData + 2);
+            } else {
+
+                std::string strEvent;
+                if (!vscp_convertEventExToString(strEvent, &pEvents[i])) {
+                    return VSCP_ERROR_PARAMETER;
+                }
+                strBlock += strEvent;
+                strBlock += "\r\n";
+            }
+        }
+
+        doClrInputQueue();
+
+        if (stcp_write(m_conn, strBlock.c_str(), strBlock.length()) !=
+            (int)strBlock.length()) {
+            return VSCP_ERROR_ERROR;
+        }
+
+        if (checkReturnValue(true)) {
+            continue;
+        }
+
+        // "-OK - n event(s) sent, failed: i,j,..." lists the events that
+        // was not sent. Any other reply is an error for the whole block.
+        if (m_inputStrArray.empty()) {
+            return VSCP_ERROR_ERROR;
+        }
+
+        const std::string& strReply = m_inputStrArray.back();
+        size_t pos                  = strReply.find("failed:");
+        if (std::string::npos == pos) {
+            return VSCP_ERROR_ERROR;
+        }
+
+        if (NULL != pFailed) {
+            std::deque<std::string> tokens;
+            vscp_split(tokens, strReply.substr(pos + 7), ",");
+            for (size_t i = 0; i < tokens.size(); i++) {
+                pFailed->push_back(first + vscp_readStringValue(tokens[i]));
+            }
+        }
+
+        rv = VSCP_ERROR_ERROR;
+    }
+
+    return rv;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // getEventFromLine
 //
@@ -664,6 +1174,27 @@ VscpRemoteTcpIf::doCmdReceive(vscpEvent* pEvent)
     if (m_bModeReceiveLoop)
         return VSCP_ERROR_PARAMETER;
 
+    // In binary mode events are streamed by the server
+    if (m_bModeBinary) {
+
+        if (!m_binaryEventQueue.size()) {
+            readFrames(0);
+        }
+
+        if (!m_binaryEventQueue.size()) {
+            return VSCP_ERROR_FIFO_EMPTY;
+        }
+
+        vscpEvent* pQueued = m_binaryEventQueue.front();
+        m_binaryEventQueue.pop_front();
+
+        // Caller owns the data of the event
+        memcpy(pEvent, pQueued, sizeof(vscpEvent));
+        delete pQueued;
+
+        return VSCP_ERROR_SUCCESS;
+    }
+
     if (VSCP_ERROR_SUCCESS != doCommand("RETR 1\r\n")) {
         return VSCP_ERROR_ERROR;
     }
@@ -690,23 +1221,89 @@ VscpRemoteTcpIf::doCmdReceiveEx(vscpEventEx* pEventEx)
     if (m_bModeReceiveLoop)
         return VSCP_ERROR_PARAMETER;
 
-    if (VSCP_ERROR_SUCCESS != doCommand("RETR 1\r\n")) {
-        return VSCP_ERROR_ERROR;
-    }
-
     vscpEvent* pEvent = new vscpEvent;
     if (NULL == pEvent)
         return VSCP_ERROR_PARAMETER;
+    pEvent->pdata = NULL;
 
-    if (!getEventFromLine(pEvent, m_inputStrArray[0]))
+    if (m_bModeBinary) {
+        int rv;
+        if (VSCP_ERROR_SUCCESS != (rv = doCmdReceive(pEvent))) {
+            delete pEvent;
+            return rv;
+        }
+    } else {
+
+        if (VSCP_ERROR_SUCCESS != doCommand("RETR 1\r\n")) {
+            delete pEvent;
+            return VSCP_ERROR_ERROR;
+        }
+
+        if (!getEventFromLine(pEvent, m_inputStrArray[0]))
+            return VSCP_ERROR_PARAMETER;
+    }
+
+    if (!vscp_convertEventToEventEx(pEventEx, pEvent)) {
+        vscp_deleteEvent_v2(&pEvent);
         return VSCP_ERROR_PARAMETER;
+    }
+
+    vscp_deleteEvent_v2(&pEvent);
+
+    return VSCP_ERROR_SUCCESS;
+}
 
-    if (vscp_convertEventToEventEx(pEventEx, pEvent)) {
-        vscp_deleteEvent(pEvent);
+///////////////////////////////////////////////////////////////////////////////
+// doCmdReceiveBlockEx
+//
+
+int
+VscpRemoteTcpIf::doCmdReceiveBlockEx(std::deque<vscpEventEx>& events,
+                                     uint32_t count)
+{
+    vscpEventEx ex;
+
+    if (!isConnected())
+        return VSCP_ERROR_CONNECTION;
+
+    // If in receive loop terminate
+    if (m_bModeReceiveLoop)
         return VSCP_ERROR_PARAMETER;
+
+    std::string strCmd = vscp_str_format("RETRN %u\r\n", count);
+    if (VSCP_ERROR_SUCCESS != doCommand(strCmd)) {
+        return VSCP_ERROR_ERROR;
     }
 
-    vscp_deleteEvent(pEvent);
+    // In binary mode the events are frames that are queued as they
+    // are read
+    if (m_bModeBinary) {
+
+        while (m_binaryEventQueue.size() &&
+               ((0 == count) || (events.size() < count))) {
+
+            vscpEvent* pEvent = m_binaryEventQueue.front();
+            m_binaryEventQueue.pop_front();
+
+            bool bOk = vscp_convertEventToEventEx(&ex, pEvent);
+            vscp_deleteEvent_v2(&pEvent);
+            if (!bOk) {
+                return VSCP_ERROR_PARAMETER;
+            }
+
+            events.push_back(ex);
+        }
+
+        return VSCP_ERROR_SUCCESS;
+    }
+
+    // One line for each event followed by the "+OK" line
+    for (size_t i = 0; (i + 1) < m_inputStrArray.size(); i++) {
+        if (!vscp_convertStringToEventEx(&ex, m_inputStrArray[i])) {
+            return VSCP_ERROR_PARAMETER;
+        }
+        events.push_back(ex);
+    }
 
     return VSCP_ERROR_SUCCESS;
 }
@@ -806,10 +1403,96 @@ VscpRemoteTcpIf::doCmdQuitReceiveLoop(void)
     return VSCP_ERROR_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// doCmdEnterBinaryMode
+//
+
+int
+VscpRemoteTcpIf::doCmdEnterBinaryMode(void)
+{
+    if (!isConnected())
+        return VSCP_ERROR_CONNECTION;
+
+    // If in receive loop terminate
+    if (m_bModeReceiveLoop)
+        return VSCP_ERROR_PARAMETER;
+
+    if (m_bModeBinary)
+        return VSCP_ERROR_SUCCESS;
+
+    // Needed for frame CRC
+    crcInit();
+
+    doClrInputQueue();
+
+    if (8 != stcp_write(m_conn, "BINARY\r\n", 8)) {
+        return VSCP_ERROR_ERROR;
+    }
+
+    // The reply is the last text line. Everything after it is framed.
+    const char* pLine;
+    size_t len;
+    char buf[512];
+    uint32_t start = vscp_getMsTimeStamp();
+    while (!m_response.getLine(&pLine, &len)) {
+
+        if ((vscp_getMsTimeStamp() - start) > m_responseTimeOut) {
+            return VSCP_ERROR_TIMEOUT;
+        }
+
+        int nRead = stcp_read(m_conn, buf, sizeof(buf), m_innerResponseTimeout);
+        if (STCP_ERROR_STOPPED == nRead) {
+            return VSCP_ERROR_STOPPED;
+        } else if (nRead > 0) {
+            m_response.append(buf, nRead);
+        }
+    }
+
+    if (!lineStartsWith(pLine, len, "+OK")) {
+        doClrInputQueue();
+        return VSCP_ERROR_ERROR;
+    }
+
+    m_lastResponseTime = vscp_getMsTimeStamp();
+    m_binaryBuffer.clear();
+    m_binaryBuffer.append(m_response.data(), m_response.size());
+    m_response.clear();
+    m_bModeBinary = true;
+
+    return VSCP_ERROR_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// doCmdQuitBinaryMode
+//
+
+int
+VscpRemoteTcpIf::doCmdQuitBinaryMode(void)
+{
+    if (!isConnected())
+        return VSCP_ERROR_CONNECTION;
+
+    // If **not** in binary mode terminate
+    if (!m_bModeBinary)
+        return VSCP_ERROR_SUCCESS;
+
+    if (VSCP_ERROR_SUCCESS != doCommand("QUITBINARY")) {
+        return VSCP_ERROR_TIMEOUT;
+    }
+
+    // Events not fetched are dropped
+    m_bModeBinary = false;
+    m_binaryBuffer.clear();
+    clearBinaryEventQueue();
+    m_inputStrArray.clear();
+
+    return VSCP_ERROR_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // doCmdBlockingReceive
 //
-// Just works if in receive loop
+// Just works if in receive loop or binary mode
 //
 
 int
@@ -826,6 +1509,26 @@ VscpRemoteTcpIf::doCmdBlockingReceive(vscpEvent* pEvent, uint32_t mstimeout)
     if (!isConnected())
         return VSCP_ERROR_CONNECTION;
 
+    // In binary mode wait for an event frame
+    if (m_bModeBinary) {
+
+        uint32_t startTime = vscp_getMsTimeStamp();
+        while (!m_binaryEventQueue.size()) {
+
+            if ((vscp_getMsTimeStamp() - startTime) >= mstimeout) {
+                return VSCP_ERROR_TIMEOUT;
+            }
+
+            if (!readFrames(m_innerResponseTimeout)) {
+                stcp_close_connection(m_conn);
+                m_conn = NULL;
+                return VSCP_ERROR_STOPPED;
+            }
+        }
+
+        return doCmdReceive(pEvent);
+    }
+
     // If **not** in receive loop terminate
     if (!m_bModeReceiveLoop)
         return VSCP_ERROR_PARAMETER;
@@ -867,7 +1570,7 @@ VscpRemoteTcpIf::doCmdBlockingReceive(vscpEvent* pEvent, uint32_t mstimeout)
         m_lastResponseTime = vscp_getMsTimeStamp();
 
         // Save the response
-        m_strResponse += std::string(buf, nRead);
+        m_response.append(buf, nRead);
 
         // Fill array
         addInputStringArrayFromReply();
@@ -916,8 +1619,8 @@ VscpRemoteTcpIf::doCmdBlockingReceive(vscpEventEx* pEventEx, uint32_t timeout)
     if (!isConnected())
         return VSCP_ERROR_CONNECTION;
 
-    // If not receive loop active terminate
-    if (!m_bModeReceiveLoop)
+    // If not receive loop or binary mode active terminate
+    if (!m_bModeReceiveLoop && !m_bModeBinary)
         return VSCP_ERROR_PARAMETER;
 
     if (VSCP_ERROR_SUCCESS != (rv = doCmdBlockingReceive(&e, timeout))) {
@@ -936,8 +1639,7 @@ VscpRemoteTcpIf::doCmdBlockingReceive(vscpEventEx* pEventEx, uint32_t timeout)
     if ((NULL != e.pdata) && e.sizeData) {
         memcpy(pEventEx->data, e.pdata, e.sizeData);
         // Don't need the data anymore
-        delete[] e.pdata;
-        e.pdata = NULL;
+        vscp_deleteEvent(&e);
     }
 
     return rv;
@@ -960,6 +1662,12 @@ VscpRemoteTcpIf::doCmdDataAvailable(void)
     if (m_bModeReceiveLoop)
         return VSCP_ERROR_ERROR;
 
+    // In binary mode events are streamed by the server
+    if (m_bModeBinary) {
+        readFrames(0);
+        return (int)m_binaryEventQueue.size();
+    }
+
     if (VSCP_ERROR_SUCCESS != doCommand("CDTA\r\n")) {
         return VSCP_ERROR_ERROR;
     }
@@ -55,6 +55,7 @@
 
 #include <canal.h>
 #include <guid.h>
+#include <linescanner.h>
 #include <sockettcp.h>
 #include <vscp.h>
 #include <vscpdatetime.h>
@@ -87,6 +88,28 @@
 #define TCPIP_REGISTER_READ_MAX_TRIES 3
 
 #define TCPIP_DEFAULT_CONNECT_TIMEOUT_SECONDS 15 // Seconds
+
+/*!
+    @def TCPIP_PIPELINE_WINDOW
+    Maximum number of pipelined commands sent to the daemon before
+    their replies are read. Keeps both sides from blocking on full
+    socket buffers.
+ */
+#define TCPIP_PIPELINE_WINDOW 256
+
+/*!
+    @def TCPIP_PIPELINE_POLL_TIMEOUT
+    Time in milliseconds to wait for replies in each read when
+    executing pipelined commands.
+ */
+#define TCPIP_PIPELINE_POLL_TIMEOUT 100
+
+/*!
+    @def TCPIP_BLOCK_MAX_EVENTS
+    Maximum number of events sent in one block (SENDN). Larger
+    blocks are split.
+ */
+#define TCPIP_BLOCK_MAX_EVENTS 4096
 /*!
     @def TCPIP_DLL_VERSION
     Pseudo version string
@@ -154,9 +177,17 @@ class VscpRemoteTcpIf
 
     /*!
         Get last response form remote node
-        @return Last raw response data from remote node
+        @return Lines of the last response from remote node
      */
-    std::string &getLastResponse(void) { return m_strResponse; };
+    std::string getLastResponse(void)
+    {
+        std::string str;
+        for (size_t i = 0; i < m_inputStrArray.size(); i++) {
+            str += m_inputStrArray[i];
+            str += "\r\n";
+        }
+        return str;
+    };
 
     /*!
         Get last response time
@@ -209,6 +240,71 @@ class VscpRemoteTcpIf
      */
     int doCommand(const char *cmd);
 
+    /*!
+        \brief Queue a command for pipelined execution.
+
+        Queued commands are sent with pipelineExecute. The command is
+        encoded for the current mode (text or binary) so queue commands
+        after the mode is set.
+        @param cmd Command to queue. In text mode it should end with
+       "\r\n".
+        @return VSCP_ERROR_SUCCESS on success, VSCP_ERROR_PARAMETER if the
+       command is too large to fit in a frame.
+     */
+    int pipelineCommand(const std::string &cmd);
+
+    /*!
+        \brief Queue a send of an event for pipelined execution.
+        @param pEvent Event to send.
+        @return VSCP_ERROR_SUCCESS on success, VSCP_ERROR_PARAMETER if the
+       event is invalid.
+     */
+    int pipelineSend(const vscpEvent *pEvent);
+
+    /*!
+        \brief Queue a send of an ex event for pipelined execution.
+        @param pEventEx Event to send.
+        @return VSCP_ERROR_SUCCESS on success, VSCP_ERROR_PARAMETER if the
+       event is invalid.
+     */
+    int pipelineSendEx(const vscpEventEx *pEventEx);
+
+    /*!
+        Get the number of commands queued for pipelined execution.
+     */
+    size_t pipelineSize(void) { return m_pipeline.size(); };
+
+    /*!
+        Remove all commands queued for pipelined execution.
+     */
+    void pipelineClear(void) { m_pipeline.clear(); };
+
+    /*!
+        \brief Execute all queued commands.
+
+        Commands are written to the daemon back to back, up to
+        TCPIP_PIPELINE_WINDOW at a time, without waiting for each reply.
+        The daemon answers the commands of a connection in the order they
+        are received and the replies are matched in that order, each
+        ending with a "+OK", "-OK" or "+ERR" line. Only commands with
+        exactly one reply can be pipelined. The queue is empty when the
+        call returns.
+
+        @param results Result for each command in queued order,
+       VSCP_ERROR_SUCCESS for "+OK" and VSCP_ERROR_ERROR for "-OK" or
+       "+ERR". Has fewer entries than the number of commands if the
+       execution failed.
+        @param pReplies If not NULL the full reply of each command in
+       queued order.
+        @return VSCP_ERROR_SUCCESS if all commands succeeded,
+       VSCP_ERROR_ERROR if one or more commands failed, VSCP_ERROR_TIMEOUT
+       if a reply did not arrive in time, VSCP_ERROR_COMMUNICATION on a
+       socket error, VSCP_ERROR_CONNECTION if not connected and
+       VSCP_ERROR_PARAMETER in receive loop.
+     */
+    int pipelineExecute(std::deque<int> &results,
+                        std::deque<std::string> *pReplies = NULL);
+
     /*!
         Open communication interface.
         @param strInterface should contain "username;password;ip-addr;port" if
@@ -294,6 +390,21 @@ class VscpRemoteTcpIf
      */
     int doCmdSendLevel1(const canalMsg *pMsg);
 
+    /*!
+        Send a block of VSCP ex events through the interface with the
+        SENDN command. All events of a block are written at once and
+        one reply is read for the whole block.
+        @param pEvents Events to send.
+        @param count Number of events.
+        @param pFailed If not NULL the index in pEvents of each event the
+            daemon could not send is added.
+        @return CANAL_ERROR_SUCCESS if all events were sent and error
+            code if failure.
+     */
+    int doCmdSendBlockEx(const vscpEventEx *pEvents,
+                         size_t count,
+                         std::deque<size_t> *pFailed = NULL);
+
     /*!
         Receive a VSCP event through the interface.
         @return CANAL_ERROR_SUCCESS on success and error code if failure.
@@ -306,6 +417,16 @@ class VscpRemoteTcpIf
      */
     int doCmdReceiveEx(vscpEventEx *pEvent);
 
+    /*!
+        Receive a block of VSCP ex events through the interface with the
+        RETRN command.
+        @param events Received events are added to this queue.
+        @param count Max number of events to receive. Zero is all events
+            in the daemon queue.
+        @return CANAL_ERROR_SUCCESS on success and error code if failure.
+     */
+    int doCmdReceiveBlockEx(std::deque<vscpEventEx> &events, uint32_t count);
+
     /*!
         Receive an VSCP Level I event through the interface.
         For the extended and the RTR bit to be handled the
@@ -334,6 +455,28 @@ class VscpRemoteTcpIf
      */
     int doCmdQuitReceiveLoop(void);
 
+    /*!
+        Enter binary mode (BINARY). Events are sent and received as
+        length prefixed UDP type frames and commands and replies are
+        carried in frames. All other methods can be used as before. Events
+        sent by the server are collected and are fetched with doCmdReceive
+        or doCmdBlockingReceive.
+
+        @return VSCP_ERROR_SUCCESS if success VSCP_ERROR_ERROR if not.
+     */
+    int doCmdEnterBinaryMode(void);
+
+    /*!
+        Quit binary mode (QUITBINARY)
+        @return VSCP_ERROR_SUCCESS if success VSCP_ERROR_ERROR if not.
+     */
+    int doCmdQuitBinaryMode(void);
+
+    /*!
+        Returns true if the interface is in binary mode.
+     */
+    bool isBinaryMode(void) { return m_bModeBinary; };
+
     /*!
         Receive an event
         The receiveloop command must have been issued for this method to work as
@@ -1631,6 +1774,62 @@ class VscpRemoteTcpIf
     /// Flag for active receive loop
     bool m_bModeReceiveLoop;
 
+    /// Flag for active binary mode
+    bool m_bModeBinary;
+
+    /// Received data not yet parsed into frames (binary mode)
+    CLineScanner m_binaryBuffer;
+
+    /// Events received in binary mode
+    std::deque<vscpEvent *> m_binaryEventQueue;
+
+    /// Commands queued for pipelined execution, encoded for sending
+    std::deque<std::string> m_pipeline;
+
+
+    /*!
+        Append a frame to a string (binary mode)
+        @param strFrames String the frame is added to.
+        @param type Frame type (VSCP_BINARY_TYPE_xxx)
+        @param pPayload Frame data after the type byte.
+        @param len Size of frame data.
+        @return false if the data does not fit in a frame.
+     */
+    bool encodeFrame(std::string &strFrames,
+                     uint8_t type,
+                     const uint8_t *pPayload,
+                     size_t len);
+
+    /*!
+        Write a frame (binary mode)
+        @param type Frame type (VSCP_BINARY_TYPE_xxx)
+        @param pPayload Frame data after the type byte.
+        @param len Size of frame data.
+        @return true on success.
+     */
+    bool writeFrame(uint8_t type, const uint8_t *pPayload, size_t len);
+
+    /*!
+        Read from the server and handle all complete frames (binary mode).
+        Reply text is added to m_response and events to
+        m_binaryEventQueue.
+        @param timeout Time in milliseconds to wait for data.
+        @return false if the connection failed.
+     */
+    bool readFrames(int timeout);
+
+    /*!
+        Handle all complete frames in m_binaryBuffer (binary mode).
+        Reply text is added to m_response and events to
+        m_binaryEventQueue.
+     */
+    void parseFrames(void);
+
+    /*!
+        Free all events received in binary mode
+     */
+    void clearBinaryEventQueue(void);
+
     /// Server response timeout in milliseconds
     uint32_t m_responseTimeOut;
 
@@ -1673,12 +1872,12 @@ class VscpRemoteTcpIf
     struct stcp_connection *m_conn;
 
     /*!
-     * This is the last response from a remote node.
-     * It can contain multiple response lines (separated
-     * with \r\n) and will end with a line containg +OK
-     * or -ERR if an error response was receved.
+     * Response data from the remote node not yet taken as lines.
+     * A response can contain multiple lines (separated with \r\n)
+     * and ends with a line starting with +OK or -OK. In binary mode
+     * the text of reply frames is added here.
      */
-    std::string m_strResponse;
+    CLineScanner m_response;
 };
 
 // * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
@@ -29,6 +29,11 @@
 #if !defined(WEBSOCKET_H__INCLUDED_)
 #define WEBSOCKET_H__INCLUDED_
 
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <atomic>
+
 #include <vscp.h>
 //#include <controlobject.h>
 
@@ -46,6 +51,16 @@
 // removed by the system.
 #define WEBSOCKET_EXPIRE_TIME (2 * 60)
 
+// Max time (milliseconds) the sender of a session sleeps when there is
+// nothing to send. It is woken up as soon as an event is queued.
+#define WEBSOCK_SENDER_WAIT_TIME 500
+
+// Number of events the sender takes out of the client queue at a time
+#define WEBSOCK_SENDER_BATCH 64
+
+// Max number of events in one WS2 event frame (see BATCH command)
+#define WEBSOCK_MAX_FRAME_EVENTS 256
+
 // Authentication states
 enum
 {
@@ -68,6 +83,7 @@ enum
     WEBSOCK_ERROR_PARSE_FORMAT            = 8, // Parse error, invalid format.
     WEBSOCK_ERROR_UNKNOWN_TYPE = 9, // Unkown object type
     WEBSOCK_ERROR_GENERAL = 10, // General errors and exceptions
+    WEBSOCK_ERROR_RATE_LIMITED = 11, // Over the event rate limit
 };
 
 #define WEBSOCK_STR_ERROR_NO_ERROR        "Everything is OK."
@@ -83,6 +99,8 @@ enum
 #define WEBSOCK_STR_ERROR_PARSE_FORMAT "Parse error, invalid format."
 #define WEBSOCK_STR_ERROR_UNKNOWN_TYPE "Unknown type, only know 'COMMAND' and 'EVENT'."
 #define WEBSOCK_STR_ERROR_GENERAL "Exception or other general error."
+#define WEBSOCK_STR_ERROR_RATE_LIMITED                                         \
+    "Rate limit exceeded, try again later."
 
 #define WEBSOCKET_MAINCODE_POSITIVE "+"
 #define WEBSOCKET_MAINCODE_NEGATIVE "-"
@@ -111,8 +129,8 @@ class websock_session
     // Connection object
     struct mg_connection* m_conn;
 
-    // Connection state (see enums above)
-    int m_conn_state;
+    // Connection state (see enums above). Read by the sender thread.
+    std::atomic<int> m_conn_state;
 
     // Unique ID for this session.
     char m_websocket_key[33]; // Sec-WebSocket-Key
@@ -131,6 +149,22 @@ class websock_session
 
     // Client structure for websocket
     CClientItem* m_pClientItem;
+
+    // Max number of events in one WS2 event frame. Events are sent
+    // one per frame (WS2_EVENT) when set to one.
+    std::atomic<int> m_nFrameEvents;
+
+    // Sender thread that writes queued events to the client
+    pthread_t m_senderThread;
+
+    // True when the sender thread is running
+    bool m_bSender;
+
+    // Set to true to make the sender thread exit
+    std::atomic<bool> m_bQuit;
+
+    // Wakes up the sender when it waits for the channel to be opened
+    sem_t m_semSender;
 };
 
 #define WS2_COMMAND                                                            \
@@ -147,6 +181,15 @@ class websock_session
     " %s "                                                                     \
     "}"
 
+// Several events in one frame (see BATCH command). Clients send a batch
+// of events the same way and get the status of each in the response.
+#define WS2_EVENTS                                                             \
+    "{"                                                                        \
+    " \"type\" : \"EVENTS\", "                                                 \
+    " \"events\" : "                                                           \
+    " [%s] "                                                                   \
+    "}"
+
 #define WS2_POSITIVE_RESPONSE                                                  \
     "{"                                                                        \
     " \"type\" : \"+\", "                                                      \
@@ -198,9 +241,4 @@ class w2msg
     vscpEventEx m_ex;
 };
 
-// Public functions
-
-void
-websock_post_incomingEvents(void);
-
 #endif
\ No newline at end of file
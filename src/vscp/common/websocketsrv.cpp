@@ -70,6 +70,7 @@
 #include <actioncodes.h>
 #include <controlobject.h>
 #include <devicelist.h>
+#include <eventbatch.h>
 #include <mdf.h>
 #include <remotevariablecodes.h>
 #include <version.h>
@@ -122,6 +123,12 @@ webserv_util_sendheader(struct mg_connection* nc,
 //            Forward declarations
 ////////////////////////////////////////////////////
 
+bool
+websock_start_sender(websock_session* pSession);
+
+void
+websock_stop_sender(websock_session* pSession);
+
 void
 ws1_command(struct mg_connection* conn,
             struct websock_session* pSession,
@@ -161,11 +168,16 @@ websock_session::websock_session(void)
     m_version      = 0;
     lastActiveTime = 0;
     m_pClientItem  = NULL;
+    m_nFrameEvents = 1;
+    m_bSender      = false;
+    m_bQuit        = false;
+    sem_init(&m_semSender, 0, 0);
 };
 
 websock_session::~websock_session(void)
 {
     m_pClientItem = NULL;
+    sem_destroy(&m_semSender);
 };
 
 // w2msg - Message holder for W2
@@ -292,9 +304,8 @@ websock_authentication(struct mg_connection* conn,
     pSession->m_pClientItem->m_pUserItem = pUserItem;
 
     // Copy in the user filter
-    memcpy(&pSession->m_pClientItem->m_filter,
-           pUserItem->getUserFilter(),
-           sizeof(vscpEventFilter));
+    gpobj->m_clientList.setClientFilter(pSession->m_pClientItem,
+                                        pUserItem->getUserFilter());
 
     // Log valid login
     syslog(LOG_ERR,
@@ -392,6 +403,18 @@ websock_new_session(const struct mg_connection* conn)
     }
     pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
 
+    // Start the sender that push events to the client
+    if (!websock_start_sender(pSession)) {
+        syslog(LOG_ERR,
+               "[Websockets] New session: Unable to start sender thread.");
+        pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
+        gpobj->m_clientList.removeClient(pSession->m_pClientItem);
+        pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
+        pSession->m_pClientItem = NULL;
+        delete pSession;
+        return NULL;
+    }
+
     pthread_mutex_lock(&gpobj->m_mutex_websocketSession);
     gpobj->m_websocketSessions.push_back(pSession);
     pthread_mutex_unlock(&gpobj->m_mutex_websocketSession);
@@ -433,98 +456,206 @@ websock_sendevent(struct mg_connection* conn,
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// websocket_post_incomingEvent
+// websock_writeEvents
+//
+// Write the events collected for a WS2 client in one frame.
 //
 
-void
-websock_post_incomingEvents(void)
+static void
+websock_writeEvents(websock_session* pSession,
+                    std::string& strEvents,
+                    int& nEvents)
 {
-    pthread_mutex_lock(&gpobj->m_mutex_websocketSession);
+    std::string str = vscp_str_format(WS2_EVENTS, strEvents.c_str());
+    mg_websocket_write(pSession->m_conn,
+                       MG_WEBSOCKET_OPCODE_TEXT,
+                       (const char*)str.c_str(),
+                       str.length());
+    strEvents.clear();
+    nEvents = 0;
+}
 
-    std::list<websock_session*>::iterator iter;
-    for (iter = gpobj->m_websocketSessions.begin();
-         iter != gpobj->m_websocketSessions.end();
-         ++iter) {
+///////////////////////////////////////////////////////////////////////////////
+// websock_sendEvents
+//
+// Send everything that is queued for a session. The events are taken
+// out of the client queue a batch at a time. WS1 clients get one event
+// in each frame. WS2 clients get one event in each frame or, if they
+// asked for it with the BATCH command, the events that are ready
+// (up to m_nFrameEvents) in one frame.
+//
 
-        websock_session* pSession = *iter;
-        if (NULL == pSession) {
-            continue;
+static void
+websock_sendEvents(websock_session* pSession)
+{
+    CClientItem* pClientItem = pSession->m_pClientItem;
+    CSharedEvent* batch[WEBSOCK_SENDER_BATCH];
+    std::string strEvents;
+    int nEvents = 0;
+
+    while (!pSession->m_bQuit && pClientItem->m_bOpen) {
+
+        size_t cnt = 0;
+        pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+        while (cnt < WEBSOCK_SENDER_BATCH) {
+            CSharedEvent* pSharedEvent = pClientItem->m_clientInputQueue.pop();
+            if (NULL == pSharedEvent) {
+                break;
+            }
+            batch[cnt++] = pSharedEvent;
         }
+        pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
-        // Should be a client item... hmm.... client disconnected
-        if (NULL == pSession->m_pClientItem) {
-            continue;
+        if (0 == cnt) {
+            break;
         }
 
-        if (pSession->m_conn_state < WEBSOCK_CONN_STATE_CONNECTED)
-            continue;
+        // User must be authorized to receive events
+        bool bAllowed = (NULL != pClientItem->m_pUserItem) &&
+                        (pClientItem->m_pUserItem->getUserRights() &
+                         VSCP_USER_RIGHT_ALLOW_RCV_EVENT);
 
-        if (NULL == pSession->m_conn)
-            continue;
+        for (size_t i = 0; i < cnt; i++) {
 
-        if (pSession->m_pClientItem->m_bOpen &&
-            pSession->m_pClientItem->m_clientInputQueue.size()) {
+            CSharedEvent* pSharedEvent = batch[i];
 
-            vscpEvent* pEvent;
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            if (NULL != pEvent) {
+            // Run event through filter
+            if (!bAllowed || !vscp_doLevel2Filter(pSharedEvent->getEvent(),
+                                                  &pClientItem->m_filter)) {
+                pSharedEvent->release();
+                continue;
+            }
 
-                // Run event through filter
-                if (vscp_doLevel2Filter(pEvent,
-                                        &pSession->m_pClientItem->m_filter)) {
+            // The event is rendered once for all sessions that receive it
+            const std::string* pstr = pSharedEvent->getString();
+            if (NULL == pstr) {
+                pSharedEvent->release();
+                continue;
+            }
 
-                    // User must be authorized to receive events
-                    if (!(pSession->m_pClientItem->m_pUserItem
-                            ->getUserRights() &
-                          VSCP_USER_RIGHT_ALLOW_RCV_EVENT)) {
-                        continue;
+            if (__VSCP_DEBUG_WEBSOCKET_RX) {
+                syslog(LOG_DEBUG, "Received ws event %s", pstr->c_str());
+            }
+
+            // Write it out
+            if (WS_TYPE_1 == pSession->m_wstypes) {
+                std::string str = ("E;") + *pstr;
+                mg_websocket_write(pSession->m_conn,
+                                   MG_WEBSOCKET_OPCODE_TEXT,
+                                   (const char*)str.c_str(),
+                                   str.length());
+            }
+            else if (WS_TYPE_2 == pSession->m_wstypes) {
+                const std::string* pjson = pSharedEvent->getJSON();
+                if (NULL == pjson) {
+                    ; // Could not be rendered
+                }
+                else if (pSession->m_nFrameEvents <= 1) {
+                    std::string str =
+                      vscp_str_format(WS2_EVENT, pjson->c_str());
+                    mg_websocket_write(pSession->m_conn,
+                                       MG_WEBSOCKET_OPCODE_TEXT,
+                                       (const char*)str.c_str(),
+                                       str.length());
+                }
+                else {
+                    if (nEvents) {
+                        strEvents += ",";
                     }
+                    strEvents += *pjson;
+                    if (++nEvents >= pSession->m_nFrameEvents) {
+                        websock_writeEvents(pSession, strEvents, nEvents);
+                    }
+                }
+            }
 
-                    std::string str;
-                    if (vscp_convertEventToString(str, pEvent)) {
+            // Release the event
+            pSharedEvent->release();
+        }
+    }
 
-                        if (__VSCP_DEBUG_WEBSOCKET_RX) {
-                            syslog(LOG_DEBUG,
-                                   "Received ws event %s",
-                                   str.c_str());
-                        }
+    // Write what is left when the queue is empty
+    if (nEvents) {
+        websock_writeEvents(pSession, strEvents, nEvents);
+    }
+}
 
-                        // Write it out
-                        if (WS_TYPE_1 == pSession->m_wstypes) {
-                            str = ("E;") + str;
-                            mg_websocket_write(pSession->m_conn,
-                                               MG_WEBSOCKET_OPCODE_TEXT,
-                                               (const char*)str.c_str(),
-                                               str.length());
-                        }
-                        else if (WS_TYPE_2 == pSession->m_wstypes) {
-                            std::string strEvent;
-                            vscp_convertEventToJSON(strEvent, pEvent);
-                            std::string str =
-                              vscp_str_format(WS2_EVENT, strEvent.c_str());
-                            mg_websocket_write(pSession->m_conn,
-                                               MG_WEBSOCKET_OPCODE_TEXT,
-                                               (const char*)str.c_str(),
-                                               str.length());
-                        }
-                    }
-                }
+///////////////////////////////////////////////////////////////////////////////
+// websock_senderThread
+//
+// Push events to the client of a session as soon as they are queued.
+// Each session has its own sender so a slow client does not hold up
+// the others.
+//
 
-                // Remove the event
-                vscp_deleteEvent_v2(&pEvent);
+static void*
+websock_senderThread(void* pData)
+{
+    websock_session* pSession = (websock_session*)pData;
+    if (NULL == pSession) {
+        return NULL;
+    }
 
-            } // Valid pEvent pointer
+    CClientItem* pClientItem = pSession->m_pClientItem;
 
-        } // events available
+    while (!pSession->m_bQuit) {
 
-    } // for
+        // Nothing is sent until the client has opened the channel
+        if (!pClientItem->m_bOpen ||
+            (pSession->m_conn_state < WEBSOCK_CONN_STATE_DATA)) {
+            vscp_sem_wait(&pSession->m_semSender, WEBSOCK_SENDER_WAIT_TIME);
+            continue;
+        }
 
-    pthread_mutex_unlock(&gpobj->m_mutex_websocketSession);
+        // Wait for events
+        if (!pClientItem->m_clientInputQueue.wait(WEBSOCK_SENDER_WAIT_TIME)) {
+            continue;
+        }
+
+        websock_sendEvents(pSession);
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websock_start_sender
+//
+
+bool
+websock_start_sender(websock_session* pSession)
+{
+    pSession->m_bQuit = false;
+    if (0 != pthread_create(&pSession->m_senderThread,
+                            NULL,
+                            websock_senderThread,
+                            pSession)) {
+        return false;
+    }
+
+    pSession->m_bSender = true;
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websock_stop_sender
+//
+
+void
+websock_stop_sender(websock_session* pSession)
+{
+    if (!pSession->m_bSender) {
+        return;
+    }
+
+    pSession->m_bQuit = true;
+    sem_post(&pSession->m_semSender);
+    if (NULL != pSession->m_pClientItem) {
+        pSession->m_pClientItem->m_clientInputQueue.signal();
+    }
+
+    pthread_join(pSession->m_senderThread, NULL);
+    pSession->m_bSender = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -548,10 +679,10 @@ ws1_connectHandler(const struct mg_connection* conn, void* cbdata)
 
     if (NULL != pSession) {
         reject = 0;
-    }
 
-    // This is a WS1 type connection
-    pSession->m_wstypes = WS_TYPE_1;
+        // This is a WS1 type connection
+        pSession->m_wstypes = WS_TYPE_1;
+    }
 
     mg_unlock_context(ctx);
 
@@ -584,6 +715,11 @@ ws1_closeHandler(const struct mg_connection* conn, void* cbdata)
     if (pSession->m_conn_state < WEBSOCK_CONN_STATE_CONNECTED)
         return;
 
+    // The sender must be gone before the connection and client goes away.
+    // It is stopped before the context is locked as it can be held up
+    // writing to a slow client.
+    websock_stop_sender(pSession);
+
     mg_lock_context(ctx);
 
     // Record activity
@@ -591,7 +727,9 @@ ws1_closeHandler(const struct mg_connection* conn, void* cbdata)
 
     pSession->m_conn_state = WEBSOCK_CONN_STATE_NULL;
     pSession->m_conn       = NULL;
+    pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
     gpobj->m_clientList.removeClient(pSession->m_pClientItem);
+    pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
     pSession->m_pClientItem = NULL;
 
     pthread_mutex_lock(&gpobj->m_mutex_websocketSession);
@@ -978,6 +1116,18 @@ ws1_message(struct mg_connection* conn,
                         return true; // Keep connection open
                     }
 
+                    // Over the rate limit of the session or the user
+                    if (0 == gpobj->admitEvents(pSession->m_pClientItem)) {
+                        str = vscp_str_format(("-;%d;%s"),
+                                              (int)WEBSOCK_ERROR_RATE_LIMITED,
+                                              WEBSOCK_STR_ERROR_RATE_LIMITED);
+                        mg_websocket_write(conn,
+                                           MG_WEBSOCKET_OPCODE_TEXT,
+                                           (const char*)str.c_str(),
+                                           str.length());
+                        return true; // Keep connection open
+                    }
+
                     ex.obid = pSession->m_pClientItem->m_clientID;
                     if (websock_sendevent(conn, pSession, &ex)) {
                         mg_websocket_write(conn,
@@ -1165,6 +1315,9 @@ ws1_command(struct mg_connection* conn,
 
         pSession->m_pClientItem->m_bOpen = true;
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, "+;OPEN", 6);
+
+        // Let the sender deliver what is queued
+        sem_post(&pSession->m_semSender);
     }
 
     // ------------------------------------------------------------------------
@@ -1225,16 +1378,15 @@ ws1_command(struct mg_connection* conn,
             return; // We still leave channel open
         }
 
+        vscpEventFilter filter = pSession->m_pClientItem->m_filter;
+
         // Get filter
         if (!tokens.empty()) {
 
             strTok = tokens.front();
             tokens.pop_front();
 
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            if (!vscp_readFilterFromString(&pSession->m_pClientItem->m_filter,
-                                           strTok)) {
+            if (!vscp_readFilterFromString(&filter, strTok)) {
 
                 str = vscp_str_format(("-;SF;%d;%s"),
                                       (int)WEBSOCK_ERROR_SYNTAX_ERROR,
@@ -1245,13 +1397,8 @@ ws1_command(struct mg_connection* conn,
                                    (const char*)str.c_str(),
                                    str.length());
 
-                pthread_mutex_unlock(
-                  &pSession->m_pClientItem->m_mutexClientInputQueue);
                 return;
             }
-
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
         }
         else {
 
@@ -1273,10 +1420,7 @@ ws1_command(struct mg_connection* conn,
             strTok = tokens.front();
             tokens.pop_front();
 
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            if (!vscp_readMaskFromString(&pSession->m_pClientItem->m_filter,
-                                         strTok)) {
+            if (!vscp_readMaskFromString(&filter, strTok)) {
 
                 str = vscp_str_format(("-;SF;%d;%s"),
                                       (int)WEBSOCK_ERROR_SYNTAX_ERROR,
@@ -1287,13 +1431,8 @@ ws1_command(struct mg_connection* conn,
                                    (const char*)str.c_str(),
                                    str.length());
 
-                pthread_mutex_unlock(
-                  &pSession->m_pClientItem->m_mutexClientInputQueue);
                 return;
             }
-
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
         }
         else {
             str = vscp_str_format(("-;SF;%d;%s"),
@@ -1307,6 +1446,9 @@ ws1_command(struct mg_connection* conn,
             return;
         }
 
+        // Activate the new filter
+        gpobj->m_clientList.setClientFilter(pSession->m_pClientItem, &filter);
+
         // Positive response
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, "+;SF", 4);
     }
@@ -1339,18 +1481,7 @@ ws1_command(struct mg_connection* conn,
             return; // We still leave channel open
         }
 
-        std::deque<vscpEvent*>::iterator it;
         pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-
-        for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
-             it != pSession->m_pClientItem->m_clientInputQueue.end();
-             ++it) {
-            vscpEvent* pEvent =
-              pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            vscp_deleteEvent_v2(&pEvent);
-        }
-
         pSession->m_pClientItem->m_clientInputQueue.clear();
         pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
@@ -1424,10 +1555,10 @@ ws2_connectHandler(const struct mg_connection* conn, void* cbdata)
 
     if (NULL != pSession) {
         reject = 0;
-    }
 
-    // This is a WS2 type connection
-    pSession->m_wstypes = WS_TYPE_2;
+        // This is a WS2 type connection
+        pSession->m_wstypes = WS_TYPE_2;
+    }
 
     mg_unlock_context(ctx);
 
@@ -1461,6 +1592,11 @@ ws2_closeHandler(const struct mg_connection* conn, void* cbdata)
     if (pSession->m_conn_state < WEBSOCK_CONN_STATE_CONNECTED)
         return;
 
+    // The sender must be gone before the connection and client goes away.
+    // It is stopped before the context is locked as it can be held up
+    // writing to a slow client.
+    websock_stop_sender(pSession);
+
     mg_lock_context(ctx);
 
     // Record activity
@@ -1468,7 +1604,9 @@ ws2_closeHandler(const struct mg_connection* conn, void* cbdata)
 
     pSession->m_conn_state = WEBSOCK_CONN_STATE_NULL;
     pSession->m_conn       = NULL;
+    pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
     gpobj->m_clientList.removeClient(pSession->m_pClientItem);
+    pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
     pSession->m_pClientItem = NULL;
 
     pthread_mutex_lock(&gpobj->m_mutex_websocketSession);
@@ -1919,6 +2057,22 @@ ws2_message(struct mg_connection* conn,
                                     return true; // 'true' leave connection open
                                 }
 
+                                // Over the rate limit of the session or
+                                // the user
+                                if (0 == gpobj->admitEvents(
+                                           pSession->m_pClientItem)) {
+                                    str = vscp_str_format(
+                                      WS2_NEGATIVE_RESPONSE,
+                                      "EVENT",
+                                      (int)WEBSOCK_ERROR_RATE_LIMITED,
+                                      WEBSOCK_STR_ERROR_RATE_LIMITED);
+                                    mg_websocket_write(conn,
+                                                       MG_WEBSOCKET_OPCODE_TEXT,
+                                                       (const char*)str.c_str(),
+                                                       str.length());
+                                    return true; // 'true' leave connection open
+                                }
+
                                 ex.obid = pSession->m_pClientItem->m_clientID;
                                 if (websock_sendevent(conn, pSession, &ex)) {
 
@@ -1975,6 +2129,95 @@ ws2_message(struct mg_connection* conn,
                     return true; // 'true' leave connection open
                 }
             }
+            // Several events, {"type":"EVENTS","events":[{...},{...}]}
+            else if ("EVENTS" == str) {
+                msg.m_type = MSG_TYPE_EVENT;
+
+                // Client must be authorised to send events
+                if ((NULL == pSession->m_pClientItem) ||
+                    !pSession->m_pClientItem->bAuthenticated) {
+
+                    str = vscp_str_format(WS2_NEGATIVE_RESPONSE,
+                                          "EVENTS",
+                                          (int)WEBSOCK_ERROR_NOT_AUTHORISED,
+                                          WEBSOCK_STR_ERROR_NOT_AUTHORISED);
+                    mg_websocket_write(conn,
+                                       MG_WEBSOCKET_OPCODE_TEXT,
+                                       (const char*)str.c_str(),
+                                       str.length());
+
+                    syslog(LOG_ERR,
+                           "[Websocket ws2] Not authorised to send events.");
+
+                    return false; // 'false' - Drop connection
+                }
+
+                json::iterator it = json_pkg.find("events");
+                if ((json_pkg.end() == it) || !it->is_array()) {
+
+                    str = vscp_str_format(WS2_NEGATIVE_RESPONSE,
+                                          "EVENTS",
+                                          (int)WEBSOCK_ERROR_PARSE_FORMAT,
+                                          WEBSOCK_STR_ERROR_PARSE_FORMAT);
+                    mg_websocket_write(conn,
+                                       MG_WEBSOCKET_OPCODE_TEXT,
+                                       (const char*)str.c_str(),
+                                       str.length());
+
+                    syslog(LOG_ERR,
+                           "Failed to parse ws2 websocket events object");
+
+                    return true; // 'true' leave connection open
+                }
+
+                // Rights are checked and the events sent for the whole
+                // batch at once
+                CEventBatch batch;
+                for (json::const_iterator ev = it->begin(); ev != it->end();
+                     ++ev) {
+                    batch.add(*ev);
+                }
+                batch.check(pSession->m_pClientItem->m_pUserItem);
+                batch.send(pSession->m_pClientItem);
+
+                // Nothing sent because of the rate limit
+                size_t nRateLimited = 0;
+                for (size_t i = 0; i < batch.getCount(); i++) {
+                    if (EVENTBATCH_RATE_LIMITED == batch.getStatus(i)) {
+                        nRateLimited++;
+                    }
+                }
+
+                if (!batch.getSent() && nRateLimited &&
+                    (nRateLimited == batch.getFailed())) {
+                    str = vscp_str_format(WS2_NEGATIVE_RESPONSE,
+                                          "EVENTS",
+                                          (int)WEBSOCK_ERROR_RATE_LIMITED,
+                                          WEBSOCK_STR_ERROR_RATE_LIMITED);
+                }
+                else {
+                    std::string strArgs = vscp_str_format(
+                      "{\"count\":%zu,\"failed\":%s,\"sent\":%zu}",
+                      batch.getCount(),
+                      batch.getFailedJSON().c_str(),
+                      batch.getSent());
+                    str = vscp_str_format(WS2_POSITIVE_RESPONSE,
+                                          "EVENTS",
+                                          strArgs.c_str());
+                }
+
+                mg_websocket_write(conn,
+                                   MG_WEBSOCKET_OPCODE_TEXT,
+                                   (const char*)str.c_str(),
+                                   str.length());
+
+                if (__VSCP_DEBUG_WEBSOCKET_TX) {
+                    syslog(LOG_DEBUG,
+                           "Sent ws2 events %zu of %zu",
+                           batch.getSent(),
+                           batch.getCount());
+                }
+            }
             // Positive response
             else if ("+" == str) {
                 msg.m_type = MSG_TYPE_RESPONSE_POSITIVE;
@@ -2251,6 +2494,9 @@ ws2_command(struct mg_connection* conn,
                            MG_WEBSOCKET_OPCODE_TEXT,
                            (const char*)str.c_str(),
                            str.length());
+
+        // Let the sender deliver what is queued
+        sem_post(&pSession->m_semSender);
     }
 
     // ------------------------------------------------------------------------
@@ -2318,15 +2564,14 @@ ws2_command(struct mg_connection* conn,
             return false; // We still leave channel open
         }
 
+        vscpEventFilter filter = pSession->m_pClientItem->m_filter;
+
         // Get filter
         if (!argmap.empty()) {
 
             strFilter = jsonObj.dump();
 
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            if (!vscp_readFilterMaskFromJSON(&pSession->m_pClientItem->m_filter,
-                                             strFilter)) {
+            if (!vscp_readFilterMaskFromJSON(&filter, strFilter)) {
 
                 std::string str =
                   vscp_str_format(WS2_NEGATIVE_RESPONSE,
@@ -2342,13 +2587,8 @@ ws2_command(struct mg_connection* conn,
                        "[Websocket w2] Set filter syntax error. [%s]",
                        strFilter.c_str());
 
-                pthread_mutex_unlock(
-                  &pSession->m_pClientItem->m_mutexClientInputQueue);
                 return false;
             }
-
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
         }
         else {
 
@@ -2368,6 +2608,9 @@ ws2_command(struct mg_connection* conn,
             return false;
         }
 
+        // Activate the new filter
+        gpobj->m_clientList.setClientFilter(pSession->m_pClientItem, &filter);
+
         // Positive response
         std::string str =
           vscp_str_format(WS2_POSITIVE_RESPONSE, strCmd.c_str(), "null");
@@ -2404,18 +2647,7 @@ ws2_command(struct mg_connection* conn,
             return false; // We still leave channel open
         }
 
-        std::deque<vscpEvent*>::iterator it;
         pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-
-        for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
-             it != pSession->m_pClientItem->m_clientInputQueue.end();
-             ++it) {
-            vscpEvent* pEvent =
-              pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            vscp_deleteEvent_v2(&pEvent);
-        }
-
         pSession->m_pClientItem->m_clientInputQueue.clear();
         pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
@@ -2427,6 +2659,56 @@ ws2_command(struct mg_connection* conn,
                            str.length());
     }
 
+    // ------------------------------------------------------------------------
+    //                                BATCH
+    //-------------------------------------------------------------------------
+
+    // Max number of events in one event frame. With more than one the
+    // events that are ready are sent together in an EVENTS frame.
+    else if ("BATCH" == strCmd) {
+
+        int nFrameEvents = -1;
+        try {
+            if (jsonObj.is_object() && (jsonObj.find("max") != jsonObj.end())) {
+                if (jsonObj["max"].is_number_integer()) {
+                    nFrameEvents = jsonObj["max"].get<int>();
+                }
+                else if (jsonObj["max"].is_string()) {
+                    nFrameEvents = vscp_readStringValue(argmap["max"]);
+                }
+            }
+        }
+        catch (...) {
+            nFrameEvents = -1;
+        }
+
+        if ((nFrameEvents < 1) || (nFrameEvents > WEBSOCK_MAX_FRAME_EVENTS)) {
+
+            std::string str = vscp_str_format(WS2_NEGATIVE_RESPONSE,
+                                              strCmd.c_str(),
+                                              (int)WEBSOCK_ERROR_SYNTAX_ERROR,
+                                              WEBSOCK_STR_ERROR_SYNTAX_ERROR);
+            mg_websocket_write(conn,
+                               MG_WEBSOCKET_OPCODE_TEXT,
+                               (const char*)str.c_str(),
+                               str.length());
+
+            return false;
+        }
+
+        pSession->m_nFrameEvents = nFrameEvents;
+
+        std::string strResult =
+          vscp_str_format("{ \"max\" : %d }", nFrameEvents);
+        std::string str = vscp_str_format(WS2_POSITIVE_RESPONSE,
+                                          strCmd.c_str(),
+                                          strResult.c_str());
+        mg_websocket_write(conn,
+                           MG_WEBSOCKET_OPCODE_TEXT,
+                           (const char*)str.c_str(),
+                           str.length());
+    }
+
     // ------------------------------------------------------------------------
     //                              VERSION
     //-------------------------------------------------------------------------
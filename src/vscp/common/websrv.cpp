@@ -152,13 +152,14 @@ websrv_sendheader(struct mg_connection* conn,
         return;
 
     mg_printf(conn,
-              "HTTP/1.1 %d OK\r\n"
+              "HTTP/1.1 %d %s\r\n"
               "Content-Type: %s\r\n"
-              "Date: %s\r"
+              "Date: %s\r\n"
               "Cache-Control: no-cache\r\n"
               "Cache-Control: no-store\r\n"
               "Cache-Control: must-revalidate\r\n\r\n",
               returncode,
+              mg_get_response_code_text(conn, returncode),
               pcontent,
               date);
 }
@@ -186,7 +187,7 @@ websrv_sendSetCookieHeader(struct mg_connection* conn,
     mg_printf(conn,
               "HTTP/1.1 %d OK\r\n"
               "Content-Type: %s\r\n"
-              "Date: %s\r"
+              "Date: %s\r\n"
               "Set-Cookie: sessionid=%s; http-only; path=/\r\n"
               "Cache-Control: no-cache\r\n"
               "Cache-Control: no-store\r\n"
@@ -424,6 +425,9 @@ websrv_getHeaderElement(std::map<std::string, std::string>& hdrmap,
 ///////////////////////////////////////////////////////////////////////////////
 // websrv_get_session
 //
+// The session is pinned so it is not expired while it is used. It must
+// be released with websrv_release_session.
+//
 
 struct websrv_session*
 websrv_get_session(struct mg_connection* conn)
@@ -454,25 +458,33 @@ websrv_get_session(struct mg_connection* conn)
     }
 
     // find existing session
-    pthread_mutex_lock(&gpobj->m_mutex_websrvSession);
-    std::list<struct websrv_session*>::iterator iter;
-    for (iter = gpobj->m_web_sessions.begin();
-         iter != gpobj->m_web_sessions.end();
-         ++iter) {
-        pSession = *iter;
-        if (0 == strcmp(value.c_str(), pSession->m_sid)) {
-            pSession->lastActiveTime = time(NULL);
-            break;
-        }
+    pSession =
+      (struct websrv_session*)gpobj->m_web_sessions.find(value.c_str());
+    if (NULL != pSession) {
+        pSession->lastActiveTime = time(NULL);
     }
-    pthread_mutex_unlock(&gpobj->m_mutex_websrvSession);
 
     return pSession;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// websrv_release_session
+//
+
+void
+websrv_release_session(struct websrv_session* pSession)
+{
+    if (NULL != pSession) {
+        gpobj->m_web_sessions.release(pSession->m_sid);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // websrv_add_session
 //
+// The new session is pinned in the same way as websrv_get_session
+// pins it.
+//
 
 websrv_session*
 websrv_add_session(struct mg_connection* conn)
@@ -561,10 +573,15 @@ websrv_add_session(struct mg_connection* conn)
     }
     pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
 
-    // Add to linked list
-    pthread_mutex_lock(&gpobj->m_mutex_websrvSession);
-    gpobj->m_web_sessions.push_back(pSession);
-    pthread_mutex_unlock(&gpobj->m_mutex_websrvSession);
+    // Add to session table
+    if (!gpobj->m_web_sessions.add(pSession->m_sid, pSession, true)) {
+        pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
+        gpobj->removeClient(pSession->m_pClientItem);
+        pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
+        delete pSession;
+        syslog(LOG_ERR, "WEB server: Failed to add session.");
+        return NULL;
+    }
 
     return pSession;
 }
@@ -572,6 +589,8 @@ websrv_add_session(struct mg_connection* conn)
 ///////////////////////////////////////////////////////////////////////////////
 // websrv_GetCreateSession
 //
+// The session is pinned, release it with websrv_release_session.
+//
 
 struct websrv_session*
 websrv_getCreateSession(struct mg_connection* conn)
@@ -600,25 +619,21 @@ websrv_getCreateSession(struct mg_connection* conn)
 //
 
 void
-websrv_expire_sessions(struct mg_connection* conn)
+websrv_expire_sessions(void)
 {
-    time_t now;
-
-    now = time(NULL);
-
-    pthread_mutex_lock(&gpobj->m_mutex_websrvSession);
-    std::list<struct websrv_session*>::iterator it;
-    for (it = gpobj->m_web_sessions.begin(); it != gpobj->m_web_sessions.end();
-         /* inline */) {
-        struct websrv_session* pSession = *it;
-        if ((now - pSession->lastActiveTime) > (60 * 60)) {
-            it = gpobj->m_web_sessions.erase(it);
-            delete pSession;
-        } else {
-            ++it;
-        }
+    std::deque<void*> expired;
+
+    if (0 == gpobj->m_web_sessions.expire(expired)) {
+        return;
+    }
+
+    pthread_mutex_lock(&gpobj->m_clientList.m_mutexItemList);
+    for (size_t i = 0; i < expired.size(); i++) {
+        struct websrv_session* pSession = (struct websrv_session*)expired[i];
+        gpobj->removeClient(pSession->m_pClientItem);
+        delete pSession;
     }
-    pthread_mutex_unlock(&gpobj->m_mutex_websrvSession);
+    pthread_mutex_unlock(&gpobj->m_clientList.m_mutexItemList);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -47,6 +47,13 @@ start_webserver(void);
 int
 stop_webserver(void);
 
+/*!
+ * Remove web sessions that has been idle for too long and the clients
+ * they own. Called once a second from the main loop.
+ */
+void
+websrv_expire_sessions(void);
+
 /*!
  * Send header
  */
@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench.h
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Helpers shared by the test and benchmark programs in the folders
+// below tests.
+//
+
+#if !defined(BENCH_H__INCLUDED_)
+#define BENCH_H__INCLUDED_
+
+#include <time.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// now_us
+//
+// Monotonic time in microseconds
+//
+
+static inline double
+now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+#endif // BENCH_H__INCLUDED_
@@ -0,0 +1,54 @@
+# Rules shared by the test and benchmark programs in the folders below
+# tests. A test Makefile sets PROGRAM to the program to build and
+# OBJECTS to the objects it is linked from, adds what it needs to
+# EXTRALIBS and then includes this file.
+#
+# Objects for the sources in src/vscp/common and src/common are built
+# from there so a test only lists the objects it uses. HELPER_OBJECTS
+# is vscphelper and what it needs, HELPER_LIBS the libraries it needs.
+
+TOP = ../..
+
+CC = gcc
+CXX = g++
+CFLAGS = -std=c99 -O2 -DCBC
+CXXFLAGS = -std=c++11 -O2
+CPPFLAGS = -I$(TOP) -I$(TOP)/src/vscp/common -I$(TOP)/src/common \
+	-I$(TOP)/src/common/third_party -I$(TOP)/src/common/third_party/nlohmann \
+	-I$(TOP)/tests/common
+DEPFLAGS = -MMD -MP
+LDFLAGS =
+EXTRALIBS += -lpthread
+
+HELPER_OBJECTS = vscphelper.o \
+	guid.o \
+	vscp_aes.o \
+	crc.o \
+	crc8.o \
+	fastpbkdf2.o \
+	vscpbase64.o \
+	vscpmd5.o
+
+HELPER_LIBS = -lexpat -lssl -lcrypto
+
+all:	$(PROGRAM)
+
+%.o: %.cpp
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) $(DEPFLAGS) -c $< -o $@
+
+%.o: $(TOP)/src/vscp/common/%.cpp
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) $(DEPFLAGS) -c $< -o $@
+
+%.o: $(TOP)/src/common/%.c
+	$(CC) $(CFLAGS) $(CPPFLAGS) $(DEPFLAGS) -c $< -o $@
+
+$(PROGRAM): $(OBJECTS)
+	$(CXX) -o $@ $(OBJECTS) $(LDFLAGS) $(EXTRALIBS)
+
+clean:
+	rm -f $(PROGRAM)
+	rm -f *.o *.d
+
+.PHONY: all clean
+
+-include $(OBJECTS:.o=.d)
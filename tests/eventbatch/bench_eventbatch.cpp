@@ -0,0 +1,485 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_eventbatch.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Checks and times CEventBatch, the batch of events a client sends in
+// one REST (sendevents) or websocket (EVENTS) request. Batches given as
+// a JSON array and as newline delimited JSON are checked, as are empty
+// batches, invalid events, the rights of the user, the rate limit of the
+// client and a batch larger than the room in the client output queue.
+// Then a large batch is parsed, checked and sent and the time of each
+// step is reported.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <bench.h>
+#include <clientlist.h>
+#include <controlobject.h>
+#include <eventbatch.h>
+#include <eventring.h>
+#include <userlist.h>
+#include <vscp.h>
+#include <vscp_class.h>
+#include <vscphelper.h>
+
+// The batch is tested without the daemon. These are only here for the
+// linker, the test batch below does not call the control object.
+CControlObject* gpobj = NULL;
+uint32_t m_gdebugArray[8];
+
+uint32_t
+CControlObject::admitEvents(CClientItem* pClientItem, uint32_t count)
+{
+    abort();
+}
+
+size_t
+CControlObject::sendEvents(CClientItem* pClientItem,
+                           std::vector<vscpEvent*>& events,
+                           std::vector<size_t>& failed)
+{
+    abort();
+}
+
+// Settings
+static int events = 100000;
+
+///////////////////////////////////////////////////////////////////////////////
+// CTestBatch
+//
+// A batch that takes the rate limit from the client only and puts the
+// events in its own output queue, in the same way as the control object
+// does.
+//
+
+class CTestBatch : public CEventBatch
+{
+  public:
+    CTestBatch(uint32_t capacity = 1024) { m_queue.init(capacity); }
+
+    ~CTestBatch() { drain(NULL); }
+
+    /// Take the events out of the queue, their class and type go to classtype
+    void drain(std::vector<uint32_t>* pclasstype)
+    {
+        vscpEvent* pEvent;
+        while (NULL != (pEvent = m_queue.pop())) {
+            if (NULL != pclasstype) {
+                pclasstype->push_back(((uint32_t)pEvent->vscp_class << 16) +
+                                      pEvent->vscp_type);
+            }
+            vscp_deleteEvent_v2(&pEvent);
+        }
+    }
+
+    /// The output queue
+    CEventRing m_queue;
+
+  protected:
+    size_t admit(CClientItem* pClientItem, size_t count)
+    {
+        return pClientItem->m_rateLimit.take(count);
+    }
+
+    size_t post(CClientItem* pClientItem,
+                std::vector<vscpEvent*>& events,
+                std::vector<size_t>& failed)
+    {
+        size_t n = m_queue.push(events.data(), events.size());
+        for (size_t i = n; i < events.size(); i++) {
+            failed.push_back(i);
+            vscp_deleteEvent_v2(&events[i]);
+        }
+        events.clear();
+        return n;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// check
+//
+
+static bool
+check(const char* pName, bool bOk, const std::string& got = "")
+{
+    if (!bOk) {
+        printf("FAILED: %s %s\n", pName, got.c_str());
+    }
+
+    return bOk;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_parse
+//
+// The same events as a JSON array and as newline delimited JSON
+//
+
+static bool
+check_parse(CClientItem* pClientItem)
+{
+    bool rv = true;
+
+    const char* pArray =
+      "[{\"class\":10,\"type\":6,\"data\":[1,2,3]},"
+      " {\"vscpclass\":20,\"vscptype\":3,\"head\":0,\"timestamp\":1234,"
+      "  \"datetime\":\"2020-01-02T03:04:05Z\"},"
+      " {\"class\":30,\"type\":1,\"guid\":\"FF:FF:FF:FF:FF:FF:FF:FE:"
+      "00:00:00:00:00:00:00:01\"}]";
+
+    const char* pNdjson =
+      "{\"class\":10,\"type\":6,\"data\":[1,2,3]}\n"
+      "\n"
+      "{\"vscpclass\":20,\"vscptype\":3,\"head\":0,\"timestamp\":1234,"
+      "\"datetime\":\"2020-01-02 03:04:05\"}\r\n"
+      "{\"class\":30,\"type\":1,\"guid\":\"FF:FF:FF:FF:FF:FF:FF:FE:"
+      "00:00:00:00:00:00:00:01\"}";
+
+    const char* pName[] = { "JSON array", "NDJSON" };
+    const char* pData[] = { pArray, pNdjson };
+
+    for (int i = 0; i < 2; i++) {
+
+        CTestBatch batch;
+        std::vector<uint32_t> classtype;
+
+        rv &= check(pName[i], batch.parse(pData[i], strlen(pData[i])));
+        rv &= check(pName[i], 3 == batch.getCount());
+        rv &= check(pName[i], 3 == batch.send(pClientItem));
+        rv &= check(pName[i], 0 == batch.getFailed());
+        rv &= check(pName[i], "[]" == batch.getFailedJSON());
+
+        batch.drain(&classtype);
+        rv &= check(pName[i],
+                    (3 == classtype.size()) &&
+                      ((10 << 16) + 6 == classtype[0]) &&
+                      ((20 << 16) + 3 == classtype[1]) &&
+                      ((30 << 16) + 1 == classtype[2]));
+    }
+
+    printf("JSON array and NDJSON batches: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_empty
+//
+
+static bool
+check_empty(CClientItem* pClientItem)
+{
+    bool rv = true;
+    CTestBatch batch;
+
+    rv &= check("empty body", !batch.parse("", 0));
+    rv &= check("blank body", !batch.parse(" \r\n\t", 4));
+    rv &= check("not events", !batch.parse("12", 2));
+    rv &= check("bad JSON", !batch.parse("[{\"class\":1", 11));
+
+    rv &= check("empty array", batch.parse("[]", 2));
+    rv &= check("empty array", 0 == batch.getCount());
+    rv &= check("empty array", 0 == batch.send(pClientItem));
+    rv &= check("empty array", "[]" == batch.getFailedJSON());
+
+    rv &= check("blank lines", batch.parse("{}\n\n", 4));
+    rv &= check("blank lines", 1 == batch.getCount());
+
+    printf("Empty batches: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_invalid
+//
+// Invalid events are failed with their index in the batch, the valid
+// events around them are sent.
+//
+
+static bool
+check_invalid(CClientItem* pClientItem)
+{
+    bool rv = true;
+    CTestBatch batch;
+
+    std::string strData;
+    for (int i = 0; i <= VSCP_MAX_DATA; i++) {
+        strData += i ? ",1" : "1";
+    }
+
+    std::string str =
+      "{\"class\":10,\"type\":6}\n"                               // 0
+      "{\"type\":6}\n"                                            // 1
+      "{\"class\":10}\n"                                          // 2
+      "{\"class\":10,\"type\":6,\"data\":\"1,2\"}\n"              // 3
+      "{\"class\":10,\"type\":6,\"data\":[1,256]}\n"              // 4
+      "{\"class\":10,\"type\":6,\"data\":[" + strData + "]}\n"    // 5
+      "{\"class\":\"ten\",\"type\":6}\n"                          // 6
+      "not json\n"                                                // 7
+      "[1,2]\n"                                                   // 8
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020-13-01T00:00:00\"}\n" // 9
+      "{\"class\":10,\"type\":6,\"datetime\":\"2021-02-29T00:00:00\"}\n" // 10
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020-01-01T24:00:00\"}\n" // 11
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020-01-01T00:60:00\"}\n" // 12
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020/01/01T00:00:00\"}\n" // 13
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020-00-10T00:00:00\"}\n" // 14
+      "{\"class\":10,\"type\":6,\"datetime\":\"2020-02-29T23:59:59\"}\n" // 15
+      "{\"class\":20,\"type\":3,\"data\":[]}\n";                  // 16
+
+    rv &= check("parse", batch.parse(str.c_str(), str.length()));
+    rv &= check("count", 17 == batch.getCount());
+    rv &= check("sent", 3 == batch.send(pClientItem));
+
+    std::string strExpected;
+    for (int i = 1; i <= 14; i++) {
+        strExpected += vscp_str_format(
+          "%s{\"code\":1,\"error\":\"Invalid event\",\"index\":%d}",
+          (1 == i) ? "" : ",",
+          i);
+    }
+    strExpected = "[" + strExpected + "]";
+
+    std::string strFailed = batch.getFailedJSON();
+    rv &= check("failed", strExpected == strFailed, strFailed);
+
+    printf("Invalid events: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_rights
+//
+// The user is checked for each class/type
+//
+
+static bool
+check_rights(CClientItem* pClientItem)
+{
+    bool rv = true;
+    std::string strFailed;
+
+    const char* pData = "{\"class\":10,\"type\":6}\n"   // 0 allowed type
+                        "{\"class\":10,\"type\":7}\n"   // 1 not in the list
+                        "{\"class\":20,\"type\":1}\n"   // 2 allowed class
+                        "{\"class\":20,\"type\":99}\n"  // 3 allowed class
+                        "{\"class\":0,\"type\":1}\n"    // 4 protocol
+                        "{\"class\":30,\"type\":1}\n"   // 5 not in the list
+                        "{\"class\":10,\"type\":6}\n";  // 6 allowed type
+
+    CUserItem user;
+    user.setUserName("batch");
+    user.setUserRights(VSCP_USER_RIGHT_ALLOW_SEND_EVENT);
+    user.setAllowedEventsFromString("10:6,20:*,0:*");
+
+    {
+        CTestBatch batch;
+        batch.parse(pData, strlen(pData));
+        batch.check(&user);
+        rv &= check("rights", 4 == batch.send(pClientItem));
+        strFailed = batch.getFailedJSON();
+        rv &= check(
+          "rights",
+          strFailed == "[{\"code\":2,\"error\":\"Not allowed to send "
+                       "event\",\"index\":1},"
+                       "{\"code\":2,\"error\":\"Not allowed to send "
+                       "event\",\"index\":4},"
+                       "{\"code\":2,\"error\":\"Not allowed to send "
+                       "event\",\"index\":5}]",
+          strFailed);
+    }
+
+    // Protocol events need their own right
+    user.setUserRights(VSCP_USER_RIGHT_ALLOW_SEND_EVENT |
+                       VSCP_USER_RIGHT_ALLOW_SEND_L1CTRL_EVENT);
+    {
+        CTestBatch batch;
+        batch.parse(pData, strlen(pData));
+        batch.check(&user);
+        rv &= check("L1 control right", 5 == batch.send(pClientItem));
+        rv &= check("L1 control right",
+                    EVENTBATCH_OK == batch.getStatus(4));
+    }
+
+    // No right to send at all
+    user.setUserRights(VSCP_USER_RIGHT_ALLOW_RCV_EVENT);
+    {
+        CTestBatch batch;
+        batch.parse(pData, strlen(pData));
+        batch.check(&user);
+        rv &= check("no send right", 0 == batch.send(pClientItem));
+        for (size_t i = 0; i < batch.getCount(); i++) {
+            rv &= check("no send right",
+                        EVENTBATCH_NOT_ALLOWED == batch.getStatus(i));
+        }
+    }
+
+    printf("User rights: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_limits
+//
+// A client with a burst of ten gets ten events through and the rest
+// are rate limited. A batch that is larger than the room in the output
+// queue gets the rest failed at once and the tokens given back.
+//
+
+static bool
+check_limits(void)
+{
+    bool rv = true;
+    std::string strFailed;
+    std::string str;
+
+    for (int i = 0; i < 14; i++) {
+        str += "{\"class\":10,\"type\":6,\"data\":[1]}\n";
+    }
+
+    // Rate limited
+    {
+        CClientItem client;
+        client.m_rateLimit.setRate(1, 10);
+
+        CTestBatch batch;
+        batch.parse(str.c_str(), str.length());
+        rv &= check("rate limit", 10 == batch.send(&client));
+        strFailed = batch.getFailedJSON();
+        rv &= check("rate limit",
+                    strFailed == "[{\"code\":3,\"error\":\"Rate "
+                                 "limited\",\"index\":10},"
+                                 "{\"code\":3,\"error\":\"Rate "
+                                 "limited\",\"index\":11},"
+                                 "{\"code\":3,\"error\":\"Rate "
+                                 "limited\",\"index\":12},"
+                                 "{\"code\":3,\"error\":\"Rate "
+                                 "limited\",\"index\":13}]",
+                    strFailed);
+    }
+
+    // No room in the queue
+    {
+        CClientItem client;
+        client.m_rateLimit.setRate(1, 100);
+
+        CTestBatch batch(8);
+        batch.parse(str.c_str(), str.length());
+        rv &= check("no room", 8 == batch.send(&client));
+        rv &= check("no room", 6 == batch.getFailed());
+        for (size_t i = 8; i < batch.getCount(); i++) {
+            rv &= check("no room", EVENTBATCH_NO_ROOM == batch.getStatus(i));
+        }
+
+        // Only the events that went in the queue used tokens
+        rv &= check("no room tokens", 92 == client.m_rateLimit.take(100));
+    }
+
+    printf("Rate limit and queue room: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+
+static void
+run(CClientItem* pClientItem)
+{
+    std::string str = "[";
+    for (int i = 0; i < events; i++) {
+        str += vscp_str_format(
+          "%s{\"class\":10,\"type\":6,\"datetime\":\"2020-01-02T03:04:05Z\","
+          "\"guid\":\"FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:01\","
+          "\"data\":[1,2,3,%d]}",
+          i ? "," : "",
+          i & 0xff);
+    }
+    str += "]";
+
+    CUserItem user;
+    user.setUserRights(VSCP_USER_DEFAULT_RIGHTS);
+
+    CTestBatch batch(events);
+
+    double start = now_us();
+    batch.parse(str.c_str(), str.length());
+    double parsed = now_us();
+    batch.check(&user);
+    double checked = now_us();
+    batch.send(pClientItem);
+    double sent = now_us();
+
+    printf("\n%8s %10s %10s %10s %12s\n",
+           "events",
+           "parse [ms]",
+           "check [ms]",
+           "send [ms]",
+           "events/s");
+    printf("%8zu %10.2f %10.2f %10.2f %12.0f\n",
+           batch.getSent(),
+           (parsed - start) / 1e3,
+           (checked - parsed) / 1e3,
+           (sent - checked) / 1e3,
+           batch.getSent() / ((sent - start) / 1e6));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_eventbatch [options]\n");
+    printf("  -n events  Number of events in the timed batch (%d)\n", events);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "n:"))) {
+        switch (opt) {
+            case 'n':
+                events = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if (events <= 0) {
+        usage();
+        return -1;
+    }
+
+    CClientItem client;
+
+    bool rv = check_parse(&client);
+    rv      = check_empty(&client) && rv;
+    rv      = check_invalid(&client) && rv;
+    rv      = check_rights(&client) && rv;
+    rv      = check_limits() && rv;
+
+    run(&client);
+
+    return rv ? 0 : -1;
+}
@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_eventrender.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Compare the cost of delivering events to text subscribers when every
+// subscriber renders the event itself (vscp_convertEventToString/JSON/XML)
+// with the renderings cached in the shared event (getString/JSON/XML).
+// Each event is pushed to the queue of every subscriber and the queues
+// are drained by a number of consumer threads.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include <bench.h>
+#include <clientqueue.h>
+#include <sharedevent.h>
+#include <vscp.h>
+#include <vscphelper.h>
+
+// Settings
+static int subscribers = 500;
+static int count       = 2000;
+static int threads     = 4;
+
+// Renderings made in a run
+static std::atomic<unsigned long> cntRendered;
+
+// Bytes rendered by the subscribers (so the work can't be optimised away)
+static std::atomic<unsigned long> cntBytes;
+
+// Subscriber queues
+static std::vector<CClientQueue*> queues;
+
+///////////////////////////////////////////////////////////////////////////////
+// Counting renderers
+//
+
+static bool
+render_string(std::string& str, const vscpEvent* pEvent)
+{
+    cntRendered++;
+    return vscp_convertEventToString(str, pEvent);
+}
+
+static bool
+render_json(std::string& str, const vscpEvent* pEvent)
+{
+    cntRendered++;
+    return vscp_convertEventToJSON(str, pEvent);
+}
+
+static bool
+render_xml(std::string& str, const vscpEvent* pEvent)
+{
+    cntRendered++;
+    return vscp_convertEventToXML(str, pEvent);
+}
+
+// One format per subscriber, a third of them each
+static const SHAREDEVENT_RENDER renderers[] = { render_string,
+                                                render_json,
+                                                render_xml };
+
+///////////////////////////////////////////////////////////////////////////////
+// consumer
+//
+// Drain the queues of the subscribers that belong to this thread. The
+// argument is the thread index, bit 8 set when renderings are cached.
+//
+
+static void*
+consumer(void* arg)
+{
+    int idx      = (int)((size_t)arg & 0xff);
+    bool bCached = (0 != ((size_t)arg & 0x100));
+
+    unsigned long bytes = 0;
+    std::string str;
+
+    for (int i = idx; i < subscribers; i += threads) {
+        int rendering = i % 3;
+        CSharedEvent* pSharedEvent;
+        while (NULL != (pSharedEvent = queues[i]->pop())) {
+            if (bCached) {
+                const std::string* pstr =
+                  pSharedEvent->getRendering(rendering, renderers[rendering]);
+                if (NULL != pstr) {
+                    bytes += pstr->length();
+                }
+            } else {
+                str.clear();
+                if (renderers[rendering](str, pSharedEvent->getEvent())) {
+                    bytes += str.length();
+                }
+            }
+            pSharedEvent->release();
+        }
+    }
+
+    cntBytes += bytes;
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+// Deliver count events to all subscribers and let the consumer threads
+// render them. Returns the time in microseconds.
+//
+
+static double
+run(bool bCached)
+{
+    cntRendered = 0;
+    cntBytes    = 0;
+
+    double start = now_us();
+
+    for (int n = 0; n < count; n++) {
+
+        vscpEvent* pEvent;
+        if (!vscp_newEvent(&pEvent)) {
+            return -1;
+        }
+
+        memset(pEvent, 0, sizeof(vscpEvent));
+        pEvent->vscp_class = VSCP_CLASS1_MEASUREMENT;
+        pEvent->vscp_type  = VSCP_TYPE_MEASUREMENT_TEMPERATURE;
+        pEvent->head       = VSCP_PRIORITY_NORMAL;
+        pEvent->timestamp  = n;
+        pEvent->year       = 2020;
+        pEvent->month      = 1;
+        pEvent->day        = 1;
+        pEvent->hour       = n / 3600 % 24;
+        pEvent->minute     = n / 60 % 60;
+        pEvent->second     = n % 60;
+        for (int i = 0; i < 16; i++) {
+            pEvent->GUID[i] = i;
+        }
+        vscp_newEventData(pEvent, 8);
+        for (int i = 0; i < 8; i++) {
+            pEvent->pdata[i] = (n + i) & 0xff;
+        }
+
+        CSharedEvent* pSharedEvent = new CSharedEvent(pEvent);
+        for (int i = 0; i < subscribers; i++) {
+            pSharedEvent->addRef();
+            if (!queues[i]->push(pSharedEvent, false)) {
+                pSharedEvent->release();
+            }
+        }
+        pSharedEvent->release();
+    }
+
+    std::vector<pthread_t> tids(threads);
+    for (int i = 0; i < threads; i++) {
+        size_t arg = i | (bCached ? 0x100 : 0);
+        pthread_create(&tids[i], NULL, consumer, (void*)arg);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    return now_us() - start;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_eventrender [options]\n");
+    printf("  -s subscribers  Number of text subscribers (%d)\n", subscribers);
+    printf("  -n count        Number of events (%d)\n", count);
+    printf("  -t threads      Number of consumer threads (%d)\n", threads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "s:n:t:"))) {
+        switch (opt) {
+            case 's':
+                subscribers = atoi(optarg);
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if ((subscribers <= 0) || (count <= 0) || (threads <= 0) ||
+        (threads > 255)) {
+        usage();
+        return -1;
+    }
+
+    for (int i = 0; i < subscribers; i++) {
+        queues.push_back(new CClientQueue);
+        if (!queues[i]->init(count)) {
+            fprintf(stderr, "Unable to allocate queue\n");
+            return -1;
+        }
+    }
+
+    printf("%d subscribers, %d events, %d consumer threads\n\n",
+           subscribers,
+           count,
+           threads);
+
+    printf("%-12s %10s %12s %12s %12s\n",
+           "renderings",
+           "time [ms]",
+           "events/s",
+           "rendered",
+           "bytes");
+
+    unsigned long bytes[2];
+    for (int i = 0; i < 2; i++) {
+        bool bCached   = (1 == i);
+        double elapsed = run(bCached);
+        if (elapsed < 0) {
+            fprintf(stderr, "Unable to allocate event\n");
+            return -1;
+        }
+
+        bytes[i] = cntBytes;
+        printf("%-12s %10.1f %12.0f %12lu %12lu\n",
+               bCached ? "cached" : "per client",
+               elapsed / 1e3,
+               count / (elapsed / 1e6),
+               cntRendered.load(),
+               bytes[i]);
+    }
+
+    if (bytes[0] != bytes[1]) {
+        printf("ERROR: subscribers got different renderings\n");
+        return -1;
+    }
+
+    for (int i = 0; i < subscribers; i++) {
+        delete queues[i];
+    }
+
+    return 0;
+}
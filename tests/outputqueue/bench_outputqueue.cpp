@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_outputqueue.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Measure the throughput of the client output queue when many threads
+// put events in it and one thread take them out. The mutex protected
+// list that used to be used is compared with the lock free event ring.
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <list>
+
+#include <bench.h>
+#include <eventring.h>
+#include <vscp.h>
+
+// Total number of events sent through the queue for each test
+#define BENCH_EVENTS 2000000
+
+// Queue capacity (MAX_ITEMS_CLIENT_OUTPUT_QUEUE)
+#define BENCH_CAPACITY 8192
+
+// Producer counts to test
+static const int producer_counts[] = { 8, 16, 32, 64 };
+
+// The event that is queued. Only the pointer is passed around.
+static vscpEvent dummy_event;
+
+// Producers wait for this before they start
+static std::atomic<bool> bStart;
+
+// Mutex protected list (the old output queue)
+static std::list<vscpEvent*> listQueue;
+static pthread_mutex_t mutexListQueue = PTHREAD_MUTEX_INITIALIZER;
+
+// Lock free ring
+static CEventRing* pRing;
+
+// Number of events each producer send
+static int nEventsPerProducer;
+
+///////////////////////////////////////////////////////////////////////////////
+// listProducer
+//
+
+static void*
+listProducer(void* userdata)
+{
+    while (!bStart.load()) {
+        sched_yield();
+    }
+
+    for (int i = 0; i < nEventsPerProducer; i++) {
+        for (;;) {
+            // Capacity check as done before
+            if (BENCH_CAPACITY > listQueue.size()) {
+                pthread_mutex_lock(&mutexListQueue);
+                listQueue.push_back(&dummy_event);
+                pthread_mutex_unlock(&mutexListQueue);
+                break;
+            }
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ringProducer
+//
+
+static void*
+ringProducer(void* userdata)
+{
+    while (!bStart.load()) {
+        sched_yield();
+    }
+
+    for (int i = 0; i < nEventsPerProducer; i++) {
+        while (!pRing->push(&dummy_event)) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+// Start producers and take out all events in this thread. Returns the
+// number of events per second.
+//
+
+static double
+run(void* (*producer)(void*), bool bRing, int nProducers)
+{
+    pthread_t threads[64];
+    long total = (long)nEventsPerProducer * nProducers;
+    long cnt   = 0;
+
+    bStart.store(false);
+    for (int i = 0; i < nProducers; i++) {
+        pthread_create(&threads[i], NULL, producer, NULL);
+    }
+
+    double start = now_us();
+    bStart.store(true);
+
+    while (cnt < total) {
+        if (bRing) {
+            while (NULL != pRing->pop()) {
+                cnt++;
+            }
+        }
+        else {
+            pthread_mutex_lock(&mutexListQueue);
+            if (listQueue.size()) {
+                listQueue.pop_front();
+                cnt++;
+            }
+            pthread_mutex_unlock(&mutexListQueue);
+        }
+    }
+
+    double elapsed = now_us() - start;
+
+    for (int i = 0; i < nProducers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return total / (elapsed / 1e6);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    memset(&dummy_event, 0, sizeof(dummy_event));
+
+    pRing = new CEventRing;
+    pRing->init(BENCH_CAPACITY);
+
+    printf("%10s %16s %16s %10s %10s\n",
+           "producers",
+           "list [ev/s]",
+           "ring [ev/s]",
+           "speedup",
+           "overruns");
+
+    for (size_t n = 0; n < sizeof(producer_counts) / sizeof(int); n++) {
+
+        int nProducers     = producer_counts[n];
+        nEventsPerProducer = BENCH_EVENTS / nProducers;
+
+        uint32_t overruns = pRing->getOverruns();
+
+        double rateList = run(listProducer, false, nProducers);
+        double rateRing = run(ringProducer, true, nProducers);
+
+        printf("%10d %16.0f %16.0f %9.1fx %10u\n",
+               nProducers,
+               rateList,
+               rateRing,
+               rateRing / rateList,
+               pRing->getOverruns() - overruns);
+    }
+
+    delete pRing;
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_restdecoder.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Checks and times the streaming decoder for REST parameters. A number
+// of small cases with the url decoding rules are checked first. Then a
+// large body with many events in one parameter, as a batch of events
+// is sent, is decoded in one piece and in pieces of different sizes.
+// All must give the same values. The time and the decode speed of each
+// run is reported.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <bench.h>
+#include <restdecoder.h>
+
+// Settings
+static int events = 10000;
+static int rounds = 10;
+
+// Parameters the decoder knows
+enum
+{
+    PARAM_OP = 0,
+    PARAM_FORMAT,
+    PARAM_VSCPEVENT,
+    PARAM_NOTE,
+    PARAMS
+};
+
+static const char* const names[PARAMS] = { "op", "format", "vscpevent", "note" };
+
+///////////////////////////////////////////////////////////////////////////////
+// decode
+//
+// Decode data in pieces of len bytes (zero for all at once)
+//
+
+static void
+decode(CRestDecoder& decoder, const std::string& data, size_t len)
+{
+    decoder.clear();
+
+    if (0 == len) {
+        len = data.length();
+    }
+
+    for (size_t pos = 0; pos < data.length(); pos += len) {
+        decoder.feed(data.c_str() + pos, std::min(len, data.length() - pos));
+    }
+
+    decoder.finish();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check
+//
+
+static bool
+check(const char* pData, int idx, const char* pExpected)
+{
+    bool rv = true;
+    CRestDecoder decoder(names, PARAMS);
+
+    // Every piece size up to the length of the data gives the same
+    for (size_t len = 1; len <= strlen(pData); len++) {
+        decode(decoder, pData, len);
+        if (decoder[idx] != pExpected) {
+            printf("FAILED: \"%s\" in pieces of %zu gave \"%s\" not \"%s\"\n",
+                   pData,
+                   len,
+                   decoder[idx].c_str(),
+                   pExpected);
+            rv = false;
+            break;
+        }
+    }
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_rules
+//
+
+static bool
+check_rules(void)
+{
+    bool rv = true;
+
+    rv &= check("op=open&format=json", PARAM_OP, "open");
+    rv &= check("op=open&format=json", PARAM_FORMAT, "json");
+    rv &= check("OP=open", PARAM_OP, "open");
+    rv &= check("xop=open&op=close", PARAM_OP, "close");
+    rv &= check("op=first&op=second", PARAM_OP, "first");
+    rv &= check("op&op=set", PARAM_OP, "set");
+    rv &= check("op=", PARAM_OP, "");
+    rv &= check("note=a+b%20c", PARAM_NOTE, "a b c");
+    rv &= check("note=%41%4a%4B", PARAM_NOTE, "AJK");
+    rv &= check("note=100%", PARAM_NOTE, "100%");
+    rv &= check("note=%4", PARAM_NOTE, "%4");
+    rv &= check("note=%zz%4&op=x", PARAM_NOTE, "%zz%4");
+    rv &= check("note=%2b%26%3d&op=x", PARAM_NOTE, "+&=");
+    rv &= check("averyveryveryverylongnamethatisnotknown=1&op=y", PARAM_OP, "y");
+
+    printf("Decoding rules: %s\n\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_restdecoder [options]\n");
+    printf("  -n events  Number of events in the body (%d)\n", events);
+    printf("  -r rounds  Number of times each run is done (%d)\n", rounds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "n:r:"))) {
+        switch (opt) {
+            case 'n':
+                events = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if ((events <= 0) || (rounds <= 0)) {
+        usage();
+        return -1;
+    }
+
+    bool rv = check_rules();
+
+    // A body with the events separated with ';' as it is url encoded
+    std::string strEvents;
+    std::string body = "op=sendevent&format=json&vscpevent=";
+    for (int i = 0; i < events; i++) {
+        char buf[128];
+        snprintf(buf,
+                 sizeof(buf),
+                 "0,20,3,%d,,0,FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:01,"
+                 "%d,2,3;",
+                 i,
+                 i & 0xff);
+        strEvents += buf;
+        for (const char* p = buf; *p; p++) {
+            if (',' == *p) {
+                body += "%2C";
+            } else if (':' == *p) {
+                body += "%3A";
+            } else if (';' == *p) {
+                body += "%3B";
+            } else {
+                body += *p;
+            }
+        }
+    }
+    body += "&note=end";
+
+    printf("%d events, %zu bytes body\n\n", events, body.length());
+    printf("%-10s %10s %10s %8s\n", "piece", "time [ms]", "MB/s", "result");
+
+    CRestDecoder decoder(names, PARAMS);
+    size_t pieces[] = { 0, 1, 100, 1460, 4096, 65536 };
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+
+        double start = now_us();
+        for (int j = 0; j < rounds; j++) {
+            decode(decoder, body, pieces[i]);
+        }
+        double elapsed = (now_us() - start) / rounds;
+
+        bool bOK = (decoder[PARAM_VSCPEVENT] == strEvents) &&
+                   (decoder[PARAM_OP] == "sendevent") &&
+                   (decoder[PARAM_FORMAT] == "json") &&
+                   (decoder[PARAM_NOTE] == "end");
+        rv &= bOK;
+
+        char piece[32];
+        if (pieces[i]) {
+            snprintf(piece, sizeof(piece), "%zu", pieces[i]);
+        } else {
+            snprintf(piece, sizeof(piece), "all");
+        }
+        printf("%-10s %10.2f %10.1f %8s\n",
+               piece,
+               elapsed / 1e3,
+               body.length() / elapsed,
+               bOK ? "OK" : "FAILED");
+    }
+
+    return rv ? 0 : -1;
+}
@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_routing.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Compare the time it takes to find the receivers of an event with a
+// linear scan of all clients (running the filter on every client) and
+// with the subscription index in the client list. Also checks that a
+// client is found on its GUID after the GUID has been changed.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <bench.h>
+#include <clientlist.h>
+#include <guid.h>
+#include <vscp.h>
+#include <vscphelper.h>
+
+// Number of events routed for each client count
+#define BENCH_EVENTS 20000
+
+// Number of different classes clients subscribe to
+#define BENCH_CLASSES 64
+
+// Every n:th client has an open filter
+#define BENCH_WILDCARD_EVERY 50
+
+// Client counts to test
+static const int client_counts[] = { 10, 100, 1000, 4000 };
+
+///////////////////////////////////////////////////////////////////////////////
+// setup_clients
+//
+// Most clients subscribe to one class/type pair, some to a whole class
+// and a few receive everything.
+//
+
+static void
+setup_clients(CClientList& list, int cnt)
+{
+    for (int i = 0; i < cnt; i++) {
+
+        CClientItem* pItem = new CClientItem;
+        vscp_clearVSCPFilter(&pItem->m_filter);
+
+        if (0 == (i % BENCH_WILDCARD_EVERY)) {
+            ; // Receive all
+        } else if (0 == (i % 10)) {
+            pItem->m_filter.filter_class = i % BENCH_CLASSES;
+            pItem->m_filter.mask_class   = 0xffff;
+        } else {
+            pItem->m_filter.filter_class = i % BENCH_CLASSES;
+            pItem->m_filter.mask_class   = 0xffff;
+            pItem->m_filter.filter_type  = i % 8;
+            pItem->m_filter.mask_type    = 0xffff;
+        }
+
+        list.addClient(pItem, i + 1);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_guid_routing
+//
+// Clients get the server GUID with their client id when added. A driver
+// then replaces the first twelve bytes with its interface GUID. Events
+// for the interface are routed on the new GUID so the index must follow.
+//
+
+static bool
+check_guid_routing(void)
+{
+    CClientList list;
+    cguid server;
+    cguid iface;
+    server.getFromString("FF:FF:FF:FF:FF:FF:FF:FE:00:00:00:00:00:00:00:00");
+    iface.getFromString("00:01:02:03:04:05:06:07:08:09:0A:0B:00:00:00:00");
+
+    for (int i = 0; i < 4; i++) {
+
+        CClientItem* pItem = new CClientItem;
+        list.addClient(pItem, i + 1);
+
+        // As CControlObject::addClient
+        cguid guid = server;
+        guid.setClientID(pItem->m_clientID);
+        list.setClientGUID(pItem, guid);
+    }
+
+    // As the device thread for a driver
+    CClientItem* pDriver = list.getClientFromId(3);
+    cguid old            = pDriver->m_guid;
+    cguid guid           = pDriver->m_guid;
+    memcpy(guid.m_id, iface.getGUID(), 12);
+    list.setClientGUID(pDriver, guid);
+
+    if (list.getClientFromGUID(guid) != pDriver) {
+        printf("ERROR: driver not found on its new GUID\n");
+        return false;
+    }
+
+    if (NULL != list.getClientFromGUID(old)) {
+        printf("ERROR: driver still found on its old GUID\n");
+        return false;
+    }
+
+    // The other clients are still found on theirs
+    for (uint16_t id = 1; id <= 4; id++) {
+        CClientItem* pItem = list.getClientFromId(id);
+        if (list.getClientFromGUID(pItem->m_guid) != pItem) {
+            printf("ERROR: client %d not found on its GUID\n", id);
+            return false;
+        }
+    }
+
+    printf("GUID routing after GUID change OK\n\n");
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    uint8_t data[8];
+    memset(data, 0, sizeof(data));
+
+    std::vector<vscpEvent> events(BENCH_EVENTS);
+    srand(1);
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        memset(&events[i], 0, sizeof(vscpEvent));
+        events[i].vscp_class = rand() % BENCH_CLASSES;
+        events[i].vscp_type  = rand() % 8;
+        events[i].sizeData   = 3;
+        events[i].pdata      = data;
+    }
+
+    if (!check_guid_routing()) {
+        return -1;
+    }
+
+    printf("%8s %14s %14s %10s %10s\n",
+           "clients",
+           "scan [us/ev]",
+           "index [us/ev]",
+           "speedup",
+           "matches");
+
+    for (size_t n = 0; n < sizeof(client_counts) / sizeof(int); n++) {
+
+        CClientList list;
+        setup_clients(list, client_counts[n]);
+
+        // Linear scan (as sendEventAllClients did before the index)
+        unsigned long cntScan = 0;
+        double start          = now_us();
+        for (int i = 0; i < BENCH_EVENTS; i++) {
+            std::deque<CClientItem*>::iterator it;
+            for (it = list.m_itemList.begin(); it != list.m_itemList.end();
+                 ++it) {
+                if (vscp_doLevel2Filter(&events[i], &(*it)->m_filter)) {
+                    cntScan++;
+                }
+            }
+        }
+        double timeScan = (now_us() - start) / BENCH_EVENTS;
+
+        // Subscription index
+        unsigned long cntIndex = 0;
+        std::vector<CClientItem*> candidates;
+        start = now_us();
+        for (int i = 0; i < BENCH_EVENTS; i++) {
+            candidates.clear();
+            list.getSubscribers(candidates, &events[i]);
+            std::vector<CClientItem*>::iterator it;
+            for (it = candidates.begin(); it != candidates.end(); ++it) {
+                if (vscp_doLevel2Filter(&events[i], &(*it)->m_filter)) {
+                    cntIndex++;
+                }
+            }
+        }
+        double timeIndex = (now_us() - start) / BENCH_EVENTS;
+
+        if (cntScan != cntIndex) {
+            printf("ERROR: scan found %lu receivers, index found %lu\n",
+                   cntScan,
+                   cntIndex);
+            return -1;
+        }
+
+        printf("%8d %14.3f %14.3f %9.1fx %10lu\n",
+               client_counts[n],
+               timeScan,
+               timeIndex,
+               timeScan / timeIndex,
+               cntIndex);
+    }
+
+    return 0;
+}
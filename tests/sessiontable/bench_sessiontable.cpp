@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_sessiontable.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Session lookup benchmark for the web server and REST interface. Looks
+// up random sessions the old way (walking a list comparing session ids
+// under one lock) and in CSessionTable, with one and with several
+// threads, and times a full expiry of the table. Last it checks that
+// idle sessions expire and that used sessions are kept.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <bench.h>
+#include <sessiontable.h>
+
+// Settings
+static int sessions = 5000;
+static int lookups  = 200000;
+static int threads  = 4;
+
+// A session as the REST interface has it
+struct session
+{
+    char m_sid[33];
+    time_t m_lastActiveTime;
+};
+
+// The old way
+static pthread_mutex_t mutexList = PTHREAD_MUTEX_INITIALIZER;
+static std::list<session*> listSessions;
+
+// The new way
+static CSessionTable* ptable;
+
+static std::vector<session*> all;
+
+///////////////////////////////////////////////////////////////////////////////
+// list_find
+//
+
+static session*
+list_find(const char* sid)
+{
+    session* pSession = NULL;
+
+    pthread_mutex_lock(&mutexList);
+    std::list<session*>::iterator it;
+    for (it = listSessions.begin(); it != listSessions.end(); ++it) {
+        if (0 == strcmp(sid, (*it)->m_sid)) {
+            pSession                   = *it;
+            pSession->m_lastActiveTime = time(NULL);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutexList);
+
+    return pSession;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// worker
+//
+// Look up random sessions. Returns the number of misses.
+//
+
+struct work
+{
+    bool bTable;
+    unsigned int seed;
+    int count;
+    int misses;
+};
+
+static void*
+worker(void* p)
+{
+    work* pwork = (work*)p;
+
+    for (int i = 0; i < pwork->count; i++) {
+        session* pSession = all[rand_r(&pwork->seed) % all.size()];
+        void* pFound      = pwork->bTable ? ptable->find(pSession->m_sid)
+                                          : list_find(pSession->m_sid);
+        if (pFound != pSession) {
+            pwork->misses++;
+        }
+        if (pwork->bTable && (NULL != pFound)) {
+            ptable->release(pSession->m_sid);
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+
+static void
+run(bool bTable, int nthreads)
+{
+    std::vector<pthread_t> tid(nthreads);
+    std::vector<work> works(nthreads);
+
+    double start = now_us();
+    for (int i = 0; i < nthreads; i++) {
+        works[i].bTable = bTable;
+        works[i].seed   = i + 1;
+        works[i].count  = lookups / nthreads;
+        works[i].misses = 0;
+        pthread_create(&tid[i], NULL, worker, &works[i]);
+    }
+
+    int misses = 0;
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(tid[i], NULL);
+        misses += works[i].misses;
+    }
+    double elapsed = now_us() - start;
+
+    printf("%-6s %8d %8d %12.2f %14.0f %7d\n",
+           bTable ? "table" : "list",
+           sessions,
+           nthreads,
+           elapsed / lookups,
+           lookups / (elapsed / 1e6),
+           misses);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_expire
+//
+// With a two second timeout half of the sessions are used every half
+// second and the other half left idle. After four seconds only the used
+// sessions should be left.
+//
+
+static bool
+check_expire(void)
+{
+    CSessionTable table(2);
+    for (size_t i = 0; i < all.size(); i++) {
+        table.add(all[i]->m_sid, all[i]);
+    }
+
+    std::deque<void*> expired;
+    for (int i = 0; i < 8; i++) {
+        for (size_t j = 0; j < all.size(); j += 2) {
+            table.touch(all[j]->m_sid);
+        }
+        table.expire(expired);
+        usleep(500000);
+    }
+
+    // Let the last touched sessions get close to their expiry
+    usleep(500000);
+    double start = now_us();
+    table.expire(expired);
+    printf("\nLast expire took %.1f us\n", now_us() - start);
+
+    size_t idle = all.size() / 2;
+    bool rv     = (expired.size() == idle) && (table.size() == all.size() - idle);
+    for (size_t i = 0; i < expired.size(); i++) {
+        session* pSession = (session*)expired[i];
+        if (0 == ((pSession - all[0]) & 1)) {
+            // A used session (even index) has expired
+            rv = false;
+        }
+    }
+
+    printf("Expired %zu of %zu idle sessions, %zu left: %s\n",
+           expired.size(),
+           idle,
+           table.size(),
+           rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_pin
+//
+// With a one second timeout a session that is found and not released
+// must outlive an idle one. Once released it expires as any other.
+//
+
+static bool
+check_pin(void)
+{
+    CSessionTable table(1);
+    table.add(all[0]->m_sid, all[0]);
+    table.add(all[1]->m_sid, all[1]);
+    table.find(all[0]->m_sid);
+
+    std::deque<void*> expired;
+    for (int i = 0; i < 6; i++) {
+        table.expire(expired);
+        usleep(500000);
+    }
+    bool rv = (1 == expired.size()) && (all[1] == expired[0]) &&
+              (1 == table.size());
+
+    table.release(all[0]->m_sid);
+    for (int i = 0; i < 6; i++) {
+        table.expire(expired);
+        usleep(500000);
+    }
+    rv = rv && (2 == expired.size()) && (0 == table.size());
+
+    printf("Pinned session kept until released: %s\n", rv ? "OK" : "FAILED");
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_sessiontable [options]\n");
+    printf("  -s sessions  Number of sessions (%d)\n", sessions);
+    printf("  -n lookups   Number of lookups in each run (%d)\n", lookups);
+    printf("  -t threads   Number of threads in the threaded runs (%d)\n",
+           threads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "s:n:t:"))) {
+        switch (opt) {
+            case 's':
+                sessions = atoi(optarg);
+                break;
+            case 'n':
+                lookups = atoi(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if ((sessions <= 0) || (lookups <= 0) || (threads <= 0)) {
+        usage();
+        return -1;
+    }
+
+    ptable = new CSessionTable;
+
+    session* psessions = new session[sessions];
+    for (int i = 0; i < sessions; i++) {
+        session* pSession = &psessions[i];
+        snprintf(pSession->m_sid,
+                 sizeof(pSession->m_sid),
+                 "%08x%08x%08x%08x",
+                 rand(),
+                 rand(),
+                 rand(),
+                 i);
+        pSession->m_lastActiveTime = time(NULL);
+        all.push_back(pSession);
+        listSessions.push_back(pSession);
+        ptable->add(pSession->m_sid, pSession);
+    }
+
+    printf("%-6s %8s %8s %12s %14s %7s\n",
+           "how",
+           "sessions",
+           "threads",
+           "us/lookup",
+           "lookups/s",
+           "misses");
+
+    run(false, 1);
+    run(true, 1);
+    run(false, threads);
+    run(true, threads);
+
+    bool rv = check_expire();
+    rv      = check_pin() && rv;
+
+    delete ptable;
+    delete[] psessions;
+
+    return rv ? 0 : -1;
+}
@@ -0,0 +1,253 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_tcpip_pipeline.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Pipelined command benchmark for the tcp/ip interface of the VSCP daemon.
+// Runs the same commands one at a time (doCommand/doCmdSend), pipelined
+// (pipelineCommand/pipelineSend + pipelineExecute) and for events also as
+// blocks (doCmdSendBlockEx) over VscpRemoteTcpIf in text and binary mode,
+// and reports time, commands per second and the number of round trips
+// each run cost.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <bench.h>
+#include <vscpremotetcpif.h>
+
+// Settings
+static const char* host     = "127.0.0.1";
+static const char* port     = "9598";
+static const char* user     = "admin";
+static const char* password = "secret";
+static int count            = 1000;
+
+// Round trip time of one command in microseconds
+static double rtt = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// print_result
+//
+// The measured round trips are the elapsed time in round trip times.
+//
+
+static void
+print_result(const char* mode,
+             const char* what,
+             const char* how,
+             double elapsed,
+             int ideal,
+             int errors)
+{
+    printf("%-7s %-5s %-10s %10.1f %12.0f %10d %10.1f %7d\n",
+           mode,
+           what,
+           how,
+           elapsed / 1e3,
+           count / (elapsed / 1e6),
+           ideal,
+           elapsed / rtt,
+           errors);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+// Send count commands (noop) or events (send) one at a time and then
+// pipelined. Events are also sent in blocks.
+//
+
+static bool
+run(VscpRemoteTcpIf& tcpif, const char* mode, bool bSend)
+{
+    const char* what = bSend ? "send" : "noop";
+
+    vscpEventEx ex;
+    memset(&ex, 0, sizeof(ex));
+    ex.vscp_class = VSCP_CLASS1_INFORMATION;
+    ex.vscp_type  = VSCP_TYPE_INFORMATION_ON;
+    ex.sizeData   = 3;
+
+    // * * * One at a time * * *
+
+    int errors   = 0;
+    double start = now_us();
+    for (int i = 0; i < count; i++) {
+        ex.data[2] = i & 0xff;
+        int rv     = bSend ? tcpif.doCmdSendEx(&ex) : tcpif.doCmdNOOP();
+        if (VSCP_ERROR_SUCCESS != rv) {
+            errors++;
+        }
+    }
+    print_result(mode, what, "sequential", now_us() - start, count, errors);
+
+    // * * * Pipelined * * *
+
+    std::deque<int> results;
+    errors = 0;
+    start  = now_us();
+    for (int i = 0; i < count; i++) {
+        ex.data[2] = i & 0xff;
+        if (bSend) {
+            tcpif.pipelineSendEx(&ex);
+        } else {
+            tcpif.pipelineCommand("NOOP\r\n");
+        }
+    }
+
+    int rv = tcpif.pipelineExecute(results);
+    if ((VSCP_ERROR_SUCCESS != rv) && (VSCP_ERROR_ERROR != rv)) {
+        fprintf(stderr, "Pipelined %s failed (%d).\n", what, rv);
+        return false;
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (VSCP_ERROR_SUCCESS != results[i]) {
+            errors++;
+        }
+    }
+    errors += count - (int)results.size();
+
+    // Each window is written in one go and refilled when half answered
+    int ideal = 1;
+    if (count > TCPIP_PIPELINE_WINDOW) {
+        ideal += (count - TCPIP_PIPELINE_WINDOW + TCPIP_PIPELINE_WINDOW / 2 -
+                  1) /
+                 (TCPIP_PIPELINE_WINDOW / 2);
+    }
+    print_result(mode, what, "pipelined", now_us() - start, ideal, errors);
+
+    if (!bSend) {
+        return true;
+    }
+
+    // * * * Blocks * * *
+
+    std::vector<vscpEventEx> events(count, ex);
+    for (int i = 0; i < count; i++) {
+        events[i].data[2] = i & 0xff;
+    }
+
+    std::deque<size_t> failed;
+    start = now_us();
+    rv    = tcpif.doCmdSendBlockEx(events.data(), count, &failed);
+    if ((VSCP_ERROR_SUCCESS != rv) && failed.empty()) {
+        fprintf(stderr, "Block %s failed (%d).\n", what, rv);
+        return false;
+    }
+
+    // One write and one reply for each block
+    ideal = (count + TCPIP_BLOCK_MAX_EVENTS - 1) / TCPIP_BLOCK_MAX_EVENTS;
+    print_result(
+      mode, what, "block", now_us() - start, ideal, (int)failed.size());
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_tcpip_pipeline [options]\n");
+    printf("  -h host      Daemon host (%s)\n", host);
+    printf("  -p port      Daemon port (%s)\n", port);
+    printf("  -u user      User (%s)\n", user);
+    printf("  -P password  Password (%s)\n", password);
+    printf("  -n count     Number of commands in each run (%d)\n", count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "h:p:u:P:n:"))) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = optarg;
+                break;
+            case 'u':
+                user = optarg;
+                break;
+            case 'P':
+                password = optarg;
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if (count <= 0) {
+        usage();
+        return -1;
+    }
+
+    VscpRemoteTcpIf tcpif;
+    std::string strHost = std::string(host) + ":" + port;
+    if (VSCP_ERROR_SUCCESS != tcpif.doCmdOpen(strHost, user, password)) {
+        fprintf(stderr, "Unable to connect to %s\n", strHost.c_str());
+        return -1;
+    }
+
+    // Round trip time is the median of a number of noop's
+    std::deque<double> times;
+    for (int i = 0; i < 101; i++) {
+        double start = now_us();
+        tcpif.doCmdNOOP();
+        times.push_back(now_us() - start);
+    }
+    std::sort(times.begin(), times.end());
+    rtt = times[times.size() / 2];
+    printf("Round trip time %.1f us, %d commands in each run\n\n", rtt, count);
+
+    printf("%-7s %-5s %-10s %10s %12s %10s %10s %7s\n",
+           "mode",
+           "cmd",
+           "run",
+           "time [ms]",
+           "cmds/s",
+           "writes",
+           "rtts",
+           "errors");
+
+    if (!run(tcpif, "text", false) || !run(tcpif, "text", true)) {
+        return -1;
+    }
+
+    if (VSCP_ERROR_SUCCESS != tcpif.doCmdEnterBinaryMode()) {
+        fprintf(stderr, "Unable to enter binary mode\n");
+        return -1;
+    }
+
+    if (!run(tcpif, "binary", false) || !run(tcpif, "binary", true)) {
+        return -1;
+    }
+
+    tcpif.doCmdQuitBinaryMode();
+    tcpif.doCmdClose();
+
+    return 0;
+}
@@ -0,0 +1,481 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_tcpip_scaling.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Connection scaling benchmark for the tcp/ip interface of the VSCP daemon.
+// Opens a large number of idle connections and then a number of logged in
+// connections that send commands as fast as the server answers. Reports
+// connect times, command round trip times and throughput together with
+// the number of threads and memory used by the daemon.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <bench.h>
+
+// Connections are opened this many at a time
+#define BENCH_CONNECT_CHUNK 100
+
+// Max time in milliseconds to wait for a response
+#define BENCH_RESPONSE_TIMEOUT 10000
+
+// Idle connection counts to report at
+static const int idle_steps[] = { 100, 1000, 5000, 10000 };
+
+// One connection to the daemon
+struct connection
+{
+    int sock;
+    std::string buf; // Data not yet part of a complete response
+    double sent;     // Time last command was sent
+    bool bWaiting;   // Waiting for a response
+};
+
+// Settings
+static const char* host     = "127.0.0.1";
+static const char* port     = "9598";
+static const char* user     = "admin";
+static const char* password = "secret";
+static const char* command  = "noop";
+static int nIdle            = 10000;
+static int nActive          = 1000;
+static int duration         = 10;
+static int pid              = 0;
+
+static struct addrinfo* addr = NULL;
+static int fdEpoll           = -1;
+
+///////////////////////////////////////////////////////////////////////////////
+// print_daemon_usage
+//
+// Number of threads and resident memory of the daemon
+//
+
+static void
+print_daemon_usage(void)
+{
+    char path[64];
+    char line[256];
+    int threads = 0;
+    int rss     = 0;
+
+    if (!pid) {
+        printf("\n");
+        return;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* fp = fopen(path, "r");
+    if (NULL == fp) {
+        printf("\n");
+        return;
+    }
+
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        sscanf(line, "Threads: %d", &threads);
+        sscanf(line, "VmRSS: %d", &rss);
+    }
+    fclose(fp);
+
+    printf(" %8d %10d\n", threads, rss);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// open_connection
+//
+
+static bool
+open_connection(connection& conn)
+{
+    conn.sock = socket(addr->ai_family, SOCK_STREAM, 0);
+    if (-1 == conn.sock) {
+        perror("socket");
+        return false;
+    }
+
+    if (-1 == connect(conn.sock, addr->ai_addr, addr->ai_addrlen)) {
+        perror("connect");
+        close(conn.sock);
+        conn.sock = -1;
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(conn.sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(conn.sock, F_SETFL, fcntl(conn.sock, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &conn;
+    epoll_ctl(fdEpoll, EPOLL_CTL_ADD, conn.sock, &ev);
+
+    conn.sent     = now_us();
+    conn.bWaiting = true; // The welcome message
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// send_command
+//
+
+static bool
+send_command(connection& conn, const std::string& cmd)
+{
+    std::string str = cmd + "\r\n";
+
+    conn.sent     = now_us();
+    conn.bWaiting = true;
+
+    // Short commands on an idle connection always fit in the socket buffer
+    if ((ssize_t)str.length() != write(conn.sock, str.c_str(), str.length())) {
+        perror("write");
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// read_response
+//
+// A response is complete when a line starting with +OK or -OK is received.
+// Returns true when a response has been completed.
+//
+
+static bool
+read_response(connection& conn)
+{
+    char buf[4096];
+    ssize_t n;
+
+    while ((n = read(conn.sock, buf, sizeof(buf))) > 0) {
+        conn.buf.append(buf, n);
+    }
+
+    if (0 == n) {
+        fprintf(stderr, "Connection closed by server.\n");
+        exit(-1);
+    }
+
+    size_t pos;
+    bool bDone = false;
+    while (std::string::npos != (pos = conn.buf.find('\n'))) {
+        if ((0 == conn.buf.compare(0, 3, "+OK")) ||
+            (0 == conn.buf.compare(0, 3, "-OK"))) {
+            bDone = true;
+        }
+        conn.buf.erase(0, pos + 1);
+    }
+
+    if (bDone) {
+        conn.bWaiting = false;
+    }
+
+    return bDone;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wait_all
+//
+// Wait until no connection waits for a response
+//
+
+static bool
+wait_all(std::vector<connection>& conns, size_t first, size_t last)
+{
+    struct epoll_event events[256];
+    size_t nWaiting = last - first;
+
+    while (nWaiting) {
+        int n = epoll_wait(fdEpoll, events, 256, BENCH_RESPONSE_TIMEOUT);
+        if (n <= 0) {
+            fprintf(stderr, "Timeout waiting for %zu response(s).\n", nWaiting);
+            return false;
+        }
+
+        for (int i = 0; i < n; i++) {
+            connection* pconn = (connection*)events[i].data.ptr;
+            if (pconn->bWaiting && read_response(*pconn)) {
+                nWaiting--;
+            }
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// open_connections
+//
+// Open connections [first, last) and wait for the welcome messages
+//
+
+static bool
+open_connections(std::vector<connection>& conns, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i += BENCH_CONNECT_CHUNK) {
+        size_t end = std::min(last, i + BENCH_CONNECT_CHUNK);
+        for (size_t j = i; j < end; j++) {
+            if (!open_connection(conns[j])) {
+                return false;
+            }
+        }
+        if (!wait_all(conns, i, end)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// login
+//
+
+static bool
+login(std::vector<connection>& conns, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++) {
+        send_command(conns[i], std::string("user ") + user);
+    }
+    if (!wait_all(conns, first, last)) {
+        return false;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        send_command(conns[i], std::string("pass ") + password);
+    }
+    return wait_all(conns, first, last);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run_active
+//
+// Every active connection has one command outstanding at all times
+//
+
+static void
+run_active(std::vector<connection>& conns, size_t first, size_t last)
+{
+    struct epoll_event events[256];
+    std::vector<double> rtt;
+    rtt.reserve(1000000);
+
+    for (size_t i = first; i < last; i++) {
+        send_command(conns[i], command);
+    }
+
+    double start = now_us();
+    double end   = start + duration * 1e6;
+    while (now_us() < end) {
+        int n = epoll_wait(fdEpoll, events, 256, BENCH_RESPONSE_TIMEOUT);
+        if (n <= 0) {
+            fprintf(stderr, "Timeout waiting for responses.\n");
+            exit(-1);
+        }
+
+        for (int i = 0; i < n; i++) {
+            connection* pconn = (connection*)events[i].data.ptr;
+            if (pconn->bWaiting && read_response(*pconn)) {
+                rtt.push_back(now_us() - pconn->sent);
+                send_command(*pconn, command);
+            }
+        }
+    }
+    double elapsed = (now_us() - start) / 1e6;
+
+    // Let the outstanding commands finish
+    wait_all(conns, first, last);
+
+    if (!rtt.size()) {
+        printf("No responses.\n");
+        return;
+    }
+
+    std::sort(rtt.begin(), rtt.end());
+    printf("\n%8s %12s %10s %10s %10s %10s %8s %10s\n",
+           "active",
+           "cmd/s",
+           "p50 [us]",
+           "p90 [us]",
+           "p99 [us]",
+           "max [us]",
+           "threads",
+           "rss [kB]");
+    printf("%8zu %12.0f %10.0f %10.0f %10.0f %10.0f",
+           last - first,
+           rtt.size() / elapsed,
+           rtt[rtt.size() / 2],
+           rtt[rtt.size() * 9 / 10],
+           rtt[rtt.size() * 99 / 100],
+           rtt[rtt.size() - 1]);
+    print_daemon_usage();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_tcpip_scaling [options]\n");
+    printf("  -h host      Daemon host (%s)\n", host);
+    printf("  -p port      Daemon port (%s)\n", port);
+    printf("  -u user      User for active connections (%s)\n", user);
+    printf("  -P password  Password for active connections (%s)\n", password);
+    printf("  -i n         Number of idle connections (%d)\n", nIdle);
+    printf("  -a n         Number of active connections (%d)\n", nActive);
+    printf("  -c command   Command sent on active connections (%s)\n", command);
+    printf("  -d seconds   Time to run the active connections (%d)\n", duration);
+    printf("  -n pid       Pid of the daemon to report threads/memory for\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "h:p:u:P:i:a:c:d:n:"))) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = optarg;
+                break;
+            case 'u':
+                user = optarg;
+                break;
+            case 'P':
+                password = optarg;
+                break;
+            case 'i':
+                nIdle = atoi(optarg);
+                break;
+            case 'a':
+                nActive = atoi(optarg);
+                break;
+            case 'c':
+                command = optarg;
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'n':
+                pid = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    // We need a descriptor for each connection
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < (rlim_t)(nIdle + nActive + 16)) {
+        fprintf(stderr,
+                "Warning: Open file limit %lu is too low for %d connections.\n",
+                (unsigned long)rl.rlim_cur,
+                nIdle + nActive);
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (0 != getaddrinfo(host, port, &hints, &addr)) {
+        fprintf(stderr, "Unable to resolve %s:%s\n", host, port);
+        return -1;
+    }
+
+    fdEpoll = epoll_create1(0);
+
+    // Must not move when connections are added as epoll has pointers
+    std::vector<connection> conns(nIdle + nActive);
+    for (size_t i = 0; i < conns.size(); i++) {
+        conns[i].sock     = -1;
+        conns[i].bWaiting = false;
+    }
+
+    // * * * Idle connections * * *
+
+    printf("%8s %14s %14s %8s %10s\n",
+           "idle",
+           "connect [s]",
+           "per conn [us]",
+           "threads",
+           "rss [kB]");
+
+    int opened = 0;
+    for (size_t n = 0; n <= sizeof(idle_steps) / sizeof(int); n++) {
+
+        int target = (n < sizeof(idle_steps) / sizeof(int)) ? idle_steps[n]
+                                                             : nIdle;
+        if (target > nIdle) {
+            target = nIdle;
+        }
+        if (target <= opened) {
+            continue;
+        }
+
+        double start = now_us();
+        if (!open_connections(conns, opened, target)) {
+            return -1;
+        }
+        double elapsed = now_us() - start;
+
+        printf("%8d %14.3f %14.1f",
+               target,
+               elapsed / 1e6,
+               elapsed / (target - opened));
+        print_daemon_usage();
+        opened = target;
+    }
+
+    // * * * Active connections * * *
+
+    if (nActive) {
+        if (!open_connections(conns, nIdle, nIdle + nActive) ||
+            !login(conns, nIdle, nIdle + nActive)) {
+            return -1;
+        }
+        run_active(conns, nIdle, nIdle + nActive);
+    }
+
+    for (size_t i = 0; i < conns.size(); i++) {
+        if (conns[i].sock >= 0) {
+            close(conns[i].sock);
+        }
+    }
+
+    close(fdEpoll);
+    freeaddrinfo(addr);
+
+    return 0;
+}
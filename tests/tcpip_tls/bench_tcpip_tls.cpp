@@ -0,0 +1,285 @@
+///////////////////////////////////////////////////////////////////////////////
+// bench_tcpip_tls.cpp
+//
+// https://www.vscp.org   Grodans Paradis AB   info@grodansparadis.com
+//
+// Reconnect storm benchmark for the SSL port of the tcp/ip interface of the
+// VSCP daemon. A number of threads connect, wait for the welcome message
+// and disconnect over and over, first with a full handshake each time and
+// then resuming the session of the previous connection. Reports the time
+// for the whole storm, connections per second, the time from connect to
+// welcome message and how many sessions were resumed.
+//
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <bench.h>
+
+// Settings
+static const char* host = "127.0.0.1";
+static const char* port = "9599";
+static int count        = 1000;
+static int nThreads     = 50;
+
+static struct addrinfo* addr = NULL;
+static SSL_CTX* ctx          = NULL;
+
+// One thread of the storm
+struct storm
+{
+    pthread_t thread;
+    int count;                  // Connections to make
+    bool bResume;               // Resume the previous session
+    std::vector<double> times;  // Connect to welcome in microseconds
+    int reused;                 // Resumed sessions
+    int errors;                 // Failed connections
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// reconnect
+//
+// Connect, do the handshake and wait for the welcome message. The session
+// is taken after the welcome message as TLS 1.3 servers send it after the
+// handshake.
+//
+
+static bool
+reconnect(SSL_SESSION** ppSession, bool* pbReused)
+{
+    int sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (-1 == sock) {
+        return false;
+    }
+
+    if (-1 == connect(sock, addr->ai_addr, addr->ai_addrlen)) {
+        close(sock);
+        return false;
+    }
+
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, sock);
+    if (NULL != *ppSession) {
+        SSL_set_session(ssl, *ppSession);
+    }
+
+    bool rv = false;
+    if (1 == SSL_connect(ssl)) {
+
+        std::string buf;
+        char tmp[512];
+        int n;
+        while ((std::string::npos == buf.find("+OK")) &&
+               ((n = SSL_read(ssl, tmp, sizeof(tmp))) > 0)) {
+            buf.append(tmp, n);
+        }
+
+        if (std::string::npos != buf.find("+OK")) {
+            *pbReused = SSL_session_reused(ssl);
+            if (NULL != *ppSession) {
+                SSL_SESSION_free(*ppSession);
+            }
+            *ppSession = SSL_get1_session(ssl);
+            rv         = true;
+        }
+    }
+
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(sock);
+    ERR_clear_error();
+
+    return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stormThread
+//
+
+static void*
+stormThread(void* pData)
+{
+    storm* p              = (storm*)pData;
+    SSL_SESSION* pSession = NULL;
+
+    for (int i = 0; i < p->count; i++) {
+
+        bool bReused = false;
+        double start = now_us();
+        if (!reconnect(&pSession, &bReused)) {
+            p->errors++;
+            continue;
+        }
+
+        p->times.push_back(now_us() - start);
+        if (bReused) {
+            p->reused++;
+        }
+
+        // Start over with a full handshake next time
+        if (!p->bResume) {
+            SSL_SESSION_free(pSession);
+            pSession = NULL;
+        }
+    }
+
+    if (NULL != pSession) {
+        SSL_SESSION_free(pSession);
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+
+static void
+run(bool bResume)
+{
+    std::vector<storm> storms(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        storms[i].count   = count / nThreads + ((i < count % nThreads) ? 1 : 0);
+        storms[i].bResume = bResume;
+        storms[i].reused  = 0;
+        storms[i].errors  = 0;
+    }
+
+    double start = now_us();
+    for (int i = 0; i < nThreads; i++) {
+        pthread_create(&storms[i].thread, NULL, stormThread, &storms[i]);
+    }
+
+    std::vector<double> times;
+    int reused = 0;
+    int errors = 0;
+    for (int i = 0; i < nThreads; i++) {
+        pthread_join(storms[i].thread, NULL);
+        times.insert(times.end(), storms[i].times.begin(), storms[i].times.end());
+        reused += storms[i].reused;
+        errors += storms[i].errors;
+    }
+    double elapsed = now_us() - start;
+
+    std::sort(times.begin(), times.end());
+    double p50 = times.size() ? times[times.size() / 2] : 0;
+    double p99 = times.size() ? times[(times.size() * 99) / 100] : 0;
+    double max = times.size() ? times.back() : 0;
+
+    printf("%-8s %10.1f %10.0f %10.1f %10.1f %10.1f %8d %7d\n",
+           bResume ? "resumed" : "full",
+           elapsed / 1e3,
+           times.size() / (elapsed / 1e6),
+           p50 / 1e3,
+           p99 / 1e3,
+           max / 1e3,
+           reused,
+           errors);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// usage
+//
+
+static void
+usage(void)
+{
+    printf("Usage: bench_tcpip_tls [options]\n");
+    printf("  -h host      Daemon host (%s)\n", host);
+    printf("  -p port      Daemon SSL port (%s)\n", port);
+    printf("  -n count     Number of connections in each storm (%d)\n", count);
+    printf("  -t threads   Number of clients connecting at once (%d)\n",
+           nThreads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char* argv[])
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "h:p:n:t:"))) {
+        switch (opt) {
+            case 'h':
+                host = optarg;
+                break;
+            case 'p':
+                port = optarg;
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 't':
+                nThreads = atoi(optarg);
+                break;
+            default:
+                usage();
+                return -1;
+        }
+    }
+
+    if ((count <= 0) || (nThreads <= 0)) {
+        usage();
+        return -1;
+    }
+
+    if (nThreads > count) {
+        nThreads = count;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (0 != getaddrinfo(host, port, &hints, &addr)) {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        return -1;
+    }
+
+    // The daemon certificate is not verified
+    ctx = SSL_CTX_new(TLS_client_method());
+    if (NULL == ctx) {
+        fprintf(stderr, "Unable to create SSL context\n");
+        return -1;
+    }
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+
+    printf("%d connections from %d clients to %s:%s\n\n",
+           count,
+           nThreads,
+           host,
+           port);
+    printf("%-8s %10s %10s %10s %10s %10s %8s %7s\n",
+           "session",
+           "time [ms]",
+           "conn/s",
+           "p50 [ms]",
+           "p99 [ms]",
+           "max [ms]",
+           "resumed",
+           "errors");
+
+    run(false);
+    run(true);
+
+    SSL_CTX_free(ctx);
+    freeaddrinfo(addr);
+
+    return 0;
+}